@@ -0,0 +1,138 @@
+/*
+    Benchmark.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Measures an operation of the firmware, run repeatedly against the `Emulator` in the `native` build.
+*/
+
+#include "Benchmark.h"
+
+#ifdef NATIVE
+
+#include "stdio.h"
+#include "stdlib.h"
+
+static int compare_latency(const void* a, const void* b) {
+    unsigned long long first = *(const unsigned long long*)(a);
+    unsigned long long second = *(const unsigned long long*)(b);
+
+    return (first > second) - (first < second);
+};
+
+Benchmark::Benchmark(const char* name, Emulator* emulator) {
+    _name = name;
+    _emulator = emulator;
+    _num_samples = 0;
+};
+
+void Benchmark::start() {
+    _start_time = _emulator->now();
+    _start_spi_bytes = _emulator->spi_bytes();
+    _start_spi_transactions = _emulator->spi_transactions();
+};
+
+void Benchmark::stop(bool succeeded) {
+    /*
+        Record the sample started by `start()`; samples beyond BENCHMARK_MAX_SAMPLES are dropped
+    */
+
+    if (_num_samples == BENCHMARK_MAX_SAMPLES) {
+        return;
+    }
+
+    BenchmarkSample* sample = &_samples[_num_samples++];
+
+    sample->nanoseconds = _emulator->now() - _start_time;
+    sample->spi_bytes = _emulator->spi_bytes() - _start_spi_bytes;
+    sample->spi_transactions = _emulator->spi_transactions() - _start_spi_transactions;
+    sample->succeeded = succeeded;
+};
+
+int Benchmark::num_samples() {
+    return _num_samples;
+};
+
+int Benchmark::num_failures() {
+    int failures = 0;
+
+    for (int i = 0; i < _num_samples; i++) {
+        if (!_samples[i].succeeded) {
+            failures++;
+        }
+    }
+
+    return failures;
+};
+
+unsigned long long Benchmark::percentile(int percent) {
+    /*
+        The latency, in nanoseconds, that `percent`% of the samples took at most (nearest rank); 0 with no samples
+    */
+
+    if (_num_samples == 0) {
+        return 0;
+    }
+
+    unsigned long long latencies[BENCHMARK_MAX_SAMPLES];
+
+    for (int i = 0; i < _num_samples; i++) {
+        latencies[i] = _samples[i].nanoseconds;
+    }
+
+    qsort(latencies, _num_samples, sizeof(latencies[0]), compare_latency);
+
+    int rank = (percent * _num_samples + 99) / 100;
+
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    return latencies[rank - 1];
+};
+
+double Benchmark::mean_nanoseconds() {
+    double total = 0;
+
+    for (int i = 0; i < _num_samples; i++) {
+        total += _samples[i].nanoseconds;
+    }
+
+    return _num_samples ? total / _num_samples : 0;
+};
+
+double Benchmark::mean_spi_bytes() {
+    double total = 0;
+
+    for (int i = 0; i < _num_samples; i++) {
+        total += _samples[i].spi_bytes;
+    }
+
+    return _num_samples ? total / _num_samples : 0;
+};
+
+double Benchmark::mean_spi_transactions() {
+    double total = 0;
+
+    for (int i = 0; i < _num_samples; i++) {
+        total += _samples[i].spi_transactions;
+    }
+
+    return _num_samples ? total / _num_samples : 0;
+};
+
+void Benchmark::print_header() {
+    printf("%-40s %6s %6s %10s %10s %10s %10s %9s %9s\n", "operation", "runs", "failed", "p50 ms", "p90 ms", "p99 ms", "max ms",
+           "SPI B", "NSS txn");
+};
+
+void Benchmark::print() {
+    printf("%-40s %6d %6d %10.3f %10.3f %10.3f %10.3f %9.1f %9.1f\n", _name, _num_samples, num_failures(), percentile(50) / 1e6,
+           percentile(90) / 1e6, percentile(99) / 1e6, percentile(100) / 1e6, mean_spi_bytes(), mean_spi_transactions());
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+    Benchmark.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Measures an operation of the firmware, run repeatedly against the `Emulator` in the `native` build; for every run, the
+    simulated time it took, the bytes it put on the SPI bus, the SPI transactions (NSS going low) it made, and whether it
+    succeeded. Reports the latency percentiles, and the means of the rest.
+*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#ifdef NATIVE
+
+#include "Emulator.h"
+
+#ifndef BENCHMARK_MAX_SAMPLES
+#define BENCHMARK_MAX_SAMPLES       1000
+#endif
+
+struct BenchmarkSample {
+    unsigned long long nanoseconds;
+    unsigned long spi_bytes;
+    unsigned long spi_transactions;
+    bool succeeded;
+};
+
+class Benchmark {
+    public:
+        Benchmark(const char* name, Emulator* emulator);
+
+        void start();
+        void stop(bool succeeded);
+
+        template <typename operation>
+        bool measure(operation run) {
+            /*
+                Run `bool run()` once as a sample; returns what it returned
+            */
+
+            start();
+            bool succeeded = run();
+            stop(succeeded);
+
+            return succeeded;
+        };
+
+        int num_samples();
+        int num_failures();
+
+        unsigned long long percentile(int percent);
+        double mean_nanoseconds();
+        double mean_spi_bytes();
+        double mean_spi_transactions();
+
+        static void print_header();
+        void print();
+
+    private:
+        const char* _name;
+        Emulator* _emulator;
+
+        BenchmarkSample _samples[BENCHMARK_MAX_SAMPLES];
+        int _num_samples;
+
+        unsigned long long _start_time;
+        unsigned long _start_spi_bytes;
+        unsigned long _start_spi_transactions;
+};
+
+#endif
+
+#endif
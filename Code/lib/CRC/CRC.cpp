@@ -0,0 +1,62 @@
+/*
+    CRC.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Cyclic redundancy checks used to detect corrupted records.
+
+    The following sources were referenced.
+
+    https://reveng.sourceforge.io/crc-catalogue/all.htm
+*/
+
+#include "CRC.h"
+
+unsigned char crc8(unsigned char* bytes, int length, unsigned char crc) {
+    /*
+        Compute the CRC-8 of `length` bytes in `bytes`, bit by bit, so no lookup table is needed in SRAM or flash
+
+        Pass the result of a previous call in `crc` to continue the CRC over several separate arrays.
+    */
+
+    for (int i = 0; i < length; i++) {
+        crc ^= bytes[i];
+
+        for (int bit = 0; bit < 8; bit++) {
+            if (crc & 0x80) {
+                crc = (crc << 1) ^ CRC8_POLYNOMIAL;
+            } else {
+                crc <<= 1;
+            }
+        }
+    }
+
+    return crc;
+};
+
+unsigned int crc16(unsigned char* bytes, int length, unsigned int crc) {
+    /*
+        Compute the CRC-16 of `length` bytes in `bytes`, bit by bit, as `crc8()`; for records too long for a CRC-8 to protect
+        well, where a corrupted record must not pass for a valid one
+    */
+
+    for (int i = 0; i < length; i++) {
+        crc ^= (unsigned int)(bytes[i]) << 8;
+
+        for (int bit = 0; bit < 8; bit++) {
+            if (crc & 0x8000) {
+                crc = (crc << 1) ^ CRC16_POLYNOMIAL;
+            } else {
+                crc <<= 1;
+            }
+        }
+
+        crc &= 0xFFFF; // `unsigned int` is wider than 16 bits off the microcontroller
+    }
+
+    return crc;
+};
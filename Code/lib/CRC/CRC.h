@@ -0,0 +1,31 @@
+/*
+    CRC.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Cyclic redundancy checks used to detect corrupted records.
+
+    The following sources were referenced.
+
+    https://reveng.sourceforge.io/crc-catalogue/all.htm
+*/
+
+#ifndef CRC_H
+#define CRC_H
+
+// CRC-8/SMBUS; polynomial x^8 + x^2 + x + 1, initial value 0x00, no reflection
+#define CRC8_POLYNOMIAL     0x07
+#define CRC8_INITIAL        0x00
+
+// CRC-16/CCITT-FALSE; polynomial x^16 + x^12 + x^5 + 1, initial value 0xFFFF, no reflection
+#define CRC16_POLYNOMIAL    0x1021
+#define CRC16_INITIAL       0xFFFF
+
+unsigned char crc8(unsigned char* bytes, int length, unsigned char crc = CRC8_INITIAL);
+unsigned int crc16(unsigned char* bytes, int length, unsigned int crc = CRC16_INITIAL);
+
+#endif
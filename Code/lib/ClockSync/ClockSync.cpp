@@ -0,0 +1,148 @@
+/*
+    ClockSync.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Maps the millisecond tick counter of the microcontroller to the wall clock of the host.
+*/
+
+#include "ClockSync.h"
+
+ClockSync::ClockSync() {
+    reset();
+};
+
+bool ClockSync::sample(unsigned long tick, unsigned long seconds, unsigned int milliseconds, unsigned int round_trip) {
+    /*
+        Take the Unix time `seconds`.`milliseconds` of the host as the wall clock time at `tick`, placed within a round trip of
+        `round_trip` ms over the serial port; returns `false` if the sample was not taken
+    */
+
+    if (round_trip > CLOCK_SYNC_MAX_ROUND_TRIP || milliseconds >= 1000) {
+        return false;
+    }
+
+    if (_synced) {
+        unsigned long mapped_seconds;
+        unsigned int mapped_milliseconds;
+
+        wall_time(tick, &mapped_seconds, &mapped_milliseconds);
+
+        long seconds_behind = (long)(seconds - mapped_seconds);
+        long error = 0;
+
+        // Checked in seconds first, as the error in milliseconds might not fit
+        bool too_large = seconds_behind > CLOCK_SYNC_MAX_ERROR / 1000 + 1 || seconds_behind < -(CLOCK_SYNC_MAX_ERROR / 1000 + 1);
+
+        if (!too_large) {
+            error = seconds_behind * 1000 + (long)(milliseconds) - (long)(mapped_milliseconds);
+            too_large = error > CLOCK_SYNC_MAX_ERROR || error < -CLOCK_SYNC_MAX_ERROR;
+        }
+
+        if (!too_large) {
+            long span = (long)(tick - _anchor_tick);
+
+            if (span < CLOCK_SYNC_MIN_SPAN) {
+                _last_error = error;
+                return false;
+            }
+
+            // The error over the span, in parts per million; error * 10^6 / span, without overflowing
+            long uncorrected = (error * 10000) / (span / 100);
+
+            _drift += uncorrected / (1 << CLOCK_SYNC_SMOOTHING);
+
+            if (_drift > CLOCK_SYNC_MAX_DRIFT) {
+                _drift = CLOCK_SYNC_MAX_DRIFT;
+            } else if (_drift < -CLOCK_SYNC_MAX_DRIFT) {
+                _drift = -CLOCK_SYNC_MAX_DRIFT;
+            }
+
+            _last_error = error;
+            _samples++;
+        } else {
+            // The host's clock was set, or the tick counter started over; what was learnt no longer holds
+            _drift = 0;
+            _last_error = 0;
+            _samples = 1;
+        }
+    } else {
+        _synced = true;
+        _samples = 1;
+    }
+
+    _anchor_tick = tick;
+    _anchor_seconds = seconds;
+    _anchor_milliseconds = milliseconds;
+
+    return true;
+};
+
+bool ClockSync::wall_time(unsigned long tick, unsigned long* seconds, unsigned int* milliseconds) {
+    /*
+        Place the Unix time at `tick` in `seconds` and `milliseconds`; returns `false` if the host has not given the time yet.
+        Ticks before the anchor are mapped as well, as long as they are within 24 days of it
+    */
+
+    if (!_synced) {
+        return false;
+    }
+
+    long total = (long)(_anchor_milliseconds) + elapsed(tick);
+    long whole_seconds = total / 1000;
+    long remainder = total % 1000;
+
+    if (remainder < 0) {
+        remainder += 1000;
+        whole_seconds--;
+    }
+
+    *seconds = _anchor_seconds + whole_seconds;
+    *milliseconds = remainder;
+
+    return true;
+};
+
+void ClockSync::reset() {
+    _synced = false;
+
+    _anchor_tick = 0;
+    _anchor_seconds = 0;
+    _anchor_milliseconds = 0;
+
+    _drift = 0;
+    _last_error = 0;
+    _samples = 0;
+};
+
+bool ClockSync::synced() {
+    return _synced;
+};
+
+long ClockSync::drift() {
+    return _drift;
+};
+
+long ClockSync::last_error() {
+    return _last_error;
+};
+
+unsigned int ClockSync::samples() {
+    return _samples;
+};
+
+long ClockSync::elapsed(unsigned long tick) {
+    /*
+        The milliseconds of wall clock time from the anchor to `tick`, corrected for the drift; a drift in parts per million is
+        as many milliseconds per 1000 s, so the correction is worked out per 1000 s and per second to stay within 32 bits
+    */
+
+    long raw = (long)(tick - _anchor_tick);
+    long whole_seconds = raw / 1000;
+
+    return raw + (whole_seconds / 1000) * _drift + ((whole_seconds % 1000) * _drift) / 1000;
+};
@@ -0,0 +1,82 @@
+/*
+    ClockSync.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Maps the millisecond tick counter of the microcontroller to the wall clock of the host, so that events can be stamped when
+    they happen, on the device, and sent whenever the uplink gets to them, in bursts, without losing the time they happened.
+
+    The host gives the wall clock time at a tick now and then (see the SYNC exchange in `main.cpp`). The first time it does,
+    the tick is taken as an anchor, and any tick is mapped by the milliseconds elapsed from it, corrected by the drift of the
+    tick counter against the host's clock, in parts per million. Each time after that, the error of the mapping at the new tick
+    is measured; spread over the ticks elapsed since the anchor, it is the drift not yet corrected for, of which a part is
+    added to the drift, so that one sample thrown off by a late line does not throw the drift off as much. The new tick is then
+    taken as the anchor. A ceramic resonator drifts by up to thousands of parts per million, i.e. seconds a day, with the
+    temperature; a crystal by tens.
+
+    Samples whose round trip over the serial port took too long are not taken, as the host can only place the tick within it;
+    nor are those too close to the anchor to tell drift from jitter, and an error too large to be drift, as when the host's
+    clock is set, starts over from the new sample.
+
+    Wall clock time is kept as Unix time, in seconds and milliseconds, as Unix time in milliseconds does not fit 32 bits.
+
+    The following sources were referenced.
+
+    https://www.rfc-editor.org/rfc/rfc5905 [NTP] [Section 8]
+*/
+
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#ifndef CLOCK_SYNC_MAX_ROUND_TRIP
+#define CLOCK_SYNC_MAX_ROUND_TRIP   60 // ms; a SYNC and its reply take about 30 ms at 9600 baud
+#endif
+
+#ifndef CLOCK_SYNC_MIN_SPAN
+#define CLOCK_SYNC_MIN_SPAN         10000 // ms from the anchor before a sample is taken for the drift
+#endif
+
+#ifndef CLOCK_SYNC_MAX_ERROR
+#define CLOCK_SYNC_MAX_ERROR        2000 // ms; a larger error starts over
+#endif
+
+#ifndef CLOCK_SYNC_MAX_DRIFT
+#define CLOCK_SYNC_MAX_DRIFT        20000 // ppm
+#endif
+
+#ifndef CLOCK_SYNC_SMOOTHING
+#define CLOCK_SYNC_SMOOTHING        2 // The drift moves by 1 / 2^CLOCK_SYNC_SMOOTHING of each error measured
+#endif
+
+class ClockSync {
+    public:
+        ClockSync();
+
+        bool sample(unsigned long tick, unsigned long seconds, unsigned int milliseconds, unsigned int round_trip);
+        bool wall_time(unsigned long tick, unsigned long* seconds, unsigned int* milliseconds);
+        void reset();
+
+        bool synced();
+        long drift();
+        long last_error();
+        unsigned int samples();
+
+    private:
+        long elapsed(unsigned long tick);
+
+        bool _synced;
+
+        unsigned long _anchor_tick;             // Milliseconds on the tick counter
+        unsigned long _anchor_seconds;          // Unix time at the anchor
+        unsigned int _anchor_milliseconds;
+
+        long _drift;                            // Parts per million the tick counter runs slow by; negative if fast
+        long _last_error;                       // Milliseconds the mapping was behind the host at the last sample
+        unsigned int _samples;
+};
+
+#endif
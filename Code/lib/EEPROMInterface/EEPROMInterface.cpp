@@ -0,0 +1,90 @@
+/*
+    EEPROMInterface.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Reads and writes the ATMega328P's internal EEPROM.
+
+    The following sources were referenced.
+
+    https://ww1.microchip.com/downloads/en/DeviceDoc/Atmel-7810-Automotive-Microcontrollers-ATmega328P_Datasheet.pdf
+    [Section 7.4], [Section 7.6]
+*/
+
+#include "EEPROMInterface.h"
+
+EEPROMInterface::EEPROMInterface() {
+    ;
+};
+
+bool EEPROMInterface::ready() {
+    /*
+        A write takes about 3.4 ms, during which EEPE stays set and the EEPROM cannot be accessed [Section 7.6.3]
+    */
+
+    return !(EECR & (1 << EEPE));
+};
+
+unsigned char EEPROMInterface::read_byte(unsigned int address) {
+    // Follows the example in Section 7.6.3
+
+    while (!ready()) {
+        ; // Wait for any previous write to complete
+    }
+
+    EEARH = (unsigned char)(address >> 8);
+    EEARL = (unsigned char)(address);
+
+    // Start the read; the CPU is halted for four cycles and the byte is then available in EEDR
+    EECR |= (1 << EERE);
+
+    return EEDR;
+};
+
+bool EEPROMInterface::write_byte(unsigned int address, unsigned char byte) {
+    /*
+        Write `byte` at `address` with an atomic erase and write; skipped if the EEPROM already holds `byte`, since every write
+        wears the cell. Blocks only while a previous write is still in progress, so check `ready()` first to avoid stalling.
+
+        Follows the example in Section 7.6.3
+    */
+
+    if (address >= EEPROM_SIZE) {
+        return false;
+    }
+
+    if (read_byte(address) == byte) {
+        return true;
+    }
+
+    EEARH = (unsigned char)(address >> 8);
+    EEARL = (unsigned char)(address);
+    EEDR = byte;
+
+    // EEPE must be set within four clock cycles of setting EEMPE, so no interrupt may occur in between
+    unsigned char status = SREG;
+    SREG = status & ~(1 << SREG_I);
+
+    EECR |= (1 << EEMPE);
+    EECR |= (1 << EEPE);
+
+    SREG = status;
+
+    return true;
+};
+
+bool EEPROMInterface::read(unsigned int address, unsigned char* buffer, int length) {
+    if (address + length > EEPROM_SIZE) {
+        return false;
+    }
+
+    for (int i = 0; i < length; i++) {
+        buffer[i] = read_byte(address + i);
+    }
+
+    return true;
+};
@@ -0,0 +1,51 @@
+/*
+    EEPROMInterface.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Reads and writes the ATMega328P's internal EEPROM.
+
+    The following sources were referenced.
+
+    https://ww1.microchip.com/downloads/en/DeviceDoc/Atmel-7810-Automotive-Microcontrollers-ATmega328P_Datasheet.pdf
+    [Section 7.4], [Section 7.6]
+*/
+
+#ifndef EEPROMINTERFACE_H
+#define EEPROMINTERFACE_H
+
+#include "Registers.h"
+
+// Relevant registers and bit positions [Section 31]
+#define EECR        IO_REGISTER(0x3F)
+#define EEDR        IO_REGISTER(0x40)
+#define EEARL       IO_REGISTER(0x41)
+#define EEARH       IO_REGISTER(0x42)
+
+#define SREG        IO_REGISTER(0x5F)
+
+#define EERE        0
+#define EEPE        1
+#define EEMPE       2
+
+#define SREG_I      7
+
+#define EEPROM_SIZE 1024 // 1 KB on the ATMega328P
+
+class EEPROMInterface {
+    public:
+        EEPROMInterface();
+
+        bool ready();
+
+        unsigned char read_byte(unsigned int address);
+        bool write_byte(unsigned int address, unsigned char byte);
+
+        bool read(unsigned int address, unsigned char* buffer, int length);
+};
+
+#endif
@@ -0,0 +1,475 @@
+/*
+    Emulator.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Emulates the peripherals of the ATMega328P the libraries use, behind the emulated register file of the `native` build.
+
+    The following sources were referenced.
+
+    https://ww1.microchip.com/downloads/en/DeviceDoc/Atmel-7810-Automotive-Microcontrollers-ATmega328P_Datasheet.pdf
+    [Section 7.6], [Section 14], [Section 15], [Section 18], [Section 19], [Section 31]
+*/
+
+#include "Emulator.h"
+
+#ifdef NATIVE
+
+#include "Pins.h"
+#include "SPI.h"
+#include "Timer.h"
+#include "SerialInterface.h"
+#include "EEPROMInterface.h"
+
+#include "stdio.h"
+#include "string.h"
+
+// Addresses of the registers the emulator acts on [Section 31]; the libraries define the registers themselves
+#define PINB_ADDRESS        0x23
+#define PINC_ADDRESS        0x26
+#define PIND_ADDRESS        0x29
+#define PORTB_ADDRESS       0x25
+#define PORTC_ADDRESS       0x28
+#define PORTD_ADDRESS       0x2B
+
+#define TIFR0_ADDRESS       0x35
+#define EECR_ADDRESS        0x3F
+#define EEDR_ADDRESS        0x40
+#define EEARL_ADDRESS       0x41
+#define EEARH_ADDRESS       0x42
+#define TCCR0B_ADDRESS      0x45
+#define OCR0A_ADDRESS       0x47
+#define SPCR_ADDRESS        0x4C
+#define SPSR_ADDRESS        0x4D
+#define SPDR_ADDRESS        0x4E
+#define TCCR1B_ADDRESS      0x81
+#define TCNT1L_ADDRESS      0x84
+#define TCNT1H_ADDRESS      0x85
+#define UCSR0A_ADDRESS      0xC0
+#define UDR0_ADDRESS        0xC6
+
+#define SPR1                1
+#define SPI2X               0
+
+// Prescaling factors selected by the CS bits of Timer 0 and Timer 1; 6 and 7 select an external clock [Table 14-9], [Table 15-6]
+static const unsigned int prescalers[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+
+static unsigned char reverse_bits(unsigned char byte) {
+    unsigned char reversed = 0;
+
+    for (int i = 0; i < 8; i++) {
+        reversed = (reversed << 1) | ((byte >> i) & 0b1);
+    }
+
+    return reversed;
+};
+
+Emulator* Emulator::_attached = nullptr;
+
+Emulator::Emulator() {
+    _now = 0;
+    _num_spi_devices = 0;
+    _num_events = 0;
+
+    _timer1_start = 0;
+    _timer1_start_count = 0;
+    _timer1_temp = 0;
+    _eeprom_busy_until = 0;
+
+    _serial_input_length = 0;
+    _serial_input_position = 0;
+    _echo_serial = true;
+
+    // An erased EEPROM reads 0xFF
+    memset(eeprom, 0xFF, EMULATED_EEPROM_SIZE);
+
+    reset_counters();
+};
+
+void Emulator::attach() {
+    /*
+        Route the emulated registers to this emulator, starting them from their reset values
+    */
+
+    reset_registers();
+
+    _attached = this;
+    set_register_hooks(on_read, on_write);
+};
+
+void Emulator::detach() {
+    if (_attached == this) {
+        _attached = nullptr;
+        set_register_hooks(nullptr, nullptr);
+    }
+};
+
+bool Emulator::add_spi_device(SPI_Device* device, unsigned char port, unsigned char pin) {
+    /*
+        Put `device` on the SPI bus, with its NSS on pin `pin` of `port` (B, C or D, as for `Pin`)
+    */
+
+    if (_num_spi_devices == MAX_SPI_DEVICES) {
+        return false;
+    }
+
+    _spi_devices[_num_spi_devices] = device;
+    _spi_device_ports[_num_spi_devices] = port;
+    _spi_device_pins[_num_spi_devices] = pin;
+    _num_spi_devices++;
+
+    return true;
+};
+
+unsigned long long Emulator::now() {
+    // Simulated time in nanoseconds
+    return _now;
+};
+
+unsigned long Emulator::now_microseconds() {
+    return (unsigned long)(_now / 1000);
+};
+
+void Emulator::advance(unsigned long long nanoseconds) {
+    /*
+        Move the simulated time forward, running the events that fall due on the way, in order
+    */
+
+    unsigned long long until = _now + nanoseconds;
+
+    while (true) {
+        int next = -1;
+
+        for (int i = 0; i < _num_events; i++) {
+            if (_event_times[i] <= until && (next < 0 || _event_times[i] < _event_times[next])) {
+                next = i;
+            }
+        }
+
+        if (next < 0) {
+            break;
+        }
+
+        emulator_event event = _events[next];
+        void* context = _event_contexts[next];
+
+        if (_event_times[next] > _now) {
+            _now = _event_times[next];
+        }
+
+        _num_events--;
+        _events[next] = _events[_num_events];
+        _event_contexts[next] = _event_contexts[_num_events];
+        _event_times[next] = _event_times[_num_events];
+
+        event(context);
+    }
+
+    _now = until;
+};
+
+bool Emulator::schedule(unsigned long long time, emulator_event event, void* context) {
+    /*
+        Call `event(context)` once the simulated time reaches `time`, in nanoseconds; returns `false` if MAX_EMULATOR_EVENTS
+        events are already waiting
+    */
+
+    if (_num_events == MAX_EMULATOR_EVENTS) {
+        return false;
+    }
+
+    _events[_num_events] = event;
+    _event_contexts[_num_events] = context;
+    _event_times[_num_events] = time;
+    _num_events++;
+
+    return true;
+};
+
+bool Emulator::feed_serial(const unsigned char* bytes, int length) {
+    /*
+        Queue `length` bytes to be received by the USART
+    */
+
+    // Move what is left unread to the front
+    memmove(_serial_input, _serial_input + _serial_input_position, _serial_input_length - _serial_input_position);
+    _serial_input_length -= _serial_input_position;
+    _serial_input_position = 0;
+
+    if (_serial_input_length + length > SERIAL_INPUT_SIZE) {
+        return false;
+    }
+
+    memcpy(_serial_input + _serial_input_length, bytes, length);
+    _serial_input_length += length;
+
+    return true;
+};
+
+void Emulator::echo_serial(bool on) {
+    // Write the bytes the USART sends to the standard output; on by default
+    _echo_serial = on;
+};
+
+unsigned long Emulator::spi_bytes() {
+    return _spi_bytes;
+};
+
+unsigned long Emulator::spi_transactions() {
+    // Number of times a device was selected
+    return _spi_transactions;
+};
+
+unsigned long Emulator::eeprom_writes() {
+    return _eeprom_writes;
+};
+
+void Emulator::reset_counters() {
+    _spi_bytes = 0;
+    _spi_transactions = 0;
+    _eeprom_writes = 0;
+};
+
+unsigned char Emulator::on_read(unsigned int address, unsigned char stored) {
+    return _attached ? _attached->read(address, stored) : stored;
+};
+
+unsigned char Emulator::on_write(unsigned int address, unsigned char stored, unsigned char written) {
+    return _attached ? _attached->write(address, stored, written) : written;
+};
+
+unsigned char Emulator::read(unsigned int address, unsigned char stored) {
+    switch (address) {
+        case PINB_ADDRESS:
+        case PINC_ADDRESS:
+        case PIND_ADDRESS:
+            // Nothing drives the pins from outside; they read back what the port drives, or its pull-ups
+            return emulated_registers[address + 2].value;
+
+        case SPDR_ADDRESS:
+            // Reading SPDR after SPSR clears SPIF [Section 18.5.2]
+            emulated_registers[SPSR_ADDRESS].value &= ~(1 << SPIF);
+            return stored;
+
+        case TIFR0_ADDRESS: {
+            // The firmware is waiting for the next compare match; let a compare period pass
+            unsigned long long period = timer0_period();
+
+            if (!(stored & (1 << OCF0A)) && period) {
+                advance(period);
+                stored |= (1 << OCF0A);
+                emulated_registers[TIFR0_ADDRESS].value = stored;
+            }
+
+            return stored;
+        }
+
+        case TCNT1L_ADDRESS: {
+            // Reading the low byte latches the high byte into TEMP [Section 15.3]
+            advance(EMULATED_POLL_NS);
+
+            unsigned int count = timer1_count();
+            _timer1_temp = (unsigned char)(count >> 8);
+
+            return (unsigned char)(count);
+        }
+
+        case TCNT1H_ADDRESS:
+            return _timer1_temp;
+
+        case EECR_ADDRESS:
+            // EEPE stays set until the write completes; polling it takes time
+            if (_now < _eeprom_busy_until) {
+                advance(EMULATED_POLL_NS);
+                return stored | (1 << EEPE);
+            }
+
+            return stored & ~(1 << EEPE);
+
+        case UCSR0A_ADDRESS:
+            // Sending is immediate, so the data register is always empty
+            return (stored & ~((1 << RXC0) | (1 << UDRE0))) | (1 << UDRE0) |
+                   ((_serial_input_position < _serial_input_length) ? (1 << RXC0) : 0);
+
+        case UDR0_ADDRESS:
+            if (_serial_input_position < _serial_input_length) {
+                return _serial_input[_serial_input_position++];
+            }
+
+            return stored;
+
+        default:
+            return stored;
+    }
+};
+
+unsigned char Emulator::write(unsigned int address, unsigned char stored, unsigned char written) {
+    switch (address) {
+        case PORTB_ADDRESS:
+        case PORTC_ADDRESS:
+        case PORTD_ADDRESS:
+            port_written(address - 0x22, stored, written);
+            return written;
+
+        case SPDR_ADDRESS: {
+            // Writing SPDR starts a transfer, if the SPI is enabled [Section 18.5.3]
+            if (!(emulated_registers[SPCR_ADDRESS].value & (1 << SPE))) {
+                return written;
+            }
+
+            advance(spi_byte_time());
+            unsigned char received = spi_transfer(written);
+            emulated_registers[SPSR_ADDRESS].value |= (1 << SPIF);
+
+            return received;
+        }
+
+        case TIFR0_ADDRESS:
+            // Flags are cleared by writing a 1 to them [Section 14.9.7]
+            return stored & ~written;
+
+        case TCCR1B_ADDRESS:
+            // The count so far is kept, and continues at the new prescaling factor
+            _timer1_start_count = timer1_count();
+            _timer1_start = _now;
+            return written;
+
+        case TCNT1H_ADDRESS:
+            // Writing the high byte only fills TEMP; it is written along with the low byte [Section 15.3]
+            _timer1_temp = written;
+            return written;
+
+        case TCNT1L_ADDRESS:
+            _timer1_start_count = ((unsigned int)(_timer1_temp) << 8) | written;
+            _timer1_start = _now;
+            return written;
+
+        case EECR_ADDRESS: {
+            unsigned int eeprom_address = ((emulated_registers[EEARH_ADDRESS].value << 8) |
+                                           emulated_registers[EEARL_ADDRESS].value) % EMULATED_EEPROM_SIZE;
+
+            // Setting EEPE while EEMPE is set starts a write [Section 7.6.3]
+            if ((written & (1 << EEPE)) && (stored & (1 << EEMPE)) && _now >= _eeprom_busy_until) {
+                eeprom[eeprom_address] = emulated_registers[EEDR_ADDRESS].value;
+                _eeprom_busy_until = _now + EMULATED_EEPROM_WRITE_NS;
+                _eeprom_writes++;
+
+                // EEMPE clears itself after four clock cycles
+                written &= ~(1 << EEMPE);
+            }
+
+            if (written & (1 << EERE)) {
+                emulated_registers[EEDR_ADDRESS].value = eeprom[eeprom_address];
+                written &= ~(1 << EERE);
+            }
+
+            return written & ~(1 << EEPE);
+        }
+
+        case UDR0_ADDRESS:
+            if (_echo_serial) {
+                putchar(written);
+                fflush(stdout);
+            }
+
+            return written;
+
+        default:
+            return written;
+    }
+};
+
+unsigned char Emulator::spi_transfer(unsigned char byte) {
+    /*
+        Exchange `byte` with every selected device; MISO is pulled up when nothing drives it, and devices driving it at once are
+        taken to pull it low
+    */
+
+    unsigned char master_order = (emulated_registers[SPCR_ADDRESS].value >> DORD) & 0b1;
+    unsigned char received = 0xFF;
+
+    for (int i = 0; i < _num_spi_devices; i++) {
+        unsigned char port = emulated_registers[_spi_device_ports[i] + 0x22].value;
+
+        if (port & (1 << _spi_device_pins[i])) {
+            continue;
+        }
+
+        bool reversed = (_spi_devices[i]->data_order() != master_order);
+
+        unsigned char response = _spi_devices[i]->transfer(reversed ? reverse_bits(byte) : byte, _now);
+        received &= reversed ? reverse_bits(response) : response;
+    }
+
+    _spi_bytes++;
+
+    return received;
+};
+
+void Emulator::port_written(unsigned char port, unsigned char previous, unsigned char current) {
+    /*
+        Select the devices whose NSS went low, and deselect those whose NSS went high
+    */
+
+    for (int i = 0; i < _num_spi_devices; i++) {
+        if (_spi_device_ports[i] != port) {
+            continue;
+        }
+
+        unsigned char mask = (1 << _spi_device_pins[i]);
+
+        if ((previous & mask) && !(current & mask)) {
+            _spi_transactions++;
+            _spi_devices[i]->select(_now);
+        } else if (!(previous & mask) && (current & mask)) {
+            _spi_devices[i]->deselect(_now);
+        }
+    }
+};
+
+unsigned long long Emulator::spi_byte_time() {
+    /*
+        Eight SCK periods; SCK is the CPU clock divided by 4, 16, 64 or 128 as set by SPR1 and SPR0, and doubled by SPI2X
+        [Table 18-5]
+    */
+
+    static const unsigned int dividers[4] = {4, 16, 64, 128};
+
+    unsigned char spcr = emulated_registers[SPCR_ADDRESS].value;
+    unsigned int divider = dividers[((spcr >> SPR1) & 0b1) << 1 | ((spcr >> SPR0) & 0b1)];
+
+    if (emulated_registers[SPSR_ADDRESS].value & (1 << SPI2X)) {
+        divider /= 2;
+    }
+
+    return 8ULL * divider * 1000000000ULL / EMULATED_CPU_FREQ;
+};
+
+unsigned long long Emulator::timer0_period() {
+    /*
+        In CTC mode, OCF0A is set every (OCR0A + 1) timer clocks [Section 14.7.2]; 0 if Timer 0 is stopped
+    */
+
+    unsigned int prescaler = prescalers[emulated_registers[TCCR0B_ADDRESS].value & 0b111];
+    unsigned long long cycles = (unsigned long long)(prescaler) * (emulated_registers[OCR0A_ADDRESS].value + 1);
+
+    return cycles * 1000000000ULL / EMULATED_CPU_FREQ;
+};
+
+unsigned long Emulator::timer1_count() {
+    unsigned int prescaler = prescalers[emulated_registers[TCCR1B_ADDRESS].value & 0b111];
+
+    if (!prescaler) {
+        return _timer1_start_count;
+    }
+
+    unsigned long long cycles = (_now - _timer1_start) * (EMULATED_CPU_FREQ / 1000000ULL) / 1000ULL;
+
+    return (_timer1_start_count + cycles / prescaler) & 0xFFFF;
+};
+
+#endif
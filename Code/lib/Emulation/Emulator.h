@@ -0,0 +1,128 @@
+/*
+    Emulator.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Emulates the peripherals of the ATMega328P the libraries use, behind the emulated register file of the `native` build (see
+    Registers.h), so that the firmware runs unchanged on a computer, against simulated chips (e.g. `PN532_Model`).
+
+    Time is simulated, and only moves when the firmware waits for something; a byte on the SPI takes as long as it would at the
+    configured SPI clock, a Timer 0 compare period passes whenever `blocking_delay()` polls for it, and an EEPROM write takes
+    3.4 ms. So the time reported is what the firmware would take on the microcontroller, apart from its own computation.
+
+    Modelled are
+        - the SPI master, transferring each byte written to SPDR with the devices whose NSS pin is low
+        - the I/O ports; a write to PORTx selects or deselects the devices on it, and PINx reads back PORTx
+        - Timer 0 in CTC mode, and Timer 1 counting freely, with the 16-bit TEMP register
+        - the EEPROM, with the EEMPE / EEPE write sequence
+        - the USART, to the standard output and from a buffer filled with `feed_serial()`
+
+    Only one emulator is attached to the registers at a time.
+
+    The following sources were referenced.
+
+    https://ww1.microchip.com/downloads/en/DeviceDoc/Atmel-7810-Automotive-Microcontrollers-ATmega328P_Datasheet.pdf
+    [Section 7.6], [Section 14], [Section 15], [Section 18], [Section 19], [Section 31]
+*/
+
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#ifdef NATIVE
+
+#include "Registers.h"
+#include "SPI_Device.h"
+
+#define EMULATED_CPU_FREQ           16000000ULL // 16 MHz
+#define EMULATED_EEPROM_SIZE        1024
+#define EMULATED_EEPROM_WRITE_NS    3400000ULL  // 3.4 ms [Table 7-3]
+#define EMULATED_POLL_NS            1000ULL     // Time a poll of TCNT1 is taken to cost, so that loops waiting on it progress
+
+#ifndef MAX_SPI_DEVICES
+#define MAX_SPI_DEVICES             8
+#endif
+
+#define SERIAL_INPUT_SIZE           256
+
+#ifndef MAX_EMULATOR_EVENTS
+#define MAX_EMULATOR_EVENTS         4
+#endif
+
+// Called at a scheduled simulated time, e.g. to take a tag out of a field; it must not access the registers
+typedef void (*emulator_event)(void* context);
+
+class Emulator {
+    public:
+        Emulator();
+
+        void attach();
+        void detach();
+
+        bool add_spi_device(SPI_Device* device, unsigned char port, unsigned char pin);
+
+        unsigned long long now();
+        unsigned long now_microseconds();
+        void advance(unsigned long long nanoseconds);
+        bool schedule(unsigned long long time, emulator_event event, void* context);
+
+        bool feed_serial(const unsigned char* bytes, int length);
+        void echo_serial(bool on);
+
+        // Counters, for measuring what a piece of firmware costs; cleared by `reset_counters()`
+        unsigned long spi_bytes();
+        unsigned long spi_transactions();
+        unsigned long eeprom_writes();
+        void reset_counters();
+
+        unsigned char eeprom[EMULATED_EEPROM_SIZE];
+
+    private:
+        static unsigned char on_read(unsigned int address, unsigned char stored);
+        static unsigned char on_write(unsigned int address, unsigned char stored, unsigned char written);
+
+        unsigned char read(unsigned int address, unsigned char stored);
+        unsigned char write(unsigned int address, unsigned char stored, unsigned char written);
+
+        unsigned char spi_transfer(unsigned char byte);
+        void port_written(unsigned char port, unsigned char previous, unsigned char current);
+        unsigned long long spi_byte_time();
+        unsigned long long timer0_period();
+        unsigned long timer1_count();
+
+        unsigned long long _now;
+
+        emulator_event _events[MAX_EMULATOR_EVENTS];
+        void* _event_contexts[MAX_EMULATOR_EVENTS];
+        unsigned long long _event_times[MAX_EMULATOR_EVENTS];
+        int _num_events;
+
+        SPI_Device* _spi_devices[MAX_SPI_DEVICES];
+        unsigned char _spi_device_ports[MAX_SPI_DEVICES];
+        unsigned char _spi_device_pins[MAX_SPI_DEVICES];
+        int _num_spi_devices;
+
+        unsigned long long _timer1_start;
+        unsigned int _timer1_start_count;
+        unsigned char _timer1_temp;
+
+        unsigned long long _eeprom_busy_until;
+
+        unsigned char _serial_input[SERIAL_INPUT_SIZE];
+        int _serial_input_length;
+        int _serial_input_position;
+        bool _echo_serial;
+
+        unsigned long _spi_bytes;
+        unsigned long _spi_transactions;
+        unsigned long _eeprom_writes;
+
+        static Emulator* _attached;
+};
+
+#endif
+
+#endif
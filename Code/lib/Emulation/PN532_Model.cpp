@@ -0,0 +1,919 @@
+/*
+    PN532_Model.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    A behavioural model of the PN532 on the emulated SPI bus.
+
+    The following sources were referenced.
+
+    https://www.nxp.com/docs/en/user-guide/141520.pdf [PN532UM]
+    https://www.nxp.com/docs/en/nxp/data-sheets/PN532_C1.pdf [PN532DS]
+    http://www.emutag.com/iso/14443-4.pdf [ISO-4]
+*/
+
+#include "PN532_Model.h"
+
+#ifdef NATIVE
+
+#include "PN532.h"
+#include "PN532_Commands.h"
+
+#include "string.h"
+
+// Sent in place of the response when the command cannot be executed [Section 6.2.1.5 (PN532UM)]
+static const unsigned char ERROR_FRAME[] = {PREAMBLE, STARTCODE1, STARTCODE2, 0x01, 0xFF, 0x7F, 0x81, POSTAMBLE};
+
+// What the host gets when it clocks out more than the PN532 has to send
+#define IDLE_BYTE           0x00
+
+PN532_Model::PN532_Model() {
+    _operation = 0;
+    _first_byte = false;
+    _received_length = 0;
+
+    _queue_size = 0;
+    _read_position = 0;
+    _read_started = false;
+
+    _last_response_length = 0;
+    _responses_read = 0;
+    _corrupt_read = false;
+
+    _num_cards = 0;
+    _num_targets = 0;
+
+    power_up();
+
+    set_timing(PN532_MODEL_ACK_DELAY, PN532_MODEL_RESPONSE_DELAY, PN532_MODEL_RF_EXCHANGE);
+    set_jitter(0, 1);
+    set_corruption(0);
+
+    _receiver_modelled = false;
+    _error_state = 1;
+
+    reset_counters();
+};
+
+void PN532_Model::set_powered(bool on) {
+    /*
+        Cut the power of the PN532, as a brown-out of it alone would, or restore it; while off, it answers nothing, and once back
+        on, it has lost its configuration and any response that was pending
+    */
+
+    if (on && !_powered) {
+        power_up();
+    }
+
+    _powered = on;
+};
+
+void PN532_Model::power_up() {
+    _powered = true;
+
+    _queue_size = 0;
+    _operation = 0;
+    clear_targets();
+
+    _rf_field = false;
+    _activation_retries = 0xFF; // Retry forever, until changed with RF_CONFIGURATION [Section 7.3.1 (PN532UM)]
+    _parameters = PROFILE_ISO_DEP;
+
+    // The analog settings for ISO14443A are loaded at power up [Section 7.3.1 (PN532UM)]
+    memset(_registers, 0, sizeof(_registers));
+    write_register(CIU_RF_CFG, ANALOG_106_A_DEFAULTS[ANALOG_RF_CFG_IDX]);
+    write_register(CIU_RX_THRESHOLD, ANALOG_106_A_DEFAULTS[ANALOG_RX_THRESHOLD_IDX]);
+};
+
+void PN532_Model::select(unsigned long long /* now */) {
+    _first_byte = true;
+    _received_length = 0;
+    _read_started = false;
+};
+
+void PN532_Model::deselect(unsigned long long now) {
+    /*
+        A transaction ends when NSS goes high; a frame written is executed, and a frame read is done with [Section 6.2.5 (PN532UM)]
+    */
+
+    if (!_powered) {
+        ;
+    } else if (_operation == DATA_WRITE && !_first_byte) {
+        handle_frame(now);
+    } else if (_operation == DATA_READ && _read_started) {
+        if (is_response(0)) {
+            memcpy(_last_response, _queue[0], _queue_lengths[0]);
+            _last_response_length = _queue_lengths[0];
+        }
+
+        pop();
+    }
+
+    _operation = 0;
+};
+
+unsigned char PN532_Model::transfer(unsigned char byte, unsigned long long now) {
+    // Without power, MISO is never driven
+    if (!_powered) {
+        return 0x00;
+    }
+
+    // The first byte of a transaction tells what it is [Section 6.2.5 (PN532UM)]
+    if (_first_byte) {
+        _first_byte = false;
+        _operation = byte;
+
+        if (_operation == STATUS_READ) {
+            _status_polls++;
+        } else if (_operation == DATA_READ) {
+            // A frame can only be read once it is ready
+            _read_started = frame_ready(now);
+            _read_position = 0;
+            _corrupt_read = false;
+
+            if (_read_started && is_response(0)) {
+                _responses_read++;
+                _corrupt_read = (_corruption_interval != 0) && (_responses_read % _corruption_interval == 0);
+            }
+        }
+
+        return IDLE_BYTE;
+    }
+
+    switch (_operation) {
+        case STATUS_READ:
+            // Bit 0 is set once a frame is ready to be read [Section 6.2.5.1 (PN532UM)]
+            return frame_ready(now) ? 0x01 : 0x00;
+
+        case DATA_WRITE:
+            if (_received_length < PN532_MODEL_MAX_FRAME) {
+                _received[_received_length++] = byte;
+            }
+
+            return IDLE_BYTE;
+
+        case DATA_READ:
+            if (_read_started && _read_position < _queue_lengths[0]) {
+                unsigned char sent = _queue[0][_read_position++];
+
+                // A bit flipped in PD0 fails the DCS
+                return (_corrupt_read && _read_position - 1 == OPCODE_IDX) ? sent ^ 0x01 : sent;
+            }
+
+            return IDLE_BYTE;
+
+        default:
+            return IDLE_BYTE;
+    }
+};
+
+unsigned char PN532_Model::data_order() {
+    // The PN532 shifts bytes LSB first on its SPI [Section 8.3.5 (PN532DS)]
+    return LSB_FIRST;
+};
+
+bool PN532_Model::add_card(Simulated_Card* card) {
+    // Bring `card` into the field
+    if (_num_cards == PN532_MODEL_MAX_CARDS) {
+        return false;
+    }
+
+    card->reset();
+    _cards[_num_cards++] = card;
+
+    return true;
+};
+
+bool PN532_Model::remove_card(Simulated_Card* card) {
+    // Take `card` out of the field; a target it was stays gone
+    for (int i = 0; i < _num_cards; i++) {
+        if (_cards[i] != card) {
+            continue;
+        }
+
+        _cards[i] = _cards[--_num_cards];
+
+        for (int j = 0; j < _num_targets; j++) {
+            if (_targets[j] == card) {
+                _targets[j] = nullptr;
+            }
+        }
+
+        return true;
+    }
+
+    return false;
+};
+
+void PN532_Model::set_timing(unsigned long ack_delay, unsigned long response_delay, unsigned long rf_exchange) {
+    /*
+        Set, in microseconds, how long after a frame is written its ACK is ready, how long after that the response is ready (not
+        counting the RF), and how long each exchange with a tag, or attempt to activate one, takes
+    */
+
+    _ack_delay = ack_delay * 1000ULL;
+    _response_delay = response_delay * 1000ULL;
+    _rf_exchange = rf_exchange * 1000ULL;
+};
+
+void PN532_Model::set_jitter(unsigned long jitter, unsigned long seed) {
+    /*
+        Delay every response by a further pseudorandom 0 to `jitter` microseconds, as the firmware of the PN532 does not take the
+        same time every time, counted from when the host would first have found it ready; the same `seed` (non-zero) gives the
+        same delays
+    */
+
+    _jitter = jitter;
+    _random_state = seed ? seed : 1;
+};
+
+unsigned long long PN532_Model::jitter() {
+    if (_jitter == 0) {
+        return 0;
+    }
+
+    // xorshift32
+    _random_state ^= _random_state << 13;
+    _random_state ^= _random_state >> 17;
+    _random_state ^= _random_state << 5;
+
+    return (_random_state % (_jitter + 1)) * 1000ULL;
+};
+
+void PN532_Model::set_corruption(unsigned long interval) {
+    /*
+        Flip a bit in every `interval`th response frame (not ACK) read by the host, as noise on the bus would, while the frame
+        kept to be sent again on a NACK stays intact; 0 to corrupt none
+    */
+
+    _corruption_interval = interval;
+};
+
+void PN532_Model::set_receiver_optimum(unsigned char rx_gain, unsigned char min_level) {
+    /*
+        Have exchanges fail with a CRC error, pseudorandomly, more often the further the receiver gain (CIU_RFCfg) and minimum
+        level (CIU_RxThreshold) are from `rx_gain` and `min_level`, as with an antenna detuned by metal nearby
+    */
+
+    _receiver_modelled = true;
+    _optimum_gain = rx_gain;
+    _optimum_level = min_level;
+};
+
+bool PN532_Model::rf_error() {
+    if (!_receiver_modelled) {
+        return false;
+    }
+
+    int gain = (read_register(CIU_RF_CFG) >> 4) & 0x07;
+    int level = read_register(CIU_RX_THRESHOLD) >> 4;
+
+    int percent = PN532_MODEL_GAIN_PENALTY * ((gain > _optimum_gain) ? gain - _optimum_gain : _optimum_gain - gain) +
+                  PN532_MODEL_LEVEL_PENALTY * ((level > _optimum_level) ? level - _optimum_level : _optimum_level - level);
+
+    // xorshift32, apart from the jitter's, so that the jitter stays the same
+    _error_state ^= _error_state << 13;
+    _error_state ^= _error_state >> 17;
+    _error_state ^= _error_state << 5;
+
+    return (int)(_error_state % 100) < percent;
+};
+
+unsigned char PN532_Model::read_register(unsigned int address) {
+    // Only the CIU registers are kept; anything else reads 0
+    if (address < PN532_MODEL_CIU_BASE || address >= PN532_MODEL_CIU_BASE + PN532_MODEL_CIU_SIZE) {
+        return 0;
+    }
+
+    return _registers[address - PN532_MODEL_CIU_BASE];
+};
+
+void PN532_Model::write_register(unsigned int address, unsigned char value) {
+    if (address >= PN532_MODEL_CIU_BASE && address < PN532_MODEL_CIU_BASE + PN532_MODEL_CIU_SIZE) {
+        _registers[address - PN532_MODEL_CIU_BASE] = value;
+    }
+};
+
+bool PN532_Model::rf_field() {
+    return _rf_field;
+};
+
+unsigned long PN532_Model::frames_received() {
+    return _frames_received;
+};
+
+unsigned long PN532_Model::status_polls() {
+    return _status_polls;
+};
+
+unsigned long PN532_Model::frame_errors() {
+    // Frames dropped for a wrong preamble, LCS, TFI, or DCS
+    return _frame_errors;
+};
+
+unsigned long PN532_Model::nacks_received() {
+    return _nacks_received;
+};
+
+unsigned long PN532_Model::rf_exchanges() {
+    // Exchanges with tags, and attempts to activate them; for an ISO14443-4 tag, each block sent and answered
+    return _rf_exchanges;
+};
+
+void PN532_Model::reset_counters() {
+    _frames_received = 0;
+    _status_polls = 0;
+    _frame_errors = 0;
+    _nacks_received = 0;
+    _rf_exchanges = 0;
+};
+
+void PN532_Model::handle_frame(unsigned long long now) {
+    /*
+        Check the frame written, ACK it, and execute the command in it
+
+        PREAMBLE STARTCODE1 STARTCODE2 LEN LCS TFI PD0 ... PDn DCS POSTAMBLE [Section 6.2.1.1 (PN532UM)]
+    */
+
+    unsigned char* frame = _received;
+
+    if (_received_length < ACK_SIZE || frame[PREAMBLE_IDX] != PREAMBLE || frame[STARTCODE1_IDX] != STARTCODE1 ||
+        frame[STARTCODE2_IDX] != STARTCODE2) {
+        _frame_errors++;
+        return;
+    }
+
+    // A NACK from the host has the last response sent again [Section 6.2.1.4 (PN532UM)]
+    if (memcmp(frame, NACK_FRAME, NACK_SIZE) == 0) {
+        _nacks_received++;
+
+        if (_last_response_length > 0) {
+            _queue_size = 0;
+            queue(_last_response, _last_response_length, now + _ack_delay);
+        }
+
+        return;
+    }
+
+    // An ACK from the host aborts the command being executed [Section 6.2.1.3 (PN532UM)]
+    if (memcmp(frame, ACK_FRAME, ACK_SIZE) == 0) {
+        _queue_size = 0;
+        return;
+    }
+
+    int length = frame[LEN_IDX];
+
+    if ((unsigned char)(frame[LEN_IDX] + frame[LCS_IDX]) != 0 || length < 2 ||
+        _received_length < FRAME_HEADER_SIZE + length - 1 + FRAME_TRAILER_SIZE || frame[TFI_IDX] != TFI_HOST_TO_PN532) {
+        _frame_errors++;
+        return;
+    }
+
+    unsigned char sum = 0;
+
+    for (int i = 0; i <= length; i++) {
+        sum += frame[TFI_IDX + i];
+    }
+
+    if (sum != 0) {
+        _frame_errors++;
+        return;
+    }
+
+    _frames_received++;
+
+    // A new command replaces whatever was left unread
+    _queue_size = 0;
+
+    queue(ACK_FRAME, ACK_SIZE, now + _ack_delay);
+    execute(frame + OPCODE_IDX, length - 1, now + _ack_delay + _response_delay);
+
+    if (_queue_size > 0 && is_response(_queue_size - 1)) {
+        _queue_jitters[_queue_size - 1] = jitter();
+    }
+};
+
+void PN532_Model::execute(unsigned char* command, int length, unsigned long long ready_time) {
+    unsigned char response[PN532_MODEL_MAX_FRAME];
+    int response_length = 0;
+
+    response[0] = command[0] + 1;
+
+    switch (command[0]) {
+        case SAM_CONFIGURATION:
+            response_length = 1;
+            break;
+
+        case SET_PARAMETERS:
+            // Flags [Section 7.2.9 (PN532UM)]
+            if (length >= 2) {
+                _parameters = command[1];
+            }
+
+            response_length = 1;
+            break;
+
+        case GET_FIRMWARE_VERSION:
+            response[1] = PN532_MODEL_IC;
+            response[2] = PN532_MODEL_VERSION;
+            response[3] = PN532_MODEL_REVISION;
+            response[4] = PN532_MODEL_SUPPORT;
+            response_length = 5;
+            break;
+
+        case RF_CONFIGURATION:
+            // CfgItem ConfigurationData [Section 7.3.1 (PN532UM)]
+            if (length >= 3 && command[1] == RF_FIELD_ITEM) {
+                _rf_field = command[2] & 0b1;
+
+                if (!_rf_field) {
+                    // Tags lose power, and forget what they were doing
+                    for (int i = 0; i < _num_cards; i++) {
+                        _cards[i]->reset();
+                    }
+
+                    clear_targets();
+                }
+            } else if (length >= 5 && command[1] == MAX_RETRIES_ITEM) {
+                _activation_retries = command[4];
+            } else if (length >= 2 + ANALOG_SETTINGS_SIZE && command[1] == ANALOG_106_A_ITEM) {
+                // Only the receiver settings are kept
+                write_register(CIU_RF_CFG, command[2 + ANALOG_RF_CFG_IDX]);
+                write_register(CIU_RX_THRESHOLD, command[2 + ANALOG_RX_THRESHOLD_IDX]);
+            }
+
+            response_length = 1;
+            break;
+
+        case READ_REGISTER:
+            // ADR1H ADR1L ...; response is Val1 ... [Section 7.2.4 (PN532UM)]
+            for (int i = 1; i + 1 < length; i += 2) {
+                response[1 + i / 2] = read_register((command[i] << 8) | command[i + 1]);
+            }
+
+            response_length = 1 + (length - 1) / 2;
+            break;
+
+        case WRITE_REGISTER:
+            // ADR1H ADR1L Val1 ... [Section 7.2.5 (PN532UM)]
+            for (int i = 1; i + 2 < length; i += 3) {
+                write_register((command[i] << 8) | command[i + 1], command[i + 2]);
+            }
+
+            response_length = 1;
+            break;
+
+        case LIST_PASSIVE_TARGETS: {
+            // With no tag in the field and endless retries, the PN532 keeps looking, and never answers
+            unsigned char attempts = list_passive_targets(command, length, response, &response_length);
+
+            if (response_length == 0) {
+                return;
+            }
+
+            ready_time += attempts * _rf_exchange;
+            _rf_exchanges += attempts;
+            break;
+        }
+
+        case SELECT_TARGET:
+            // Tg; response is Status [Section 7.3.12 (PN532UM)]
+            response[1] = PN532_MODEL_STATUS_WRONG_CONTEXT;
+
+            if (length >= 2 && command[1] >= 1 && command[1] <= _num_targets && _targets[command[1] - 1]) {
+                response[1] = SIMULATED_STATUS_OK;
+                ready_time += 2 * _rf_exchange;
+                _rf_exchanges += 2;
+            }
+
+            response_length = 2;
+            break;
+
+        case PSL:
+            // Tg BRit BRti; response is Status [Section 7.3.7 (PN532UM)]
+            response[1] = set_bit_rates(command, length);
+            response_length = 2;
+
+            // The PPS request is sent, whether or not the tag answers it
+            if (response[1] == SIMULATED_STATUS_OK || response[1] == SIMULATED_STATUS_TIMEOUT) {
+                ready_time += _rf_exchange;
+                _rf_exchanges++;
+            }
+
+            break;
+
+        case DATA_EXCHANGE: {
+            // Tg DataOut ...; response is Status DataIn ... [Section 7.3.8 (PN532UM)]
+            response[1] = PN532_MODEL_STATUS_WRONG_CONTEXT;
+            response_length = 2;
+
+            // MI in Tg, for a command chained in pieces, only applies to ISO14443-4 tags
+            int target = (command[1] & ~MORE_INFORMATION) - 1;
+
+            if (length < 2 || target < 0 || target >= _num_targets) {
+                break;
+            }
+
+            Simulated_Card* card = _targets[target];
+
+            // The tag has left the field; the PN532 waits out its timeout
+            if (!card) {
+                response[1] = SIMULATED_STATUS_TIMEOUT;
+                ready_time += _rf_exchange;
+                _rf_exchanges++;
+                break;
+            }
+
+            int data_length = 0;
+
+            if (_iso_dep[target]) {
+                ready_time += iso_dep_exchange(target, command, length, response, &response_length);
+                break;
+            }
+
+            if (length < 3 || (command[1] & MORE_INFORMATION)) {
+                break;
+            }
+
+            response[1] = card->exchange(command + 2, length - 2, response + 2, &data_length);
+            response_length = 2 + data_length;
+
+            // With the receiver set badly, the answer is garbled on the way back; the tag did get the command
+            write_register(CIU_ERROR, 0);
+
+            if (rf_error()) {
+                write_register(CIU_ERROR, 1 << CIU_CRC_ERR);
+                response[1] = PN532_MODEL_STATUS_CRC_ERROR;
+                response_length = 2;
+            }
+
+            // A MIFARE Classic authentication takes two exchanges
+            int exchanges = (command[2] == AUTHENTICATE_KEY_A || command[2] == AUTHENTICATE_KEY_B) ? 2 : 1;
+
+            ready_time += exchanges * _rf_exchange;
+            _rf_exchanges += exchanges;
+            break;
+        }
+
+        default:
+            queue(ERROR_FRAME, sizeof(ERROR_FRAME), ready_time);
+            return;
+    }
+
+    respond(response, response_length, ready_time);
+};
+
+static unsigned char card_ta(Simulated_Card* card) {
+    // TA of the ATS of `card`, the bit rates it supports, or what it means when left out [Section 5.2.4 (ISO-4)]
+    if (card->ats_length > ATS_T0_IDX + 1 && (card->ats[ATS_T0_IDX] & ATS_TA_PRESENT)) {
+        return card->ats[ATS_T0_IDX + 1];
+    }
+
+    return DEFAULT_TA;
+};
+
+static bool bit_rate_supported(unsigned char rates, unsigned char bit_rate) {
+    // Whether `bit_rate` is 106 kbps, which every tag supports, or one of the `rates` taken from TA
+    return bit_rate == BIT_RATE_106 || (rates & (1 << (bit_rate - 1)));
+};
+
+unsigned char PN532_Model::set_bit_rates(unsigned char* command, int length) {
+    /*
+        Tg BRit BRti; returns the Status. Only an ISO14443-4 tag, and only before anything was exchanged with it since its ATS,
+        can be sent the PPS request [Section 5.6 (ISO-4)]; it does not answer one asking for a bit rate its TA does not offer.
+    */
+
+    if (length < 4 || command[1] < 1 || command[1] > _num_targets || !_targets[command[1] - 1]) {
+        return PN532_MODEL_STATUS_WRONG_CONTEXT;
+    }
+
+    int target = command[1] - 1;
+
+    if (!_iso_dep[target] || !_pps_allowed[target]) {
+        return PN532_MODEL_STATUS_WRONG_CONTEXT;
+    }
+
+    unsigned char to_card = command[2];
+    unsigned char from_card = command[3];
+
+    if (to_card > PN532_MODEL_MAX_BIT_RATE || from_card > PN532_MODEL_MAX_BIT_RATE) {
+        return PN532_MODEL_STATUS_INVALID_PARAMETER;
+    }
+
+    unsigned char ta = card_ta(_targets[target]);
+
+    if (!bit_rate_supported(ta >> TA_DR_SHIFT, to_card) || !bit_rate_supported(ta >> TA_DS_SHIFT, from_card) ||
+        ((ta & TA_SAME_D_ONLY) && to_card != from_card)) {
+        return SIMULATED_STATUS_TIMEOUT;
+    }
+
+    _bit_rate_to_card[target] = to_card;
+    _bit_rate_from_card[target] = from_card;
+    _pps_allowed[target] = false;
+
+    return SIMULATED_STATUS_OK;
+};
+
+static int blocks_for(int length, int frame_size) {
+    // I-blocks for `length` bytes of INF in frames of up to `frame_size` bytes; at least one, even with nothing to send
+    int block_data = frame_size - ISO_DEP_BLOCK_OVERHEAD;
+
+    return (length == 0) ? 1 : (length + block_data - 1) / block_data;
+};
+
+unsigned long long PN532_Model::iso_dep_exchange(int target, unsigned char* command, int length, unsigned char* response,
+                                                 int* response_length) {
+    /*
+        DATA_EXCHANGE with the ISO14443-4 tag `target`; Tg DataOut ..., in `command` of `length` bytes, and the response, Status
+        DataIn ..., placed in `response` and its length in `response_length`. Returns how long the RF took, in nanoseconds.
+
+        A command sent with MI set in Tg is kept until the piece without it completes it, and only then given to the tag; each
+        piece is sent as I-blocks of up to FSC bytes, chained, each acknowledged by the tag with an R(ACK) [Section 7.5.2 (ISO-4)].
+        The tag answers likewise in I-blocks of up to FSD bytes. A response longer than PN532_MODEL_MAX_EXCHANGE_DATA is sent to
+        the host in pieces, each but the last with MI set in Status, the next fetched with an empty DATA_EXCHANGE.
+    */
+
+    Simulated_Card* card = _targets[target];
+    bool more = command[1] & MORE_INFORMATION;
+    unsigned char* data = command + 2;
+    int data_length = length - 2;
+
+    *response_length = 2;
+    _pps_allowed[target] = false;
+
+    // The rest of the last response, already received from the tag
+    if (data_length == 0 && !more && _held_position < _held_length) {
+        int piece = _held_length - _held_position;
+
+        if (piece > PN532_MODEL_MAX_EXCHANGE_DATA) {
+            piece = PN532_MODEL_MAX_EXCHANGE_DATA;
+        }
+
+        memcpy(response + 2, _held + _held_position, piece);
+        _held_position += piece;
+
+        response[1] = SIMULATED_STATUS_OK | ((_held_position < _held_length) ? MORE_INFORMATION : 0);
+        *response_length = 2 + piece;
+        return 0;
+    }
+
+    _held_length = 0;
+    _held_position = 0;
+
+    if (_chained_length + data_length > PN532_MODEL_MAX_FRAME) {
+        _chained_length = 0;
+        response[1] = PN532_MODEL_STATUS_INVALID_PARAMETER;
+        return 0;
+    }
+
+    memcpy(_chained + _chained_length, data, data_length);
+    _chained_length += data_length;
+
+    // FSC from the ATS, or what it means when left out [Section 5.2.3 (ISO-4)]
+    static const int frame_sizes[9] = {16, 24, 32, 40, 48, 64, 96, 128, 256};
+    int fsci = (card->ats_length > ATS_T0_IDX) ? card->ats[ATS_T0_IDX] & ATS_FSCI_MASK : DEFAULT_FSCI;
+    int fsc = frame_sizes[(fsci < 8) ? fsci : 8];
+
+    unsigned long long byte_to_card = PN532_MODEL_BYTE_TIME_106 * 1000ULL >> _bit_rate_to_card[target];
+    unsigned long long byte_from_card = PN532_MODEL_BYTE_TIME_106 * 1000ULL >> _bit_rate_from_card[target];
+
+    int blocks_out = blocks_for(data_length, fsc);
+
+    if (more) {
+        // Every I-block acknowledged; the tag has yet to answer
+        _rf_exchanges += blocks_out;
+        response[1] = SIMULATED_STATUS_OK;
+
+        return blocks_out * _rf_exchange + (data_length + ISO_DEP_BLOCK_OVERHEAD * blocks_out) * byte_to_card +
+               ISO_DEP_BLOCK_OVERHEAD * blocks_out * byte_from_card;
+    }
+
+    int answer_length = 0;
+    response[1] = card->exchange(_chained, _chained_length, _held, &answer_length);
+    _chained_length = 0;
+
+    int blocks_in = blocks_for(answer_length, PN532_MODEL_FSD);
+    int exchanges = blocks_out + blocks_in - 1;
+
+    // Each chained block but the last, either way, answered with an R(ACK)
+    unsigned long long rf_time = exchanges * _rf_exchange +
+                                 (data_length + ISO_DEP_BLOCK_OVERHEAD * (blocks_out + blocks_in - 1)) * byte_to_card +
+                                 (answer_length + ISO_DEP_BLOCK_OVERHEAD * (blocks_in + blocks_out - 1)) * byte_from_card;
+
+    _rf_exchanges += exchanges;
+
+    // With the receiver set badly, the answer is garbled on the way back; the tag did get the command
+    write_register(CIU_ERROR, 0);
+
+    if (rf_error()) {
+        write_register(CIU_ERROR, 1 << CIU_CRC_ERR);
+        response[1] = PN532_MODEL_STATUS_CRC_ERROR;
+        return rf_time;
+    }
+
+    if (response[1] != SIMULATED_STATUS_OK) {
+        return rf_time;
+    }
+
+    _held_length = answer_length;
+
+    int piece = (answer_length > PN532_MODEL_MAX_EXCHANGE_DATA) ? PN532_MODEL_MAX_EXCHANGE_DATA : answer_length;
+
+    memcpy(response + 2, _held, piece);
+    _held_position = piece;
+
+    response[1] |= (_held_position < _held_length) ? MORE_INFORMATION : 0;
+    *response_length = 2 + piece;
+
+    return rf_time;
+};
+
+unsigned char PN532_Model::list_passive_targets(unsigned char* command, int length, unsigned char* response, int* response_length) {
+    /*
+        MaxTg BrTy; response is NbTg, then for each target Tg ATQA[0] ATQA[1] SAK UIDLength UID[0] ... [Section 7.3.5 (PN532UM)]
+
+        With PARAMETER_AUTO_RATS set, an ISO14443-4 tag (bit 5 of its SAK set) is also sent RATS, and its ATS, TL first, follows
+        its UID.
+
+        Returns the number of RF exchanges it took; the activation of each tag, one per cascade level beyond the request and
+        anticollision, and the RATS, another anticollision round for each tag left in the field, or one timed out attempt for
+        each retry when no tag is found.
+    */
+
+    *response_length = 0;
+
+    if (length < 3 || command[2] != 0x00) {
+        response[1] = 0;
+        *response_length = 2;
+        return 0;
+    }
+
+    int max_targets = (command[1] < PN532_MODEL_MAX_TARGETS) ? command[1] : PN532_MODEL_MAX_TARGETS;
+
+    // The PN532 switches the field on by itself; the targets found before are released
+    _rf_field = true;
+    clear_targets();
+
+    for (int i = 0; i < _num_cards && _num_targets < max_targets; i++) {
+        _cards[i]->reset();
+        _targets[_num_targets++] = _cards[i];
+    }
+
+    if (_num_targets == 0) {
+        if (_activation_retries == 0xFF) {
+            return 0;
+        }
+
+        response[1] = 0;
+        *response_length = 2;
+        return _activation_retries + 1;
+    }
+
+    unsigned char exchanges = 0;
+    int position = 2;
+
+    for (int i = 0; i < _num_targets; i++) {
+        Simulated_Card* card = _targets[i];
+
+        response[position++] = i + 1;
+        response[position++] = card->atqa[0];
+        response[position++] = card->atqa[1];
+        response[position++] = card->sak;
+        response[position++] = card->uid_length;
+        memcpy(response + position, card->uid, card->uid_length);
+        position += card->uid_length;
+
+        exchanges += 1 + 2 * ((card->uid_length == 4) ? 1 : (card->uid_length == 7) ? 2 : 3);
+
+        if ((_parameters & PARAMETER_AUTO_RATS) && (card->sak & 0b100000)) {
+            response[position++] = card->ats_length + 1;
+            memcpy(response + position, card->ats, card->ats_length);
+            position += card->ats_length;
+
+            // The tag now speaks ISO14443-4, at 106 kbps until PSL changes it, which it may only do first [Section 5.6 (ISO-4)]
+            _iso_dep[i] = true;
+            _pps_allowed[i] = true;
+
+            exchanges++;
+        }
+    }
+
+    exchanges += 2 * (_num_cards - _num_targets);
+
+    response[1] = _num_targets;
+    *response_length = position;
+
+    return exchanges;
+};
+
+void PN532_Model::respond(unsigned char* data, int length, unsigned long long ready_time) {
+    /*
+        Queue a response frame with `length` bytes of data; an extended frame if LEN, which counts TFI, does not fit a byte
+        [Section 6.2.1.2 (PN532UM)]
+    */
+
+    unsigned char frame[PN532_MODEL_MAX_FRAME];
+    int position = LEN_IDX;
+
+    frame[PREAMBLE_IDX] = PREAMBLE;
+    frame[STARTCODE1_IDX] = STARTCODE1;
+    frame[STARTCODE2_IDX] = STARTCODE2;
+
+    if (length + 1 > 0xFF) {
+        frame[position++] = EXTENDED_FRAME_MARKER;
+        frame[position++] = EXTENDED_FRAME_MARKER;
+        frame[position++] = (length + 1) >> 8;
+        frame[position++] = (length + 1) & 0xFF;
+        frame[position] = ~(frame[position - 2] + frame[position - 1]) + 1;
+        position++;
+    } else {
+        frame[position++] = length + 1;
+        frame[position] = ~frame[position - 1] + 1;
+        position++;
+    }
+
+    frame[position++] = TFI_PN532_TO_HOST;
+
+    unsigned char DCS = TFI_PN532_TO_HOST;
+
+    for (int i = 0; i < length; i++) {
+        frame[position++] = data[i];
+        DCS += data[i];
+    }
+
+    frame[position++] = ~DCS + 1;
+    frame[position++] = POSTAMBLE;
+
+    queue(frame, position, ready_time);
+};
+
+void PN532_Model::queue(const unsigned char* frame, int length, unsigned long long ready_time) {
+    if (_queue_size == PN532_MODEL_QUEUE_SIZE) {
+        return;
+    }
+
+    memcpy(_queue[_queue_size], frame, length);
+    _queue_lengths[_queue_size] = length;
+    _queue_ready_times[_queue_size] = ready_time;
+    _queue_jitters[_queue_size] = 0;
+    _queue_size++;
+};
+
+void PN532_Model::pop() {
+    for (int i = 1; i < _queue_size; i++) {
+        memcpy(_queue[i - 1], _queue[i], _queue_lengths[i]);
+        _queue_lengths[i - 1] = _queue_lengths[i];
+        _queue_ready_times[i - 1] = _queue_ready_times[i];
+        _queue_jitters[i - 1] = _queue_jitters[i];
+    }
+
+    if (_queue_size > 0) {
+        _queue_size--;
+    }
+};
+
+bool PN532_Model::frame_ready(unsigned long long now) {
+    /*
+        Whether the frame at the head of the queue can be read; its jitter is only added once it would have been, so that it
+        shows in the time the host takes to find it, however coarsely the host polls
+    */
+
+    if (_queue_size == 0 || now < _queue_ready_times[0]) {
+        return false;
+    }
+
+    if (_queue_jitters[0] > 0) {
+        _queue_ready_times[0] = now + _queue_jitters[0];
+        _queue_jitters[0] = 0;
+
+        return false;
+    }
+
+    return true;
+};
+
+bool PN532_Model::is_response(int index) {
+    // Whether the frame queued at `index` is a response, not an ACK
+    return !(_queue_lengths[index] == ACK_SIZE && memcmp(_queue[index], ACK_FRAME, ACK_SIZE) == 0);
+};
+
+void PN532_Model::clear_targets() {
+    _num_targets = 0;
+
+    for (int i = 0; i < PN532_MODEL_MAX_TARGETS; i++) {
+        _iso_dep[i] = false;
+        _pps_allowed[i] = false;
+        _bit_rate_to_card[i] = BIT_RATE_106;
+        _bit_rate_from_card[i] = BIT_RATE_106;
+    }
+
+    _chained_length = 0;
+    _held_length = 0;
+    _held_position = 0;
+};
+
+#endif
@@ -0,0 +1,193 @@
+/*
+    PN532_Model.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    A behavioural model of the PN532 on the emulated SPI bus, for running the `PN532` driver, and what is built on it, on a
+    computer. It speaks the SPI framing of the PN532 (STATUS_READ, DATA_WRITE, DATA_READ), checks the LCS and DCS of every frame
+    it is sent, ACKs it, and queues the response, which becomes ready after a configurable delay; the status byte reports it ready
+    only then, so the driver's polling is exercised as on the hardware. A NACK has the last response sent again, and responses
+    can be corrupted on their way to the host, as noise on the bus would. Its power can be cut, as a brown-out would, after which it
+    has lost its configuration.
+
+    Implemented are SAM_CONFIGURATION, RF_CONFIGURATION (the RF field, the passive activation retries, and the analog settings
+    for ISO14443A), GET_FIRMWARE_VERSION, SET_PARAMETERS (whether ISO14443-4 tags are sent RATS), READ_REGISTER and WRITE_REGISTER (the CIU registers), LIST_PASSIVE_TARGETS
+    (ISO14443A), SELECT_TARGET, PSL (the bit rates of an ISO14443-4 tag, up to 424 kbps) and DATA_EXCHANGE, the last handed to
+    the `Simulated_Card`s placed in the field. For an ISO14443-4 tag, DATA_EXCHANGE also takes a command in pieces chained with
+    MI, and hands back a response of more than 262 bytes the same way; past 254 bytes, a response goes in an extended frame. Any other command is answered with the error frame. The
+    RF is not modelled beyond the time it takes, the blocks and bytes an ISO14443-4 exchange takes at its bit rates included,
+    and, if asked for, exchanges that fail with a CRC error more often the further the receiver is set from a given optimum.
+
+    The following sources were referenced.
+
+    https://www.nxp.com/docs/en/user-guide/141520.pdf [PN532UM]
+    https://www.nxp.com/docs/en/nxp/data-sheets/PN532_C1.pdf [PN532DS]
+    http://www.emutag.com/iso/14443-4.pdf [ISO-4]
+*/
+
+#ifndef PN532_MODEL_H
+#define PN532_MODEL_H
+
+#ifdef NATIVE
+
+#include "SPI_Device.h"
+#include "Simulated_Cards.h"
+
+#define PN532_MODEL_MAX_CARDS           4
+#define PN532_MODEL_MAX_TARGETS         2   // LIST_PASSIVE_TARGETS initializes at most 2 targets [Section 7.3.5 (PN532UM)]
+#define PN532_MODEL_MAX_FRAME           275 // PREAMBLE ... POSTAMBLE of an extended information frame with LEN = 265
+#define PN532_MODEL_QUEUE_SIZE          2   // An ACK, and the response to the command
+
+// Default timing, in microseconds
+#define PN532_MODEL_ACK_DELAY           500
+#define PN532_MODEL_RESPONSE_DELAY      1000
+#define PN532_MODEL_RF_EXCHANGE         1000 // An exchange with a tag, or the timeout of an attempt to activate one
+#define PN532_MODEL_BYTE_TIME_106       85   // A byte of an ISO14443-4 block, parity bits included, at 106 kbps; half that at 212
+
+// ISO14443-4; the longest frame the PN532 accepts, the fastest bit rate it goes to, and the most DataIn it sends at once
+#define PN532_MODEL_FSD                 64
+#define PN532_MODEL_MAX_BIT_RATE        0x02 // 424 kbps [Section 7.3.7 (PN532UM)]
+#define PN532_MODEL_MAX_EXCHANGE_DATA   262  // Sent in an extended frame past 252 [Section 6.2.1.2 (PN532UM)]
+
+// Firmware version reported; the PN532, version 1.6, supporting ISO14443A, ISO14443B and ISO18092 [Section 7.2.2 (PN532UM)]
+#define PN532_MODEL_IC                  0x32
+#define PN532_MODEL_VERSION             0x01
+#define PN532_MODEL_REVISION            0x06
+#define PN532_MODEL_SUPPORT             0x07
+
+// Status reported for a command that does not apply, e.g. to a target that was not activated, and for a garbled answer
+// [Section 7.1 (PN532UM)]
+#define PN532_MODEL_STATUS_WRONG_CONTEXT 0x27
+#define PN532_MODEL_STATUS_CRC_ERROR    0x02
+#define PN532_MODEL_STATUS_INVALID_PARAMETER 0x10
+
+// The CIU registers, 0x6301 to 0x633F [Section 8.6.23 (PN532DS)]
+#define PN532_MODEL_CIU_BASE            0x6300
+#define PN532_MODEL_CIU_SIZE            0x40
+
+// How much more often, in percent, an exchange fails per step of the receiver gain, and of the minimum level, away from the
+// optimum set with `set_receiver_optimum()`
+#define PN532_MODEL_GAIN_PENALTY        12
+#define PN532_MODEL_LEVEL_PENALTY       3
+
+class PN532_Model : public SPI_Device {
+    public:
+        PN532_Model();
+
+        void select(unsigned long long now);
+        void deselect(unsigned long long now);
+        unsigned char transfer(unsigned char byte, unsigned long long now);
+        unsigned char data_order();
+
+        bool add_card(Simulated_Card* card);
+        bool remove_card(Simulated_Card* card);
+
+        void set_timing(unsigned long ack_delay, unsigned long response_delay, unsigned long rf_exchange);
+        void set_jitter(unsigned long jitter, unsigned long seed);
+        void set_receiver_optimum(unsigned char rx_gain, unsigned char min_level);
+        void set_corruption(unsigned long interval);
+        void set_powered(bool on);
+
+        bool rf_field();
+        unsigned char read_register(unsigned int address);
+
+        // Counters; cleared by `reset_counters()`
+        unsigned long frames_received();
+        unsigned long status_polls();
+        unsigned long frame_errors();
+        unsigned long nacks_received();
+        unsigned long rf_exchanges();
+        void reset_counters();
+
+    private:
+        void handle_frame(unsigned long long now);
+        void execute(unsigned char* command, int length, unsigned long long ready_time);
+        void respond(unsigned char* data, int length, unsigned long long ready_time);
+        void queue(const unsigned char* frame, int length, unsigned long long ready_time);
+        void pop();
+        bool frame_ready(unsigned long long now);
+        bool is_response(int index);
+        void clear_targets();
+        void power_up();
+        unsigned long long jitter();
+        bool rf_error();
+        void write_register(unsigned int address, unsigned char value);
+
+        unsigned char list_passive_targets(unsigned char* command, int length, unsigned char* response, int* response_length);
+        unsigned char set_bit_rates(unsigned char* command, int length);
+        unsigned long long iso_dep_exchange(int target, unsigned char* command, int length, unsigned char* response,
+                                            int* response_length);
+
+        // SPI operation of the current transaction, set by its first byte
+        unsigned char _operation;
+        bool _first_byte;
+
+        unsigned char _received[PN532_MODEL_MAX_FRAME];
+        int _received_length;
+
+        unsigned char _queue[PN532_MODEL_QUEUE_SIZE][PN532_MODEL_MAX_FRAME];
+        int _queue_lengths[PN532_MODEL_QUEUE_SIZE];
+        unsigned long long _queue_ready_times[PN532_MODEL_QUEUE_SIZE];
+        unsigned long long _queue_jitters[PN532_MODEL_QUEUE_SIZE]; // Added to the ready time when the frame is first found ready
+        int _queue_size;
+        int _read_position;
+        bool _read_started;
+
+        // The last response read, sent again on a NACK
+        unsigned char _last_response[PN532_MODEL_MAX_FRAME];
+        int _last_response_length;
+
+        unsigned long _corruption_interval;
+        unsigned long _responses_read;
+        bool _corrupt_read;
+
+        Simulated_Card* _cards[PN532_MODEL_MAX_CARDS];
+        int _num_cards;
+
+        Simulated_Card* _targets[PN532_MODEL_MAX_TARGETS];
+        int _num_targets;
+
+        // ISO14443-4 targets, whether PSL may still change their bit rates, and the bit rates (BIT_RATE_ values) each way
+        bool _iso_dep[PN532_MODEL_MAX_TARGETS];
+        bool _pps_allowed[PN532_MODEL_MAX_TARGETS];
+        unsigned char _bit_rate_to_card[PN532_MODEL_MAX_TARGETS];
+        unsigned char _bit_rate_from_card[PN532_MODEL_MAX_TARGETS];
+
+        // A command being chained in by the host, and the rest of a response not yet sent to it
+        unsigned char _chained[PN532_MODEL_MAX_FRAME];
+        int _chained_length;
+        unsigned char _held[SIMULATED_MAX_RESPONSE];
+        int _held_length;
+        int _held_position;
+
+        bool _powered;
+        bool _rf_field;
+        unsigned char _activation_retries;
+        unsigned char _parameters;
+
+        unsigned long long _ack_delay;
+        unsigned long long _response_delay;
+        unsigned long long _rf_exchange;
+        unsigned long _jitter;
+        unsigned long _random_state;
+
+        unsigned char _registers[PN532_MODEL_CIU_SIZE];
+        bool _receiver_modelled;
+        unsigned char _optimum_gain;
+        unsigned char _optimum_level;
+        unsigned long _error_state;
+
+        unsigned long _frames_received;
+        unsigned long _status_polls;
+        unsigned long _frame_errors;
+        unsigned long _nacks_received;
+        unsigned long _rf_exchanges;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,365 @@
+/*
+    PN532_Trace_Replay.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Plays back an SPI trace captured from a PN532 on the emulated SPI bus.
+
+    The following sources were referenced.
+
+    https://www.nxp.com/docs/en/user-guide/141520.pdf [PN532UM]
+*/
+
+#include "PN532_Trace_Replay.h"
+
+#ifdef NATIVE
+
+#include "PN532.h"
+
+#include "string.h"
+
+PN532_Trace_Replay::PN532_Trace_Replay() {
+    _num_transactions = 0;
+    _in_transaction = false;
+    _device = -1;
+    _captured_time = 0;
+    _last_ticks = 0;
+    _has_ticks = false;
+
+    _num_commands = 0;
+
+    _current = -1;
+    _replaying.length = 0;
+    _ack_read = false;
+    _response_position = 0;
+};
+
+bool PN532_Trace_Replay::add_record(unsigned char type, unsigned char sent, unsigned char received, unsigned int ticks) {
+    /*
+        Add the next record of the trace; only the transactions of the first device selected in the trace are kept. Returns
+        `false` once TRACE_MAX_TRANSACTIONS are kept.
+    */
+
+    if (_has_ticks) {
+        _captured_time += ((ticks - _last_ticks) & 0xFFFF) * TRACE_TICK_NS;
+    }
+
+    _last_ticks = ticks;
+    _has_ticks = true;
+
+    switch (type) {
+        case SPI_TRACE_SELECT:
+            if (_device < 0) {
+                _device = sent;
+            }
+
+            _in_transaction = (sent == _device);
+
+            if (_in_transaction) {
+                if (_num_transactions == TRACE_MAX_TRANSACTIONS) {
+                    _in_transaction = false;
+                    return false;
+                }
+
+                _transactions[_num_transactions].start = _captured_time;
+                _transactions[_num_transactions].length = 0;
+            }
+
+            return true;
+
+        case SPI_TRACE_BYTE:
+            if (_in_transaction) {
+                TraceTransaction* transaction = &_transactions[_num_transactions];
+
+                if (transaction->length < TRACE_MAX_BYTES) {
+                    transaction->sent[transaction->length] = sent;
+                    transaction->received[transaction->length] = received;
+                    transaction->length++;
+                }
+            }
+
+            return true;
+
+        case SPI_TRACE_DESELECT:
+            if (_in_transaction && sent == _device) {
+                _transactions[_num_transactions].end = _captured_time;
+                _num_transactions++;
+                _in_transaction = false;
+            }
+
+            return true;
+
+        default:
+            return true;
+    }
+};
+
+int PN532_Trace_Replay::split_commands() {
+    /*
+        Split the transactions kept into commands; returns the number of commands
+    */
+
+    TraceCommand* command = nullptr;
+    _num_commands = 0;
+
+    for (int i = 0; i < _num_transactions; i++) {
+        TraceTransaction* transaction = &_transactions[i];
+
+        if (transaction->length < 1) {
+            continue;
+        }
+
+        // The PN532 was ready by the time a poll that found it ready began
+        unsigned long long since_write = command ? transaction->start - command->write_end : 0;
+
+        switch (transaction->sent[0]) {
+            case DATA_WRITE:
+                // An ACK from the host aborts a command, it is not one
+                if (transaction->length - 1 == ACK_SIZE && memcmp(transaction->sent + 1, ACK_FRAME, ACK_SIZE) == 0) {
+                    break;
+                }
+
+                if (_num_commands == TRACE_MAX_COMMANDS) {
+                    return _num_commands;
+                }
+
+                command = &_commands[_num_commands++];
+                memset(command, 0, sizeof(TraceCommand));
+
+                command->frame_length = transaction->length - 1;
+                memcpy(command->frame, transaction->sent + 1, command->frame_length);
+                command->start = transaction->start;
+                command->write_end = transaction->end;
+                command->ack_end = transaction->end;
+                command->end = transaction->end;
+                command->divergence = -1;
+                break;
+
+            case STATUS_READ:
+                if (!command) {
+                    break;
+                }
+
+                command->status_polls++;
+
+                // Bit 0 of the status byte is set when a frame is ready [Section 6.2.5.1 (PN532UM)]
+                if (transaction->length < 2 || !(transaction->received[1] & 0b1)) {
+                    break;
+                }
+
+                if (command->ack_length == 0 && !command->has_ack) {
+                    command->has_ack = true;
+                    command->ack_latency = since_write;
+                } else if (command->ack_length > 0 && !command->has_response) {
+                    command->has_response = true;
+                    command->response_latency = since_write;
+                }
+
+                break;
+
+            case DATA_READ:
+                if (!command) {
+                    break;
+                }
+
+                // The first frame read is the ACK, and the rest is the response, however many transactions it is read in
+                if (command->ack_length == 0) {
+                    if (!command->has_ack) {
+                        command->has_ack = true;
+                        command->ack_latency = transaction->start - command->write_end;
+                    }
+
+                    command->ack_length = transaction->length - 1;
+                    memcpy(command->ack, transaction->received + 1, command->ack_length);
+                    command->ack_end = transaction->end;
+                    command->end = transaction->end;
+                } else {
+                    if (!command->has_response) {
+                        command->has_response = true;
+                        command->response_latency = transaction->start - command->write_end;
+                    }
+
+                    int length = transaction->length - 1;
+
+                    if (command->response_length + length > TRACE_MAX_BYTES) {
+                        length = TRACE_MAX_BYTES - command->response_length;
+                    }
+
+                    memcpy(command->response + command->response_length, transaction->received + 1, length);
+                    command->response_length += length;
+                    command->end = transaction->end;
+                }
+
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return _num_commands;
+};
+
+void PN532_Trace_Replay::select(unsigned long long now) {
+    _replaying.start = now;
+    _replaying.length = 0;
+};
+
+void PN532_Trace_Replay::deselect(unsigned long long now) {
+    if (_replaying.length < 1) {
+        return;
+    }
+
+    TraceCommand* command = (_current >= 0 && _current < _num_commands) ? &_commands[_current] : nullptr;
+
+    switch (_replaying.sent[0]) {
+        case DATA_WRITE:
+            replay_written(now);
+            break;
+
+        case DATA_READ:
+            if (!command) {
+                break;
+            }
+
+            if (!_ack_read) {
+                _ack_read = true;
+                command->replay_ack_end = now;
+            }
+
+            command->replay_end = now;
+            break;
+
+        default:
+            break;
+    }
+};
+
+unsigned char PN532_Trace_Replay::transfer(unsigned char byte, unsigned long long now) {
+    int position = _replaying.length;
+
+    if (position < TRACE_MAX_BYTES) {
+        _replaying.sent[position] = byte;
+        _replaying.length++;
+    }
+
+    TraceCommand* command = (_current >= 0 && _current < _num_commands) ? &_commands[_current] : nullptr;
+
+    if (position == 0 || !command) {
+        return 0x00;
+    }
+
+    switch (_replaying.sent[0]) {
+        case STATUS_READ: {
+            if (position == 1) {
+                command->replay_status_polls++;
+            }
+
+            // Ready as long after the frame as it was found ready in the capture
+            unsigned long long since_write = now - command->replay_write_end;
+
+            if (!_ack_read) {
+                return (command->has_ack && since_write >= command->ack_latency) ? 0x01 : 0x00;
+            }
+
+            return (command->has_response && since_write >= command->response_latency) ? 0x01 : 0x00;
+        }
+
+        case DATA_READ:
+            if (!_ack_read) {
+                return (position - 1 < command->ack_length) ? command->ack[position - 1] : 0x00;
+            }
+
+            if (_response_position < command->response_length) {
+                return command->response[_response_position++];
+            }
+
+            return 0x00;
+
+        default:
+            return 0x00;
+    }
+};
+
+unsigned char PN532_Trace_Replay::data_order() {
+    // The trace holds the bytes as the master shifted them, in the order the PN532 driver uses
+    return LSB_FIRST;
+};
+
+void PN532_Trace_Replay::replay_written(unsigned long long now) {
+    /*
+        The driver wrote a frame; compare it with the next command captured, and start answering it
+    */
+
+    unsigned char* frame = _replaying.sent + 1;
+    int length = _replaying.length - 1;
+
+    if (length == ACK_SIZE && memcmp(frame, ACK_FRAME, ACK_SIZE) == 0) {
+        return;
+    }
+
+    _current++;
+    _ack_read = false;
+    _response_position = 0;
+
+    if (_current >= _num_commands) {
+        return;
+    }
+
+    TraceCommand* command = &_commands[_current];
+
+    command->replayed = true;
+    command->divergence = -1;
+
+    int longest = (length > command->frame_length) ? length : command->frame_length;
+
+    for (int i = 0; i < longest; i++) {
+        unsigned char expected = (i < command->frame_length) ? command->frame[i] : 0x00;
+        unsigned char written = (i < length) ? frame[i] : 0x00;
+
+        if (i >= length || i >= command->frame_length || expected != written) {
+            command->divergence = i;
+            command->expected = expected;
+            command->written = written;
+            break;
+        }
+    }
+
+    command->replay_status_polls = 0;
+    command->replay_start = _replaying.start;
+    command->replay_write_end = now;
+    command->replay_ack_end = now;
+    command->replay_end = now;
+};
+
+int PN532_Trace_Replay::num_commands() {
+    return _num_commands;
+};
+
+TraceCommand* PN532_Trace_Replay::command(int index) {
+    return &_commands[index];
+};
+
+int PN532_Trace_Replay::num_divergences() {
+    // Commands whose frame differs from the capture, and frames written beyond the commands captured
+    int divergences = (_current >= _num_commands) ? _current - _num_commands + 1 : 0;
+
+    for (int i = 0; i < _num_commands; i++) {
+        if (_commands[i].divergence >= 0) {
+            divergences++;
+        }
+    }
+
+    return divergences;
+};
+
+unsigned char PN532_Trace_Replay::device() {
+    // Id of the NSS pin of the device whose transactions were kept
+    return (_device < 0) ? 0 : _device;
+};
+
+#endif
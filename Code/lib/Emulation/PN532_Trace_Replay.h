@@ -0,0 +1,121 @@
+/*
+    PN532_Trace_Replay.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Plays back an SPI trace captured from a PN532 in the field (with SPI_TRACE; see SPI.h) on the emulated SPI bus, so that the
+    `PN532` driver can be run through the same session at a desk.
+
+    The trace is split into the commands the host sent; each is a DATA_WRITE of the command frame, followed by status polls, a
+    DATA_READ of the ACK, more status polls, and DATA_READs of the response. When the driver writes a command frame, it is
+    compared with the frame captured, and any difference is reported as a divergence; the driver is then answered with the ACK
+    and the response captured, each made ready as long after the frame as the first status poll that found it ready in the
+    capture. So a driver that polls differently, or waits less, takes a different time over the same session, which is measured
+    in simulated time.
+
+    Captured times come from `tick_count()`, in ticks of 4 microseconds; gaps between records over 262.144 ms are lost.
+
+    The following sources were referenced.
+
+    https://www.nxp.com/docs/en/user-guide/141520.pdf [PN532UM]
+*/
+
+#ifndef PN532_TRACE_REPLAY_H
+#define PN532_TRACE_REPLAY_H
+
+#ifdef NATIVE
+
+#include "SPI_Device.h"
+
+#define TRACE_MAX_TRANSACTIONS          4096
+#define TRACE_MAX_COMMANDS              1024
+#define TRACE_MAX_BYTES                 270 // Operation byte, and the longest frame
+
+#define TRACE_TICK_NS                   4000ULL
+
+struct TraceTransaction {
+    unsigned long long start;           // Simulated or captured time, in nanoseconds
+    unsigned long long end;
+    unsigned char sent[TRACE_MAX_BYTES];
+    unsigned char received[TRACE_MAX_BYTES];
+    int length;
+};
+
+struct TraceCommand {
+    // Captured
+    unsigned char frame[TRACE_MAX_BYTES];   // PREAMBLE ... POSTAMBLE, as written
+    int frame_length;
+    unsigned char ack[TRACE_MAX_BYTES];
+    int ack_length;
+    unsigned char response[TRACE_MAX_BYTES];
+    int response_length;
+
+    bool has_ack;                           // A status poll found the ACK ready
+    bool has_response;
+    unsigned long long ack_latency;         // From the end of the DATA_WRITE to the first ready status poll
+    unsigned long long response_latency;
+    int status_polls;
+
+    unsigned long long start;               // Times the DATA_WRITE began, the ACK was read, and the response was read
+    unsigned long long write_end;
+    unsigned long long ack_end;
+    unsigned long long end;
+
+    // Replayed
+    bool replayed;
+    int divergence;                         // Offset of the first byte of the frame that differs, or -1
+    unsigned char expected;
+    unsigned char written;
+    int replay_status_polls;
+    unsigned long long replay_start;
+    unsigned long long replay_write_end;
+    unsigned long long replay_ack_end;
+    unsigned long long replay_end;
+};
+
+class PN532_Trace_Replay : public SPI_Device {
+    public:
+        PN532_Trace_Replay();
+
+        bool add_record(unsigned char type, unsigned char sent, unsigned char received, unsigned int ticks);
+        int split_commands();
+
+        void select(unsigned long long now);
+        void deselect(unsigned long long now);
+        unsigned char transfer(unsigned char byte, unsigned long long now);
+        unsigned char data_order();
+
+        int num_commands();
+        TraceCommand* command(int index);
+        int num_divergences();
+        unsigned char device();
+
+    private:
+        void replay_written(unsigned long long now);
+
+        // Capture
+        TraceTransaction _transactions[TRACE_MAX_TRANSACTIONS];
+        int _num_transactions;
+        bool _in_transaction;
+        int _device;
+        unsigned long long _captured_time;
+        unsigned int _last_ticks;
+        bool _has_ticks;
+
+        TraceCommand _commands[TRACE_MAX_COMMANDS];
+        int _num_commands;
+
+        // Replay
+        int _current;                           // Command being replayed, or -1 before the first
+        TraceTransaction _replaying;
+        bool _ack_read;
+        int _response_position;
+};
+
+#endif
+
+#endif
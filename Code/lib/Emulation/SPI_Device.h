@@ -0,0 +1,49 @@
+/*
+    SPI_Device.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    A device on the emulated SPI bus, e.g. `PN532_Model`; the `Emulator` selects it when its NSS pin goes low, and exchanges a byte
+    with it for every byte the master sends while it is selected. `now` is the simulated time in nanoseconds.
+
+    Bytes are passed in the order of significance the device shifts them in; the emulator reverses the bits of a byte if the
+    master shifts them in the other order (DORD), as a mismatched device would see them.
+*/
+
+#ifndef SPI_DEVICE_H
+#define SPI_DEVICE_H
+
+#ifdef NATIVE
+
+#include "SPI.h"
+
+class SPI_Device {
+    public:
+        virtual ~SPI_Device() {
+            ;
+        };
+
+        virtual void select(unsigned long long /* now */) {
+            ;
+        };
+
+        virtual void deselect(unsigned long long /* now */) {
+            ;
+        };
+
+        // Take the byte the master sent, and return the byte sent back
+        virtual unsigned char transfer(unsigned char byte, unsigned long long now) = 0;
+
+        // MSB_FIRST or LSB_FIRST
+        virtual unsigned char data_order() {
+            return MSB_FIRST;
+        };
+};
+
+#endif
+
+#endif
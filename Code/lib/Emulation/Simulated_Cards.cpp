@@ -0,0 +1,290 @@
+/*
+    Simulated_Cards.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Tags for the simulated readers to find in their fields; a MIFARE Classic 1K, an NTAG213, and an ISO14443-4 card.
+
+    The following sources were referenced.
+
+    https://www.nxp.com/docs/en/data-sheet/MF1S50YYX_V1.pdf [MF1S50]
+    https://www.nxp.com/docs/en/data-sheet/NTAG213_215_216.pdf [NTAG]
+    https://www.nxp.com/docs/en/user-guide/141520.pdf [PN532UM]
+    https://cardwerk.com/smart-card-standard-iso7816-4-section-6-basic-interindustry-commands/ [ISO-7816-4]
+*/
+
+#include "Simulated_Cards.h"
+
+#ifdef NATIVE
+
+#include "MIFARE_Classic_Commands.h"
+
+#include "string.h"
+
+#define CASCADE_TAG_BYTE        0x88
+
+/*
+    Simulated_MIFARE_Classic
+*/
+
+Simulated_MIFARE_Classic::Simulated_MIFARE_Classic(const unsigned char* four_byte_uid) {
+    /*
+        A card as shipped; block 0 holds the UID and its BCC, and every sector trailer holds the transport keys, FF FF FF FF FF FF,
+        with the transport access bits FF 07 80 [Section 8.6.3 (MF1S50)]
+    */
+
+    atqa[0] = 0x00;
+    atqa[1] = 0x04;
+    sak = 0x08;
+    uid_length = 4;
+    memcpy(uid, four_byte_uid, 4);
+    ats_length = 0;
+
+    memset(blocks, 0, sizeof(blocks));
+    memcpy(blocks[0], uid, 4);
+    blocks[0][4] = uid[0] ^ uid[1] ^ uid[2] ^ uid[3];
+
+    for (int block = 3; block < MIFARE_CLASSIC_1K_BLOCKS; block += 4) {
+        static const unsigned char transport_trailer[MIFARE_CLASSIC_BLOCK_SIZE] = {
+            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x07, 0x80, 0x69, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+        };
+
+        memcpy(blocks[block], transport_trailer, MIFARE_CLASSIC_BLOCK_SIZE);
+    }
+
+    _authenticated_sector = -1;
+};
+
+void Simulated_MIFARE_Classic::reset() {
+    _authenticated_sector = -1;
+};
+
+unsigned char Simulated_MIFARE_Classic::exchange(const unsigned char* command, int length, unsigned char* response, int* response_length) {
+    /*
+        Commands as the PN532 takes them through DATA_EXCHANGE [Section 7.3.8 (PN532UM)]
+
+        AUTH_COMMAND Addr Key[0] ... Key[5] UID[0] ... UID[3]
+        READ_BLOCK Addr
+        WRITE_BLOCK Addr Data[0] ... Data[15]
+
+        Blocks can only be read or written in the sector last authenticated; a failed authentication leaves none authenticated.
+        Access conditions are not modelled beyond that; key A reads back as zeroes from a trailer [Section 8.7.3 (MF1S50)].
+    */
+
+    *response_length = 0;
+
+    if (length < 2 || command[1] >= MIFARE_CLASSIC_1K_BLOCKS) {
+        return SIMULATED_STATUS_MIFARE_ERROR;
+    }
+
+    unsigned char block = command[1];
+    int sector = block / 4;
+    unsigned char* trailer = blocks[sector * 4 + 3];
+
+    switch (command[0]) {
+        case AUTHENTICATE_KEY_A:
+        case AUTHENTICATE_KEY_B: {
+            if (length != 12) {
+                return SIMULATED_STATUS_MIFARE_ERROR;
+            }
+
+            const unsigned char* key = (command[0] == AUTHENTICATE_KEY_A) ? trailer : trailer + 10;
+
+            if (memcmp(command + 2, key, 6) != 0 || memcmp(command + 8, uid, 4) != 0) {
+                _authenticated_sector = -1;
+                return SIMULATED_STATUS_MIFARE_ERROR;
+            }
+
+            _authenticated_sector = sector;
+            return SIMULATED_STATUS_OK;
+        }
+
+        case READ_BLOCK:
+            if (sector != _authenticated_sector) {
+                return SIMULATED_STATUS_MIFARE_ERROR;
+            }
+
+            memcpy(response, blocks[block], MIFARE_CLASSIC_BLOCK_SIZE);
+
+            if (block % 4 == 3) {
+                memset(response, 0, 6);
+            }
+
+            *response_length = MIFARE_CLASSIC_BLOCK_SIZE;
+            return SIMULATED_STATUS_OK;
+
+        case WRITE_BLOCK:
+            // Block 0 is written by the manufacturer, and locked
+            if (length != 2 + MIFARE_CLASSIC_BLOCK_SIZE || sector != _authenticated_sector || block == 0) {
+                return SIMULATED_STATUS_MIFARE_ERROR;
+            }
+
+            memcpy(blocks[block], command + 2, MIFARE_CLASSIC_BLOCK_SIZE);
+            return SIMULATED_STATUS_OK;
+
+        default:
+            return SIMULATED_STATUS_MIFARE_ERROR;
+    }
+};
+
+/*
+    Simulated_NTAG213
+*/
+
+Simulated_NTAG213::Simulated_NTAG213(const unsigned char* seven_byte_uid) {
+    /*
+        A tag as shipped; pages 0 to 2 hold the UID and its check bytes, page 3 the capability container of an empty NDEF tag, and
+        page 4 an empty NDEF message TLV [Section 8.5 (NTAG)]
+    */
+
+    atqa[0] = 0x00;
+    atqa[1] = 0x44;
+    sak = 0x00;
+    uid_length = 7;
+    memcpy(uid, seven_byte_uid, 7);
+    ats_length = 0;
+
+    memset(pages, 0, sizeof(pages));
+
+    pages[0][0] = uid[0];
+    pages[0][1] = uid[1];
+    pages[0][2] = uid[2];
+    pages[0][3] = CASCADE_TAG_BYTE ^ uid[0] ^ uid[1] ^ uid[2];
+    memcpy(pages[1], uid + 3, 4);
+    pages[2][0] = uid[3] ^ uid[4] ^ uid[5] ^ uid[6];
+
+    pages[3][0] = 0xE1;
+    pages[3][1] = 0x10;
+    pages[3][2] = 0x12;
+
+    pages[4][0] = 0x03;
+    pages[4][2] = 0xFE;
+};
+
+unsigned char Simulated_NTAG213::exchange(const unsigned char* command, int length, unsigned char* response, int* response_length) {
+    /*
+        READ Addr               returns the 4 pages from Addr, rolling over to page 0 past the last page [Section 10.2 (NTAG)]
+        WRITE Addr Data[0..3]   writes a page of the user memory [Section 10.4 (NTAG)]
+
+        Anything else, or an address out of range, is NAK'ed
+    */
+
+    *response_length = 0;
+
+    if (length < 2 || command[1] >= NTAG213_PAGES) {
+        return SIMULATED_STATUS_MIFARE_ERROR;
+    }
+
+    unsigned char page = command[1];
+
+    switch (command[0]) {
+        case NTAG_READ:
+            for (int i = 0; i < 4; i++) {
+                memcpy(response + i * NTAG_PAGE_SIZE, pages[(page + i) % NTAG213_PAGES], NTAG_PAGE_SIZE);
+            }
+
+            *response_length = 4 * NTAG_PAGE_SIZE;
+            return SIMULATED_STATUS_OK;
+
+        case NTAG_WRITE:
+            if (length != 2 + NTAG_PAGE_SIZE || page < NTAG213_FIRST_USER_PAGE || page > NTAG213_LAST_USER_PAGE) {
+                return SIMULATED_STATUS_MIFARE_ERROR;
+            }
+
+            memcpy(pages[page], command + 2, NTAG_PAGE_SIZE);
+            return SIMULATED_STATUS_OK;
+
+        default:
+            return SIMULATED_STATUS_MIFARE_ERROR;
+    }
+};
+
+/*
+    Simulated_ISO_DEP_Card
+*/
+
+// TL 06, T0 75 (TA, TB and TC follow, FSCI 5), TA 77, TB 81 (FWI 8, SFGI 1), TC 02, and one historical byte
+static const unsigned char DESFIRE_ATS[5] = {0x75, 0x77, 0x81, 0x02, 0x80};
+
+Simulated_ISO_DEP_Card::Simulated_ISO_DEP_Card(const unsigned char* seven_byte_uid) {
+    atqa[0] = 0x03;
+    atqa[1] = 0x44;
+    sak = 0x20;
+    memcpy(uid, seven_byte_uid, 7);
+    uid_length = 7;
+
+    memcpy(ats, DESFIRE_ATS, sizeof(DESFIRE_ATS));
+    ats_length = sizeof(DESFIRE_ATS);
+
+    memset(file, 0, sizeof(file));
+};
+
+static void put_status_word(unsigned char* response, int* response_length, unsigned int status_word) {
+    response[(*response_length)++] = status_word >> 8;
+    response[(*response_length)++] = status_word & 0xFF;
+};
+
+unsigned char Simulated_ISO_DEP_Card::exchange(const unsigned char* command, int length, unsigned char* response, int* response_length) {
+    /*
+        READ BINARY Le              returns Le bytes (256 for Le = 0) of the file from offset P1 P2 [Section 6.1 (ISO-7816-4)]
+        UPDATE BINARY Lc Data       writes Lc bytes to the file from offset P1 P2 [Section 6.3 (ISO-7816-4)]
+
+        Each answered with a status word; anything else with SW_INS_NOT_SUPPORTED. The ISO14443-4 blocks carrying them are the
+        reader's to handle, so a whole APDU is exchanged at once.
+    */
+
+    *response_length = 0;
+
+    if (length < APDU_HEADER_SIZE) {
+        put_status_word(response, response_length, SW_WRONG_LENGTH);
+        return SIMULATED_STATUS_OK;
+    }
+
+    int offset = (command[APDU_P1_IDX] << 8) | command[APDU_P2_IDX];
+
+    switch (command[APDU_INS_IDX]) {
+        case APDU_READ_BINARY: {
+            int count = (length > APDU_LC_IDX && command[APDU_LC_IDX] != 0) ? command[APDU_LC_IDX] : 256;
+
+            if (offset + count > ISO_DEP_FILE_SIZE) {
+                put_status_word(response, response_length, SW_WRONG_OFFSET);
+                break;
+            }
+
+            memcpy(response, file + offset, count);
+            *response_length = count;
+            put_status_word(response, response_length, SW_SUCCESS);
+            break;
+        }
+
+        case APDU_UPDATE_BINARY: {
+            int count = (length > APDU_LC_IDX) ? command[APDU_LC_IDX] : 0;
+
+            if (length != APDU_HEADER_SIZE + 1 + count) {
+                put_status_word(response, response_length, SW_WRONG_LENGTH);
+                break;
+            }
+
+            if (offset + count > ISO_DEP_FILE_SIZE) {
+                put_status_word(response, response_length, SW_WRONG_OFFSET);
+                break;
+            }
+
+            memcpy(file + offset, command + APDU_HEADER_SIZE + 1, count);
+            put_status_word(response, response_length, SW_SUCCESS);
+            break;
+        }
+
+        default:
+            put_status_word(response, response_length, SW_INS_NOT_SUPPORTED);
+            break;
+    }
+
+    return SIMULATED_STATUS_OK;
+};
+
+#endif
@@ -0,0 +1,128 @@
+/*
+    Simulated_Cards.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Tags for the simulated readers (e.g. `PN532_Model`) to find in their fields; a MIFARE Classic 1K, an NTAG213, and an ISO14443-4
+    card with an ISO 7816-4 file, as a MIFARE DESFire has. Each answers the commands a reader passes on to it with a PN532 status
+    byte, and what it sends back.
+
+    The following sources were referenced.
+
+    https://www.nxp.com/docs/en/data-sheet/MF1S50YYX_V1.pdf [MF1S50]
+    https://www.nxp.com/docs/en/data-sheet/NTAG213_215_216.pdf [NTAG]
+    https://www.nxp.com/docs/en/user-guide/141520.pdf [PN532UM]
+    http://www.emutag.com/iso/14443-4.pdf [ISO-4]
+    https://cardwerk.com/smart-card-standard-iso7816-4-section-6-basic-interindustry-commands/ [ISO-7816-4]
+*/
+
+#ifndef SIMULATED_CARDS_H
+#define SIMULATED_CARDS_H
+
+#ifdef NATIVE
+
+// Status bytes the PN532 reports for an exchange [Section 7.1 (PN532UM)]
+#define SIMULATED_STATUS_OK             0x00
+#define SIMULATED_STATUS_TIMEOUT        0x01 // The tag did not answer
+#define SIMULATED_STATUS_MIFARE_ERROR   0x14 // Authentication failed, or the tag NAK'ed
+
+#define SIMULATED_MAX_RESPONSE          258 // A response APDU with 256 bytes of data, and its status word
+#define SIMULATED_MAX_ATS               16
+
+class Simulated_Card {
+    public:
+        virtual ~Simulated_Card() {
+            ;
+        };
+
+        // Put the card back in the state it powers up in, e.g. when the field goes off
+        virtual void reset() {
+            ;
+        };
+
+        /*
+            Handle `length` bytes of `command`, as received over the RF, and place what the card sends back in `response`, which
+            holds SIMULATED_MAX_RESPONSE bytes, and its length in `response_length`; returns the PN532 status of the exchange
+        */
+        virtual unsigned char exchange(const unsigned char* command, int length, unsigned char* response, int* response_length) = 0;
+
+        unsigned char atqa[2];
+        unsigned char sak;
+        unsigned char uid[10];
+        unsigned char uid_length;
+
+        // ATS bytes after TL, sent in answer to RATS by a card with bit 5 of its SAK set; none by default
+        unsigned char ats[SIMULATED_MAX_ATS];
+        unsigned char ats_length;
+};
+
+#define MIFARE_CLASSIC_1K_BLOCKS        64
+#define MIFARE_CLASSIC_BLOCK_SIZE       16
+
+class Simulated_MIFARE_Classic : public Simulated_Card {
+    public:
+        Simulated_MIFARE_Classic(const unsigned char* four_byte_uid);
+
+        void reset();
+        unsigned char exchange(const unsigned char* command, int length, unsigned char* response, int* response_length);
+
+        // Memory as it would be read with every sector authenticated, trailers included
+        unsigned char blocks[MIFARE_CLASSIC_1K_BLOCKS][MIFARE_CLASSIC_BLOCK_SIZE];
+
+    private:
+        int _authenticated_sector;
+};
+
+#define NTAG213_PAGES                   45
+#define NTAG_PAGE_SIZE                  4
+#define NTAG213_FIRST_USER_PAGE         4
+#define NTAG213_LAST_USER_PAGE          39
+
+#define NTAG_READ                       0x30
+#define NTAG_WRITE                      0xA2
+
+class Simulated_NTAG213 : public Simulated_Card {
+    public:
+        Simulated_NTAG213(const unsigned char* seven_byte_uid);
+
+        unsigned char exchange(const unsigned char* command, int length, unsigned char* response, int* response_length);
+
+        unsigned char pages[NTAG213_PAGES][NTAG_PAGE_SIZE];
+};
+
+// An ISO14443-4 card (SAK 0x20) with one transparent file, read and written with the ISO 7816-4 APDUs below; its ATS (that of
+// a MIFARE DESFire EV1) offers frames of up to 64 bytes and every bit rate up to 848 kbps
+#define ISO_DEP_FILE_SIZE               512
+
+#define APDU_CLA_IDX                    0
+#define APDU_INS_IDX                    1
+#define APDU_P1_IDX                     2
+#define APDU_P2_IDX                     3
+#define APDU_LC_IDX                     4 // Or Le, for a command without data
+#define APDU_HEADER_SIZE                4
+
+#define APDU_READ_BINARY                0xB0
+#define APDU_UPDATE_BINARY              0xD6
+
+// Status words [Section 5.1.3 (ISO-7816-4)]
+#define SW_SUCCESS                      0x9000
+#define SW_WRONG_LENGTH                 0x6700
+#define SW_WRONG_OFFSET                 0x6B00
+#define SW_INS_NOT_SUPPORTED            0x6D00
+
+class Simulated_ISO_DEP_Card : public Simulated_Card {
+    public:
+        Simulated_ISO_DEP_Card(const unsigned char* seven_byte_uid);
+
+        unsigned char exchange(const unsigned char* command, int length, unsigned char* response, int* response_length);
+
+        unsigned char file[ISO_DEP_FILE_SIZE];
+};
+
+#endif
+
+#endif
@@ -0,0 +1,155 @@
+/*
+    HostLink.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Assembles the bytes received from the host (the ESP8266 uplink) over the serial port into lines, and splits each line into a
+    command word followed by space separated arguments.
+*/
+
+#include "HostLink.h"
+
+#include "string.h"
+
+HostLink::HostLink() {
+    _length = 0;
+    _overflowed = false;
+    _num_tokens = 0;
+};
+
+bool HostLink::feed(unsigned char byte) {
+    /*
+        Accept the next byte received from the host; returns `true` once a complete line has been received, after which the
+        command can be inspected with `is()` and `argument...()` until the next byte is fed in
+
+        Lines end with '\n' (a preceding '\r' is ignored). Lines longer than HOST_LINK_LINE_LENGTH are discarded.
+    */
+
+    if (byte == '\r') {
+        return false;
+    }
+
+    if (byte == '\n') {
+        bool complete = !_overflowed && _length > 0;
+
+        _line[_length] = '\0';
+        _length = 0;
+        _overflowed = false;
+
+        if (complete) {
+            tokenize();
+        }
+
+        return complete;
+    }
+
+    // A new line is starting; the previous command is no longer available
+    _num_tokens = 0;
+
+    if (_length == HOST_LINK_LINE_LENGTH) {
+        _overflowed = true;
+    } else {
+        _line[_length++] = byte;
+    }
+
+    return false;
+};
+
+bool HostLink::is(const char* command) {
+    return (_num_tokens > 0) && (strcmp(_tokens[0], command) == 0);
+};
+
+unsigned char HostLink::argument_count() {
+    return (_num_tokens > 0) ? _num_tokens - 1 : 0;
+};
+
+unsigned long HostLink::argument(unsigned char index) {
+    /*
+        Return argument `index` (0 is the first argument after the command word) read as a decimal number, or 0 if there is no
+        such argument
+    */
+
+    if (index >= argument_count()) {
+        return 0;
+    }
+
+    unsigned long value = 0;
+
+    for (char* digit = _tokens[index + 1]; *digit >= '0' && *digit <= '9'; digit++) {
+        value = value * 10 + (*digit - '0');
+    }
+
+    return value;
+};
+
+int HostLink::argument_bytes(unsigned char index, unsigned char* buffer, int max_length) {
+    /*
+        Read argument `index` as a string of hexadecimal digits, two per byte, into `buffer`; returns the number of bytes read,
+        or -1 if there is no such argument, or it is not made of an even number of hexadecimal digits, or it would not fit in
+        `max_length` bytes
+    */
+
+    if (index >= argument_count()) {
+        return -1;
+    }
+
+    char* digits = _tokens[index + 1];
+    int num_digits = strlen(digits);
+
+    if (num_digits % 2 != 0 || num_digits / 2 > max_length) {
+        return -1;
+    }
+
+    for (int i = 0; i < num_digits; i++) {
+        char digit = digits[i];
+        unsigned char nibble;
+
+        if (digit >= '0' && digit <= '9') {
+            nibble = digit - '0';
+        } else if (digit >= 'A' && digit <= 'F') {
+            nibble = digit - 'A' + 10;
+        } else if (digit >= 'a' && digit <= 'f') {
+            nibble = digit - 'a' + 10;
+        } else {
+            return -1;
+        }
+
+        if (i % 2 == 0) {
+            buffer[i / 2] = nibble << 4;
+        } else {
+            buffer[i / 2] |= nibble;
+        }
+    }
+
+    return num_digits / 2;
+};
+
+void HostLink::tokenize() {
+    /*
+        Split the line in place at spaces into the command word and its arguments
+    */
+
+    _num_tokens = 0;
+
+    char* character = _line;
+
+    while (*character != '\0' && _num_tokens < HOST_LINK_MAX_TOKENS) {
+        while (*character == ' ') {
+            *character++ = '\0';
+        }
+
+        if (*character == '\0') {
+            break;
+        }
+
+        _tokens[_num_tokens++] = character;
+
+        while (*character != ' ' && *character != '\0') {
+            character++;
+        }
+    }
+};
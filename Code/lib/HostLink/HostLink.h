@@ -0,0 +1,47 @@
+/*
+    HostLink.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Assembles the bytes received from the host (the ESP8266 uplink) over the serial port into lines, and splits each line into a
+    command word followed by space separated arguments, e.g.
+
+    ACK 1234
+
+    Bytes are fed in one at a time as they arrive, so the main loop never waits for a line to complete.
+*/
+
+#ifndef HOSTLINK_H
+#define HOSTLINK_H
+
+#define HOST_LINK_LINE_LENGTH       64
+#define HOST_LINK_MAX_TOKENS        8 // Command word and arguments
+
+class HostLink {
+    public:
+        HostLink();
+
+        bool feed(unsigned char byte);
+
+        bool is(const char* command);
+
+        unsigned char argument_count();
+        unsigned long argument(unsigned char index);
+        int argument_bytes(unsigned char index, unsigned char* buffer, int max_length);
+
+    private:
+        void tokenize();
+
+        char _line[HOST_LINK_LINE_LENGTH + 1];
+        unsigned char _length;
+        bool _overflowed;
+
+        char* _tokens[HOST_LINK_MAX_TOKENS];
+        unsigned char _num_tokens;
+};
+
+#endif
@@ -1,6 +1,9 @@
 #ifndef ISO14443_H
 #define ISO14443_H
 
+#include "stdint.h"
+#include "string.h"
+
 /*
     ## Short Frame Structure
     E   b7 b6 b5 b4 b3 b2 b1   S
@@ -30,74 +33,462 @@
     ## Anticollision Frame Structure
     S   b7  b6  b5  b4  b3  b2  b1   E
 
+    ## ANTICOLLISION/SELECT Command Structure
+    SEL NVB UID_CLn_0 UID_CLn_1 UID_CLn_2 UID_CLn_3 BCC [CRC_A CRC_A]
+
+    SEL             -   SEL_CL1, SEL_CL2 or SEL_CL3; the cascade level
+    NVB             -   Number of valid bits sent, SEL and NVB included; upper nibble is whole bytes, lower nibble extra bits
+    UID_CLn_x       -   UID bytes of the cascade level; UID_CLn_0 is CASCADE_TAG if the UID continues in the next level
+    BCC             -   UID_CLn_0 ^ UID_CLn_1 ^ UID_CLn_2 ^ UID_CLn_3
+
+    NVB = 0x20 asks every tag in READY state to send its 40 bits; NVB < 0x70 asks the tags whose first bits match those sent to
+    send the rest, with the first bit of the response following the last bit sent in the same byte (a split frame). NVB = 0x70
+    with CRC_A selects the tag, which answers with SAK CRC_A. [Section 6.4.3 (ISO-3)]
+
+    ## SAK Structure
+    b8 b7 b6 b5 b4 b3 b2 b1
+
+    b3              -   Cascade bit; UID not complete
+    b6              -   UID complete, PICC compliant with ISO14443-4
 */
 
 /*
-    Expects two callbacks; send_callback and receive_callback
+    Expects three callbacks; send_callback, receive_callback and collision_callback
 
-    send_callback(uint8_t valid_bits_last_byte, uint8_t byte1, uint8_t byte2, ...)
-    Sends the specified bytes through the RF field.
+    bool send_callback(uint8_t* bytes, uint8_t num_bytes, uint8_t valid_bits_last_byte, uint8_t rx_align)
+    Sends the bytes through the RF field, without appending a CRC. Returns `true` if the frame was sent.
 
-    - valid_bits_last_byte  :   Number of valid bits in the last byte to be sent
-    - byte1, byte2, ...     :   Bytes to be sent
+    - bytes                 :   Bytes to be sent
+    - num_bytes             :   Number of bytes to be sent
+    - valid_bits_last_byte  :   Number of valid bits in the last byte to be sent; 0 if all 8 are valid
+    - rx_align              :   Bit position of the first byte of the response at which the first bit received goes
 
-    receive_callback(uint8_t* buffer, uint8_t length)
-    Reads bytes transmitted back through the RF field.
+    int receive_callback(uint8_t* buffer, uint8_t length)
+    Reads the response to the frame last sent. Returns the number of bytes received (the first, partial, byte of a split frame
+    included), or 0 if nothing was received.
 
     - buffer                :   Pointer to the buffer where received data will be stored
-    - length                :   Number of bytes to be received
+    - length                :   Maximum number of bytes to be received
+
+    int collision_callback()
+    Returns the bit position, counted from bit 0 of the first byte of the last response received (so rx_align included), of the
+    first bit at which several tags answered differently, or -1 if there was no collision.
+
+    e.g. With the PN5180, `transmit_rf()` and `receive_rf()`, with RX_STATUS giving the collision position.
+
+    The following sources were referenced.
+
+    http://www.emutag.com/iso/14443-3.pdf [ISO-3]
 */
 
-#define REQA_FRAME      0x26
-#define WUPA_FRAME      0x52
+#ifndef MAX_UID_LENGTH
+#define MAX_UID_LENGTH          10 // Triple size UID
+#endif
+
+#define REQA_FRAME              0x26
+#define WUPA_FRAME              0x52
+#define HLTA_FRAME              0x50
+
+#define SEL_CL1                 0x93
+#define SEL_CL2                 0x95
+#define SEL_CL3                 0x97
+
+#define CASCADE_TAG             0x88
+#define NVB_ANTICOLLISION       0x20
+#define NVB_SELECT              0x70
+
+#define SAK_CASCADE_BIT         0x04
+#define SAK_ISO14443_4_BIT      0x20
+
+#define CRC_A_INITIAL           0x6363
+
+#define ISO14443A_CASCADE_LEVELS    3
+#define ISO14443A_CASCADE_SIZE      5 // UID bytes of a cascade level, and the BCC
 
-#define SEL_CL1         0x93
-#define SEL_CL2         0x95
-#define SEL_CL3         0x97
+#ifndef ISO14443A_MAX_BRANCHES
+#define ISO14443A_MAX_BRANCHES  8 // Unexplored sides of collisions remembered by `enumerate()`
+#endif
+
+#define ISO14443A_MAX_FAILURES  3
+
+inline uint16_t crc_a(uint8_t* bytes, int length) {
+    /*
+        CRC_A; polynomial x^16 + x^12 + x^5 + 1, processed LSB first, initially 0x6363. Sent LSB first. [Annex B (ISO-3)]
+    */
+
+    uint16_t crc = CRC_A_INITIAL;
+
+    for (int i = 0; i < length; i++) {
+        uint8_t byte = bytes[i] ^ (uint8_t)(crc);
+        byte ^= byte << 4;
+        crc = (crc >> 8) ^ ((uint16_t)(byte) << 8) ^ ((uint16_t)(byte) << 3) ^ (byte >> 4);
+    }
+
+    return crc;
+};
+
+struct ISO14443A_Tag {
+    uint8_t uid[MAX_UID_LENGTH];
+    uint8_t uid_length;
+    uint8_t sak;
+};
 
 template <typename send_callback, typename receive_callback, typename collision_callback>
 class ISO14443A_PCD {
     public:
         ISO14443A_PCD(send_callback send_cb, receive_callback receive_cb, collision_callback collision_cb)
             : _send_callback(send_cb), _receive_callback(receive_cb), _collision_callback(collision_cb) {
-                ;
+                _num_branches = 0;
+                _rounds = 0;
         };
 
-        void send_REQA() {
-            _send_callback(7, REQA_FRAME);  // Send the REQA command
-        };
+        bool request(bool wake_up, uint8_t* atqa) {
+            /*
+                Send REQA, or WUPA to also wake tags that were halted, and receive the ATQA into `atqa`; returns `true` if any
+                tag answered. The ATQAs of several tags collide, which is expected. [Section 6.4.1 (ISO-3)]
+            */
+
+            uint8_t frame = wake_up ? WUPA_FRAME : REQA_FRAME;
+
+            if (!_send_callback(&frame, 1, 7, 0)) {
+                return false;
+            }
 
-        void send_WUPA() {
-            _send_callback(7, WUPA_FRAME);  // Send the WUPA command
+            return _receive_callback(atqa, 2) == 2;
         };
 
-        void receive_ATQA(uint8_t* atqa_buffer) {
-            _receive_callback(atqa_buffer, 2);  // Receive 2 bytes for ATQA
+        bool select(ISO14443A_Tag* tag) {
+            /*
+                Select one of the tags that answered the last `request()`, going through as many cascade levels as its UID
+                needs, and place its UID and SAK in `tag`. Where tags collide, the one with a 1 at the first colliding bit is
+                taken. Returns `true` if a tag was selected.
+            */
+
+            Branch path;
+            path.level = 0;
+            path.known_bits = 0;
+
+            _rounds = 0;
+
+            return resolve(&path, tag, false) > 0;
         };
 
-        template <typename... bytes>
-        void send_AC(uint8_t CLn, uint8_t NVB, bytes... uncollided_bytes) {
-            if (NVB == 0x20) {
-                // No bytes have been read, we ask to send all UID bytes
-                _send_callback(0, CLn, NVB);  // Send CLn and NVB
-            } else {
-                uint8_t num_uncollided_bits = (NVB - 0x20) % 8;
-                _send_callback(num_uncollided_bits, CLn, NVB, uncollided_bytes...);
+        bool select_uid(uint8_t* uid, uint8_t uid_length, ISO14443A_Tag* tag) {
+            /*
+                Select the tag whose `uid` is already known, e.g. from an earlier `enumerate()`, directly with SELECT at every
+                cascade level, without anticollision; the tag must have answered the last `request()`. Places its UID and SAK in
+                `tag`, and returns `true` if it was selected.
+            */
+
+            uint8_t levels = (uid_length == 4) ? 1 : (uid_length == 7) ? 2 : (uid_length == 10) ? 3 : 0;
+            if (levels == 0) {
+                return false;
+            }
+
+            for (uint8_t level = 0; level < levels; level++) {
+                uint8_t bytes[ISO14443A_CASCADE_SIZE];
+
+                if (level < levels - 1) {
+                    bytes[0] = CASCADE_TAG;
+                    memcpy(bytes + 1, uid + 3 * level, 3);
+                } else {
+                    memcpy(bytes, uid + 3 * level, 4);
+                }
+
+                bytes[4] = bcc(bytes);
+
+                uint8_t sak;
+                if (!select_level(level, bytes, &sak)) {
+                    return false;
+                }
+
+                // The cascade bit must be set at every level but the last
+                if (((sak & SAK_CASCADE_BIT) != 0) != (level < levels - 1)) {
+                    return false;
+                }
+
+                tag->sak = sak;
             }
-        }
 
-        void receive_AC(uint8_t* receive_buffer, uint8_t* uncollided_bytes) {
-            _receive_callback(receive_buffer, 5);  // Receive UID bytes, we must read 5 bytes
-            uint8_t first_collision_pos = _collision_callback();
-            // Store into uncollided bytes the bytes that were not collided reading from receive_buffer
+            memcpy(tag->uid, uid, uid_length);
+            tag->uid_length = uid_length;
+
+            return true;
         };
 
+        bool halt() {
+            /*
+                Send HLTA; the selected tag goes to HALT, and answers only WUPA from then on. Tags left in READY return to IDLE.
+                A tag that accepts HLTA does not answer it. [Section 6.4.4 (ISO-3)]
+            */
+
+            uint8_t frame[4] = {HLTA_FRAME, 0x00, 0x00, 0x00};
+            append_crc(frame, 2);
+
+            return _send_callback(frame, 4, 0, 0);
+        };
+
+        int enumerate(ISO14443A_Tag* tags, int max_tags) {
+            /*
+                Select and halt every tag in the field in turn, placing their UIDs and SAKs in `tags`, of length `max_tags`;
+                returns the number of tags found. The tags are left halted.
+
+                When tags collide, the tag with a 1 at the colliding bit is resolved first, and the known bits with a 0 instead
+                are remembered. Later anticollision loops resume from those bits, selecting the known lower cascade levels
+                directly, so every colliding bit costs one anticollision round rather than one per tag behind it. A pass from
+                the start (REQA, NVB 0x20) then runs once nothing is remembered, and enumeration ends when no tag answers it.
+            */
+
+            _num_branches = 0;
+            _rounds = 0;
 
+            int num_tags = 0;
+            uint8_t failures = 0;
+            bool wake_up = true; // Tags halted by an earlier enumeration are woken once
+
+            while (num_tags < max_tags && failures < ISO14443A_MAX_FAILURES) {
+                Branch branch;
+                bool from_start = (_num_branches == 0);
+
+                if (from_start) {
+                    branch.level = 0;
+                    branch.known_bits = 0;
+                } else {
+                    _num_branches--;
+                    branch = _branches[_num_branches];
+                }
+
+                uint8_t atqa[2];
+                if (!request(wake_up, atqa)) {
+                    if (from_start) {
+                        break; // Every tag has been halted
+                    }
+
+                    continue;
+                }
+
+                wake_up = false;
+
+                int result = resolve(&branch, &tags[num_tags], true);
+
+                // Halt the selected tag; tags left in READY return to IDLE, to answer the next REQA
+                halt();
+
+                if (result > 0 && !is_duplicate(tags, num_tags)) {
+                    num_tags++;
+                } else if (result != 0 || from_start) {
+                    failures++;
+                }
+            }
+
+            return num_tags;
+        };
+
+        unsigned int anticollision_rounds() {
+            // Anticollision frames sent by the last `select()` or `enumerate()`
+            return _rounds;
+        };
 
     private:
+        struct Branch {
+            uint8_t level;          // Cascade level with bits still unknown
+            uint8_t known_bits;     // Bits known at that cascade level
+            uint8_t cascade[ISO14443A_CASCADE_LEVELS][ISO14443A_CASCADE_SIZE]; // Complete below `level`
+        };
+
+        int resolve(Branch* path, ISO14443A_Tag* tag, bool record_branches) {
+            /*
+                Select a tag whose UID begins with the bits in `path`, and place its UID and SAK in `tag`
+
+                Returns 1 if a tag was selected, 0 if none answered, and -1 on a transmission error.
+            */
+
+            uint8_t start_level = path->level;
+            tag->uid_length = 0;
+
+            for (uint8_t level = 0; level < ISO14443A_CASCADE_LEVELS; level++) {
+                uint8_t* bytes = path->cascade[level];
+
+                if (level >= start_level) {
+                    uint8_t known_bits = (level == start_level) ? path->known_bits : 0;
+
+                    int result = anticollision(path, level, known_bits, record_branches);
+                    if (result <= 0) {
+                        return result;
+                    }
+                }
+
+                uint8_t sak;
+                if (!select_level(level, bytes, &sak)) {
+                    // The lower cascade levels of a remembered branch are selected blindly; the tags may have left
+                    return (level < start_level) ? 0 : -1;
+                }
+
+                if (sak & SAK_CASCADE_BIT) {
+                    if (bytes[0] != CASCADE_TAG || level == ISO14443A_CASCADE_LEVELS - 1) {
+                        return -1;
+                    }
+
+                    memcpy(tag->uid + tag->uid_length, bytes + 1, 3);
+                    tag->uid_length += 3;
+                } else {
+                    memcpy(tag->uid + tag->uid_length, bytes, 4);
+                    tag->uid_length += 4;
+                    tag->sak = sak;
+
+                    return 1;
+                }
+            }
+
+            return -1;
+        };
+
+        int anticollision(Branch* path, uint8_t level, uint8_t known_bits, bool record_branches) {
+            /*
+                Complete the UID bytes and BCC at cascade `level` in `path`, of which the first `known_bits` bits are known, with
+                bit-oriented anticollision [Section 6.5.3 (ISO-3)]
+
+                Returns 1 once all 40 bits are known and the BCC checks, 0 if no tag answered, and -1 on a transmission error.
+            */
+
+            uint8_t* bytes = path->cascade[level];
+
+            while (true) {
+                uint8_t whole_bytes = known_bits / 8;
+                uint8_t extra_bits = known_bits % 8;
+                uint8_t sent_bytes = whole_bytes + (extra_bits ? 1 : 0);
+
+                uint8_t frame[2 + ISO14443A_CASCADE_SIZE];
+                frame[0] = SEL_CL1 + 2 * level;
+                frame[1] = ((2 + whole_bytes) << 4) | extra_bits;
+                memcpy(frame + 2, bytes, sent_bytes);
+
+                _rounds++;
+
+                // The response fills the rest of the last byte sent, and then the following bytes
+                if (!_send_callback(frame, 2 + sent_bytes, extra_bits, extra_bits)) {
+                    return -1;
+                }
+
+                uint8_t response[ISO14443A_CASCADE_SIZE];
+                int received = _receive_callback(response, ISO14443A_CASCADE_SIZE - whole_bytes);
+
+                if (received <= 0) {
+                    return 0;
+                }
+
+                int collision = _collision_callback();
+
+                uint8_t known_mask = (1 << extra_bits) - 1;
+                bytes[whole_bytes] = (bytes[whole_bytes] & known_mask) | (response[0] & ~known_mask);
+                memcpy(bytes + whole_bytes + 1, response + 1, received - 1);
+
+                if (collision < 0) {
+                    if (whole_bytes + received < ISO14443A_CASCADE_SIZE) {
+                        return -1;
+                    }
+
+                    return (bcc(bytes) == bytes[4]) ? 1 : -1;
+                }
+
+                // The bits before the collision are common to every tag that answered
+                int position = whole_bytes * 8 + collision;
+                if (position < known_bits || position >= 32) {
+                    return -1;
+                }
+
+                uint8_t bit = 1 << (position % 8);
+                uint8_t below = bit - 1;
+                bytes[position / 8] &= below;
+
+                if (record_branches) {
+                    remember(path, level, position + 1);
+                }
+
+                bytes[position / 8] |= bit;
+                known_bits = position + 1;
+            }
+        };
+
+        bool select_level(uint8_t level, uint8_t* bytes, uint8_t* sak) {
+            // Send SELECT for the complete UID bytes and BCC of cascade `level`, and receive SAK [Section 6.5.3.4 (ISO-3)]
+            uint8_t frame[2 + ISO14443A_CASCADE_SIZE + 2];
+            frame[0] = SEL_CL1 + 2 * level;
+            frame[1] = NVB_SELECT;
+            memcpy(frame + 2, bytes, ISO14443A_CASCADE_SIZE);
+            append_crc(frame, 2 + ISO14443A_CASCADE_SIZE);
+
+            if (!_send_callback(frame, sizeof(frame), 0, 0)) {
+                return false;
+            }
+
+            uint8_t response[3];
+            if (_receive_callback(response, 3) != 3 || _collision_callback() >= 0) {
+                return false;
+            }
+
+            uint16_t crc = crc_a(response, 1);
+            if (response[1] != (uint8_t)(crc) || response[2] != (uint8_t)(crc >> 8)) {
+                return false;
+            }
+
+            *sak = response[0];
+            return true;
+        };
+
+        void remember(Branch* path, uint8_t level, uint8_t known_bits) {
+            /*
+                Remember the other side of a collision; `path` with its last known bit, which is still 0, the bit at which the
+                tags collided. When the stack is full the branch is dropped; the pass from the start still finds its tags.
+            */
+
+            if (_num_branches == ISO14443A_MAX_BRANCHES) {
+                return;
+            }
+
+            _branches[_num_branches] = *path;
+            _branches[_num_branches].level = level;
+            _branches[_num_branches].known_bits = known_bits;
+            _num_branches++;
+        };
+
+        bool is_duplicate(ISO14443A_Tag* tags, int num_tags) {
+            // A tag that did not accept HLTA answers again; keep it once
+            for (int i = 0; i < num_tags; i++) {
+                if (tags[i].uid_length == tags[num_tags].uid_length &&
+                    memcmp(tags[i].uid, tags[num_tags].uid, tags[i].uid_length) == 0) {
+                    return true;
+                }
+            }
+
+            return false;
+        };
+
+        uint8_t bcc(uint8_t* bytes) {
+            return bytes[0] ^ bytes[1] ^ bytes[2] ^ bytes[3];
+        };
+
+        void append_crc(uint8_t* frame, int length) {
+            uint16_t crc = crc_a(frame, length);
+            frame[length] = (uint8_t)(crc);
+            frame[length + 1] = (uint8_t)(crc >> 8);
+        };
+
         send_callback _send_callback;
         receive_callback _receive_callback;
         collision_callback _collision_callback;
+
+        Branch _branches[ISO14443A_MAX_BRANCHES];
+        uint8_t _num_branches;
+        unsigned int _rounds;
+};
+
+template <typename send_callback, typename receive_callback, typename collision_callback>
+ISO14443A_PCD<send_callback, receive_callback, collision_callback> make_ISO14443A_PCD(send_callback send_cb,
+                                                                                    receive_callback receive_cb,
+                                                                                    collision_callback collision_cb) {
+    // Deduces the callback types, so that lambdas can be passed
+    return ISO14443A_PCD<send_callback, receive_callback, collision_callback>(send_cb, receive_cb, collision_cb);
 };
 
-#endif
\ No newline at end of file
+#endif
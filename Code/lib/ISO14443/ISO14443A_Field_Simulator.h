@@ -0,0 +1,338 @@
+#ifndef ISO14443A_FIELD_SIMULATOR_H
+#define ISO14443A_FIELD_SIMULATOR_H
+
+#include "stdint.h"
+#include "string.h"
+#include "ISO14443.h"
+
+/*
+    A simulated RF field holding a population of ISO14443A tags, for running `ISO14443A_PCD` on a host without a reader
+
+    Each tag follows the PICC state machine (IDLE, READY, ACTIVE, HALT) through REQA, WUPA, ANTICOLLISION, SELECT and HLTA
+    [Section 6.3 (ISO-3)]. The responses of every tag that answers a frame are combined bit by bit; a bit at which they differ
+    is a collision, as a reader's receiver would see it.
+
+    ISO14443A_Field_Simulator field;
+    field.add_tag(uid, 7, 0x08);
+
+    auto pcd = make_ISO14443A_PCD(
+        [&](uint8_t* bytes, uint8_t num_bytes, uint8_t valid_bits, uint8_t rx_align) {
+            return field.send(bytes, num_bytes, valid_bits, rx_align);
+        },
+        [&](uint8_t* buffer, uint8_t length) { return field.receive(buffer, length); },
+        [&]() { return field.collision(); });
+
+    The following sources were referenced.
+
+    http://www.emutag.com/iso/14443-3.pdf [ISO-3]
+*/
+
+#ifndef ISO14443A_FIELD_CAPACITY
+#define ISO14443A_FIELD_CAPACITY    32
+#endif
+
+#define ISO14443A_MAX_RESPONSE_SIZE 16
+
+// PICC States
+#define PICC_IDLE                   0
+#define PICC_READY                  1
+#define PICC_ACTIVE                 2
+#define PICC_HALT                   3
+
+class ISO14443A_Field_Simulator {
+    public:
+        ISO14443A_Field_Simulator() {
+            clear();
+        };
+
+        void clear() {
+            _num_tags = 0;
+            _response_bytes = 0;
+            _collision = -1;
+            _frames = 0;
+        };
+
+        bool add_tag(uint8_t* uid, uint8_t uid_length, uint8_t sak) {
+            /*
+                Place a tag with a single (4), double (7) or triple (10) size `uid` in the field; `sak` is the SAK it answers
+                with once selected. The tag starts in IDLE.
+            */
+
+            if (_num_tags == ISO14443A_FIELD_CAPACITY || (uid_length != 4 && uid_length != 7 && uid_length != 10)) {
+                return false;
+            }
+
+            Tag* tag = &_tags[_num_tags++];
+
+            memcpy(tag->uid, uid, uid_length);
+            tag->uid_length = uid_length;
+            tag->sak = sak & ~SAK_CASCADE_BIT;
+            tag->state = PICC_IDLE;
+            tag->level = 0;
+
+            return true;
+        };
+
+        bool remove_tag(uint8_t* uid, uint8_t uid_length) {
+            // Take a tag out of the field
+            for (int i = 0; i < _num_tags; i++) {
+                if (_tags[i].uid_length == uid_length && memcmp(_tags[i].uid, uid, uid_length) == 0) {
+                    _tags[i] = _tags[--_num_tags];
+                    return true;
+                }
+            }
+
+            return false;
+        };
+
+        void reset() {
+            // Switch the field off and on; every tag returns to IDLE
+            for (int i = 0; i < _num_tags; i++) {
+                _tags[i].state = PICC_IDLE;
+                _tags[i].level = 0;
+            }
+        };
+
+        bool send(uint8_t* bytes, uint8_t num_bytes, uint8_t valid_bits_last_byte, uint8_t rx_align) {
+            /*
+                Deliver a frame to every tag, and combine their responses for `receive()` and `collision()`
+            */
+
+            int num_bits = (valid_bits_last_byte == 0) ? num_bytes * 8 : (num_bytes - 1) * 8 + valid_bits_last_byte;
+
+            uint8_t response[ISO14443A_MAX_RESPONSE_SIZE];
+            uint8_t mask[ISO14443A_MAX_RESPONSE_SIZE];  // Bits at which some tag answered
+            uint8_t conflict[ISO14443A_MAX_RESPONSE_SIZE];
+            int response_bits = 0;
+
+            memset(response, 0, sizeof(response));
+            memset(mask, 0, sizeof(mask));
+            memset(conflict, 0, sizeof(conflict));
+
+            _frames++;
+
+            for (int i = 0; i < _num_tags; i++) {
+                uint8_t answer[ISO14443A_MAX_RESPONSE_SIZE];
+                int answer_bits = respond(&_tags[i], bytes, num_bits, answer);
+
+                // Place the answer from bit `rx_align` of the first byte onwards
+                for (int bit = 0; bit < answer_bits; bit++) {
+                    int target = rx_align + bit;
+                    uint8_t value = (answer[bit / 8] >> (bit % 8)) & 0x01;
+                    uint8_t position = 1 << (target % 8);
+
+                    if (mask[target / 8] & position) {
+                        if (((response[target / 8] & position) != 0) != value) {
+                            conflict[target / 8] |= position;
+                        }
+                    } else {
+                        mask[target / 8] |= position;
+                    }
+
+                    // Colliding bits read as 1
+                    if (value) {
+                        response[target / 8] |= position;
+                    }
+                }
+
+                if (answer_bits > 0 && rx_align + answer_bits > response_bits) {
+                    response_bits = rx_align + answer_bits;
+                }
+            }
+
+            _response_bytes = (response_bits + 7) / 8;
+            memcpy(_response, response, _response_bytes);
+
+            _collision = -1;
+            for (int bit = 0; bit < response_bits; bit++) {
+                if (conflict[bit / 8] & (1 << (bit % 8))) {
+                    _collision = bit;
+                    break;
+                }
+            }
+
+            return true;
+        };
+
+        int receive(uint8_t* buffer, uint8_t length) {
+            int received = (_response_bytes < length) ? _response_bytes : length;
+            memcpy(buffer, _response, received);
+
+            return received;
+        };
+
+        int collision() {
+            return _collision;
+        };
+
+        int num_tags() {
+            return _num_tags;
+        };
+
+        int halted() {
+            // Tags in HALT
+            int count = 0;
+            for (int i = 0; i < _num_tags; i++) {
+                count += (_tags[i].state == PICC_HALT);
+            }
+
+            return count;
+        };
+
+        unsigned long frames() {
+            // Frames sent into the field since `clear()`
+            return _frames;
+        };
+
+    private:
+        struct Tag {
+            uint8_t uid[MAX_UID_LENGTH];
+            uint8_t uid_length;
+            uint8_t sak;
+            uint8_t state;
+            uint8_t level; // Cascade level reached while in READY
+        };
+
+        void cascade_bytes(Tag* tag, uint8_t level, uint8_t* bytes) {
+            // The UID bytes and BCC that `tag` answers with at cascade `level` [Section 6.4.4 (ISO-3)]
+            uint8_t levels = (tag->uid_length == 4) ? 1 : (tag->uid_length == 7) ? 2 : 3;
+
+            if (level < levels - 1) {
+                bytes[0] = CASCADE_TAG;
+                memcpy(bytes + 1, tag->uid + 3 * level, 3);
+            } else {
+                memcpy(bytes, tag->uid + 3 * level, 4);
+            }
+
+            bytes[4] = bytes[0] ^ bytes[1] ^ bytes[2] ^ bytes[3];
+        };
+
+        bool is_last_level(Tag* tag) {
+            return tag->level == ((tag->uid_length == 4) ? 0 : (tag->uid_length == 7) ? 1 : 2);
+        };
+
+        int respond(Tag* tag, uint8_t* bytes, int num_bits, uint8_t* answer) {
+            /*
+                Run `tag` through a frame of `num_bits` bits; places its answer in `answer` and returns its length in bits, 0 if
+                it stays silent
+            */
+
+            // Short frames
+            if (num_bits == 7) {
+                uint8_t command = bytes[0] & 0x7F;
+
+                bool answers = (tag->state == PICC_IDLE && (command == REQA_FRAME || command == WUPA_FRAME)) ||
+                               (tag->state == PICC_HALT && command == WUPA_FRAME);
+
+                if (!answers) {
+                    // REQA and WUPA are unexpected in READY and ACTIVE
+                    if (tag->state == PICC_READY || tag->state == PICC_ACTIVE) {
+                        tag->state = PICC_IDLE;
+                    }
+
+                    return 0;
+                }
+
+                tag->state = PICC_READY;
+                tag->level = 0;
+
+                uint8_t uid_size = (tag->uid_length == 4) ? 0 : (tag->uid_length == 7) ? 1 : 2;
+                answer[0] = (uid_size << 6) | 0x04;
+                answer[1] = 0x00;
+
+                return 16;
+            }
+
+            if (num_bits >= 32 && bytes[0] == HLTA_FRAME && bytes[1] == 0x00) {
+                if (tag->state == PICC_ACTIVE) {
+                    tag->state = PICC_HALT;
+                } else if (tag->state == PICC_READY) {
+                    tag->state = PICC_IDLE;
+                }
+
+                return 0;
+            }
+
+            bool is_select = (num_bits >= 16) && (bytes[0] == SEL_CL1 || bytes[0] == SEL_CL2 || bytes[0] == SEL_CL3);
+
+            if (!is_select) {
+                if (tag->state == PICC_READY || tag->state == PICC_ACTIVE) {
+                    tag->state = PICC_IDLE;
+                }
+
+                return 0;
+            }
+
+            uint8_t level = (bytes[0] - SEL_CL1) / 2;
+            if (tag->state != PICC_READY || tag->level != level) {
+                return 0;
+            }
+
+            uint8_t own[ISO14443A_CASCADE_SIZE];
+            cascade_bytes(tag, level, own);
+
+            uint8_t nvb = bytes[1];
+
+            if (nvb == NVB_SELECT) {
+                // SELECT; answer SAK if the UID bytes are this tag's
+                if (num_bits != 9 * 8 || memcmp(bytes + 2, own, ISO14443A_CASCADE_SIZE) != 0) {
+                    return 0;
+                }
+
+                uint16_t crc = crc_a(bytes, 7);
+                if (bytes[7] != (uint8_t)(crc) || bytes[8] != (uint8_t)(crc >> 8)) {
+                    return 0;
+                }
+
+                if (is_last_level(tag)) {
+                    tag->state = PICC_ACTIVE;
+                    answer[0] = tag->sak;
+                } else {
+                    tag->level++;
+                    answer[0] = SAK_CASCADE_BIT;
+                }
+
+                crc = crc_a(answer, 1);
+                answer[1] = (uint8_t)(crc);
+                answer[2] = (uint8_t)(crc >> 8);
+
+                return 24;
+            }
+
+            // ANTICOLLISION; answer the remaining bits if the bits sent match the start of this tag's
+            int known_bits = ((nvb >> 4) - 2) * 8 + (nvb & 0x0F);
+            if (known_bits < 0 || known_bits >= 40 || num_bits != 16 + known_bits) {
+                return 0;
+            }
+
+            for (int bit = 0; bit < known_bits; bit++) {
+                uint8_t sent = (bytes[2 + bit / 8] >> (bit % 8)) & 0x01;
+                uint8_t mine = (own[bit / 8] >> (bit % 8)) & 0x01;
+
+                if (sent != mine) {
+                    return 0;
+                }
+            }
+
+            memset(answer, 0, ISO14443A_CASCADE_SIZE);
+            for (int bit = known_bits; bit < 40; bit++) {
+                if ((own[bit / 8] >> (bit % 8)) & 0x01) {
+                    int target = bit - known_bits;
+                    answer[target / 8] |= 1 << (target % 8);
+                }
+            }
+
+            return 40 - known_bits;
+        };
+
+        Tag _tags[ISO14443A_FIELD_CAPACITY];
+        int _num_tags;
+
+        uint8_t _response[ISO14443A_MAX_RESPONSE_SIZE];
+        int _response_bytes;
+        int _collision;
+
+        unsigned long _frames;
+};
+
+#endif
@@ -0,0 +1,166 @@
+/*
+    Manifest.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    The pallets of the shipment being loaded, for checking each tag detected against it on the spot.
+
+    The following sources were referenced.
+
+    http://www.isthe.com/chongo/tech/comp/fnv/index.html [FNV]
+*/
+
+#include "Manifest.h"
+
+#include "string.h"
+
+// 32-bit FNV-1a [FNV]
+#define FNV_OFFSET_BASIS        2166136261UL
+#define FNV_PRIME               16777619UL
+
+Manifest::Manifest() {
+    clear();
+};
+
+void Manifest::clear() {
+    // Drop the manifest; nothing is checked until another is loaded
+    _pallets = 0;
+    _loaded = 0;
+    _shipment = 0;
+    _active = false;
+
+    memset(_loaded_bits, 0, sizeof(_loaded_bits));
+};
+
+void Manifest::begin(unsigned long shipment) {
+    /*
+        Start loading the manifest of `shipment`, replacing the one before; it is checked against once `end()` is called
+    */
+
+    clear();
+    _shipment = shipment;
+};
+
+bool Manifest::add(unsigned char* uid, unsigned char uid_length) {
+    /*
+        Add the pallet whose tag has the given UID to the manifest being loaded, keeping the fingerprints sorted; one already on
+        it is not added twice. Returns `false` if the manifest is full, or was already loaded with `end()`.
+    */
+
+    if (_active) {
+        return false;
+    }
+
+    unsigned long print = fingerprint(uid, uid_length);
+
+    if (find(print) >= 0) {
+        return true;
+    }
+
+    if (_pallets == MANIFEST_CAPACITY) {
+        return false;
+    }
+
+    // Insertion; the manifest is loaded once per shipment, and is short, so the shifting costs nothing that matters
+    int i = _pallets;
+
+    while (i > 0 && _fingerprints[i - 1] > print) {
+        _fingerprints[i] = _fingerprints[i - 1];
+        i--;
+    }
+
+    _fingerprints[i] = print;
+    _pallets++;
+
+    return true;
+};
+
+void Manifest::end() {
+    // The manifest is loaded; check the tags detected against it from now on
+    _active = true;
+};
+
+unsigned char Manifest::check(unsigned char* uid, unsigned char uid_length) {
+    /*
+        Look up the tag with the given UID, marking it loaded if it is on the manifest; returns MANIFEST_EXPECTED the first time
+        a pallet on the manifest is seen, MANIFEST_ALREADY_LOADED after that, MANIFEST_UNEXPECTED for a pallet not on it, or
+        MANIFEST_NONE if there is no manifest to check against
+    */
+
+    if (!_active) {
+        return MANIFEST_NONE;
+    }
+
+    int index = find(fingerprint(uid, uid_length));
+
+    if (index < 0) {
+        return MANIFEST_UNEXPECTED;
+    }
+
+    unsigned char bit = 1 << (index % 8);
+
+    if (_loaded_bits[index / 8] & bit) {
+        return MANIFEST_ALREADY_LOADED;
+    }
+
+    _loaded_bits[index / 8] |= bit;
+    _loaded++;
+
+    return MANIFEST_EXPECTED;
+};
+
+bool Manifest::active() {
+    return _active;
+};
+
+bool Manifest::complete() {
+    // Whether every pallet on the manifest has been loaded
+    return _active && _loaded == _pallets;
+};
+
+unsigned long Manifest::shipment() {
+    return _shipment;
+};
+
+unsigned char Manifest::pallets() {
+    return _pallets;
+};
+
+unsigned char Manifest::loaded() {
+    return _loaded;
+};
+
+unsigned long Manifest::fingerprint(unsigned char* uid, unsigned char uid_length) {
+    unsigned long hash = FNV_OFFSET_BASIS;
+
+    for (int i = 0; i < uid_length; i++) {
+        hash ^= uid[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash & 0xFFFFFFFFUL;
+};
+
+int Manifest::find(unsigned long fingerprint) {
+    // Bisection; returns the index of `fingerprint`, or -1 if it is not on the manifest
+    int low = 0;
+    int high = _pallets - 1;
+
+    while (low <= high) {
+        int middle = (low + high) / 2;
+
+        if (_fingerprints[middle] == fingerprint) {
+            return middle;
+        } else if (_fingerprints[middle] < fingerprint) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    return -1;
+};
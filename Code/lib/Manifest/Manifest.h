@@ -0,0 +1,65 @@
+/*
+    Manifest.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    The pallets of the shipment being loaded, as the host pushes it down, so that each tag detected can be checked against it on
+    the spot; a wrong pallet is flagged to the driver at once, without waiting on the uplink and the backend.
+
+    Rather than the UIDs themselves (up to 10 bytes each), a 32-bit fingerprint of each is kept (FNV-1a), in a sorted array
+    searched by bisection, with a bit per pallet for whether it has been loaded. A tag not on the manifest passes for one with
+    odds of about one in 2^32 / MANIFEST_CAPACITY.
+
+    The following sources were referenced.
+
+    http://www.isthe.com/chongo/tech/comp/fnv/index.html [FNV]
+*/
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#ifndef MANIFEST_CAPACITY
+#define MANIFEST_CAPACITY           128 // Pallets in a shipment; 4 bytes and a bit of SRAM each
+#endif
+
+// What `check()` finds
+#define MANIFEST_NONE               0 // No manifest loaded
+#define MANIFEST_EXPECTED           1 // On the manifest, and seen for the first time
+#define MANIFEST_ALREADY_LOADED     2 // On the manifest, and seen before
+#define MANIFEST_UNEXPECTED         3 // Not on the manifest
+
+class Manifest {
+    public:
+        Manifest();
+
+        void begin(unsigned long shipment);
+        bool add(unsigned char* uid, unsigned char uid_length);
+        void end();
+        void clear();
+
+        unsigned char check(unsigned char* uid, unsigned char uid_length);
+
+        bool active();
+        bool complete();
+        unsigned long shipment();
+        unsigned char pallets();
+        unsigned char loaded();
+
+    private:
+        unsigned long fingerprint(unsigned char* uid, unsigned char uid_length);
+        int find(unsigned long fingerprint);
+
+        unsigned long _fingerprints[MANIFEST_CAPACITY]; // Sorted, ascending
+        unsigned char _loaded_bits[(MANIFEST_CAPACITY + 7) / 8];
+        unsigned char _pallets;
+        unsigned char _loaded;
+
+        unsigned long _shipment;
+        bool _active;
+};
+
+#endif
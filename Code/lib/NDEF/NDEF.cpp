@@ -0,0 +1,141 @@
+/*
+    NDEF.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Builds NDEF records, to be written to a tag with `NDEF_Tag::write_message()`.
+
+    The following sources were referenced.
+
+    https://nfc-forum.org/uploads/specifications/97-NFCForum-TS-NDEF_1.0.pdf [NDEF]
+    https://nfc-forum.org/uploads/specifications/101-NFCForum-TS-RTD_URI_1.0.pdf [RTD-URI]
+    https://nfc-forum.org/uploads/specifications/103-NFCForum-TS-RTD_Text_1.0.pdf [RTD-Text]
+*/
+
+#include "NDEF.h"
+
+#include "string.h"
+
+// URI Identifier Codes [Section 3.2.2 (RTD-URI)]; only the first few, which cover the web and contact URIs, are kept in SRAM
+#define NUM_URI_PREFIXES    7
+
+const char* const URI_PREFIXES[NUM_URI_PREFIXES] = {
+    "", "http://www.", "https://www.", "http://", "https://", "tel:", "mailto:"
+};
+
+const char* ndef_uri_prefix(unsigned char code) {
+    /*
+        The prefix abbreviated by URI identifier code `code`, or a null pointer for the codes not kept
+    */
+
+    return (code < NUM_URI_PREFIXES) ? URI_PREFIXES[code] : nullptr;
+};
+
+static int make_record_header(unsigned char* target, int max_length, unsigned char flags, unsigned char tnf, const unsigned char* type,
+                              int type_length, int payload_length) {
+    /*
+        Header TypeLength PayloadLength[1 or 4] Type[0 ... ]; a short record if the payload is under 256 bytes, and without an ID
+        [Section 3.2 (NDEF)]
+    */
+
+    bool short_record = payload_length < 256;
+    int length = 2 + (short_record ? 1 : 4) + type_length;
+
+    if (length + payload_length > max_length) {
+        return -1;
+    }
+
+    int position = 0;
+    target[position++] = (flags & (NDEF_MB | NDEF_ME)) | (short_record ? NDEF_SR : 0) | (tnf & NDEF_TNF_MASK);
+    target[position++] = type_length;
+
+    if (!short_record) {
+        target[position++] = 0;
+        target[position++] = 0;
+        target[position++] = payload_length >> 8;
+    }
+
+    target[position++] = payload_length;
+
+    memcpy(target + position, type, type_length);
+
+    return length;
+};
+
+int ndef_make_record(unsigned char* target, int max_length, unsigned char flags, unsigned char tnf, const unsigned char* type,
+                     int type_length, const unsigned char* payload, int payload_length) {
+    /*
+        Build a record with the given TNF, type and payload in `target`, which holds `max_length` bytes; `flags` is NDEF_MB if it
+        is the first record of its message, and NDEF_ME if the last (both for a message of one record). Returns the length of the
+        record, or -1 if it does not fit. Records are concatenated to make a message.
+    */
+
+    int header_length = make_record_header(target, max_length, flags, tnf, type, type_length, payload_length);
+
+    if (header_length < 0) {
+        return -1;
+    }
+
+    memcpy(target + header_length, payload, payload_length);
+
+    return header_length + payload_length;
+};
+
+int ndef_make_uri_record(unsigned char* target, int max_length, unsigned char flags, const char* uri) {
+    /*
+        Build a URI record of `uri`, abbreviating the longest prefix that has an identifier code [Section 3.2 (RTD-URI)]
+    */
+
+    unsigned char code = 0;
+    int prefix_length = 0;
+
+    for (unsigned char i = 1; i < NUM_URI_PREFIXES; i++) {
+        int length = strlen(URI_PREFIXES[i]);
+
+        if (length > prefix_length && strncmp(uri, URI_PREFIXES[i], length) == 0) {
+            code = i;
+            prefix_length = length;
+        }
+    }
+
+    int rest_length = strlen(uri) - prefix_length;
+    unsigned char type = NDEF_TYPE_URI;
+
+    int header_length = make_record_header(target, max_length, flags, TNF_WELL_KNOWN, &type, 1, 1 + rest_length);
+
+    if (header_length < 0) {
+        return -1;
+    }
+
+    target[header_length] = code;
+    memcpy(target + header_length + 1, uri + prefix_length, rest_length);
+
+    return header_length + 1 + rest_length;
+};
+
+int ndef_make_text_record(unsigned char* target, int max_length, unsigned char flags, const char* language, const char* text) {
+    /*
+        Build a text record of UTF-8 `text` in `language` (e.g. "en") [Section 3.2.1 (RTD-Text)]
+    */
+
+    int language_length = strlen(language) & TEXT_LANGUAGE_LENGTH_MASK;
+    int text_length = strlen(text);
+    unsigned char type = NDEF_TYPE_TEXT;
+
+    int header_length = make_record_header(target, max_length, flags, TNF_WELL_KNOWN, &type, 1, 1 + language_length + text_length);
+
+    if (header_length < 0) {
+        return -1;
+    }
+
+    // Status is the length of the language code, with bit 7 clear for UTF-8
+    target[header_length] = language_length;
+    memcpy(target + header_length + 1, language, language_length);
+    memcpy(target + header_length + 1 + language_length, text, text_length);
+
+    return header_length + 1 + language_length + text_length;
+};
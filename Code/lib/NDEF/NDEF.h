@@ -0,0 +1,666 @@
+/*
+    NDEF.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Reads and writes NDEF messages (e.g. a URI record pointing at the shipment, a text record with the SKU) on MIFARE Classic
+    cards and NTAG/Ultralight (NFC Forum Type 2) tags, through any `Reader`.
+
+    The tag is streamed 16 bytes at a time through a single block held in SRAM, never buffered whole. On a MIFARE Classic card,
+    the MAD in sector 0 tells which sectors hold NDEF data; on a Type 2 tag, the capability container in page 3 tells how large
+    the data area is. The TLVs in the data area are walked up to the NDEF message, and the records of the message up to the one
+    asked for; whatever is skipped over is not read, and reading stops as soon as the record is complete.
+
+    A message is written by changing only the bytes that differ from what is on the tag; only the blocks (MIFARE Classic) or
+    pages (Type 2) that end up different are written back.
+
+    A template over the type of the reader, as `ReaderGroup` is; the NDEF records themselves are built by the functions in
+    NDEF.cpp.
+
+    The following sources were referenced.
+
+    https://nfc-forum.org/uploads/specifications/97-NFCForum-TS-NDEF_1.0.pdf [NDEF]
+    https://nfc-forum.org/uploads/specifications/90-NFCForum-TS-Type-2-Tag_1.1.pdf [T2T]
+    https://nfc-forum.org/uploads/specifications/101-NFCForum-TS-RTD_URI_1.0.pdf [RTD-URI]
+    https://nfc-forum.org/uploads/specifications/103-NFCForum-TS-RTD_Text_1.0.pdf [RTD-Text]
+    https://www.nxp.com/docs/en/application-note/AN1304.pdf [AN1304]
+    https://www.nxp.com/docs/en/application-note/AN10787.pdf [MAD]
+    http://www.emutag.com/iso/14443-3.pdf [ISO-3]
+*/
+
+#ifndef NDEF_H
+#define NDEF_H
+
+#include "Reader.h"
+
+#include "string.h"
+
+// TLV Types [Section 2.3 (T2T)]
+#define TLV_NULL                    0x00
+#define TLV_LOCK_CONTROL            0x01
+#define TLV_MEMORY_CONTROL          0x02
+#define TLV_NDEF_MESSAGE            0x03
+#define TLV_PROPRIETARY             0xFD
+#define TLV_TERMINATOR              0xFE
+
+#define TLV_LONG_LENGTH             0xFF // The length follows in the next 2 bytes, MSB first
+
+// NDEF Record Header [Section 3.2 (NDEF)]
+#define NDEF_MB                     0x80 // Message Begin
+#define NDEF_ME                     0x40 // Message End
+#define NDEF_CF                     0x20 // Chunk Flag
+#define NDEF_SR                     0x10 // Short Record; 1-byte payload length
+#define NDEF_IL                     0x08 // ID Length is present
+#define NDEF_TNF_MASK               0x07
+
+// Type Name Formats [Section 3.2.6 (NDEF)]
+#define TNF_EMPTY                   0x00
+#define TNF_WELL_KNOWN              0x01
+#define TNF_MIME_MEDIA              0x02
+#define TNF_ABSOLUTE_URI            0x03
+#define TNF_EXTERNAL                0x04
+
+// Well Known Types
+#define NDEF_TYPE_URI               'U'
+#define NDEF_TYPE_TEXT              'T'
+
+#define TEXT_LANGUAGE_LENGTH_MASK   0x3F // Status byte of a text record [Section 3.2.1 (RTD-Text)]
+
+// Type 2 Tags [Section 5 (T2T)]
+#define T2T_READ                    0x30 // Returns 4 pages, 16 bytes
+#define T2T_WRITE                   0xA2 // Writes 1 page
+#define T2T_PAGE_SIZE               4
+#define T2T_CC_PAGE                 3
+#define T2T_DATA_PAGE               4 // First page of the data area
+#define T2T_CC_MAGIC                0xE1
+#define T2T_CC_VERSION_MAJOR        1
+
+// MIFARE Classic as an NFC Forum tag [Section 4, 5 (AN1304)], [Section 3 (MAD)]
+#define CLASSIC_READ                0x30
+#define CLASSIC_WRITE               0xA0
+#define CLASSIC_MAD_BLOCK_1         1
+#define CLASSIC_MAD_BLOCK_2         2
+#define CLASSIC_MAD_SECTORS         16 // MAD1; the 16 sectors of a 1K card, and the first 16 of a 4K card
+#define CLASSIC_BLOCKS_PER_SECTOR   4 // The last is the sector trailer
+#define NDEF_AID_APPLICATION        0x03 // NDEF AID 0xE103, stored LSB first
+#define NDEF_AID_CLUSTER            0xE1
+
+#define NDEF_BLOCK_SIZE             16
+
+const unsigned char MAD_KEY_A[6] = {0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5};
+const unsigned char NFC_KEY_A[6] = {0xD3, 0xF7, 0xD3, 0xF7, 0xD3, 0xF7}; // Public key A of NDEF sectors
+
+const char* ndef_uri_prefix(unsigned char code);
+
+int ndef_make_record(unsigned char* target, int max_length, unsigned char flags, unsigned char tnf, const unsigned char* type,
+                     int type_length, const unsigned char* payload, int payload_length);
+int ndef_make_uri_record(unsigned char* target, int max_length, unsigned char flags, const char* uri);
+int ndef_make_text_record(unsigned char* target, int max_length, unsigned char flags, const char* language, const char* text);
+
+template <typename Reader_Impl>
+class NDEF_Tag {
+    public:
+        NDEF_Tag(Reader_Impl* reader, ReaderTag* tag) {
+            _reader = reader;
+            _tag = tag;
+
+            _data_size = 0;
+            _ndef_sectors = 0;
+            _read_only = true;
+
+            _cached_block = -1;
+            _dirty_pages = 0;
+            _authenticated_sector = -1;
+
+            _key_type = READER_KEY_A;
+            memcpy(_key, NFC_KEY_A, 6);
+
+            _num_reads = 0;
+            _num_writes = 0;
+        };
+
+        void set_key(unsigned char key_type, const unsigned char* key) {
+            // The key of the NDEF sectors of a MIFARE Classic card, if not the public NFC_KEY_A, e.g. key B for writing
+            _key_type = key_type;
+            memcpy(_key, key, 6);
+            _authenticated_sector = -1;
+        };
+
+        bool open() {
+            /*
+                Find the data area of the tag, which must already be selected; returns `false` if it is not formatted for NDEF
+
+                SAK 0x08 and 0x18 are MIFARE Classic 1K and 4K, and SAK 0x00 a Type 2 tag [Table 8, Section 6.4.3.4 (ISO-3)]
+            */
+
+            _cached_block = -1;
+            _dirty_pages = 0;
+            _authenticated_sector = -1;
+
+            if (_tag->sak == 0x08 || _tag->sak == 0x18) {
+                return open_classic();
+            } else if (_tag->sak == 0x00) {
+                return open_type_2();
+            }
+
+            return false;
+        };
+
+        int read_record(unsigned char tnf, const unsigned char* type, int type_length, unsigned char* payload,
+                        int max_payload_length) {
+            /*
+                Find the first record of the NDEF message with the given TNF and type, and place its payload in `payload`, which
+                holds `max_payload_length` bytes; returns the length of the payload, or -1 if there is no such record, it does not
+                fit, or the tag could not be read
+
+                A record is [Section 3.2 (NDEF)]
+
+                Header TypeLength PayloadLength[1 or 4] (IDLength) Type[0 ... ] (ID[0 ... ]) Payload[0 ... ]
+
+                The type of a record is only read if its TNF and type length match, and the payload only of the record asked for.
+                Chunked records are skipped.
+            */
+
+            unsigned int position;
+            unsigned int message_length;
+
+            if (!find_message(&position, &message_length, nullptr)) {
+                return -1;
+            }
+
+            unsigned int end = position + message_length;
+
+            while (position < end) {
+                int header = byte_at(position++);
+                int record_type_length = byte_at(position++);
+
+                if (header < 0 || record_type_length < 0) {
+                    return -1;
+                }
+
+                unsigned long payload_length = 0;
+
+                for (int i = 0; i < ((header & NDEF_SR) ? 1 : 4); i++) {
+                    int length_byte = byte_at(position++);
+
+                    if (length_byte < 0) {
+                        return -1;
+                    }
+
+                    payload_length = (payload_length << 8) | length_byte;
+                }
+
+                int id_length = 0;
+
+                if (header & NDEF_IL) {
+                    if ((id_length = byte_at(position++)) < 0) {
+                        return -1;
+                    }
+                }
+
+                bool match = ((header & NDEF_TNF_MASK) == tnf) && (record_type_length == type_length) && !(header & NDEF_CF);
+
+                for (int i = 0; match && i < type_length; i++) {
+                    int type_byte = byte_at(position + i);
+
+                    if (type_byte < 0) {
+                        return -1;
+                    }
+
+                    match = (type_byte == type[i]);
+                }
+
+                position += record_type_length + id_length;
+
+                if (match) {
+                    if (payload_length > (unsigned long)(max_payload_length) || position + payload_length > end) {
+                        return -1;
+                    }
+
+                    return read_bytes(position, payload, payload_length) ? (int)(payload_length) : -1;
+                }
+
+                if (header & NDEF_ME) {
+                    break;
+                }
+
+                position += payload_length;
+            }
+
+            return -1;
+        };
+
+        int read_uri(char* uri, int max_length) {
+            /*
+                Read the first URI record into `uri`, which holds `max_length` characters, with the abbreviated prefix expanded
+                and a terminating null; returns the length of the URI, or -1
+
+                Payload is Identifier Code, URI Field [Section 3.2 (RTD-URI)]
+            */
+
+            unsigned char type = NDEF_TYPE_URI;
+            int length = read_record(TNF_WELL_KNOWN, &type, 1, (unsigned char*)(uri), max_length - 1);
+
+            if (length < 1) {
+                return -1;
+            }
+
+            const char* prefix = ndef_uri_prefix(uri[0]);
+            int prefix_length = prefix ? strlen(prefix) : 0;
+
+            if (prefix_length + length - 1 > max_length - 1) {
+                return -1;
+            }
+
+            memmove(uri + prefix_length, uri + 1, length - 1);
+            memcpy(uri, prefix, prefix_length);
+            uri[prefix_length + length - 1] = '\0';
+
+            return prefix_length + length - 1;
+        };
+
+        int read_text(char* text, int max_length) {
+            /*
+                Read the text of the first text record into `text`, which holds `max_length` characters, with a terminating null;
+                returns its length, or -1. The text is returned as encoded on the tag, normally UTF-8.
+
+                Payload is Status, Language Code[0 ... ], Text[0 ... ] [Section 3.2.1 (RTD-Text)]
+            */
+
+            unsigned char type = NDEF_TYPE_TEXT;
+            int length = read_record(TNF_WELL_KNOWN, &type, 1, (unsigned char*)(text), max_length - 1);
+
+            if (length < 1) {
+                return -1;
+            }
+
+            int skipped = 1 + (text[0] & TEXT_LANGUAGE_LENGTH_MASK);
+
+            if (skipped > length) {
+                return -1;
+            }
+
+            memmove(text, text + skipped, length - skipped);
+            text[length - skipped] = '\0';
+
+            return length - skipped;
+        };
+
+        bool write_message(const unsigned char* message, int length) {
+            /*
+                Write `message` (records built with `ndef_make_record()` and the like) over the NDEF message on the tag, or where
+                the TLVs end if there is none, followed by a terminator TLV if there is room; only what differs from what is
+                already on the tag is written
+            */
+
+            if (_read_only) {
+                return false;
+            }
+
+            unsigned int tlv_start;
+
+            if (!find_message(nullptr, nullptr, &tlv_start)) {
+                return false;
+            }
+
+            int header_length = (length < TLV_LONG_LENGTH) ? 2 : 4;
+
+            if (tlv_start + header_length + length > _data_size) {
+                return false;
+            }
+
+            unsigned char header[4] = {TLV_NDEF_MESSAGE, (unsigned char)(length), 0, 0};
+
+            if (header_length == 4) {
+                header[1] = TLV_LONG_LENGTH;
+                header[2] = length >> 8;
+                header[3] = length;
+            }
+
+            unsigned int position = tlv_start;
+            bool written = store_bytes(position, header, header_length) && store_bytes(position + header_length, message, length);
+            position += header_length + length;
+
+            if (written && position < _data_size) {
+                unsigned char terminator = TLV_TERMINATOR;
+                written = store_bytes(position, &terminator, 1);
+            }
+
+            return flush() && written;
+        };
+
+        unsigned int data_size() {
+            return _data_size;
+        };
+
+        unsigned long num_reads() {
+            return _num_reads;
+        };
+
+        unsigned long num_writes() {
+            return _num_writes;
+        };
+
+    private:
+        bool is_classic() {
+            return _ndef_sectors != 0;
+        };
+
+        bool open_type_2() {
+            /*
+                The capability container is Magic Version Size Access; the data area holds Size * 8 bytes, and may be written if
+                the low nibble of Access is 0 [Section 6.1 (T2T)]
+            */
+
+            unsigned char command[2] = {T2T_READ, T2T_CC_PAGE};
+
+            if (_reader->exchange(_tag, command, 2, _block, NDEF_BLOCK_SIZE) != NDEF_BLOCK_SIZE) {
+                return false;
+            }
+
+            _num_reads++;
+
+            if (_block[0] != T2T_CC_MAGIC || (_block[1] >> 4) != T2T_CC_VERSION_MAJOR) {
+                return false;
+            }
+
+            _data_size = _block[2] * 8;
+            _read_only = (_block[3] & 0x0F) != 0;
+
+            return _data_size > 0;
+        };
+
+        bool open_classic() {
+            /*
+                Sector 0 holds the MAD, readable with MAD_KEY_A; block 1 holds the AIDs of sectors 1 to 7 from byte 2 on, and block
+                2 those of sectors 8 to 15, 2 bytes each, LSB first. The NDEF data is in the sectors whose AID is 0xE103, in order,
+                3 blocks each. [Section 3.7 (MAD)], [Section 5.1 (AN1304)]
+            */
+
+            unsigned char mad_key[6];
+            memcpy(mad_key, MAD_KEY_A, 6);
+
+            if (!_reader->authenticate(_tag, READER_KEY_A, CLASSIC_MAD_BLOCK_1, mad_key)) {
+                return false;
+            }
+
+            _authenticated_sector = 0;
+            _ndef_sectors = 0;
+
+            for (int mad_block = CLASSIC_MAD_BLOCK_1; mad_block <= CLASSIC_MAD_BLOCK_2; mad_block++) {
+                unsigned char command[2] = {CLASSIC_READ, (unsigned char)(mad_block)};
+
+                if (_reader->exchange(_tag, command, 2, _block, NDEF_BLOCK_SIZE) != NDEF_BLOCK_SIZE) {
+                    _ndef_sectors = 0;
+                    return false;
+                }
+
+                _num_reads++;
+
+                int first_sector = (mad_block == CLASSIC_MAD_BLOCK_1) ? 1 : 8;
+                int first_byte = (mad_block == CLASSIC_MAD_BLOCK_1) ? 2 : 0;
+
+                for (int i = first_byte; i < NDEF_BLOCK_SIZE; i += 2) {
+                    if (_block[i] == NDEF_AID_APPLICATION && _block[i + 1] == NDEF_AID_CLUSTER) {
+                        _ndef_sectors |= 1u << (first_sector + (i - first_byte) / 2);
+                    }
+                }
+            }
+
+            int num_sectors = 0;
+
+            for (int sector = 1; sector < CLASSIC_MAD_SECTORS; sector++) {
+                num_sectors += (_ndef_sectors >> sector) & 1;
+            }
+
+            _data_size = num_sectors * (CLASSIC_BLOCKS_PER_SECTOR - 1) * NDEF_BLOCK_SIZE;
+            _read_only = false;
+
+            return _data_size > 0;
+        };
+
+        int classic_block_address(unsigned int data_block) {
+            // The address of the `data_block`th block of the data area, skipping sector trailers and sectors not holding NDEF
+            for (int sector = 1; sector < CLASSIC_MAD_SECTORS; sector++) {
+                if (!((_ndef_sectors >> sector) & 1)) {
+                    continue;
+                }
+
+                if (data_block < CLASSIC_BLOCKS_PER_SECTOR - 1) {
+                    return sector * CLASSIC_BLOCKS_PER_SECTOR + data_block;
+                }
+
+                data_block -= CLASSIC_BLOCKS_PER_SECTOR - 1;
+            }
+
+            return -1;
+        };
+
+        bool load_block(unsigned int data_block) {
+            /*
+                Hold the `data_block`th 16 bytes of the data area in `_block`, writing back the block held before if it was changed
+            */
+
+            if ((long)(data_block) == _cached_block) {
+                return true;
+            }
+
+            if (!flush()) {
+                return false;
+            }
+
+            _cached_block = -1;
+
+            unsigned char command[2] = {T2T_READ, (unsigned char)(T2T_DATA_PAGE + data_block * (NDEF_BLOCK_SIZE / T2T_PAGE_SIZE))};
+
+            if (is_classic()) {
+                int address = classic_block_address(data_block);
+
+                if (address < 0) {
+                    return false;
+                }
+
+                int sector = address / CLASSIC_BLOCKS_PER_SECTOR;
+
+                if (sector != _authenticated_sector) {
+                    if (!_reader->authenticate(_tag, _key_type, address, _key)) {
+                        _authenticated_sector = -1;
+                        return false;
+                    }
+
+                    _authenticated_sector = sector;
+                }
+
+                command[0] = CLASSIC_READ;
+                command[1] = address;
+            }
+
+            if (_reader->exchange(_tag, command, 2, _block, NDEF_BLOCK_SIZE) != NDEF_BLOCK_SIZE) {
+                return false;
+            }
+
+            _num_reads++;
+            _cached_block = data_block;
+
+            return true;
+        };
+
+        bool flush() {
+            /*
+                Write back the block held in `_block`, if it was changed; the whole block on a MIFARE Classic card, only the pages
+                changed on a Type 2 tag
+            */
+
+            if (!_dirty_pages) {
+                return true;
+            }
+
+            if (is_classic()) {
+                unsigned char command[2 + NDEF_BLOCK_SIZE];
+                command[0] = CLASSIC_WRITE;
+                command[1] = classic_block_address(_cached_block);
+                memcpy(command + 2, _block, NDEF_BLOCK_SIZE);
+
+                if (!_reader->write(_tag, command, 2 + NDEF_BLOCK_SIZE)) {
+                    return false;
+                }
+
+                _num_writes++;
+            } else {
+                for (int page = 0; page < NDEF_BLOCK_SIZE / T2T_PAGE_SIZE; page++) {
+                    if (!((_dirty_pages >> page) & 1)) {
+                        continue;
+                    }
+
+                    unsigned char command[2 + T2T_PAGE_SIZE];
+                    command[0] = T2T_WRITE;
+                    command[1] = T2T_DATA_PAGE + _cached_block * (NDEF_BLOCK_SIZE / T2T_PAGE_SIZE) + page;
+                    memcpy(command + 2, _block + page * T2T_PAGE_SIZE, T2T_PAGE_SIZE);
+
+                    if (!_reader->write(_tag, command, 2 + T2T_PAGE_SIZE)) {
+                        return false;
+                    }
+
+                    _num_writes++;
+                }
+            }
+
+            _dirty_pages = 0;
+            return true;
+        };
+
+        int byte_at(unsigned int position) {
+            // The byte at `position` in the data area, or -1 past its end or if it could not be read
+            if (position >= _data_size || !load_block(position / NDEF_BLOCK_SIZE)) {
+                return -1;
+            }
+
+            return _block[position % NDEF_BLOCK_SIZE];
+        };
+
+        bool read_bytes(unsigned int position, unsigned char* bytes, int length) {
+            for (int i = 0; i < length; i++) {
+                int value = byte_at(position + i);
+
+                if (value < 0) {
+                    return false;
+                }
+
+                bytes[i] = value;
+            }
+
+            return true;
+        };
+
+        bool store_bytes(unsigned int position, const unsigned char* bytes, int length) {
+            // Change bytes of the data area in `_block`, marking the pages that end up different to be written back
+            for (int i = 0; i < length; i++) {
+                if (byte_at(position + i) < 0) {
+                    return false;
+                }
+
+                unsigned char offset = (position + i) % NDEF_BLOCK_SIZE;
+
+                if (_block[offset] != bytes[i]) {
+                    _block[offset] = bytes[i];
+                    _dirty_pages |= 1 << (offset / T2T_PAGE_SIZE);
+                }
+            }
+
+            return true;
+        };
+
+        bool find_message(unsigned int* message_start, unsigned int* message_length, unsigned int* tlv_start) {
+            /*
+                Walk the TLVs of the data area, Tag Length[1 or 3] Value[0 ... Length - 1], to the NDEF message TLV; NULL TLVs
+                are a single byte, and the terminator TLV ends them [Section 2.3 (T2T)]. The values of the other TLVs are skipped
+                without being read.
+
+                Puts where the NDEF message starts and its length in `message_start` and `message_length`, and where its TLV
+                starts in `tlv_start`; without an NDEF message, returns `false` if `message_start` is asked for, and otherwise
+                puts where the terminator is (or where the TLVs end) in `tlv_start`, where a message may be written.
+            */
+
+            unsigned int position = 0;
+
+            while (position < _data_size) {
+                unsigned int start = position;
+                int tag = byte_at(position++);
+
+                if (tag < 0) {
+                    return false;
+                }
+
+                if (tag == TLV_NULL) {
+                    continue;
+                }
+
+                if (tag == TLV_TERMINATOR) {
+                    position = start;
+                    break;
+                }
+
+                int length_byte = byte_at(position++);
+                unsigned int length = length_byte;
+
+                if (length_byte == TLV_LONG_LENGTH) {
+                    int msb = byte_at(position++);
+                    int lsb = byte_at(position++);
+
+                    if (msb < 0 || lsb < 0) {
+                        return false;
+                    }
+
+                    length = (msb << 8) | lsb;
+                } else if (length_byte < 0) {
+                    return false;
+                }
+
+                if (tag == TLV_NDEF_MESSAGE) {
+                    if (message_start) {
+                        *message_start = position;
+                        *message_length = length;
+                    }
+
+                    if (tlv_start) {
+                        *tlv_start = start;
+                    }
+
+                    return true;
+                }
+
+                position += length;
+            }
+
+            if (message_start || position > _data_size) {
+                return false;
+            }
+
+            *tlv_start = position;
+            return true;
+        };
+
+        Reader_Impl* _reader;
+        ReaderTag* _tag;
+
+        unsigned int _data_size;
+        unsigned int _ndef_sectors;     // Bit n set if sector n of a MIFARE Classic card holds NDEF data
+        bool _read_only;
+
+        unsigned char _block[NDEF_BLOCK_SIZE];
+        long _cached_block;             // Which 16 bytes of the data area are in `_block`, or -1
+        unsigned char _dirty_pages;     // Bit n set if bytes 4n to 4n + 3 of `_block` were changed
+        int _authenticated_sector;
+
+        unsigned char _key_type;
+        unsigned char _key[6];
+
+        unsigned long _num_reads;
+        unsigned long _num_writes;
+};
+
+#endif
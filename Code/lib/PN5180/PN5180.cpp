@@ -1,76 +1,136 @@
-#include "avr/io.h"
-#include "avr/delay.h"
+/*
+    PN5180.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Provides an interface to communicate with NXP's PN5180 RFID chip over SPI, exchange frames over the RF field, and run
+    ISO15693 (vicinity) inventories for the longer read range.
+
+    The following sources were referenced.
+
+    https://www.nxp.com/docs/en/data-sheet/PN5180A0XX_C3_C4.pdf [PN5180DS]
+    https://www.nxp.com/docs/en/application-note/AN12650.pdf [AN12650]
+    https://github.com/ATrappmann/PN5180-Library
+    ISO/IEC 15693-3 [ISO-15693-3]
+*/
+
+#include "stdint.h"
 #include "Pins.h"
 #include "SPI.h"
+#include "Timer.h"
+#include "TokenLog.h"
 #include "PN5180_Registers.h"
 #include "PN5180_Commands.h"
 #include "PN5180.h"
 
-PN5180::PN5180(
-    Pin RST,
-    Pin BUSY,
-    Pin NSS,
-    Pin MOSI,
-    Pin MISO,
-    Pin SCK
-) : _RST(RST), _BUSY(BUSY), _NSS(NSS), _spi(MOSI, MISO, SCK)  { // Create SPI in the constructor
-    // Initialize other pins
+#include "string.h"
+
+// Frames to transmit are built here; one command is in flight on the bus at a time, so every PN5180 shares it
+uint8_t PN5180::_frame_arena[2 + PN5180_MAX_FRAME_SIZE];
+
+PN5180::PN5180(Pin NSS, Pin BUSY, Pin RST) : _NSS(NSS), _BUSY(BUSY), _RST(RST) {
     _NSS.set_output();
     _RST.set_output();
     _BUSY.set_input();
 
     // Keep NSS asserted
     _NSS.assert();
+
+    _collision_position = -1;
+
+    _spi = SPI_Master();
 };
 
 void PN5180::reset() {
+    /*
+        Pulse RST low, and wait for the PN5180 to signal that it has booted by setting IDLE_IRQ [Section 11.2 (PN5180DS)]
+    */
+
     _RST.deassert(); // Set RST to low to reset
-    _delay_ms(100);  // Wait 100 ms
-    _RST.assert(); // Set RST high to release from resets
-    _delay_ms(100);  // Wait another 100 mss
+    blocking_delay(1, MILLISECONDS); // Must be held low for at least 10 us
+    _RST.assert(); // Set RST high to release from reset
+
+    // Booting takes about 2.5 ms
+    wait_for_irq((uint32_t)(1) << IDLE_IRQ, 10, nullptr);
 };
 
 void PN5180::initialize() {
-    // Initialize SPI
-    _spi.initialize();
+    // The PN5180 shifts the MSB first [Section 11.4.1 (PN5180DS)]
+    _spi.initialize(MSB_FIRST);
 
     // Reset the PN5180
     reset();
 };
 
+bool PN5180::wait_while_busy() {
+    // Wait, for at most PN5180_BUSY_TIMEOUT microseconds, for BUSY to go low
+    unsigned long start = current_time(MICROSECONDS);
+
+    while (_BUSY.is_high()) {
+        if (current_time(MICROSECONDS) - start > PN5180_BUSY_TIMEOUT) {
+            return false;
+        }
+    }
+
+    return true;
+};
+
+bool PN5180::wait_until_busy() {
+    // Wait, for at most PN5180_BUSY_TIMEOUT microseconds, for BUSY to go high
+    unsigned long start = current_time(MICROSECONDS);
+
+    while (_BUSY.is_low()) {
+        if (current_time(MICROSECONDS) - start > PN5180_BUSY_TIMEOUT) {
+            return false;
+        }
+    }
+
+    return true;
+};
+
 bool PN5180::transceive(bool send_or_receive, uint8_t* data, int length) {
-    // Follows the procedure described in the datasheet to exchange data
+    // Follows the procedure described in Section 11.4.1 (PN5180DS) to exchange data
 
     // 0. Wait for BUSY to go low
-    while (_BUSY.is_high()) { ; }
+    if (!wait_while_busy()) {
+        return false;
+    }
 
     // 1. Deassert NSS
-    _NSS.deassert();
+    _spi.select(&_NSS);
 
     // 2. Send/Receive data
+    bool exchanged;
     if (send_or_receive == SEND) {
-        if (!_spi.send(data, length)) {
-            return false;  // Return false if sending fails
-        }
+        exchanged = _spi.send(data, length);
     } else {
-        if (!_spi.receive(data, length)) {
-            return false;  // Return false if receiving fails
-        }
+        exchanged = _spi.receive(data, length);
+    }
+
+    if (!exchanged) {
+        _spi.deselect(&_NSS);
+        return false;
     }
 
     // 3. Wait for BUSY to go high
-    while (_BUSY.is_low()) { ; }
+    bool busy = wait_until_busy();
 
     // 4. Assert NSS
-    _NSS.assert();
+    _spi.deselect(&_NSS);
 
-    // 5. Wait for BUSY to go low again
-    while (_BUSY.is_high()) { ; }
+    if (!busy) {
+        return false;
+    }
 
-    return true;  // Return true if everything was successful
+    // 5. Wait for BUSY to go low again
+    return wait_while_busy();
 };
 
-bool PN5180::issue_command(uint8_t* command_bytes, uint8_t num_command_bytes) {
+bool PN5180::issue_command_from_array(uint8_t* command_bytes, int num_command_bytes) {
     return transceive(SEND, command_bytes, num_command_bytes);
 };
 
@@ -79,113 +139,368 @@ bool PN5180::receive_command_response(uint8_t* response_buffer, int length) {
     return transceive(RECEIVE, response_buffer, length);
 };
 
-bool PN5180::transmit_rf(uint8_t valid_bits_last_byte, uint8_t num_bytes, uint8_t* bytes) {
-    // Clear the TX_RFON_IRQ_STAT bit in the IRQ_STATUS register
-    issue_command(WRITE_REGISTER, REG_IRQ_CLEAR, 0xFF, 0xFF, 0xFF, 0xFF);
+bool PN5180::write_register(uint8_t address, uint32_t value) {
+    // Registers are 32 bits wide, and sent LSB first [Section 11.4.3.1 (PN5180DS)]
+    return issue_command(PN5180_WRITE_REGISTER, address, value, value >> 8, value >> 16, value >> 24);
+};
+
+bool PN5180::write_register_or_mask(uint8_t address, uint32_t mask) {
+    return issue_command(PN5180_WRITE_REGISTER_OR, address, mask, mask >> 8, mask >> 16, mask >> 24);
+};
+
+bool PN5180::write_register_and_mask(uint8_t address, uint32_t mask) {
+    return issue_command(PN5180_WRITE_REGISTER_AND, address, mask, mask >> 8, mask >> 16, mask >> 24);
+};
 
-    // registers are read
+bool PN5180::read_register(uint8_t address, uint32_t* value) {
+    if (!issue_command(PN5180_READ_REGISTER, address)) {
+        return false;
+    }
+
+    // The 4 bytes of the register come back LSB first
     // b7 b6 b5 b4 b3 b2 b1 b0 | b15 b14 b13 b12 b11 b10 b9 b8 etc
+    uint8_t bytes[4];
+    if (!receive_command_response(bytes, 4)) {
+        return false;
+    }
 
-    // Turn on the RF field
-    issue_command(RF_ON, 0x00);
-    _delay_ms(1);  // Wait for a short time to ensure the RF field is stable
-    
-    // See that the field is on by reading IRQ_STATUS
-    issue_command(READ_REGISTER, REG_IRQ_STATUS);
-    uint8_t irq_status[4];
-    receive_command_response(irq_status, 4);
-    
-    if (!(irq_status[1] & 0x02)) {  // Check if the RF field is on
-        Serial.println("RF field is not on, cannot transmit RF data.");
-    } else {
-        Serial.println("RF field is on, proceeding to transmit RF data.");
-    }
-
-    // We will first move to the IDLE state and enter the TRANSCEIVE state
-    issue_command(WRITE_REGISTER_AND, REG_SYSTEM_CONFIG, 0xF8, 0xFF, 0xFF, 0xFF); // Set 3 LSBs to 000 for IDLE
-    _delay_ms(1);
-    issue_command(WRITE_REGISTER_OR, REG_SYSTEM_CONFIG, 0x03, 0x00, 0x00, 0x00); // Set 3 LSBs to 100 for TRANSCEIVE
-
-    // Read RF_STATUS register, which stores the state of the transceive machine
-    issue_command(READ_REGISTER, REG_RF_STATUS);
-    uint8_t rf_status[4];
-    receive_command_response(rf_status, 4);  // Receive the 4 bytes of RF_STATUS
-    
-    // Check if the state in bits 24:26 is WAIT_TRANSMIT (0x02)
-    if ((rf_status[3] & 0x07) != 0x01) {
-        Serial.println("We are not in the WAIT_TRANSMIT state, cannot transmit RF data.");
-        //return false;
-    } else {
-        Serial.println("We are in the WAIT_TRANSMIT state, proceeding to transmit RF data.");
-    }
-
-    // Send the data
-    uint8_t command_bytes[num_bytes + 2];
-    command_bytes[0] = SEND_DATA;
-    command_bytes[1] = valid_bits_last_byte;
-    for (int i = 0; i < num_bytes; i++) {
-        command_bytes[2 + i] = bytes[i];
-    }
-    issue_command(command_bytes, num_bytes + 2);
-    Serial.println("DATA SENT");
-
-    _delay_ms(1000);
-
-    // Read RF_STATUS register, which stores the state of the transceive machine
-    issue_command(READ_REGISTER, REG_RF_STATUS);
-    uint8_t rf_statuss[4];
-    receive_command_response(rf_statuss, 4);  // Receive the 4 bytes of RF_STATUS
-    Serial.print("RF_STATUS: ");
-    for (int i = 0; i < 4; i++) {
-        Serial.print(rf_statuss[i], BIN);
-        Serial.print(" ");
-    };
-    Serial.println();
-    
-    // Check if the state in bits 24:26 is WAIT_TRANSMIT (0x02)
-    Serial.println("WAiting for WAIT_RECEIVE state");
-    while ((rf_statuss[3] & 0x07) != 0x03) {
-        issue_command(READ_REGISTER, REG_RF_STATUS);
-        receive_command_response(rf_statuss, 4);  // Receive the 4 bytes of RF_STATUS
-        Serial.print(rf_statuss[0], BIN);
-        Serial.print(" ");
-        Serial.print(rf_statuss[1], BIN);
-        Serial.print(" ");
-        Serial.print(rf_statuss[2], BIN);
-        Serial.print(" ");
-        Serial.println(rf_statuss[3], BIN);
-        _delay_ms(100);
-        //return false;
-    }
-    
-    Serial.println("We are in the WAIT_RECEIVE state.");
-
-    // Clear the TX_RFOFF_IRQ_STAT bit in the IRQ_STATUS register
-    issue_command(WRITE_REGISTER, REG_IRQ_CLEAR, 0xFF, 0xFF, 0xFF, 0xFF);
-
-    // Turn off the RF field
-    Serial.println("turning off RF field");
-    issue_command(RF_OFF, 0x00);
-    _delay_ms(1);  // Wait for a short time to ensure the RF field is stable
-    
-    // See that the field is on by reading IRQ_STATUS
-    Serial.println("checking RF field status after turning off");
-    issue_command(READ_REGISTER, REG_IRQ_STATUS);
-    uint8_t irq_statuss[4];
-    receive_command_response(irq_statuss, 4);
-    Serial.println("Received IRQ_STATUS:");
-    Serial.print("IRQ_STATUS: ");
-    for (int i = 0; i < 4; i++) {
-      Serial.print(irq_statuss[i], BIN);
-      Serial.print(" ");
-    }
-    Serial.println();
-    // or consider putting in a loop
-    if (!(irq_statuss[1] & 0x01)) {  // Check if the RF field is off
-        Serial.println("RF field is not off.");
-    } else {
-        Serial.println("RF field is off, transmission complete.");
+    *value = (uint32_t)(bytes[0]) | ((uint32_t)(bytes[1]) << 8) | ((uint32_t)(bytes[2]) << 16) | ((uint32_t)(bytes[3]) << 24);
+
+    return true;
+};
+
+bool PN5180::clear_irq_status(uint32_t mask) {
+    return write_register(REG_IRQ_CLEAR, mask);
+};
+
+bool PN5180::wait_for_irq(uint32_t mask, unsigned long timeout, uint32_t* irq_status) {
+    /*
+        Poll IRQ_STATUS until any of the interrupts in `mask` is raised, or GENERAL_ERROR is, or `timeout` milliseconds pass;
+        returns `true` only if one of the interrupts in `mask` was raised. The last IRQ_STATUS read goes in `irq_status`, unless it
+        is a null pointer.
+    */
+
+    unsigned long start = current_time(MILLISECONDS);
+    uint32_t status = 0;
+
+    while (current_time(MILLISECONDS) - start <= timeout) {
+        if (!read_register(REG_IRQ_STATUS, &status)) {
+            break;
+        }
+
+        if ((status & mask) || (status & ((uint32_t)(1) << GENERAL_ERROR_IRQ))) {
+            break;
+        }
+    }
+
+    if (irq_status) {
+        *irq_status = status;
+    }
+
+    return (status & mask) != 0;
+};
+
+bool PN5180::load_rf_config(uint8_t tx_configuration, uint8_t rx_configuration) {
+    // Load the protocol specific register settings from the PN5180's EEPROM [Section 11.4.3.10 (PN5180DS)]
+    return issue_command(PN5180_LOAD_RF_CONFIG, tx_configuration, rx_configuration);
+};
+
+bool PN5180::set_rf_field(bool on) {
+    /*
+        Switch the RF field on or off, and wait for TX_RFON_IRQ or TX_RFOFF_IRQ to confirm it [Sections 11.4.3.12, 11.4.3.13
+        (PN5180DS)]
+    */
+
+    uint32_t irq = (uint32_t)(1) << (on ? TX_RFON_IRQ : TX_RFOFF_IRQ);
+
+    if (!clear_irq_status(irq)) {
+        return false;
+    }
+
+    if (!issue_command(on ? PN5180_RF_ON : PN5180_RF_OFF, 0x00)) {
+        return false;
+    }
+
+    return wait_for_irq(irq, PN5180_RF_ON_TIMEOUT, nullptr);
+};
+
+bool PN5180::start_transceive() {
+    /*
+        Move the transceive state machine to IDLE, then start the TRANSCEIVE command, after which it waits for data to transmit
+        [Section 11.5.2 (PN5180DS)]
+    */
+
+    if (!write_register_and_mask(REG_SYSTEM_CONFIG, ~(uint32_t)(SYSTEM_CONFIG_COMMAND_MASK))) {
+        return false;
+    }
+
+    return write_register_or_mask(REG_SYSTEM_CONFIG, COMMAND_TRANSCEIVE);
+};
+
+bool PN5180::transmit_rf(uint8_t valid_bits_last_byte, uint8_t num_bytes, uint8_t* bytes) {
+    /*
+        Transmit `num_bytes` bytes through the RF field, of which only `valid_bits_last_byte` bits of the last byte are sent (0
+        for all 8); the field must already be on, and the protocol configured with `load_rf_config()`
+    */
+
+    if (num_bytes > PN5180_MAX_FRAME_SIZE) {
+        return false;
+    }
+
+    if (!clear_irq_status(ALL_IRQS) || !start_transceive()) {
+        return false;
+    }
+
+    // The state machine must be in WAIT_TRANSMIT to accept SEND_DATA
+    uint32_t rf_status;
+    if (!read_register(REG_RF_STATUS, &rf_status)) {
+        return false;
+    }
+
+    if (((rf_status >> TRANSCEIVE_STATE_SHIFT) & TRANSCEIVE_STATE_MASK) != STATE_WAIT_TRANSMIT) {
+        log_event(LOG_PN5180_TX_STATE, rf_status);
+        return false;
+    }
+
+    // SEND_DATA NumValidBits Data[0] ... Data[n] [Section 11.4.3.7 (PN5180DS)], built in the frame arena rather than on the stack
+    _frame_arena[0] = PN5180_SEND_DATA;
+    _frame_arena[1] = valid_bits_last_byte;
+    memcpy(_frame_arena + 2, bytes, num_bytes);
+
+    return issue_command_from_array(_frame_arena, num_bytes + 2);
+};
+
+bool PN5180::receive_rf(uint8_t* receive_buffer, uint8_t num_bytes, uint8_t* valid_bytes, uint8_t* valid_bits_last_byte) {
+    /*
+        Wait for the response to a frame sent with `transmit_rf()`, and read up to `num_bytes` of it into `receive_buffer`; the
+        number of bytes received goes in `valid_bytes`, and the number of valid bits in the last of them in
+        `valid_bits_last_byte`
+
+        Returns `false` if nothing is received within PN5180_RX_TIMEOUT milliseconds, or the frame was received with errors or
+        does not fit in `receive_buffer`. A frame in which several tags collided is returned as received, and the position of
+        the first collision is kept for `collision_position()`.
+    */
+
+    _collision_position = -1;
+
+    if (!wait_for_irq((uint32_t)(1) << RX_IRQ, PN5180_RX_TIMEOUT, nullptr)) {
+        return false;
+    }
+
+    uint32_t rx_status;
+    if (!read_register(REG_RX_STATUS, &rx_status)) {
+        return false;
+    }
+
+    uint32_t errors = ((uint32_t)(1) << RX_DATA_INTEGRITY_ERROR) | ((uint32_t)(1) << RX_PROTOCOL_ERROR);
+
+    uint16_t length = rx_status & RX_NUM_BYTES_MASK;
+
+    // Colliding bits also fail the parity check, so that is only an error without a collision
+    if (rx_status & ((uint32_t)(1) << RX_COLLISION_DETECTED)) {
+        _collision_position = (rx_status >> RX_COLL_POS_SHIFT) & RX_COLL_POS_MASK;
+    } else if (rx_status & errors) {
+        log_event(LOG_PN5180_RX_ERROR, rx_status);
+        return false;
+    }
+
+    if (length > num_bytes) {
+        return false;
     }
 
+    // READ_DATA 0x00 [Section 11.4.3.8 (PN5180DS)]
+    if (!issue_command(PN5180_READ_DATA, 0x00) || !receive_command_response(receive_buffer, length)) {
+        return false;
+    }
+
+    uint8_t last_bits = (rx_status >> RX_NUM_LAST_BITS_SHIFT) & RX_NUM_LAST_BITS_MASK;
+
+    *valid_bytes = length;
+    *valid_bits_last_byte = (last_bits == 0) ? 8 : last_bits;
+
     return true;
-};
\ No newline at end of file
+};
+
+int PN5180::collision_position() {
+    // Bit position of the first collision in the frame last received by `receive_rf()`, or -1 if there was none
+    return _collision_position;
+};
+
+bool PN5180::set_crc(bool enable) {
+    /*
+        Have the PN5180 append a CRC to every frame sent and check (and remove) it from every frame received, or leave the
+        CRC to the host; e.g. ISO14443A anticollision frames carry none
+    */
+
+    return set_crc(enable, enable);
+};
+
+bool PN5180::set_crc(bool transmit, bool receive) {
+    // As above, with the CRC of the frames sent and received set apart; e.g. a 4-bit ACK is answered to a frame with a CRC
+    bool transmit_set = transmit ? write_register_or_mask(REG_CRC_TX_CONFIG, CRC_ENABLE)
+                                 : write_register_and_mask(REG_CRC_TX_CONFIG, ~(uint32_t)(CRC_ENABLE));
+
+    if (!transmit_set) {
+        return false;
+    }
+
+    return receive ? write_register_or_mask(REG_CRC_RX_CONFIG, CRC_ENABLE)
+                   : write_register_and_mask(REG_CRC_RX_CONFIG, ~(uint32_t)(CRC_ENABLE));
+};
+
+bool PN5180::set_rx_bit_align(uint8_t bit) {
+    // Place the first bit of the next frame received at bit `bit` of the first byte, for split ISO14443A anticollision frames
+    if (!write_register_and_mask(REG_CRC_RX_CONFIG, ~(uint32_t)(RX_BIT_ALIGN_MASK))) {
+        return false;
+    }
+
+    return (bit == 0) || write_register_or_mask(REG_CRC_RX_CONFIG, ((uint32_t)(bit) << RX_BIT_ALIGN_SHIFT) & RX_BIT_ALIGN_MASK);
+};
+
+bool PN5180::mifare_authenticate(uint8_t* key, uint8_t key_type, uint8_t block_address, uint8_t* uid) {
+    /*
+        Authenticate `block_address` of a selected MIFARE Classic card with the 6-byte `key`, of `key_type` 0x60 (key A) or 0x61
+        (key B), and the first 4 bytes of its `uid`; the PN5180 then encrypts the exchanges that follow by itself
+
+        Command format is;
+
+        MIFARE_AUTHENTICATE Key[0] ... Key[5] KeyType BlockAddress UID[0] ... UID[3]
+
+        Response is a single byte; 0x00 if authenticated [Section 11.4.3.9 (PN5180DS)]
+    */
+
+    uint8_t command_bytes[13];
+    command_bytes[0] = PN5180_MIFARE_AUTHENTICATE;
+    memcpy(command_bytes + 1, key, 6);
+    command_bytes[7] = key_type;
+    command_bytes[8] = block_address;
+    memcpy(command_bytes + 9, uid, 4);
+
+    uint8_t status;
+    if (!issue_command_from_array(command_bytes, 13) || !receive_command_response(&status, 1)) {
+        return false;
+    }
+
+    return status == 0x00;
+};
+
+bool PN5180::send_inventory_request(uint8_t* mask, uint8_t mask_length) {
+    /*
+        Send a 16 slot ISO15693 INVENTORY request, addressed to the tags whose UIDs end in the `mask_length` bits of `mask`
+
+        Request format is;
+
+        Flags INVENTORY MaskLength Mask[0] ... Mask[n]
+
+        Flags       = high data rate, inventory, 16 slots (Nb_slots_flag cleared)
+        MaskLength  = number of valid bits in the mask
+        Mask        = the least significant bits of the UID, LSB first, padded to a whole byte
+
+        [Section 10.3.1 (ISO-15693-3)]
+    */
+
+    uint8_t request[3 + ISO15693_UID_LENGTH];
+    uint8_t mask_bytes = (mask_length + 7) / 8;
+
+    request[0] = ISO15693_FLAG_HIGH_DATA_RATE | ISO15693_FLAG_INVENTORY;
+    request[1] = ISO15693_INVENTORY;
+    request[2] = mask_length;
+    memcpy(request + 3, mask, mask_bytes);
+
+    return transmit_rf(0, 3 + mask_bytes, request);
+};
+
+int PN5180::iso15693_inventory(uint8_t* uids, int max_uids) {
+    /*
+        Find every ISO15693 tag in the field, and place their 8-byte UIDs (LSB first, as received) one after the other in `uids`,
+        which must hold `max_uids` * ISO15693_UID_LENGTH bytes. Returns the number of UIDs found, or -1 if the PN5180 could not be
+        driven.
+
+        Each round sends one INVENTORY request, then moves the tags through the 16 slots by sending an EOF at the end of each
+        slot; a tag answers in the slot numbered by the next 4 bits of its UID after the mask. Slots in which several tags
+        answered at once are queued and resolved in a later round, with the slot number appended to the mask, so that only the
+        tags that collided answer again. [Section 8.3 (ISO-15693-3)], [Section 4.3 (AN12650)]
+
+        A slot is taken as empty once no start of frame is seen in ISO15693_SLOT_TIMEOUT; only a slot in which a tag started
+        answering is waited on for up to PN5180_RX_TIMEOUT, so that an empty round takes about 16 ms rather than 160 ms.
+    */
+
+    // Collided slots still to be resolved, as masks; the first round has an empty mask and addresses every tag
+    uint8_t masks[PN5180_MAX_COLLISIONS][ISO15693_UID_LENGTH];
+    uint8_t mask_lengths[PN5180_MAX_COLLISIONS];
+    int num_masks = 1;
+
+    memset(masks[0], 0, ISO15693_UID_LENGTH);
+    mask_lengths[0] = 0;
+
+    if (!set_rf_field(true)) {
+        return -1;
+    }
+
+    int num_uids = 0;
+
+    while (num_masks > 0 && num_uids < max_uids) {
+        num_masks--;
+
+        uint8_t mask[ISO15693_UID_LENGTH];
+        uint8_t mask_length = mask_lengths[num_masks];
+        memcpy(mask, masks[num_masks], ISO15693_UID_LENGTH);
+
+        // Reloading the configuration also restores TX_CONFIG after the EOF-only slot markers of the previous round
+        if (!load_rf_config(RF_CONFIG_ISO15693_TX, RF_CONFIG_ISO15693_RX) || !send_inventory_request(mask, mask_length)) {
+            return -1;
+        }
+
+        for (uint8_t slot = 0; slot < ISO15693_NUM_SLOTS; slot++) {
+            // An empty slot raises neither RX_SOF_DET_IRQ nor RX_IRQ, and simply times out
+            uint32_t answered = ((uint32_t)(1) << RX_SOF_DET_IRQ) | ((uint32_t)(1) << RX_IRQ);
+
+            if (wait_for_irq(answered, ISO15693_SLOT_TIMEOUT, nullptr) &&
+                wait_for_irq((uint32_t)(1) << RX_IRQ, PN5180_RX_TIMEOUT, nullptr)) {
+                uint32_t rx_status;
+                if (!read_register(REG_RX_STATUS, &rx_status)) {
+                    return -1;
+                }
+
+                uint16_t length = rx_status & RX_NUM_BYTES_MASK;
+                bool collided = (rx_status & ((uint32_t)(1) << RX_COLLISION_DETECTED)) ||
+                                ((rx_status & ((uint32_t)(1) << RX_DATA_INTEGRITY_ERROR)) && length > 0);
+
+                if (collided) {
+                    // Resolve this slot later, by appending its number to the mask
+                    if (num_masks < PN5180_MAX_COLLISIONS && mask_length + 4 <= ISO15693_MAX_MASK_LENGTH) {
+                        memcpy(masks[num_masks], mask, ISO15693_UID_LENGTH);
+                        masks[num_masks][mask_length / 8] |= slot << (mask_length % 8);
+                        mask_lengths[num_masks] = mask_length + 4;
+                        num_masks++;
+                    }
+                } else if (length == 2 + ISO15693_UID_LENGTH && num_uids < max_uids) {
+                    // Response format is Flags DSFID UID[0] ... UID[7] [Section 10.3.1 (ISO-15693-3)]
+                    uint8_t response[2 + ISO15693_UID_LENGTH];
+
+                    if (!issue_command(PN5180_READ_DATA, 0x00) || !receive_command_response(response, length)) {
+                        return -1;
+                    }
+
+                    // Bit 0 of the response flags is set on errors
+                    if (!(response[0] & 0x01)) {
+                        memcpy(uids + num_uids * ISO15693_UID_LENGTH, response + 2, ISO15693_UID_LENGTH);
+                        num_uids++;
+                    }
+                }
+            }
+
+            if (slot == ISO15693_NUM_SLOTS - 1) {
+                break;
+            }
+
+            // Send just an EOF to move on to the next slot [Section 4.3 (AN12650)]
+            if (!write_register_and_mask(REG_TX_CONFIG, TX_CONFIG_EOF_ONLY_MASK) || !start_transceive() ||
+                !clear_irq_status(ALL_IRQS) || !issue_command(PN5180_SEND_DATA, 0x00)) {
+                return -1;
+            }
+        }
+    }
+
+    return num_uids;
+};
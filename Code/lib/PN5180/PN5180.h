@@ -1,3 +1,25 @@
+/*
+    PN5180.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Provides an interface to communicate with NXP's PN5180 RFID chip over SPI, exchange frames over the RF field, and run
+    ISO15693 (vicinity) inventories for the longer read range.
+
+    Every wait on the chip is bounded, so a missing or unresponsive PN5180 makes a call fail instead of hanging. Uses
+    `current_time()`, so `initialize_tick_counter()` must have been called first.
+
+    The following sources were referenced.
+
+    https://www.nxp.com/docs/en/data-sheet/PN5180A0XX_C3_C4.pdf [PN5180DS]
+    https://www.nxp.com/docs/en/application-note/AN12650.pdf [AN12650]
+    https://github.com/ATrappmann/PN5180-Library
+    ISO/IEC 15693-3 [ISO-15693-3]
+*/
 
 #ifndef PN5180_H
 #define PN5180_H
@@ -5,24 +27,30 @@
 #define SEND    0
 #define RECEIVE 1
 
-#include "Arduino.h"
-#include "avr/io.h"
-#include "avr/delay.h"
+#include "stdint.h"
 #include "Pins.h"
 #include "SPI.h"
+#include "Timer.h"
 #include "PN5180_Registers.h"
 #include "PN5180_Commands.h"
 
+// Timeouts
+#define PN5180_BUSY_TIMEOUT         50000 // Microseconds; LOAD_RF_CONFIG and RF_ON keep BUSY high the longest
+#define PN5180_RF_ON_TIMEOUT        10 // Milliseconds
+#define PN5180_RX_TIMEOUT           10 // Milliseconds; long enough for an ISO15693 inventory response at 26 kbps
+#define ISO15693_SLOT_TIMEOUT       1  // Milliseconds; a tag starts answering 320 us into its slot [Section 9.1 (ISO-15693-3)]
+
+// ISO15693 Inventory
+#define ISO15693_UID_LENGTH         8
+#define ISO15693_NUM_SLOTS          16
+#define ISO15693_MAX_MASK_LENGTH    60 // Bits; the mask grows by 4 bits per round of collision resolution
+#define PN5180_MAX_COLLISIONS       8 // Collided slots waiting to be resolved
+
+#define PN5180_MAX_FRAME_SIZE       32
+
 class PN5180 {
     public:
-        PN5180(
-            Pin RST,
-            Pin BUSY,
-            Pin NSS,
-            Pin MOSI,
-            Pin MISO,
-            Pin SCK
-        );
+        PN5180(Pin NSS, Pin BUSY, Pin RST);
 
         void reset();
         void initialize();
@@ -32,25 +60,55 @@ class PN5180 {
         template <typename PN5180_Command, typename... PN5180_Params>
         bool issue_command(PN5180_Command opcode, PN5180_Params... params) {
             // Put the opcode and parameters in an array
-            uint8_t send_bytes[] = {opcode, params...};
+            uint8_t send_bytes[] = {(uint8_t)(opcode), (uint8_t)(params)...};
             int length = sizeof(send_bytes) / sizeof(send_bytes[0]);
 
             // Send the command over SPI
             return transceive(SEND, send_bytes, length);
         };
-        bool issue_command(uint8_t* command_bytes, uint8_t num_command_bytes);
+        bool issue_command_from_array(uint8_t* command_bytes, int num_command_bytes);
 
         bool receive_command_response(uint8_t* response_buffer, int length);
 
+        bool write_register(uint8_t address, uint32_t value);
+        bool write_register_or_mask(uint8_t address, uint32_t mask);
+        bool write_register_and_mask(uint8_t address, uint32_t mask);
+        bool read_register(uint8_t address, uint32_t* value);
+
+        bool clear_irq_status(uint32_t mask);
+        bool wait_for_irq(uint32_t mask, unsigned long timeout, uint32_t* irq_status);
+
+        bool load_rf_config(uint8_t tx_configuration, uint8_t rx_configuration);
+        bool set_rf_field(bool on);
+
         bool transmit_rf(uint8_t valid_bits_last_byte, uint8_t num_bytes, uint8_t* bytes);
         bool receive_rf(uint8_t* receive_buffer, uint8_t num_bytes, uint8_t* valid_bytes, uint8_t* valid_bits_last_byte);
+        int collision_position();
+
+        bool set_crc(bool enable);
+        bool set_crc(bool transmit, bool receive);
+        bool set_rx_bit_align(uint8_t bit);
+
+        bool mifare_authenticate(uint8_t* key, uint8_t key_type, uint8_t block_address, uint8_t* uid);
+
+        int iso15693_inventory(uint8_t* uids, int max_uids);
 
     private:
-        Pin _RST;
-        Pin _BUSY;
+        bool wait_while_busy();
+        bool wait_until_busy();
+
+        bool start_transceive();
+        bool send_inventory_request(uint8_t* mask, uint8_t mask_length);
+
         Pin _NSS;
+        Pin _BUSY;
+        Pin _RST;
 
         SPI_Master _spi;
+
+        int _collision_position;
+
+        static uint8_t _frame_arena[2 + PN5180_MAX_FRAME_SIZE];
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,21 +1,38 @@
 #ifndef PN5180_COMMANDS_H
 #define PN5180_COMMANDS_H
 
-#define WRITE_REGISTER      0x00
-#define WRITE_REGISTER_OR   0x01
-#define WRITE_REGISTER_AND  0x02
+// Prefixed with PN5180_, as some of the names clash with the commands in PN532_Commands.h [Section 11.4.3 (PN5180DS)]
+#define PN5180_WRITE_REGISTER       0x00
+#define PN5180_WRITE_REGISTER_OR    0x01
+#define PN5180_WRITE_REGISTER_AND   0x02
 
-#define READ_REGISTER       0x04
+#define PN5180_READ_REGISTER        0x04
 
-#define READ_EEPROM         0x07
+#define PN5180_READ_EEPROM          0x07
 
-#define WRITE_TX_DATA       0x08
-#define SEND_DATA           0x09
-#define READ_DATA           0x0A
+#define PN5180_WRITE_TX_DATA        0x08
+#define PN5180_SEND_DATA            0x09
+#define PN5180_READ_DATA            0x0A
 
-#define LOAD_RF_CONFIG      0x11
+#define PN5180_MIFARE_AUTHENTICATE  0x0C
 
-#define RF_ON               0x16
-#define RF_OFF              0x17
+#define PN5180_LOAD_RF_CONFIG       0x11
 
-#endif
\ No newline at end of file
+#define PN5180_RF_ON                0x16
+#define PN5180_RF_OFF               0x17
+
+// RF Configurations for LOAD_RF_CONFIG [Table 32 (PN5180DS)]
+#define RF_CONFIG_ISO14443A_TX      0x00 // 106 kbps
+#define RF_CONFIG_ISO14443A_RX      0x80
+#define RF_CONFIG_ISO15693_TX       0x0D // ASK 100%, 26 kbps
+#define RF_CONFIG_ISO15693_RX       0x8D
+
+// ISO15693 Commands [Section 10.3 (ISO-15693-3)]
+#define ISO15693_INVENTORY          0x01
+
+// ISO15693 Request Flags [Section 7.3.1 (ISO-15693-3)]
+#define ISO15693_FLAG_HIGH_DATA_RATE    0x02
+#define ISO15693_FLAG_INVENTORY         0x04
+#define ISO15693_FLAG_ONE_SLOT          0x20 // Nb_slots_flag; cleared for 16 slots
+
+#endif
@@ -12,6 +12,50 @@
 
 #define REG_RX_STATUS       0x13
 
+#define REG_TX_CONFIG       0x18
+
 #define REG_RF_STATUS       0x1D
 
-#endif
\ No newline at end of file
+// SYSTEM_CONFIG; bits 2:0 hold the command of the transceive state machine
+#define SYSTEM_CONFIG_COMMAND_MASK  0x00000007
+#define COMMAND_IDLE                0x00
+#define COMMAND_TRANSCEIVE          0x03
+
+// IRQ_STATUS bits
+#define RX_IRQ                  0
+#define TX_IRQ                  1
+#define IDLE_IRQ                2
+#define TX_RFOFF_IRQ            8
+#define TX_RFON_IRQ             9
+#define RX_SOF_DET_IRQ          14
+#define GENERAL_ERROR_IRQ       17
+
+#define ALL_IRQS                0x000FFFFF
+
+// RX_STATUS bits
+#define RX_NUM_BYTES_MASK       0x000001FF
+#define RX_NUM_LAST_BITS_SHIFT  13
+#define RX_NUM_LAST_BITS_MASK   0x07
+#define RX_DATA_INTEGRITY_ERROR 16
+#define RX_PROTOCOL_ERROR       17
+#define RX_COLLISION_DETECTED   18
+#define RX_COLL_POS_SHIFT       19 // Bits 25:19; position of the first collision, in the bits received
+#define RX_COLL_POS_MASK        0x7F
+
+// CRC_RX_CONFIG and CRC_TX_CONFIG; bit 0 enables the CRC. Bits 8:6 of CRC_RX_CONFIG place the first bit received at that bit of the
+// first byte, for split ISO14443A anticollision frames
+#define CRC_ENABLE              0x00000001
+#define RX_BIT_ALIGN_SHIFT      6
+#define RX_BIT_ALIGN_MASK       0x000001C0
+
+// TX_CONFIG; clearing TX_DATA_ENABLE and the start symbol makes the next SEND_DATA transmit just an EOF, which moves ISO15693
+// tags on to the next inventory slot
+#define TX_CONFIG_EOF_ONLY_MASK 0xFFFFFB3F
+
+// RF_STATUS; bits 26:24 hold the state of the transceive state machine
+#define TRANSCEIVE_STATE_SHIFT  24
+#define TRANSCEIVE_STATE_MASK   0x07
+#define STATE_WAIT_TRANSMIT     0x01
+#define STATE_WAIT_RECEIVE      0x03
+
+#endif
@@ -20,6 +20,7 @@
     https://www.nxp.com/docs/en/user-guide/141520.pdf [PN532UM]
     https://www.nxp.com/docs/en/nxp/data-sheets/PN532_C1.pdf [PN532DS]
     http://www.emutag.com/iso/14443-3.pdf [ISO-3]
+    http://www.emutag.com/iso/14443-4.pdf [ISO-4]
 
     https://www.nxp.com/docs/en/data-sheet/MF1S50YYX_V1.pdf
 */
@@ -27,6 +28,7 @@
 #include "Pins.h"
 #include "SPI.h"
 #include "Timer.h"
+#include "TokenLog.h"
 #include "PN532_Commands.h"
 #include "MIFARE_Classic_Commands.h"
 #include "PN532.h"
@@ -37,17 +39,38 @@
     PN532 Methods
 */
 
+// Every frame sent or read whole is built in here, rather than on the stack of each call
+unsigned char PN532::_frame_arena[FRAME_ARENA_SIZE];
+
 PN532::PN532(Pin NSS) : _NSS(NSS) {
     _NSS.set_output();
-    
+
+    // Keep the chip deselected until it is initialized, as other chips on the bus share MISO
+    _NSS.assert();
+
     _spi = SPI_Master();
+
+    reset_error_counters();
+    reset_rf_statistics();
+
+    _parameters = PROFILE_UNKNOWN;
+
+    _rx_gain = DEFAULT_RX_GAIN;
+    _min_level = DEFAULT_MIN_LEVEL;
+
+    _firmware_version = 0;
+
+    _exchange_status = 0;
 };
 
 void PN532::initialize() {
     _spi.initialize(LSB_FIRST);
 
     _NSS.assert(); // Keep the chip deactivated initially
-    blocking_delay(5, MILLISECONDS);
+    blocking_delay(PN532_NSS_HOLD_TIME, MICROSECONDS);
+
+    // The PN532 may or may not have been reset along with the host
+    _parameters = PROFILE_UNKNOWN;
 };
 
 bool PN532::send_bytes(unsigned char* bytes, int length) {
@@ -64,23 +87,23 @@ bool PN532::write_frame(unsigned char* frame, int length) {
     */
     
     // NSS assertion and deassertion as described in Section 8.3.5.5 (PN532DS)
-    _NSS.deassert();
-    blocking_delay(5, MILLISECONDS);
+    _spi.select(&_NSS);
+    blocking_delay(PN532_NSS_SETUP_TIME, MICROSECONDS);
 
     // Start by first sending a DATA_WRITE byte, as required by modified SPI frames [Section 6.2.5 (PN532UM)]
     if (!_spi.send_and_receive_byte(DATA_WRITE, nullptr)) {
-        _NSS.assert();
+        _spi.deselect(&_NSS);
         return false;
     }
 
     // Send the rest of the bytes
     if (!send_bytes(frame, length)) {
-        _NSS.assert();
+        _spi.deselect(&_NSS);
         return false;
     }
 
-    _NSS.assert();
-    blocking_delay(5, MILLISECONDS);
+    _spi.deselect(&_NSS);
+    blocking_delay(PN532_NSS_HOLD_TIME, MICROSECONDS);
 
     return true;
 };
@@ -102,26 +125,26 @@ bool PN532::read_frame(unsigned char* frame_target, int length, bool start, bool
     // If not continuing from a previous frame read, select the PN532, and send a DATA_READ byte to prepare to read
     if (start) {
         // Deassert NSS to start data read [Section 8.3.5.4 (PN532DS)]
-        _NSS.deassert();
-        blocking_delay(5, MILLISECONDS);
-        
+        _spi.select(&_NSS);
+        blocking_delay(PN532_NSS_SETUP_TIME, MICROSECONDS);
+
         // Start by sending a DATA_READ byte [Section 6.2.5 (PN532UM)]
         if (!_spi.send_and_receive_byte(DATA_READ, nullptr)) {
-            _NSS.assert();
+            _spi.deselect(&_NSS);
             return false;
         }
     }
 
     // Read `length` bytes of the response
     if (!receive_bytes(frame_target, length)) {
-        _NSS.assert();
+        _spi.deselect(&_NSS);
         return false;
     }
 
     // If concluding the frame read, reassert NSS to deselect the PN532 [Section 8.3.5.4 (PN532DS)], else return without
     // asserting NSS
     if (conclude) {
-        _NSS.assert();
+        _spi.deselect(&_NSS);
     }
 
     return true;
@@ -164,30 +187,38 @@ void PN532::make_normal_information_frame(unsigned char* target_frame, unsigned
     target_frame[TFI_IDX + 1 + num_bytes + 1] = POSTAMBLE;
 };
 
-bool PN532::ready_to_respond() {
+bool PN532::response_available() {
     /*
-        Poll the PN532's status byte until it has data available to be read
+        Poll the PN532's status byte once, and see if it has data available to be read; does not wait
     */
 
-    int timeout = 1000; // Timeout in milliseconds
-    bool ready = false;
-
     // NSS assertion and deassertion as described in Section 8.3.5.3 (PN532DS)
-    while (!(ready) && timeout > 0) {
-        _NSS.deassert();
+    _spi.select(&_NSS);
+
+    // Poll the Status byte and receive a byte of response [Section 6.2.5.1 (PN532UM)]
+    _spi.send_and_receive_byte(STATUS_READ, nullptr);
+
+    unsigned char response_buffer;
+    _spi.send_and_receive_byte(0x00, &response_buffer);
+
+    _spi.deselect(&_NSS);
 
-        blocking_delay(10, MILLISECONDS);
-        timeout -= 10; 
+    return (response_buffer & 0b1); // Extract the LSB of the received byte
+};
 
-        // Poll the Status byte and receive a byte of response [Section 6.2.5.1 (PN532UM)]
-        _spi.send_and_receive_byte(STATUS_READ, nullptr);
+bool PN532::ready_to_respond(int timeout, int interval) {
+    /*
+        Poll the PN532's status byte every `interval` milliseconds until it has data available to be read, for up to `timeout`
+        milliseconds
+    */
 
-        unsigned char response_buffer;
-        _spi.send_and_receive_byte(0x00, &response_buffer);
+    bool ready = false;
 
-        _NSS.assert();
+    while (!(ready) && timeout > 0) {
+        blocking_delay(interval, MILLISECONDS);
+        timeout -= interval;
 
-        ready = (response_buffer & 0b1); // Extract the LSB of the received byte
+        ready = response_available();
     }
 
     return ready;
@@ -213,32 +244,225 @@ bool PN532::check_ack() {
     return true;
 };
 
+bool PN532::check_response_code(unsigned char opcode) {
+    /*
+        Read a response that consists of just OPCODE+1, and check that it is the response to `opcode`
+    */
+
+    PN532_Response response;
+    if (!read_response(&response)) {
+        return false;
+    }
+
+    return (response.data[0] == opcode + 1);
+};
+
 bool PN532::issue_command_from_array(unsigned char* command_array, int length) {
     /*
         Send `command_array`, where the 0th entry is the command code, and all following entries contain the relevant parameters for
         the command, and wait for it to be acknowledged (`command_array` should contain PD1 ... PDn)
     */
 
-    // Create a normal information frame by adding the frame header and trailer [Section 6.2.1.1 (PN532UM)]
-    unsigned char normal_information_frame[FRAME_HEADER_SIZE + length + FRAME_TRAILER_SIZE];
-    make_normal_information_frame(normal_information_frame, TFI_HOST_TO_PN532, command_array, length);
+    if (length > PN532_MAX_DATA_SIZE) {
+        return false;
+    }
+
+    // `command_array` may already be in the frame arena
+    memmove(command_buffer(), command_array, length);
+
+    return issue_buffered_command(length);
+};
+
+unsigned char* PN532::command_buffer() {
+    /*
+        Where the command code and parameters (PD0 ... PDn) of the next command are placed, inside the frame arena, so that a
+        command can be built where it is sent from; holds PN532_MAX_DATA_SIZE bytes
+    */
+
+    return _frame_arena + OPCODE_IDX;
+};
+
+bool PN532::issue_buffered_command(int length) {
+    /*
+        Send the `length` bytes placed at `command_buffer()`, and wait for them to be acknowledged
+    */
 
-    if (!write_frame(normal_information_frame, FRAME_HEADER_SIZE + length + FRAME_TRAILER_SIZE)) {
+    if (length > PN532_MAX_DATA_SIZE) {
         return false;
     }
-    
-    if (!ready_to_respond()) {
+
+    // Add the frame header and trailer around the bytes in place [Section 6.2.1.1 (PN532UM)]
+    make_normal_information_frame(_frame_arena, TFI_HOST_TO_PN532, command_buffer(), length);
+
+    if (!write_frame(_frame_arena, FRAME_HEADER_SIZE + length + FRAME_TRAILER_SIZE)) {
+        return false;
+    }
+
+    if (!ready_to_respond(PN532_ACK_TIMEOUT)) {
         return false;
     }
 
     return check_ack();
-}
+};
+
+bool PN532::read_response(PN532_Response* response) {
+    /*
+        Wait for the response to the command issued last, and read the whole frame into the frame arena in one transaction;
+        `response` is pointed at its data, PD0 (OPCODE+1) ... PDn. Returns `false` if the frame is malformed, fails its
+        checksums, is the error frame, or does not fit in the frame arena. [Section 6.2.1.1, 6.2.1.5 (PN532UM)]
+
+        A frame that arrives corrupted is asked for again with a NACK, up to PN532_NACK_RETRIES times; the PN532 sends the same
+        response again, so noise on the bus costs one more frame read, not the command, and whatever had to be done again to
+        issue it (e.g. an authentication). [Section 6.2.1.4 (PN532UM)]
+    */
+
+    return read_response(response, nullptr, 0);
+};
+
+bool PN532::read_response(PN532_Response* response, unsigned char* tail, int max_tail_length) {
+    /*
+        As above, but only the first RESPONSE_HEAD_SIZE bytes of the data go in the frame arena, and the rest straight into
+        `tail`, which holds `max_tail_length` bytes; so a response longer than the frame arena, up to the 264 bytes of an
+        extended frame, can be read where it is wanted, without the frame arena being as long
+    */
+
+    for (int attempt = 0; ; attempt++) {
+        bool corrupted = false;
+
+        if (read_response_frame(response, &corrupted, tail, max_tail_length)) {
+            if (attempt > 0) {
+                _nack_recoveries++;
+            }
+
+            return true;
+        }
+
+        if (!corrupted) {
+            return false;
+        }
+
+        _checksum_errors++;
+        log_event(LOG_PN532_CORRUPTED, _NSS.id(), attempt + 1);
+
+        if (attempt == PN532_NACK_RETRIES || !send_nack()) {
+            return false;
+        }
+    }
+};
+
+bool PN532::read_response_frame(PN532_Response* response, bool* corrupted, unsigned char* tail, int max_tail_length) {
+    /*
+        Read one response frame, normal or extended, as `read_response()`; `corrupted` is set if it failed its start code, LCS,
+        or DCS, and is worth asking for again. A frame too long for where it is to go is read to its end and dropped, but not
+        asked for again, as it would be as long again.
+    */
+
+    if (!receive_command_response(_frame_arena, FRAME_HEADER_SIZE, true, false)) {
+        return false;
+    }
+
+    int length = _frame_arena[LEN_IDX];
+    unsigned char length_checksum = length + _frame_arena[LCS_IDX];
+
+    // The length of an extended frame follows its marker; TFI is moved to where it is in a normal frame
+    if (length == EXTENDED_FRAME_MARKER && _frame_arena[LCS_IDX] == EXTENDED_FRAME_MARKER) {
+        unsigned char extended[EXTENDED_LENGTH_SIZE];
+
+        if (!read_frame(extended, EXTENDED_LENGTH_SIZE, false, false)) {
+            return false;
+        }
+
+        length = (_frame_arena[TFI_IDX] << 8) | extended[0];
+        length_checksum = _frame_arena[TFI_IDX] + extended[0] + extended[1];
+        _frame_arena[TFI_IDX] = extended[2];
+    }
+
+    if (_frame_arena[STARTCODE1_IDX] != STARTCODE1 || _frame_arena[STARTCODE2_IDX] != STARTCODE2 || length_checksum != 0 ||
+        length == 0) {
+        _spi.deselect(&_NSS);
+        *corrupted = true;
+        return false;
+    }
+
+    // LEN counts TFI, which is already read; the data goes in the frame arena, but for what goes in `tail`
+    int data_length = length - 1;
+    int head_length = (tail && data_length > RESPONSE_HEAD_SIZE) ? RESPONSE_HEAD_SIZE : data_length;
+    int tail_length = data_length - head_length;
+
+    if (head_length > PN532_MAX_DATA_SIZE || tail_length > max_tail_length) {
+        log_event(LOG_PN532_TOO_LONG, _NSS.id(), data_length);
+        drain_response_frame(data_length + FRAME_TRAILER_SIZE);
+        return false;
+    }
+
+    // The trailer follows the data
+    if (!read_frame(_frame_arena + OPCODE_IDX, head_length, false, false) ||
+        (tail_length > 0 && !read_frame(tail, tail_length, false, false)) ||
+        !read_frame(_frame_arena + OPCODE_IDX + head_length, FRAME_TRAILER_SIZE, false, true)) {
+        return false;
+    }
+
+    unsigned char DCS = 0;
+
+    for (int i = 0; i < head_length + 2; i++) { // TFI, the data in the frame arena, DCS
+        DCS += _frame_arena[TFI_IDX + i];
+    }
+
+    for (int i = 0; i < tail_length; i++) {
+        DCS += tail[i];
+    }
+
+    if (DCS != 0) {
+        *corrupted = true;
+        return false;
+    }
+
+    // The error frame, sent on a syntax error, has TFI = 0x7F and no data; sent again, it would be the same
+    if (_frame_arena[TFI_IDX] != TFI_PN532_TO_HOST || length < 2) {
+        return false;
+    }
+
+    response->data = _frame_arena + OPCODE_IDX;
+    response->length = data_length;
+
+    return true;
+};
+
+bool PN532::drain_response_frame(int length) {
+    /*
+        Read the last `length` bytes of a frame, whose header has been read, and drop them, a frame arena at a time; so that the
+        PN532 is done with the frame, and the host with the transaction
+    */
+
+    while (length > 0) {
+        int piece = (length < FRAME_ARENA_SIZE) ? length : FRAME_ARENA_SIZE;
+        length -= piece;
+
+        if (!read_frame(_frame_arena, piece, false, length == 0)) {
+            return false;
+        }
+    }
+
+    return true;
+};
+
+bool PN532::send_nack() {
+    /*
+        Ask the PN532 to send its last response frame again [Section 6.2.1.4 (PN532UM)]
+    */
+
+    unsigned char nack[NACK_SIZE];
+    memcpy(nack, NACK_FRAME, NACK_SIZE);
+
+    return write_frame(nack, NACK_SIZE);
+};
 
 bool PN532::receive_command_response(unsigned char* response_buffer, int length, bool start, bool conclude) {
     /*
         See if the PN532 is ready to respond, then buffer in `length` bytes of the response
 
-        `start` and `conclude` apply in the same sense as described in `read_frame()`
+        `start` and `conclude` apply in the same sense as described in `read_frame()`; to read a response whole, without
+        knowing its length, use `read_response()`
     */
 
     if (start) {
@@ -250,6 +474,56 @@ bool PN532::receive_command_response(unsigned char* response_buffer, int length,
     return read_frame(response_buffer, length, start, conclude);
 };
 
+bool PN532::wake_up(unsigned long timeout) {
+    /*
+        Wake the PN532, and probe it with GET_FIRMWARE_VERSION until it answers, for up to `timeout` milliseconds; in place of a
+        fixed delay after power up, so that the scans start as soon as the PN532 is ready, and to find out whether a PN532 that
+        stopped answering is back. Returns `true` once it has answered; its version is then in `firmware_version()`.
+
+        A falling edge on NSS wakes the PN532 from power down [Section 7.2.11 (PN532UM)]; a probe that is not ACK'ed within
+        PN532_PROBE_TIMEOUT is sent again.
+
+        Command format is;
+
+        GET_FIRMWARE_VERSION
+
+        Response is OPCODE+1 IC Ver Rev Support [Section 7.2.2 (PN532UM)]
+    */
+
+    unsigned long start = current_time(MILLISECONDS);
+
+    do {
+        _spi.select(&_NSS);
+        blocking_delay(PN532_WAKE_UP_TIME, MILLISECONDS);
+        _spi.deselect(&_NSS);
+
+        unsigned char* command = command_buffer();
+        command[0] = GET_FIRMWARE_VERSION;
+
+        make_normal_information_frame(_frame_arena, TFI_HOST_TO_PN532, command, 1);
+
+        if (!write_frame(_frame_arena, FRAME_HEADER_SIZE + 1 + FRAME_TRAILER_SIZE) ||
+            !ready_to_respond(PN532_PROBE_TIMEOUT, 1) || !check_ack()) {
+            continue;
+        }
+
+        PN532_Response response;
+
+        if (read_response(&response) && response.length == 5 && response.data[0] == GET_FIRMWARE_VERSION + 1) {
+            _firmware_version = ((unsigned long)(response.data[1]) << 24) | ((unsigned long)(response.data[2]) << 16) |
+                                ((unsigned long)(response.data[3]) << 8) | response.data[4];
+            return true;
+        }
+    } while (current_time(MILLISECONDS) - start < timeout);
+
+    return false;
+};
+
+unsigned long PN532::firmware_version() {
+    // IC Ver Rev Support, MSB first, as last reported to `wake_up()`; 0 if it never answered
+    return _firmware_version;
+};
+
 bool PN532::SAMConfig() {
     /*
         Configure the PN532 in the Normal Mode to not use SAM
@@ -270,17 +544,239 @@ bool PN532::SAMConfig() {
     }
 
     // Response is just OPCODE+1
-    unsigned char response[FRAME_HEADER_SIZE + 1 + FRAME_TRAILER_SIZE];
-    if (!receive_command_response(response, FRAME_HEADER_SIZE + 1 + FRAME_TRAILER_SIZE, true, true)) {
+    return check_response_code(SAM_CONFIGURATION);
+};
+
+bool PN532::set_parameters(unsigned char flags) {
+    /*
+        Set the internal parameters of the PN532, e.g. one of the PROFILE_ values; most importantly whether LIST_PASSIVE_TARGETS
+        sends RATS to ISO14443-4 tags, an extra RF exchange and up to MAX_ATS_LENGTH more bytes in the response on every detection.
+        Not sent again if `flags` are already set, so it costs nothing to call before every scan.
+
+        Command format is;
+
+        SET_PARAMETERS Flags
+
+        [Section 7.2.9 (PN532UM)]
+    */
+
+    if (flags == _parameters) {
+        return true;
+    }
+
+    if (!issue_command(SET_PARAMETERS, flags)) {
+        return false;
+    }
+
+    // Response is just OPCODE+1
+    if (!check_response_code(SET_PARAMETERS)) {
+        // Whatever the PN532 holds now is not known
+        _parameters = PROFILE_UNKNOWN;
         return false;
     }
 
-    return ((response[TFI_IDX] == TFI_PN532_TO_HOST) && (response[OPCODE_IDX] == SAM_CONFIGURATION + 1));
+    _parameters = flags;
+
+    return true;
+};
+
+unsigned char PN532::parameters() {
+    // The flags last set with `set_parameters()`, or PROFILE_UNKNOWN if none have been since `initialize()`
+    return _parameters;
 };
 
-bool PN532::detect_card(unsigned char* card_number, unsigned char* card_data) {
+bool PN532::read_registers(const unsigned int* addresses, int count, unsigned char* values) {
+    /*
+        Read the `count` registers (CIU registers, SFRs, or XRAM) at `addresses` into `values`, in one command
+
+        Command format is;
+
+        READ_REGISTER ADR1H ADR1L ... ADRnH ADRnL
+
+        Response is OPCODE+1 Val1 ... Valn [Section 7.2.4 (PN532UM)]
+    */
+
+    if (count < 1 || 1 + 2 * count > PN532_MAX_DATA_SIZE) {
+        return false;
+    }
+
+    unsigned char* command = command_buffer();
+    command[0] = READ_REGISTER;
+
+    for (int i = 0; i < count; i++) {
+        command[1 + 2 * i] = addresses[i] >> 8;
+        command[2 + 2 * i] = addresses[i];
+    }
+
+    if (!issue_buffered_command(1 + 2 * count)) {
+        return false;
+    }
+
+    PN532_Response response;
+    if (!read_response(&response)) {
+        return false;
+    }
+
+    if (response.length < 1 + count || response.data[0] != READ_REGISTER + 1) {
+        return false;
+    }
+
+    memcpy(values, response.data + 1, count);
+
+    return true;
+};
+
+bool PN532::write_registers(const unsigned int* addresses, const unsigned char* values, int count) {
+    /*
+        Write `values` to the `count` registers at `addresses`, in one command
+
+        Command format is;
+
+        WRITE_REGISTER ADR1H ADR1L Val1 ... ADRnH ADRnL Valn
+
+        [Section 7.2.5 (PN532UM)]
+    */
+
+    if (count < 1 || 1 + 3 * count > PN532_MAX_DATA_SIZE) {
+        return false;
+    }
+
+    unsigned char* command = command_buffer();
+    command[0] = WRITE_REGISTER;
+
+    for (int i = 0; i < count; i++) {
+        command[1 + 3 * i] = addresses[i] >> 8;
+        command[2 + 3 * i] = addresses[i];
+        command[3 + 3 * i] = values[i];
+    }
+
+    if (!issue_buffered_command(1 + 3 * count)) {
+        return false;
+    }
+
+    return check_response_code(WRITE_REGISTER);
+};
+
+bool PN532::read_rf_errors(unsigned char* ciu_error) {
+    /*
+        Read CIU_Error, the errors the contactless interface flagged in the last RF exchange (CIU_PROTOCOL_ERR, CIU_PARITY_ERR,
+        CIU_CRC_ERR, CIU_COLL_ERR, CIU_BUFFER_OVFL, CIU_TEMP_ERR) [Section 8.6.23.12 (PN532DS)]
+    */
+
+    const unsigned int address = CIU_ERROR;
+
+    return read_registers(&address, 1, ciu_error);
+};
+
+bool PN532::set_rf_field(bool on) {
+    /*
+        Switch the RF field on or off; switch it off to keep an idle antenna from interfering with a neighbouring reader. The
+        PN532 switches it back on by itself when it next needs it.
+
+        Command format is;
+
+        RF_CONFIGURATION CfgItem ConfigurationData
+
+        CfgItem             = RF_FIELD_ITEM
+        ConfigurationData   = bit 0 is RF on/off, bit 1 is AutoRFCA; we leave AutoRFCA off
+
+        [Section 7.3.1 (PN532UM)]
+    */
+
+    if (!issue_command(RF_CONFIGURATION, RF_FIELD_ITEM, on ? 0x01 : 0x00)) {
+        return false;
+    }
+
+    return check_response_code(RF_CONFIGURATION);
+};
+
+bool PN532::set_passive_activation_retries(unsigned char retries) {
+    /*
+        Set how many times the PN532 retries activating a target in LIST_PASSIVE_TARGETS before reporting no target; the default
+        0xFF retries forever, so LIST_PASSIVE_TARGETS only returns once a tag enters the field
+
+        Command format is;
+
+        RF_CONFIGURATION CfgItem MxRtyATR MxRtyPSL MxRtyPassiveActivation
+
+        CfgItem                 = MAX_RETRIES_ITEM
+        MxRtyATR, MxRtyPSL      = left at their defaults, 0xFF and 0x01
+        MxRtyPassiveActivation  = `retries`
+
+        [Section 7.3.1 (PN532UM)]
+    */
+
+    if (!issue_command(RF_CONFIGURATION, MAX_RETRIES_ITEM, 0xFF, 0x01, retries)) {
+        return false;
+    }
+
+    return check_response_code(RF_CONFIGURATION);
+};
+
+bool PN532::set_receiver(unsigned char rx_gain, unsigned char min_level) {
+    /*
+        Set the gain of the receiver, 0 to 7 (18, 23, 18, 23, 33, 38, 43, 48 dB), and the minimum signal level, 0 to 15, it
+        takes as a bit for ISO14443A; the other analog settings are left at their defaults
+
+        Command format is;
+
+        RF_CONFIGURATION CfgItem ConfigurationData[0] ... ConfigurationData[10]
+
+        CfgItem             = ANALOG_106_A_ITEM
+        ConfigurationData   = the 11 analog settings, with RxGain in CIU_RFCfg, and MinLevel in CIU_RxThreshold
+
+        [Section 7.3.1 (PN532UM)], [Section 8.6.23 (PN532DS)]
+    */
+
+    unsigned char* command = command_buffer();
+    command[0] = RF_CONFIGURATION;
+    command[1] = ANALOG_106_A_ITEM;
+
+    unsigned char* settings = command + 2;
+    memcpy(settings, ANALOG_106_A_DEFAULTS, ANALOG_SETTINGS_SIZE);
+
+    settings[ANALOG_RF_CFG_IDX] = (settings[ANALOG_RF_CFG_IDX] & 0x8F) | ((rx_gain & 0x07) << 4);
+    settings[ANALOG_RX_THRESHOLD_IDX] = (settings[ANALOG_RX_THRESHOLD_IDX] & 0x0F) | ((min_level & 0x0F) << 4);
+
+    if (!issue_buffered_command(2 + ANALOG_SETTINGS_SIZE) || !check_response_code(RF_CONFIGURATION)) {
+        return false;
+    }
+
+    _rx_gain = rx_gain;
+    _min_level = min_level;
+
+    return true;
+};
+
+bool PN532::restore_receiver() {
+    /*
+        Make the receiver setting last made with `set_receiver()` again, e.g. after the PN532 was reset; nothing is sent if it is
+        the default, which the PN532 starts with
+    */
+
+    if (_rx_gain == DEFAULT_RX_GAIN && _min_level == DEFAULT_MIN_LEVEL) {
+        return true;
+    }
+
+    return set_receiver(_rx_gain, _min_level);
+};
+
+unsigned char PN532::rx_gain() {
+    // The receiver gain last set with `set_receiver()`, or the default
+    return _rx_gain;
+};
+
+unsigned char PN532::min_level() {
+    // The minimum signal level last set with `set_receiver()`, or the default
+    return _min_level;
+};
+
+bool PN532::request_card_detection() {
     /*
-        Find a tag, put its logical number in `tag_number`, read its UID (and ATS if ISO 14443-4 Compliant), and put it in `tag_data`
+        Ask the PN532 to look for a tag, without waiting for the result; read it later with `read_card_detection()`
+
+        Splitting the command from its response lets the host issue commands to other PN532s while this one is busy with the RF
+        exchanges.
 
         Command format is;
         
@@ -292,75 +788,259 @@ bool PN532::detect_card(unsigned char* card_number, unsigned char* card_data) {
         [Section 7.3.5 (PN532UM)]
     */
 
-    if (!issue_command(LIST_PASSIVE_TARGETS, 0x01, 0x00)) {
+    return issue_command(LIST_PASSIVE_TARGETS, 0x01, 0x00);
+};
+
+bool PN532::read_card_detection(unsigned char* card_number, unsigned char* card_data) {
+    /*
+        Read the response to `request_card_detection()`, put the logical number of the tag found in `card_number`, and its UID
+        (and ATS if ISO 14443-4 Compliant) in `card_data`, which must hold CARD_DATA_SIZE bytes
+    */
+
+    PN532_Response response;
+    if (!read_response(&response)) {
         return false;
     }
 
-    // Response begins OPCODE+1 NbTg ...
-    unsigned char response[FRAME_HEADER_SIZE + 2];
-    if (!receive_command_response(response, FRAME_HEADER_SIZE + 2, true, false)) {
+    // Response is OPCODE+1 NbTg Tg ATQA_MSB ATQA_LSB SAK UID_Length UID[0] ... UID[n] (ATS_Length ATS[0] ... ATS[m])
+    // NbTg is the number of tags detected; we expect it to be 1 if a tag was found, as we will issue commands to read only 1
+    // tag. With limited retries, NbTg = 0 if no tag was found, and nothing follows.
+    unsigned char* data = response.data;
+
+    if (response.length < 7 || data[0] != LIST_PASSIVE_TARGETS + 1 || data[1] == 0) {
         return false;
     }
-    // `response[7]` = NbTg is the number of tags detected; we do not need this value, we expect it to be 1 always, as we will
-    // issue commands to read only 1 tag
 
-    // Response continues from above as ... Tg ATQA_MSB ATQA_LSB SAK UID_Length ...
-    if (!receive_command_response(response, 5, false, false)) {
-        return false;
-    };
+    *card_number = data[2];
 
-    *card_number = response[0];
-    
-    card_data[ATQA_MSB_IDX] = response[1];
-    card_data[ATQA_LSB_IDX] = response[2];
-    
-    unsigned char sak = response[3];
+    card_data[ATQA_MSB_IDX] = data[3];
+    card_data[ATQA_LSB_IDX] = data[4];
+
+    unsigned char sak = data[5];
     card_data[SAK_IDX] = sak;
 
-    int uid_length = response[4];
+    int uid_length = data[6];
     card_data[UID_LEN_IDX] = uid_length;
 
-    // As per Table 8, Section 6.4.3.4 (ISO-3)
-    bool iso14443_4_compliant = sak & 0b100000;
-
-    // Next `uid_length` bytes of the response form the UID of the card
-    // If the card is not ISO14443-4 compliant, the response ends after the UID; there will be no ATS
-    if (!receive_command_response(response, uid_length, false, !iso14443_4_compliant)) {
+    if (uid_length > 10 || 7 + uid_length > response.length) {
         return false;
     }
 
-    // 4-byte UID goes in `tag_data[4]` ... `tag_data[7]`
-    // 7-byte UID goes in `tag_data[4]` ... `tag_data[10]`
-    // 10-byte UID goes in `tag_data[4]` ... `tag_data[13]`
-    memcpy(card_data + 4, response, uid_length);
+    // 4-byte UID goes in `card_data[4]` ... `card_data[7]`
+    // 7-byte UID goes in `card_data[4]` ... `card_data[10]`
+    // 10-byte UID goes in `card_data[4]` ... `card_data[13]`
+    memcpy(card_data + UID_START_IDX, data + 7, uid_length);
 
-    if (iso14443_4_compliant) { // There are more bytes (ATS) to be read
-        // Response continues as ... ATS_Length ...
-        unsigned char ats_length;
-        _spi.send_and_receive_byte(0x00, &ats_length);
+    // As per Table 8, Section 6.4.3.4 (ISO-3); if the card is not ISO14443-4 compliant, the response ends after the UID. It also
+    // does for one that is, unless PARAMETER_AUTO_RATS is set.
+    bool iso14443_4_compliant = sak & 0b100000;
+    card_data[UID_START_IDX + uid_length] = 0;
 
-        // Put ATS Length in `tag_data[4 + i]`
-        card_data[4 + uid_length] = ats_length;
+    if (iso14443_4_compliant && 7 + uid_length < response.length) {
+        // Response continues as ... TL ATS[1] ... ATS[TL - 1]; TL, the first byte of the ATS, counts itself [Section 5.2.2 (ISO-4)]
+        int ats_length = (data[7 + uid_length] > 0) ? data[7 + uid_length] - 1 : 0;
 
-        // The next `ats_length` bytes form the ATS sent by the card; read them and conclude reading the frame
-        if (!receive_command_response(response, ats_length, false, true)) {
+        if (ats_length > MAX_ATS_LENGTH || 7 + uid_length + 1 + ats_length > response.length) {
             return false;
         }
 
-        // Place the ATS bytes in the following indices
-        memcpy(card_data + 4 + uid_length + 1, response, ats_length);
+        card_data[UID_START_IDX + uid_length] = ats_length;
+        memcpy(card_data + UID_START_IDX + uid_length + 1, data + 7 + uid_length + 1, ats_length);
     }
 
     return true;
 };
 
+bool PN532::detect_card(unsigned char* card_number, unsigned char* card_data) {
+    /*
+        Find a tag, put its logical number in `tag_number`, read its UID (and ATS if ISO 14443-4 Compliant), and put it in
+        `tag_data`, which must hold CARD_DATA_SIZE bytes
+    */
+
+    if (!request_card_detection()) {
+        return false;
+    }
+
+    return read_card_detection(card_number, card_data);
+};
+
+bool PN532::select_target(unsigned char card_number) {
+    /*
+        Select the tag with logical number `card_number`, found by an earlier detection, as the target of later exchanges
+
+        Command format is;
+
+        SELECT_TARGET Tg
+
+        Response is OPCODE+1 Status; Status = 0 on success [Section 7.3.12 (PN532UM)]
+    */
+
+    if (!issue_command(SELECT_TARGET, card_number)) {
+        return false;
+    }
+
+    PN532_Response response;
+    if (!read_response(&response)) {
+        return false;
+    }
+
+    return (response.length == 2) && (response.data[0] == SELECT_TARGET + 1) && (response.data[1] == 0);
+};
+
+int PN532::data_exchange(unsigned char card_number, unsigned char* data, int length, unsigned char* response, int max_response_length) {
+    /*
+        Send `length` bytes in `data` to the tag with logical number `card_number`, and place what it answers in `response`, which
+        holds `max_response_length` bytes; returns the number of bytes it answered with, or -1 if the exchange failed. The answer
+        is read straight into `response`, so it may be longer than the frame arena, up to the 262 bytes of DataIn the PN532 sends.
+    */
+
+    if (!issue_data_exchange(card_number, data, length)) {
+        return -1;
+    }
+
+    PN532_Response frame;
+    if (!read_response(&frame, response, max_response_length)) {
+        return -1;
+    }
+
+    return data_exchange_answer(&frame);
+};
+
+int PN532::data_exchange(unsigned char card_number, unsigned char* data, int length, unsigned char** response) {
+    /*
+        As above, without copying the answer; `response` is pointed at it in the frame arena, where it stays until the next
+        command is issued
+
+        Command format is;
+
+        DATA_EXCHANGE Tg DataOut[0] ... DataOut[n]
+
+        Response is OPCODE+1 Status DataIn[0] ... DataIn[m]; Status = 0 on success [Section 7.3.8 (PN532UM)]
+    */
+
+    if (!issue_data_exchange(card_number, data, length)) {
+        return -1;
+    }
+
+    PN532_Response frame;
+    if (!read_response(&frame)) {
+        return -1;
+    }
+
+    int response_length = data_exchange_answer(&frame);
+    *response = frame.data + 2;
+
+    return response_length;
+};
+
+bool PN532::issue_data_exchange(unsigned char card_number, unsigned char* data, int length) {
+    if (2 + length > PN532_MAX_DATA_SIZE) {
+        return false;
+    }
+
+    // Build the command where it is sent from; `data` may itself be in the frame arena, at `command_buffer() + 2`
+    unsigned char* command = command_buffer();
+    memmove(command + 2, data, length);
+    command[0] = DATA_EXCHANGE;
+    command[1] = card_number;
+
+    return issue_buffered_command(2 + length);
+};
+
+int PN532::data_exchange_answer(PN532_Response* frame) {
+    // Check the response to DATA_EXCHANGE, and return the length of its DataIn, or -1 if the exchange failed
+    if (frame->length < 2 || frame->data[0] != DATA_EXCHANGE + 1) {
+        return -1;
+    }
+
+    _exchange_status = frame->data[1];
+
+    if (!check_exchange_status(_exchange_status)) {
+        return -1;
+    }
+
+    return frame->length - 2;
+};
+
+bool PN532::check_exchange_status(unsigned char status) {
+    /*
+        Count the Status of a DATA_EXCHANGE in the RF statistics, and return `true` if it reports success [Section 7.1 (PN532UM)]
+    */
+
+    _rf_statistics.exchanges++;
+
+    switch (status & STATUS_ERROR_MASK) {
+        case 0:
+            return true;
+
+        case STATUS_TIMEOUT:
+            _rf_statistics.timeouts++;
+            break;
+
+        case STATUS_CRC_ERROR:
+            _rf_statistics.crc_errors++;
+            break;
+
+        case STATUS_PARITY_ERROR:
+            _rf_statistics.parity_errors++;
+            break;
+
+        case STATUS_FRAMING_ERROR:
+            _rf_statistics.framing_errors++;
+            break;
+
+        case STATUS_BIT_COUNT_ERROR:
+        case STATUS_BIT_COLLISION:
+            _rf_statistics.collisions++;
+            break;
+
+        default:
+            _rf_statistics.other_errors++;
+            break;
+    }
+
+    return false;
+};
+
+unsigned char PN532::exchange_status() {
+    // The Status of the last DATA_EXCHANGE; MORE_INFORMATION is set in it if the tag has more data to send
+    return _exchange_status;
+};
+
+bool PN532::set_bit_rates(unsigned char card_number, unsigned char to_card, unsigned char from_card) {
+    /*
+        Change the bit rates of the exchanges with the activated tag with logical number `card_number`, each one of the BIT_RATE_
+        values; the PN532 sends an ISO14443-4 tag the PPS request [Section 5.3 (ISO-4)]. Both must be ones the tag supports.
+
+        Command format is;
+
+        PSL Tg BRit BRti
+
+        BRit    = bit rate from the PN532 to the tag
+        BRti    = bit rate from the tag to the PN532
+
+        Response is OPCODE+1 Status; Status = 0 on success [Section 7.3.7 (PN532UM)]
+    */
+
+    if (!issue_command(PSL, card_number, to_card, from_card)) {
+        return false;
+    }
+
+    PN532_Response response;
+    if (!read_response(&response)) {
+        return false;
+    }
+
+    return (response.length == 2) && (response.data[0] == PSL + 1) && (response.data[1] & STATUS_ERROR_MASK) == 0;
+};
+
 MIFARE_Classic_PN532* PN532::get_mifare_classic_card() {
     /*
         Use `detect_card()` to find a MIFARE Classic Card, and return a pointer to a new MIFARE_Classic_PN532 object
     */
 
     unsigned char card_number;
-    unsigned char card_data[8];
+    unsigned char card_data[CARD_DATA_SIZE];
 
     if (!detect_card(&card_number, card_data)) {
         return nullptr;
@@ -369,6 +1049,51 @@ MIFARE_Classic_PN532* PN532::get_mifare_classic_card() {
     }
 };
 
+ISO_DEP_PN532* PN532::get_iso_dep_card() {
+    /*
+        Use `detect_card()` to find an ISO14443-4 card, having it sent RATS, and return a pointer to a new ISO_DEP_PN532 object;
+        a null pointer if no card was found, or it is not ISO14443-4 compliant. The parameters are left at PROFILE_ISO_DEP.
+    */
+
+    unsigned char card_number;
+    unsigned char card_data[CARD_DATA_SIZE];
+
+    if (!set_parameters(PROFILE_ISO_DEP) || !detect_card(&card_number, card_data)) {
+        return nullptr;
+    }
+
+    // The ATS length follows the UID; 0 if the card sent none
+    if (!(card_data[SAK_IDX] & 0b100000) || card_data[UID_START_IDX + card_data[UID_LEN_IDX]] == 0) {
+        return nullptr;
+    }
+
+    return new ISO_DEP_PN532(this, card_number, card_data);
+};
+
+unsigned long PN532::checksum_errors() {
+    // Response frames that arrived failing their start code, LCS, or DCS, whether or not they were recovered
+    return _checksum_errors;
+};
+
+unsigned long PN532::nack_recoveries() {
+    // Responses read intact after one or more NACKs
+    return _nack_recoveries;
+};
+
+void PN532::reset_error_counters() {
+    _checksum_errors = 0;
+    _nack_recoveries = 0;
+};
+
+PN532_RF_Statistics* PN532::rf_statistics() {
+    // Since `reset_rf_statistics()`, e.g. per scan session
+    return &_rf_statistics;
+};
+
+void PN532::reset_rf_statistics() {
+    memset(&_rf_statistics, 0, sizeof(_rf_statistics));
+};
+
 /*
     MIFARE_Classic_PN532
 */
@@ -376,8 +1101,13 @@ MIFARE_Classic_PN532* PN532::get_mifare_classic_card() {
 MIFARE_Classic_PN532::MIFARE_Classic_PN532(PN532* pn532_pcd, unsigned char* uid, int length) {
     _pcd = pn532_pcd;
 
+    // Keep a copy; `uid` is usually in the caller's `card_data`, gone once `get_mifare_classic_card()` returns
+    if (length > MAX_UID_LENGTH) {
+        length = MAX_UID_LENGTH;
+    }
+
     _uid_length = length;
-    _uid = uid;
+    memcpy(_uid, uid, length);
 };
 
 bool MIFARE_Classic_PN532::issue_command_from_array(unsigned char* command_array, int length) {
@@ -395,15 +1125,17 @@ bool MIFARE_Classic_PN532::receive_command_response(unsigned char* response_buff
         If the command executed successfully, Status = 0 [Section 7.1 (PN532UM)]
     */
 
-    response_buffer -= (FRAME_HEADER_SIZE + 2); // To accomodate the frame header, OPCODE+1, and Status bytes
-    if (!_pcd->receive_command_response(response_buffer, FRAME_HEADER_SIZE + 2 + length + FRAME_TRAILER_SIZE, true, true)) {
+    PN532_Response response;
+    if (!_pcd->read_response(&response)) {
         return false;
     }
 
-    if (response_buffer[7] != 0) {
+    if (response.length < 2 || !_pcd->check_exchange_status(response.data[1]) || response.length < 2 + length) {
         return false;
     }
-    
+
+    memcpy(response_buffer, response.data + 2, length);
+
     return true;
 };
 
@@ -412,17 +1144,13 @@ bool MIFARE_Classic_PN532::executed_successfully() {
         Read just two bytes and see if Status = 0; use when no bytes sent by the MIFARE Classic Card are sent back to the host
     */
 
-    unsigned char response[FRAME_HEADER_SIZE + 2 + FRAME_TRAILER_SIZE];
-    if (!_pcd->receive_command_response(response, FRAME_HEADER_SIZE + 2 + FRAME_TRAILER_SIZE, true, true)) {
+    PN532_Response response;
+    if (!_pcd->read_response(&response)) {
         return false;
     }
 
-    if (response[7] != 0) {
-        return false;
-    }
-    
-    return true;
-}
+    return (response.length >= 2) && _pcd->check_exchange_status(response.data[1]);
+};
 
 bool MIFARE_Classic_PN532::authenticate_block(unsigned char authentication_type, unsigned char block_address, unsigned char* key) {
     /*
@@ -440,7 +1168,7 @@ bool MIFARE_Classic_PN532::authenticate_block(unsigned char authentication_type,
         UID[0] ... UID[3]   = 4-byte UID of the card; already stored in `_uid`
     */
 
-    unsigned char command_array[14];
+    unsigned char* command_array = _pcd->command_buffer();
 
     command_array[0] = DATA_EXCHANGE;
     command_array[1] = 1;
@@ -450,7 +1178,7 @@ bool MIFARE_Classic_PN532::authenticate_block(unsigned char authentication_type,
     memcpy(command_array + 4, key, 6);
     memcpy(command_array + 10, _uid, 4);
 
-    if (!_pcd->issue_command_from_array(command_array, 14)) {
+    if (!_pcd->issue_buffered_command(14)) {
         return false;
     }
 
@@ -483,6 +1211,28 @@ bool MIFARE_Classic_PN532::read_block(unsigned char block_address, unsigned char
     return true;
 };
 
+unsigned char* MIFARE_Classic_PN532::read_block(unsigned char block_address) {
+    /*
+        As above, without copying the contents; returns a pointer to the 16 bytes in the PN532's frame arena, valid until the next
+        command is issued, or `nullptr` if the block could not be read
+    */
+
+    if (!_pcd->issue_command(DATA_EXCHANGE, 1, READ_BLOCK, block_address)) {
+        return nullptr;
+    }
+
+    PN532_Response response;
+    if (!_pcd->read_response(&response)) {
+        return nullptr;
+    }
+
+    if (response.length < 2 || !_pcd->check_exchange_status(response.data[1]) || response.length < 2 + 16) {
+        return nullptr;
+    }
+
+    return response.data + 2;
+};
+
 bool MIFARE_Classic_PN532::write_block(unsigned char block_address, unsigned char* contents) {
     /*
         Write the 16 bytes of data specified in `contents` to the block at `block_address`
@@ -497,19 +1247,199 @@ bool MIFARE_Classic_PN532::write_block(unsigned char block_address, unsigned cha
         Byte[0] ... Byte[15]    = 16 bytes of data to be written to the block
     */
 
-    unsigned char command_array[20];
+    unsigned char* command_array = _pcd->command_buffer();
+
+    // `contents` may be a block just read, still in the frame arena, so it is moved in place before anything is written over it
+    memmove(command_array + 4, contents, 16);
 
     command_array[0] = DATA_EXCHANGE;
     command_array[1] = 1;
     command_array[2] = WRITE_BLOCK;
     command_array[3] = block_address;
 
-    memcpy(command_array + 4, contents, 16);
-
-    if (!_pcd->issue_command_from_array(command_array, 20)) {
+    if (!_pcd->issue_buffered_command(20)) {
         return false;
     }
 
     // Nothing received from the PICC is sent back to the host, simply check the Status byte
     return executed_successfully();
-};
\ No newline at end of file
+};
+
+/*
+    ISO_DEP_PN532
+*/
+
+// FSC, the longest frame the card accepts, by FSCI; FSCI 9 to 15 are reserved, and taken as 256 [Section 5.2.3 (ISO-4)]
+static const int FRAME_SIZES[9] = {16, 24, 32, 40, 48, 64, 96, 128, 256};
+
+static unsigned char fastest_bit_rate(unsigned char supported, unsigned char max_bit_rate) {
+    // The fastest bit rate in `supported` (bit 0 for 212 kbps, bit 1 for 424 kbps, bit 2 for 848 kbps) up to `max_bit_rate`
+    for (unsigned char bit_rate = max_bit_rate; bit_rate > BIT_RATE_106; bit_rate--) {
+        if (supported & (1 << (bit_rate - 1))) {
+            return bit_rate;
+        }
+    }
+
+    return BIT_RATE_106;
+};
+
+ISO_DEP_PN532::ISO_DEP_PN532(PN532* pn532_pcd, unsigned char card_number, unsigned char* card_data) {
+    /*
+        `card_number` and `card_data` are as `detect_card()` found them, the ATS included
+    */
+
+    _pcd = pn532_pcd;
+    _card_number = card_number;
+
+    _fsci = DEFAULT_FSCI;
+    _ta = DEFAULT_TA;
+    _tb = DEFAULT_TB;
+    _tc = DEFAULT_TC;
+
+    // The ATS length follows the UID, then the ATS, from T0
+    int ats_length = card_data[UID_START_IDX + card_data[UID_LEN_IDX]];
+    unsigned char* ats = card_data + UID_START_IDX + card_data[UID_LEN_IDX] + 1;
+
+    if (ats_length > 0) {
+        unsigned char t0 = ats[ATS_T0_IDX];
+        int position = ATS_T0_IDX + 1;
+
+        _fsci = t0 & ATS_FSCI_MASK;
+
+        // Each interface byte is only there if T0 says so, in this order
+        if ((t0 & ATS_TA_PRESENT) && position < ats_length) {
+            _ta = ats[position++];
+        }
+
+        if ((t0 & ATS_TB_PRESENT) && position < ats_length) {
+            _tb = ats[position++];
+        }
+
+        if ((t0 & ATS_TC_PRESENT) && position < ats_length) {
+            _tc = ats[position++];
+        }
+    }
+
+    /*
+        The PN532 splits what it is given into I-blocks of up to FSC bytes, chaining them [Section 7.5.2 (ISO-4)], and it is
+        given at most PN532_MAX_DATA_SIZE - 2 bytes at a time. Sending a whole number of I-blocks each time, rather than as much
+        as fits, keeps it from sending a short I-block at the end of every piece.
+    */
+
+    int block_data = frame_size() - ISO_DEP_BLOCK_OVERHEAD;
+    int max_chunk = PN532_MAX_DATA_SIZE - 2;
+
+    _chunk_size = (block_data < max_chunk) ? (max_chunk / block_data) * block_data : max_chunk;
+
+    _bit_rate_to_card = BIT_RATE_106;
+    _bit_rate_from_card = BIT_RATE_106;
+};
+
+int ISO_DEP_PN532::transceive(unsigned char* apdu, int length, unsigned char* response, int max_response_length) {
+    /*
+        Send the command APDU of `length` bytes in `apdu` to the card, and place the response APDU, status word included, in
+        `response`, which holds `max_response_length` bytes; returns its length, or -1 if the exchange failed, or the response
+        does not fit.
+
+        An APDU longer than `chunk_size()` is sent in pieces, each but the last with MORE_INFORMATION set in Tg, and a response
+        the PN532 could not hold at once is asked for again, with an empty DATA_EXCHANGE, for as long as MORE_INFORMATION is set
+        in its Status [Section 7.3.8 (PN532UM)]. The response is read straight into `response`, in pieces of up to the 262 bytes
+        the PN532 holds, so it need not fit in the frame arena.
+    */
+
+    int sent = 0;
+
+    while (length - sent > _chunk_size) {
+        if (_pcd->data_exchange(_card_number | MORE_INFORMATION, apdu + sent, _chunk_size, response, max_response_length) < 0) {
+            return -1;
+        }
+
+        sent += _chunk_size;
+    }
+
+    int received = 0;
+    unsigned char* piece = apdu + sent;
+    int piece_length = length - sent;
+
+    do {
+        int answer_length = _pcd->data_exchange(_card_number, piece, piece_length, response + received,
+                                                max_response_length - received);
+
+        if (answer_length < 0) {
+            return -1;
+        }
+
+        received += answer_length;
+
+        // Nothing more is sent while the rest of the response is fetched
+        piece_length = 0;
+    } while (_pcd->exchange_status() & MORE_INFORMATION);
+
+    return received;
+};
+
+bool ISO_DEP_PN532::negotiate_bit_rate(unsigned char max_bit_rate) {
+    /*
+        Switch to the fastest bit rates, each way, that both the card (by TA) and the PN532 (up to `max_bit_rate`) support;
+        returns `false` if the card or the PN532 refused, in which case the bit rates are left as they were. Nothing is sent if
+        there is nothing faster than 106 kbps to go to. To be done once, before the exchanges it is to speed up; the card only
+        accepts PPS right after its ATS [Section 5.3 (ISO-4)].
+    */
+
+    unsigned char to_card_rates = (_ta >> TA_DR_SHIFT) & 0x07;
+    unsigned char from_card_rates = (_ta >> TA_DS_SHIFT) & 0x07;
+
+    if (_ta & TA_SAME_D_ONLY) {
+        to_card_rates &= from_card_rates;
+        from_card_rates = to_card_rates;
+    }
+
+    unsigned char to_card = fastest_bit_rate(to_card_rates, max_bit_rate);
+    unsigned char from_card = fastest_bit_rate(from_card_rates, max_bit_rate);
+
+    if (to_card == _bit_rate_to_card && from_card == _bit_rate_from_card) {
+        return true;
+    }
+
+    if (!_pcd->set_bit_rates(_card_number, to_card, from_card)) {
+        return false;
+    }
+
+    _bit_rate_to_card = to_card;
+    _bit_rate_from_card = from_card;
+
+    return true;
+};
+
+int ISO_DEP_PN532::frame_size() {
+    // FSC, the longest frame the card accepts, in bytes
+    return FRAME_SIZES[(_fsci < 8) ? _fsci : 8];
+};
+
+int ISO_DEP_PN532::chunk_size() {
+    // The most APDU bytes given to the PN532 in one DATA_EXCHANGE
+    return _chunk_size;
+};
+
+unsigned long ISO_DEP_PN532::frame_waiting_time() {
+    // FWT, how long the card may take to answer, in microseconds; FWI 15 is reserved, and taken as 4 [Section 7.2 (ISO-4)]
+    unsigned char fwi = _tb >> TB_FWI_SHIFT;
+
+    return (unsigned long)(ISO_DEP_FWT_UNIT) << ((fwi < 15) ? fwi : 4);
+};
+
+unsigned char ISO_DEP_PN532::bit_rate_to_card() {
+    return _bit_rate_to_card;
+};
+
+unsigned char ISO_DEP_PN532::bit_rate_from_card() {
+    return _bit_rate_from_card;
+};
+
+bool ISO_DEP_PN532::nad_supported() {
+    return _tc & TC_NAD_SUPPORTED;
+};
+
+bool ISO_DEP_PN532::cid_supported() {
+    return _tc & TC_CID_SUPPORTED;
+};
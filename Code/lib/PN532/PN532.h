@@ -10,7 +10,7 @@
 
     
     Provides an interface to communicate with NXP's PN532 RFID module over SPI, and authenticate, read, and write blocks of MIFARE
-    Classic Cards.
+    Classic Cards, and exchange APDUs with ISO14443-4 (ISO-DEP) cards, such as MIFARE DESFire.
 
     The following sources were referenced.
 
@@ -20,6 +20,7 @@
     https://www.nxp.com/docs/en/user-guide/141520.pdf [PN532UM]
     https://www.nxp.com/docs/en/nxp/data-sheets/PN532_C1.pdf [PN532DS]
     http://www.emutag.com/iso/14443-3.pdf [ISO-3]
+    http://www.emutag.com/iso/14443-4.pdf [ISO-4]
 
     https://www.nxp.com/docs/en/data-sheet/MF1S50YYX_V1.pdf
 */
@@ -63,16 +64,188 @@
 #define UID_LEN_IDX             3
 #define UID_START_IDX           4
 
+// Longest `card_data` filled in by `detect_card()`; ATQA, SAK, UID length, a triple size UID, ATS length, and the ATS
+#define MAX_ATS_LENGTH          32
+#define CARD_DATA_SIZE          (UID_START_IDX + 10 + 1 + MAX_ATS_LENGTH)
+
+#ifndef MAX_UID_LENGTH
+#define MAX_UID_LENGTH          10 // Triple size UID
+#endif
+
+// Waiting for the PN532, in milliseconds
+#define PN532_READY_TIMEOUT         1000 // For a response
+#define PN532_ACK_TIMEOUT           50 // For an ACK, which comes within a millisecond; a PN532 that sends none is not answering
+#ifndef PN532_POLL_INTERVAL
+#define PN532_POLL_INTERVAL         1 // Between polls of the status byte; a response is picked up within as long of being ready
+#endif
+#define PN532_WAKE_UP_TIME          2 // NSS held low, for the PN532 to leave power down and start its oscillator
+#define PN532_BOOT_TIMEOUT          100 // For the PN532 to answer at all, after power up or a fault
+#define PN532_PROBE_TIMEOUT         10 // For the ACK of each probe while booting
+
+// NSS timing, in microseconds; the SPI timing of the datasheet asks for well under a microsecond either side of a
+// transaction, so these leave margin. Whether the PN532 is ready is polled for with the status byte, not waited out.
+// [Section 8.3.5 (PN532DS)]
+#define PN532_NSS_SETUP_TIME        2 // From NSS going low to the first clock
+#define PN532_NSS_HOLD_TIME         2 // NSS high after a transaction, before the next can start
+
+// SET_PARAMETERS Flags [Section 7.2.9 (PN532UM)]
+#define PARAMETER_NAD_USED          0x01
+#define PARAMETER_DID_USED          0x02
+#define PARAMETER_AUTO_ATR_RES      0x04 // Send ATR_REQ to NFCIP-1 targets during activation
+#define PARAMETER_AUTO_RATS         0x10 // Send RATS to ISO14443-4 tags during activation, and return their ATS
+#define PARAMETER_ISO14443_4_PICC   0x20 // Emulate the ISO14443-4 layer when the PN532 is a target
+#define PARAMETER_REMOVE_PRE_POST   0x40
+
+// Parameter profiles, one per scan mode; the PN532 starts with PROFILE_ISO_DEP. For an inventory, where only the UID and the
+// MIFARE Classic or Type 2 blocks are wanted, the activation of an ISO14443-4 tag stops at its SAK, saving the RATS exchange and
+// the ATS bytes on the bus.
+#define PROFILE_INVENTORY           0x00
+#define PROFILE_ISO_DEP             (PARAMETER_AUTO_RATS | PARAMETER_AUTO_ATR_RES)
+#define PROFILE_UNKNOWN             0xFF // Bit 7 is reserved, so no profile sent matches it
+
+// RF_CONFIGURATION Items [Section 7.3.1 (PN532UM)]
+#define RF_FIELD_ITEM           0x01
+#define MAX_RETRIES_ITEM        0x05
+#define ANALOG_106_A_ITEM       0x0A // Analog settings of the receiver and transmitter, for ISO14443A at 106 kbps
+
+// ANALOG_106_A_ITEM ConfigurationData; CIU_RFCfg, CIU_GsNOn, CIU_CWGsP, CIU_ModGsP, CIU_DemodWhenRfOn, CIU_RxThreshold,
+// CIU_DemodWhenRfOff, CIU_GsNOff, CIU_ModWidth, CIU_MifNFC, CIU_TxBitPhase; loaded into the CIU every time the field is switched
+// on for ISO14443A, so settings written straight to the registers do not last [Section 7.3.1 (PN532UM)]
+#define ANALOG_SETTINGS_SIZE    11
+#define ANALOG_RF_CFG_IDX       0
+#define ANALOG_RX_THRESHOLD_IDX 5
+
+const unsigned char ANALOG_106_A_DEFAULTS[ANALOG_SETTINGS_SIZE] = {0x59, 0xF4, 0x3F, 0x11, 0x4D, 0x85, 0x61, 0x6F, 0x26, 0x62, 0x87};
+
+// CIU Registers [Section 8.6.23 (PN532DS)]
+#define CIU_RX_THRESHOLD        0x6308 // MinLevel in bits 7 ... 4, CollLevel in bits 2 ... 0
+#define CIU_RF_CFG              0x6316 // RxGain in bits 6 ... 4, RFLevel in bits 3 ... 0
+#define CIU_ERROR               0x6336
+
+// CIU_Error Bits
+#define CIU_PROTOCOL_ERR        0
+#define CIU_PARITY_ERR          1
+#define CIU_CRC_ERR             2
+#define CIU_COLL_ERR            3
+#define CIU_BUFFER_OVFL         4
+#define CIU_TEMP_ERR            6
+
+// Receiver settings swept by `tune_receiver()`; the gains 0 and 1 repeat 2 and 3, 18 and 23 dB, and the defaults are 5 (38 dB)
+// and 8
+#define RX_GAIN_FIRST           2
+#define RX_GAIN_LAST            7
+#define MIN_LEVEL_FIRST         4
+#define MIN_LEVEL_LAST          12
+#define MIN_LEVEL_STEP          4
+#define DEFAULT_RX_GAIN         ((ANALOG_106_A_DEFAULTS[ANALOG_RF_CFG_IDX] >> 4) & 0x07)
+#define DEFAULT_MIN_LEVEL       (ANALOG_106_A_DEFAULTS[ANALOG_RX_THRESHOLD_IDX] >> 4)
+
+// Error Codes in the Status byte of DATA_EXCHANGE [Section 7.1 (PN532UM)]
+#define STATUS_ERROR_MASK       0x3F // Bit 6 is MI, bit 7 is NAD
+#define STATUS_TIMEOUT          0x01
+#define STATUS_CRC_ERROR        0x02
+#define STATUS_PARITY_ERROR     0x03
+#define STATUS_BIT_COUNT_ERROR  0x04
+#define STATUS_FRAMING_ERROR    0x05
+#define STATUS_BIT_COLLISION    0x06
+
+// Bit 6 of Tg in DATA_EXCHANGE, and of its Status; more data follows, in the next DATA_EXCHANGE [Section 7.3.8 (PN532UM)]
+#define MORE_INFORMATION        0x40
+
+// ATS, after TL; T0, then TA, TB and TC if T0 says they are present, then the historical bytes [Section 5.2 (ISO-4)]
+#define ATS_T0_IDX              0
+#define ATS_TA_PRESENT          0x10
+#define ATS_TB_PRESENT          0x20
+#define ATS_TC_PRESENT          0x40
+#define ATS_FSCI_MASK           0x0F
+
+// TA; the bit rates the card supports, from the card (DS) and to it (DR), besides 106 kbps
+#define TA_SAME_D_ONLY          0x80 // The same bit rate both ways
+#define TA_DS_SHIFT             4
+#define TA_DR_SHIFT             0 // Bit 0 is 212 kbps, bit 1 424 kbps, and bit 2 848 kbps, in either
+
+// TB; the frame waiting time is 2^FWI * 4096 / fc, 302 microseconds times 2^FWI, and the start-up frame guard time likewise
+#define TB_FWI_SHIFT            4
+#define TB_SFGI_MASK            0x0F
+
+// TC
+#define TC_NAD_SUPPORTED        0x01
+#define TC_CID_SUPPORTED        0x02
+
+// What a card that leaves TA, TB or TC out means [Section 5.2.4 - 5.2.6 (ISO-4)]
+#define DEFAULT_TA              0x00 // 106 kbps only
+#define DEFAULT_TB              0x40 // FWI 4, SFGI 0
+#define DEFAULT_TC              TC_CID_SUPPORTED
+#define DEFAULT_FSCI            2 // 32 bytes
+
+#define ISO_DEP_FWT_UNIT        302 // Microseconds, for FWI 0
+
+// Bit rates, as BRit and BRti of PSL [Section 7.3.7 (PN532UM)]
+#define BIT_RATE_106            0x00
+#define BIT_RATE_212            0x01
+#define BIT_RATE_424            0x02
+#define BIT_RATE_848            0x03
+
+// The PN532 goes up to 424 kbps for ISO14443A as a reader [PN532DS]; a faster bit rate a card offers is not used
+#ifndef ISO_DEP_MAX_BIT_RATE
+#define ISO_DEP_MAX_BIT_RATE    BIT_RATE_424
+#endif
+
+// The PCB and the CRC of each I-block; no CID or NAD, as neither PARAMETER_DID_USED nor PARAMETER_NAD_USED is set
+// [Section 7.1 (ISO-4)]
+#define ISO_DEP_BLOCK_OVERHEAD  3
+
 // Frame, Frame Header, Frame Trailer Sizes
 #define ACK_SIZE                6
 #define NACK_SIZE               6
 #define FRAME_HEADER_SIZE       6 // PREAMBLE ... TFI
 #define FRAME_TRAILER_SIZE      2
 
+// Frame Arena; frames are built and read whole in one static buffer instead of on the stack. Only one frame is in flight on
+// the SPI bus at a time, so every PN532 shares it.
+#ifndef PN532_MAX_DATA_SIZE
+#define PN532_MAX_DATA_SIZE     64 // PD0 ... PDn; the longest response used, LIST_PASSIVE_TARGETS with a full ATS, is 50
+#endif
+#define FRAME_ARENA_SIZE        (FRAME_HEADER_SIZE + PN532_MAX_DATA_SIZE + FRAME_TRAILER_SIZE)
+
+// Extended information frames, which carry up to 264 bytes of data, e.g. 262 bytes of DataIn from an ISO14443-4 tag; LEN and
+// LCS are both 0xFF, and LENM, LENL and their checksum follow them, then TFI [Section 6.2.1.2 (PN532UM)]
+#define EXTENDED_FRAME_MARKER   0xFF
+#define EXTENDED_LENGTH_SIZE    3 // LENL, LCS and TFI, read after the header, whose last byte is LENM
+
+// The bytes of a response kept in the frame arena when the rest is read straight into a buffer of the caller; OPCODE+1 and
+// the Status of DATA_EXCHANGE
+#define RESPONSE_HEAD_SIZE      2
+
+// How many times a response that arrives corrupted is asked for again with a NACK, before the command is given up on
+#ifndef PN532_NACK_RETRIES
+#define PN532_NACK_RETRIES      2
+#endif
+
+// A response read into the frame arena; `data` points at PD0 (OPCODE+1), and stays valid until the next command is issued. Of
+// a response read with a buffer of the caller, only the first RESPONSE_HEAD_SIZE bytes are at `data`, and the rest are in the
+// buffer.
+struct PN532_Response {
+    unsigned char* data;
+    int length;                 // PD0 ... PDn
+};
+
 const unsigned char ACK_FRAME[ACK_SIZE] = {PREAMBLE, STARTCODE1, STARTCODE2, 0x00, 0xFF, POSTAMBLE};
 const unsigned char NACK_FRAME[NACK_SIZE] = {PREAMBLE, STARTCODE1, STARTCODE2, 0xFF, 0x00, POSTAMBLE};
 
+// What went wrong on the RF side, counted from the Status of every DATA_EXCHANGE, at no extra cost on the bus
+struct PN532_RF_Statistics {
+    unsigned long exchanges;
+    unsigned long timeouts;         // The tag did not answer; usually it left the field
+    unsigned long crc_errors;
+    unsigned long parity_errors;
+    unsigned long framing_errors;
+    unsigned long collisions;       // Bit collisions, and wrong bit counts
+    unsigned long other_errors;
+};
+
 class MIFARE_Classic_PN532;
+class ISO_DEP_PN532;
 
 class PN532 {
     public:
@@ -88,8 +261,10 @@ class PN532 {
 
         void make_normal_information_frame(unsigned char* target_frame, unsigned char TFI, unsigned char* bytes, unsigned char num_bytes);
 
-        bool ready_to_respond();
+        bool response_available();
+        bool ready_to_respond(int timeout = PN532_READY_TIMEOUT, int interval = PN532_POLL_INTERVAL);
         bool check_ack();
+        bool check_response_code(unsigned char opcode);
         
         template <typename PN532_Command, typename... PN532_Params>
         bool issue_command(PN532_Command opcode, PN532_Params... params) {
@@ -100,34 +275,142 @@ class PN532 {
             unsigned char data_bytes[] = {(unsigned char)(opcode), (unsigned char)(params)...};
             int length = sizeof(data_bytes) / sizeof(data_bytes[0]);
 
-            // Create a normal information frame by adding the frame header and trailer [Section 6.2.1.1 (PN532UM)]
-            unsigned char normal_information_frame[FRAME_HEADER_SIZE + length + FRAME_TRAILER_SIZE];
-            make_normal_information_frame(normal_information_frame, TFI_HOST_TO_PN532, data_bytes, length);
-
-            if (!write_frame(normal_information_frame, FRAME_HEADER_SIZE + length + FRAME_TRAILER_SIZE)) {
-                return false;
-            }
-            
-            if (!ready_to_respond()) {
-                return false;
-            }
-
-            return check_ack();
+            // The frame header and trailer are added in the frame arena [Section 6.2.1.1 (PN532UM)]
+            return issue_command_from_array(data_bytes, length);
         };
 
         bool issue_command_from_array(unsigned char* command_array, int length);
-        
+
+        unsigned char* command_buffer();
+        bool issue_buffered_command(int length);
+
+        bool read_response(PN532_Response* response);
+        bool read_response(PN532_Response* response, unsigned char* tail, int max_tail_length);
+        bool send_nack();
         bool receive_command_response(unsigned char* response_buffer, int length, bool start = false, bool conclude = false);
 
+        bool wake_up(unsigned long timeout = PN532_BOOT_TIMEOUT);
+        unsigned long firmware_version();
+
         bool SAMConfig();
+        bool set_parameters(unsigned char flags);
+        unsigned char parameters();
+
+        bool read_registers(const unsigned int* addresses, int count, unsigned char* values);
+        bool write_registers(const unsigned int* addresses, const unsigned char* values, int count);
+        bool read_rf_errors(unsigned char* ciu_error);
+
+        bool set_rf_field(bool on);
+        bool set_passive_activation_retries(unsigned char retries);
+        bool set_receiver(unsigned char rx_gain, unsigned char min_level);
+        bool restore_receiver();
+        unsigned char rx_gain();
+        unsigned char min_level();
+
+        template <typename trial_function>
+        bool tune_receiver(int trials, trial_function trial, unsigned char* rx_gain, unsigned char* min_level, int* successes) {
+            /*
+                Sweep the receiver gain and the minimum signal level the receiver accepts, against a reference tag held in
+                the field, and keep the setting with the most successful reads; metal racking detunes the antenna, and what
+                suits one forklift may not suit another
+
+                `trial(PN532* pn532)` makes one read of the reference tag, e.g. a detection and a block read, and returns `true`
+                if it succeeded; it is called `trials` times per setting. The defaults are tried first, and only replaced by a
+                setting that does strictly better; the sweep stops early once a setting succeeds every time. The setting kept
+                is placed in `rx_gain` and `min_level`, and the successful reads with it in `successes`. Returns `false` if it
+                could not be applied, or no read succeeded.
+            */
+
+            *rx_gain = DEFAULT_RX_GAIN;
+            *min_level = DEFAULT_MIN_LEVEL;
+            *successes = try_receiver(*rx_gain, *min_level, trials, trial);
+
+            for (int gain = RX_GAIN_FIRST; gain <= RX_GAIN_LAST && *successes < trials; gain++) {
+                for (int level = MIN_LEVEL_FIRST; level <= MIN_LEVEL_LAST && *successes < trials; level += MIN_LEVEL_STEP) {
+                    if (gain == DEFAULT_RX_GAIN && level == DEFAULT_MIN_LEVEL) {
+                        continue;
+                    }
+
+                    int count = try_receiver(gain, level, trials, trial);
+
+                    if (count > *successes) {
+                        *rx_gain = gain;
+                        *min_level = level;
+                        *successes = count;
+                    }
+                }
+            }
+
+            return set_receiver(*rx_gain, *min_level) && *successes > 0;
+        };
+
+        template <typename trial_function>
+        int try_receiver(unsigned char rx_gain, unsigned char min_level, int trials, trial_function trial) {
+            // The successful reads out of `trials` with the given receiver setting, or -1 if it could not be applied
+            if (!set_receiver(rx_gain, min_level)) {
+                return -1;
+            }
+
+            int successes = 0;
+
+            for (int i = 0; i < trials; i++) {
+                if (trial(this)) {
+                    successes++;
+                }
+            }
 
+            return successes;
+        };
+
+        bool request_card_detection();
+        bool read_card_detection(unsigned char* card_number, unsigned char* card_data);
         bool detect_card(unsigned char* card_number, unsigned char* card_data);
+
+        bool select_target(unsigned char card_number);
+        int data_exchange(unsigned char card_number, unsigned char* data, int length, unsigned char* response, int max_response_length);
+        int data_exchange(unsigned char card_number, unsigned char* data, int length, unsigned char** response);
+        bool check_exchange_status(unsigned char status);
+        unsigned char exchange_status();
+
+        bool set_bit_rates(unsigned char card_number, unsigned char to_card, unsigned char from_card);
         
         MIFARE_Classic_PN532* get_mifare_classic_card();
+        ISO_DEP_PN532* get_iso_dep_card();
+
+        // Counters of corrupted responses; cleared by `reset_error_counters()`
+        unsigned long checksum_errors();
+        unsigned long nack_recoveries();
+        void reset_error_counters();
+
+        PN532_RF_Statistics* rf_statistics();
+        void reset_rf_statistics();
 
     private:
+        bool read_response_frame(PN532_Response* response, bool* corrupted, unsigned char* tail, int max_tail_length);
+        bool drain_response_frame(int length);
+
+        bool issue_data_exchange(unsigned char card_number, unsigned char* data, int length);
+        int data_exchange_answer(PN532_Response* frame);
+
         Pin _NSS;
         SPI_Master _spi;
+
+        unsigned long _checksum_errors;
+        unsigned long _nack_recoveries;
+
+        PN532_RF_Statistics _rf_statistics;
+
+        unsigned char _parameters;
+
+        // The receiver setting last made with `set_receiver()`, made again by `restore_receiver()`
+        unsigned char _rx_gain;
+        unsigned char _min_level;
+
+        unsigned long _firmware_version;
+
+        unsigned char _exchange_status;
+
+        static unsigned char _frame_arena[FRAME_ARENA_SIZE];
 };
 
 
@@ -165,13 +448,46 @@ class MIFARE_Classic_PN532 {
 
         bool authenticate_block(unsigned char authentication_type, unsigned char block_address, unsigned char* key);
         bool read_block(unsigned char block_address, unsigned char* contents);
+        unsigned char* read_block(unsigned char block_address);
         bool write_block(unsigned char block_address, unsigned char* contents);
 
     private:
         PN532* _pcd;
         
-        unsigned char* _uid;
+        unsigned char _uid[MAX_UID_LENGTH];
         int _uid_length;
 };
 
+
+class ISO_DEP_PN532 {
+    public:
+        ISO_DEP_PN532(PN532* pn532_pcd, unsigned char card_number, unsigned char* card_data);
+
+        int transceive(unsigned char* apdu, int length, unsigned char* response, int max_response_length);
+        bool negotiate_bit_rate(unsigned char max_bit_rate = ISO_DEP_MAX_BIT_RATE);
+
+        int frame_size();
+        int chunk_size();
+        unsigned long frame_waiting_time();
+        unsigned char bit_rate_to_card();
+        unsigned char bit_rate_from_card();
+        bool nad_supported();
+        bool cid_supported();
+
+    private:
+        PN532* _pcd;
+        unsigned char _card_number;
+
+        // From the ATS, or its defaults
+        unsigned char _fsci;
+        unsigned char _ta;
+        unsigned char _tb;
+        unsigned char _tc;
+
+        int _chunk_size;
+
+        unsigned char _bit_rate_to_card;
+        unsigned char _bit_rate_from_card;
+};
+
 #endif
\ No newline at end of file
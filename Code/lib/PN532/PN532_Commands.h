@@ -33,5 +33,7 @@
 
 #define LIST_PASSIVE_TARGETS    0x4A
 #define DATA_EXCHANGE           0x40
+#define SELECT_TARGET           0x54
+#define PSL                     0x4E
 
 #endif
\ No newline at end of file
@@ -0,0 +1,128 @@
+/*
+    PalletCache.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Keeps the pallet records last read, keyed by the UID of the tag, so that a pallet that passes the forklift again is not read
+    in full again.
+*/
+
+#include "PalletCache.h"
+
+#include "string.h"
+
+PalletCache::PalletCache() {
+    _count = 0;
+    _uses = 0;
+
+    _hits = 0;
+    _misses = 0;
+
+    for (int i = 0; i < PALLET_CACHE_CAPACITY; i++) {
+        _entries[i].uid_length = 0;
+    }
+};
+
+bool PalletCache::lookup(unsigned char* uid, unsigned char uid_length, PalletRecord* record, int* slot) {
+    /*
+        Place the record cached for the tag with the given UID in `record`, and the slot it was current in on the tag in `slot`;
+        returns `false` if there is none
+    */
+
+    int index = find(uid, uid_length);
+
+    if (index < 0) {
+        return false;
+    }
+
+    Entry* entry = &_entries[index];
+    entry->last_used = ++_uses;
+
+    *record = entry->record;
+    *slot = entry->slot;
+
+    return true;
+};
+
+void PalletCache::store(unsigned char* uid, unsigned char uid_length, PalletRecord* record, int slot) {
+    /*
+        Keep `record`, current in `slot` of the tag with the given UID, e.g. as just read or written; if the cache is full, the
+        record used longest ago is dropped to make room
+    */
+
+    if (uid_length == 0 || uid_length > MAX_UID_LENGTH) {
+        return;
+    }
+
+    int index = find(uid, uid_length);
+
+    if (index < 0) {
+        if (_count < PALLET_CACHE_CAPACITY) {
+            index = _count++;
+        } else {
+            index = 0;
+
+            for (int i = 1; i < PALLET_CACHE_CAPACITY; i++) {
+                if (_uses - _entries[i].last_used > _uses - _entries[index].last_used) {
+                    index = i;
+                }
+            }
+        }
+    }
+
+    Entry* entry = &_entries[index];
+
+    memcpy(entry->uid, uid, uid_length);
+    entry->uid_length = uid_length;
+    entry->record = *record;
+    entry->slot = slot;
+    entry->last_used = ++_uses;
+};
+
+void PalletCache::forget(unsigned char* uid, unsigned char uid_length) {
+    // Drop the record cached for the tag with the given UID, if any; the next read of the tag reads it in full
+    int index = find(uid, uid_length);
+
+    if (index < 0) {
+        return;
+    }
+
+    // Keep the entries packed at the front
+    _entries[index] = _entries[--_count];
+    _entries[_count].uid_length = 0;
+};
+
+void PalletCache::count_hit() {
+    _hits++;
+};
+
+void PalletCache::count_miss() {
+    _misses++;
+};
+
+unsigned long PalletCache::hits() {
+    return _hits;
+};
+
+unsigned long PalletCache::misses() {
+    return _misses;
+};
+
+unsigned char PalletCache::count() {
+    // Records cached
+    return _count;
+};
+
+int PalletCache::find(unsigned char* uid, unsigned char uid_length) {
+    for (int i = 0; i < _count; i++) {
+        if (_entries[i].uid_length == uid_length && memcmp(_entries[i].uid, uid, uid_length) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+};
@@ -0,0 +1,145 @@
+/*
+    PalletCache.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Keeps the pallet records last read, keyed by the UID of the tag, so that a pallet that passes the forklift again is not read
+    in full again. The same pallets pass the same forklift many times per shift.
+
+    A record on the tag is only ever rewritten through the slot that is not current (see `PalletRecord.h`), with the next
+    sequence number. So if the other slot holds a valid record no newer than the one cached, nothing has been written since,
+    and the cached record is still the current one; one read of a slot instead of two, after the authentication of a MIFARE
+    Classic card. The same holds if the other slot is blank, never written, as on a tag written once. If it holds a newer
+    record, or data that is not a valid record, the cached slot is read as well, and the newer of the two is taken, as
+    `find_pallet_record()` would; a write to the other slot may have torn after another had landed in the cached slot, so a
+    torn other slot says nothing about the cached one. A tag left with no valid record is dropped from the cache. A record
+    written to the tag other than as a transaction, in place, goes unnoticed until its entry is evicted.
+
+    The records are few, so they are kept in a small array and searched linearly; when it is full, the one used longest ago
+    makes room.
+*/
+
+#ifndef PALLET_CACHE_H
+#define PALLET_CACHE_H
+
+#include "PalletRecord.h"
+
+#ifndef MAX_UID_LENGTH
+#define MAX_UID_LENGTH              10 // Triple size UID
+#endif
+
+#ifndef PALLET_CACHE_CAPACITY
+#define PALLET_CACHE_CAPACITY       8 // Maximum number of records kept at once
+#endif
+
+class PalletCache {
+    public:
+        PalletCache();
+
+        bool lookup(unsigned char* uid, unsigned char uid_length, PalletRecord* record, int* slot);
+        void store(unsigned char* uid, unsigned char uid_length, PalletRecord* record, int slot);
+        void forget(unsigned char* uid, unsigned char uid_length);
+
+        // Counters; reads served from the cache, and reads of the whole record
+        void count_hit();
+        void count_miss();
+        unsigned long hits();
+        unsigned long misses();
+        unsigned char count();
+
+    private:
+        struct Entry {
+            unsigned char uid[MAX_UID_LENGTH];
+            unsigned char uid_length; // 0 marks an empty entry
+            PalletRecord record;
+            unsigned char slot;
+            unsigned long last_used;
+        };
+
+        int find(unsigned char* uid, unsigned char uid_length);
+
+        Entry _entries[PALLET_CACHE_CAPACITY];
+        unsigned char _count;
+        unsigned long _uses;
+
+        unsigned long _hits;
+        unsigned long _misses;
+};
+
+template <typename Reader_Impl>
+bool read_pallet_record(Reader_Impl* reader, ReaderTag* tag, unsigned char* key, PalletCache* cache, PalletRecord* record) {
+    /*
+        As `read_pallet_record()`, reading only the slot a rewrite would have gone to when the tag's record is in `cache`, and
+        keeping what is read in `cache`
+    */
+
+    PalletRecord cached;
+    int cached_slot;
+
+    if (!cache->lookup(tag->uid, tag->uid_length, &cached, &cached_slot)) {
+        cache->count_miss();
+
+        int slot = find_pallet_record(reader, tag, key, record);
+
+        if (slot >= 0) {
+            cache->store(tag->uid, tag->uid_length, record, slot);
+        }
+
+        return slot >= 0;
+    }
+
+    if (pallet_tag_is_classic(tag) && !reader->authenticate(tag, READER_KEY_A, PALLET_CLASSIC_BLOCK, key)) {
+        return false;
+    }
+
+    int other_slot = (cached_slot == 0) ? 1 : 0;
+    unsigned char block[PALLET_RECORD_SIZE];
+    PalletRecord other;
+
+    if (!read_pallet_slot(reader, tag, other_slot, block)) {
+        return false;
+    }
+
+    bool other_valid = pallet_record_decode(block, &other);
+
+    // Nothing written since; the other slot holds an older record, or was never written to, as on a tag written only once
+    bool unchanged = other_valid ? !pallet_sequence_newer(other.sequence, cached.sequence) : pallet_slot_blank(block);
+
+    if (unchanged) {
+        cache->count_hit();
+        *record = cached;
+        return true;
+    }
+
+    // Rewritten since; at least once, to the other slot, and maybe back again to the cached one, with a write to the other
+    // slot torn since
+    cache->count_miss();
+
+    PalletRecord again;
+    int slot = other_valid ? other_slot : PALLET_NO_RECORD;
+    *record = other;
+
+    if (!read_pallet_slot(reader, tag, cached_slot, block)) {
+        return false;
+    }
+
+    if (pallet_record_decode(block, &again) && (!other_valid || pallet_sequence_newer(again.sequence, other.sequence))) {
+        slot = cached_slot;
+        *record = again;
+    }
+
+    if (slot == PALLET_NO_RECORD) {
+        cache->forget(tag->uid, tag->uid_length);
+        return false;
+    }
+
+    cache->store(tag->uid, tag->uid_length, record, slot);
+
+    return true;
+};
+
+#endif
@@ -0,0 +1,94 @@
+/*
+    PalletRecord.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    The pallet record; everything needed to route a pallet, packed in one 16-byte block of its tag.
+*/
+
+#include "PalletRecord.h"
+
+static void put_bytes(unsigned char* target, unsigned long value, int num_bytes) {
+    // LSB first
+    for (int i = 0; i < num_bytes; i++) {
+        target[i] = value >> (8 * i);
+    }
+};
+
+static unsigned long get_bytes(unsigned char* source, int num_bytes) {
+    unsigned long value = 0;
+
+    for (int i = num_bytes - 1; i >= 0; i--) {
+        value = (value << 8) | source[i];
+    }
+
+    return value;
+};
+
+void pallet_record_encode(PalletRecord* record, unsigned char* block) {
+    /*
+        Pack `record` into the PALLET_RECORD_SIZE bytes of `block`, with the current version and the CRC
+    */
+
+    block[PALLET_VERSION_IDX] = PALLET_RECORD_VERSION;
+    put_bytes(block + PALLET_SKU_IDX, record->sku, 4);
+    put_bytes(block + PALLET_QUANTITY_IDX, record->quantity, 2);
+    put_bytes(block + PALLET_DESTINATION_IDX, record->destination, 2);
+    put_bytes(block + PALLET_SHIPMENT_IDX, record->shipment, 4);
+    block[PALLET_SEQUENCE_IDX] = record->sequence;
+
+    put_bytes(block + PALLET_CRC_IDX, crc16(block, PALLET_CRC_IDX), 2);
+};
+
+bool pallet_record_decode(unsigned char* block, PalletRecord* record) {
+    /*
+        Unpack the record in `block` into `record`; returns `false`, leaving `record` as it was, if the CRC does not match or the
+        record is of another version
+    */
+
+    if (crc16(block, PALLET_CRC_IDX) != get_bytes(block + PALLET_CRC_IDX, 2) || block[PALLET_VERSION_IDX] != PALLET_RECORD_VERSION) {
+        return false;
+    }
+
+    record->sku = get_bytes(block + PALLET_SKU_IDX, 4);
+    record->quantity = get_bytes(block + PALLET_QUANTITY_IDX, 2);
+    record->destination = get_bytes(block + PALLET_DESTINATION_IDX, 2);
+    record->shipment = get_bytes(block + PALLET_SHIPMENT_IDX, 4);
+    record->sequence = block[PALLET_SEQUENCE_IDX];
+
+    return true;
+};
+
+bool pallet_slot_blank(unsigned char* block) {
+    /*
+        Whether the slot read into `block` was never written; all zeros as a MIFARE Classic data block or NTAG user page ships,
+        or all ones as erased. A torn write leaves some of the record in the slot, the version byte among them, or nothing, in
+        which case the record in the other slot is still current anyway.
+    */
+
+    for (int i = 1; i < PALLET_RECORD_SIZE; i++) {
+        if (block[i] != block[0]) {
+            return false;
+        }
+    }
+
+    return block[0] == 0x00 || block[0] == 0xFF;
+};
+
+bool pallet_record_same(PalletRecord* a, PalletRecord* b) {
+    // Whether `a` and `b` hold the same pallet information, whatever their sequence numbers
+    return (a->sku == b->sku) && (a->quantity == b->quantity) && (a->destination == b->destination) && (a->shipment == b->shipment);
+};
+
+bool pallet_sequence_newer(unsigned char a, unsigned char b) {
+    /*
+        Whether sequence number `a` is newer than `b`; sequence numbers wrap around after 255, and `a` is newer if it is ahead
+        of `b` by less than half of the range (serial number arithmetic)
+    */
+
+    return a != b && (unsigned char)(a - b) < 128;
+};
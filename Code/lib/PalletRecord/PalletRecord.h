@@ -0,0 +1,281 @@
+/*
+    PalletRecord.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    The pallet record; everything needed to route a pallet, packed in one 16-byte block of its tag, so that reading it takes one
+    authentication and two reads (one per slot, below) of a MIFARE Classic card, or three reads of an NTAG/Ultralight, its
+    capability container first.
+
+    A record carries a format version, the SKU, the quantity, the destination, the shipment, a sequence number that is incremented
+    every time the record is rewritten, and a CRC-16 over all of it; a blank or corrupted block, or a record of another version,
+    does not decode.
+
+    Writes are transactional. The record is kept in two slots, a block and its shadow, in the same sector of a MIFARE Classic
+    card so that one authentication covers both, and both away from the MAD and the NDEF data of a card formatted for NDEF.
+    The valid slot with the newer sequence number is the current record. A write goes to the other slot with the next sequence
+    number, and is read back and compared; only then does the current record flip over to it. A tag pulled out of the field
+    mid-write leaves a slot that fails its CRC, or an older sequence number, and the previous record stays current.
+
+    `read_pallet_record()` and `write_pallet_record()` work through any `Reader`, as templates over its type.
+
+    The following sources were referenced.
+
+    https://www.nxp.com/docs/en/data-sheet/MF1S50YYX_V1.pdf [MF1S50]
+    https://www.nxp.com/docs/en/data-sheet/NTAG213_215_216.pdf [NTAG]
+    https://www.nxp.com/docs/en/application-note/AN10787.pdf [MAD]
+    https://nfc-forum.org/uploads/specifications/90-NFCForum-TS-Type-2-Tag_1.1.pdf [T2T]
+*/
+
+#ifndef PALLETRECORD_H
+#define PALLETRECORD_H
+
+#include "Reader.h"
+#include "CRC.h"
+
+#include "string.h"
+
+#define PALLET_RECORD_VERSION       1
+
+// Record Layout; multi-byte fields LSB first
+#define PALLET_VERSION_IDX          0
+#define PALLET_SKU_IDX              1 // 4 bytes
+#define PALLET_QUANTITY_IDX         5 // 2 bytes
+#define PALLET_DESTINATION_IDX      7 // 2 bytes
+#define PALLET_SHIPMENT_IDX         9 // 4 bytes
+#define PALLET_SEQUENCE_IDX         13
+#define PALLET_CRC_IDX              14 // 2 bytes, CRC-16 of the bytes before it
+
+#define PALLET_RECORD_SIZE          16
+
+// Where the two slots are kept, clear of the NDEF data a supplier may have put on the tag. On a MIFARE Classic card, blocks 60
+// and 61, in sector 15, which the MAD must leave free or give to another application; sector 0 holds the MAD itself. Both
+// blocks must be in the same sector. On a Type 2 tag, pages 32 to 35 and 36 to 39, the last of an NTAG213's user memory, past
+// the data area the capability container gives to NDEF, which must then be at most PALLET_TYPE_2_NDEF_SIZE bytes; page 4 on
+// holds the NDEF TLVs. An NTAG213 as shipped gives NDEF all 144 bytes, pages 4 to 39, and has no room for the slots; its
+// capability container is one-time programmable, so it cannot be given less. [Section 3 (MAD)] [Section 6.1 (T2T)]
+#ifndef PALLET_CLASSIC_BLOCK
+#define PALLET_CLASSIC_BLOCK        60
+#define PALLET_CLASSIC_SHADOW_BLOCK 61
+#endif
+
+#ifndef PALLET_TYPE_2_PAGE
+#define PALLET_TYPE_2_PAGE          32
+#define PALLET_TYPE_2_SHADOW_PAGE   36
+#endif
+
+#define PALLET_TYPE_2_NDEF_SIZE     ((PALLET_TYPE_2_PAGE - 4) * PALLET_TYPE_2_PAGE_SIZE) // From page 4 up to the first slot
+
+// The capability container of a Type 2 tag; its magic number, if formatted for NDEF, and the size of the data area it gives to
+// NDEF, in units of 8 bytes [Section 6.1 (T2T)]
+#define PALLET_TYPE_2_CC_PAGE       3
+#define PALLET_TYPE_2_CC_MAGIC      0xE1
+#define PALLET_TYPE_2_CC_SIZE_IDX   2
+
+#define PALLET_SLOTS                2
+
+// What `find_pallet_record()` returns, other than the slot of the current record
+#define PALLET_NO_RECORD            -1
+#define PALLET_READ_FAILED          -2
+#define PALLET_NO_ROOM              -3 // The slots of a Type 2 tag are inside the data area its capability container gives to NDEF
+
+// Tag Commands [Section 9 (MF1S50)], [Section 10 (NTAG)]
+#define PALLET_READ                 0x30 // A MIFARE Classic block, or 4 pages of a Type 2 tag
+#define PALLET_CLASSIC_WRITE        0xA0
+#define PALLET_TYPE_2_WRITE         0xA2
+#define PALLET_TYPE_2_PAGE_SIZE     4
+
+struct PalletRecord {
+    unsigned long sku;
+    unsigned int quantity;
+    unsigned int destination;       // Dock or zone the pallet goes to
+    unsigned long shipment;
+    unsigned char sequence;         // Incremented every time the record is rewritten
+};
+
+void pallet_record_encode(PalletRecord* record, unsigned char* block);
+bool pallet_record_decode(unsigned char* block, PalletRecord* record);
+bool pallet_slot_blank(unsigned char* block);
+
+bool pallet_record_same(PalletRecord* a, PalletRecord* b);
+bool pallet_sequence_newer(unsigned char a, unsigned char b);
+
+inline bool pallet_tag_is_classic(ReaderTag* tag) {
+    // SAK 0x08 and 0x18 are MIFARE Classic 1K and 4K
+    return tag->sak == 0x08 || tag->sak == 0x18;
+};
+
+template <typename Reader_Impl>
+bool read_pallet_slot(Reader_Impl* reader, ReaderTag* tag, int slot, unsigned char* block) {
+    /*
+        Read the 16 bytes of `slot` into `block`; a MIFARE Classic card must already be authenticated for the sector
+    */
+
+    unsigned char command[2] = {PALLET_READ, (unsigned char)(slot ? PALLET_TYPE_2_SHADOW_PAGE : PALLET_TYPE_2_PAGE)};
+
+    if (pallet_tag_is_classic(tag)) {
+        command[1] = slot ? PALLET_CLASSIC_SHADOW_BLOCK : PALLET_CLASSIC_BLOCK;
+    }
+
+    return reader->exchange(tag, command, 2, block, PALLET_RECORD_SIZE) == PALLET_RECORD_SIZE;
+};
+
+template <typename Reader_Impl>
+bool write_pallet_slot(Reader_Impl* reader, ReaderTag* tag, int slot, unsigned char* block) {
+    /*
+        Write the 16 bytes of `block` to `slot`, in one write of a MIFARE Classic block, or four page writes of a Type 2 tag
+    */
+
+    if (pallet_tag_is_classic(tag)) {
+        unsigned char command[2 + PALLET_RECORD_SIZE];
+        command[0] = PALLET_CLASSIC_WRITE;
+        command[1] = slot ? PALLET_CLASSIC_SHADOW_BLOCK : PALLET_CLASSIC_BLOCK;
+        memcpy(command + 2, block, PALLET_RECORD_SIZE);
+
+        return reader->write(tag, command, 2 + PALLET_RECORD_SIZE);
+    }
+
+    for (int page = 0; page < PALLET_RECORD_SIZE / PALLET_TYPE_2_PAGE_SIZE; page++) {
+        unsigned char command[2 + PALLET_TYPE_2_PAGE_SIZE];
+        command[0] = PALLET_TYPE_2_WRITE;
+        command[1] = (slot ? PALLET_TYPE_2_SHADOW_PAGE : PALLET_TYPE_2_PAGE) + page;
+        memcpy(command + 2, block + page * PALLET_TYPE_2_PAGE_SIZE, PALLET_TYPE_2_PAGE_SIZE);
+
+        if (!reader->write(tag, command, 2 + PALLET_TYPE_2_PAGE_SIZE)) {
+            return false;
+        }
+    }
+
+    return true;
+};
+
+template <typename Reader_Impl>
+int check_pallet_room(Reader_Impl* reader, ReaderTag* tag) {
+    /*
+        Read the capability container of a selected Type 2 `tag`; returns 0 if the slots are clear of the data area it gives to
+        NDEF, or the tag is not formatted for NDEF, PALLET_NO_ROOM if not, or PALLET_READ_FAILED
+    */
+
+    unsigned char command[2] = {PALLET_READ, PALLET_TYPE_2_CC_PAGE};
+    unsigned char pages[PALLET_RECORD_SIZE];
+
+    if (reader->exchange(tag, command, 2, pages, PALLET_RECORD_SIZE) != PALLET_RECORD_SIZE) {
+        return PALLET_READ_FAILED;
+    }
+
+    if (pages[0] == PALLET_TYPE_2_CC_MAGIC && pages[PALLET_TYPE_2_CC_SIZE_IDX] * 8 > PALLET_TYPE_2_NDEF_SIZE) {
+        return PALLET_NO_ROOM;
+    }
+
+    return 0;
+};
+
+template <typename Reader_Impl>
+int find_pallet_record(Reader_Impl* reader, ReaderTag* tag, unsigned char* key, PalletRecord* record) {
+    /*
+        Read both slots of a selected `tag`, in one authentication of a MIFARE Classic card with key A `key`, and place the
+        current record in `record`; returns its slot, PALLET_NO_RECORD if neither slot holds a valid record, PALLET_READ_FAILED
+        if the tag could not be read, or PALLET_NO_ROOM if the slots of a Type 2 tag hold NDEF data, as `check_pallet_room()`
+        finds first
+    */
+
+    if (pallet_tag_is_classic(tag)) {
+        if (!reader->authenticate(tag, READER_KEY_A, PALLET_CLASSIC_BLOCK, key)) {
+            return PALLET_READ_FAILED;
+        }
+    } else {
+        int room = check_pallet_room(reader, tag);
+
+        if (room < 0) {
+            return room;
+        }
+    }
+
+    int current = PALLET_NO_RECORD;
+
+    for (int slot = 0; slot < PALLET_SLOTS; slot++) {
+        unsigned char block[PALLET_RECORD_SIZE];
+        PalletRecord candidate;
+
+        if (!read_pallet_slot(reader, tag, slot, block)) {
+            return PALLET_READ_FAILED;
+        }
+
+        if (pallet_record_decode(block, &candidate) &&
+            (current == PALLET_NO_RECORD || pallet_sequence_newer(candidate.sequence, record->sequence))) {
+            *record = candidate;
+            current = slot;
+        }
+    }
+
+    return current;
+};
+
+template <typename Reader_Impl>
+bool read_pallet_record(Reader_Impl* reader, ReaderTag* tag, unsigned char* key, PalletRecord* record) {
+    /*
+        Read the current pallet record of a selected `tag`; `key` is the key A of the sector, for a MIFARE Classic card. Returns
+        `false` if the tag could not be read, or holds no valid record.
+    */
+
+    return find_pallet_record(reader, tag, key, record) >= 0;
+};
+
+template <typename Reader_Impl>
+bool commit_pallet_record(Reader_Impl* reader, ReaderTag* tag, PalletRecord* record, int current_slot, PalletRecord* current) {
+    /*
+        Write `record` to a selected `tag` as a transaction, where `current_slot` and `current` are what `find_pallet_record()`
+        just found, within the same authentication; for changing a few fields of the current record without reading it twice.
+        `record->sequence` is set to the sequence number written. Returns `true` once the record is on the tag and verified;
+        on `false`, the previous record is still current, and the write may simply be retried, but for a tag with no room for
+        the slots, which is never written.
+
+        A record that is already current is not written again, so a retry after a write that landed, but whose answer was lost,
+        costs only the reads.
+    */
+
+    if (current_slot == PALLET_READ_FAILED || current_slot == PALLET_NO_ROOM) {
+        return false;
+    }
+
+    if (current_slot != PALLET_NO_RECORD) {
+        if (pallet_record_same(current, record)) {
+            record->sequence = current->sequence;
+            return true;
+        }
+
+        record->sequence = current->sequence + 1;
+    }
+
+    // Write the slot that is not current
+    int slot = (current_slot == 0) ? 1 : 0;
+
+    unsigned char block[PALLET_RECORD_SIZE];
+    pallet_record_encode(record, block);
+
+    // A write whose answer was lost may still have landed; the read back decides
+    write_pallet_slot(reader, tag, slot, block);
+
+    unsigned char written[PALLET_RECORD_SIZE];
+
+    return read_pallet_slot(reader, tag, slot, written) && memcmp(written, block, PALLET_RECORD_SIZE) == 0;
+};
+
+template <typename Reader_Impl>
+bool write_pallet_record(Reader_Impl* reader, ReaderTag* tag, unsigned char* key, PalletRecord* record) {
+    /*
+        Write `record` to a selected `tag` as a transaction; `key` is as for `read_pallet_record()`, and must allow writing.
+        Returns as `commit_pallet_record()`.
+    */
+
+    PalletRecord current;
+    int current_slot = find_pallet_record(reader, tag, key, &current);
+
+    return commit_pallet_record(reader, tag, record, current_slot, &current);
+};
+
+#endif
@@ -19,36 +19,38 @@
 
 #include "Pins.h"
 
+#define PORT_INPUT_PIN_ADDRESS_REGISTER     IO_REGISTER(_port_input_pin_address)
+#define PORT_DATA_DIRECTION_REGISTER        IO_REGISTER(_port_input_pin_address + 1)
+#define PORT_DATA_REGISTER                  IO_REGISTER(_port_input_pin_address + 2)
+
 Pin::Pin(unsigned char port, unsigned char pin) {
-    _port_input_pin_address_register = (volatile unsigned char*)(port + 0x20);
-    _port_data_direction_register = (volatile unsigned char*)(port + 0x21);
-    _port_data_register = (volatile unsigned char*)(port + 0x22);
+    _port_input_pin_address = port + 0x20;
 
     _pin_position = pin;
 };
 
 void Pin::set_output() {
-    *_port_data_direction_register |= (1 << _pin_position);
+    PORT_DATA_DIRECTION_REGISTER |= (1 << _pin_position);
 }
 
 void Pin::set_input() {
-    *_port_data_direction_register &= ~(1 << _pin_position);
+    PORT_DATA_DIRECTION_REGISTER &= ~(1 << _pin_position);
 };
 
 void Pin::assert() {
-    *_port_data_register |= (1 << _pin_position);
+    PORT_DATA_REGISTER |= (1 << _pin_position);
 };
 
 void Pin::deassert() {
-    *_port_data_register &= ~(1 << _pin_position);
+    PORT_DATA_REGISTER &= ~(1 << _pin_position);
 };
 
 void Pin::toggle() {
-    *_port_data_register ^= (1 << _pin_position);
+    PORT_DATA_REGISTER ^= (1 << _pin_position);
 };
 
 bool Pin::state() {
-    return (*_port_input_pin_address_register & (1 << _pin_position));
+    return (PORT_INPUT_PIN_ADDRESS_REGISTER & (1 << _pin_position));
 };
 
 bool Pin::is_low() {
@@ -57,4 +59,9 @@ bool Pin::is_low() {
 
 bool Pin::is_high() {
     return state();
+};
+
+unsigned char Pin::id() {
+    // A number for the pin, unique on the chip; 8 * port + pin, counting ports B, C, D from 0
+    return ((_port_input_pin_address - (B + 0x20)) / 3) * 8 + _pin_position;
 };
\ No newline at end of file
@@ -20,6 +20,8 @@
 #ifndef PINS_H
 #define PINS_H
 
+#include "Registers.h"
+
 #define B   0x03
 #define C   0x06
 #define D   0x09
@@ -39,10 +41,11 @@ class Pin {
         bool is_low();
         bool is_high();
 
+        unsigned char id();
+
     private:
-        volatile unsigned char* _port_data_register;
-        volatile unsigned char* _port_data_direction_register;
-        volatile unsigned char* _port_input_pin_address_register;
+        // Address of the PINx register of the port; DDRx and PORTx follow it [Section 31]
+        unsigned char _port_input_pin_address;
         unsigned char _pin_position;
 };
 
@@ -0,0 +1,219 @@
+/*
+    PresenceTracker.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Keeps track of the tags currently in the field of the reader, so that a tag sitting on the forks is reported once when it
+    enters the field, periodically while it dwells there, and once when it leaves, instead of once every time it is detected.
+
+    The following sources were referenced.
+
+    http://www.emutag.com/iso/14443-3.pdf [ISO-3]
+*/
+
+#include "PresenceTracker.h"
+
+#include "string.h"
+
+PresenceTracker::PresenceTracker(unsigned long exit_hold_off, unsigned long dwell_interval) {
+    /*
+        `exit_hold_off`     = a tag is considered to have left the field once it has not been detected for this many milliseconds
+        `dwell_interval`    = while a tag stays in the field, it is reported again every this many milliseconds; 0 to never
+                              report dwelling tags
+    */
+
+    _exit_hold_off = exit_hold_off;
+    _dwell_interval = dwell_interval;
+
+    _count = 0;
+    _untracked = 0;
+
+    for (int i = 0; i < PRESENCE_TRACKER_CAPACITY; i++) {
+        _entries[i].uid_length = 0;
+    }
+};
+
+bool PresenceTracker::observe(unsigned char* uid, unsigned char uid_length, unsigned char reader, unsigned long now,
+                              PresenceEvent* event) {
+    /*
+        Record that the tag with the given UID was detected by reader number `reader` at time `now` (in milliseconds)
+
+        Returns `true` and fills in `event` if the detection has to be reported, i.e., the tag just entered the field (ENTER) or
+        has been in the field for another `dwell_interval` since it was last reported (DWELL). Returns `false` otherwise.
+
+        A new tag is not tracked while the table is full; dropping another tag instead, with no EXIT, would have it ENTER again
+        on its next detection and drop yet another, over and over while the field stays crowded. Tags that left make room
+        through `expire()`, with their EXIT, and the tag is tracked once detected after that.
+    */
+
+    if (uid_length == 0 || uid_length > MAX_UID_LENGTH) {
+        return false;
+    }
+
+    int slot = find(uid, uid_length);
+
+    if (slot >= 0) {
+        Entry* entry = &_entries[slot];
+        entry->last_seen = now;
+        entry->reader = reader;
+
+        if (_dwell_interval == 0 || now - entry->last_reported < _dwell_interval) {
+            return false;
+        }
+
+        entry->last_reported = now;
+        make_event(entry, PRESENCE_DWELL, now, event);
+
+        return true;
+    }
+
+    if (_count == PRESENCE_TRACKER_CAPACITY) {
+        _untracked++;
+        return false;
+    }
+
+    // Probe linearly from the home slot of the UID until an empty slot is found
+    slot = hash(uid, uid_length);
+    while (_entries[slot].uid_length != 0) {
+        slot = (slot + 1) % PRESENCE_TRACKER_CAPACITY;
+    }
+
+    Entry* entry = &_entries[slot];
+
+    memcpy(entry->uid, uid, uid_length);
+    entry->uid_length = uid_length;
+    entry->reader = reader;
+    entry->entered = now;
+    entry->last_seen = now;
+    entry->last_reported = now;
+
+    _count++;
+
+    make_event(entry, PRESENCE_ENTER, now, event);
+
+    return true;
+};
+
+bool PresenceTracker::expire(unsigned long now, PresenceEvent* event) {
+    /*
+        Look for a tag that has not been detected for more than `exit_hold_off` milliseconds, stop tracking it, and fill in an
+        EXIT event for it in `event`
+
+        Returns `true` if such a tag was found. Only one tag is expired per call, so call repeatedly until it returns `false`.
+    */
+
+    for (int i = 0; i < PRESENCE_TRACKER_CAPACITY; i++) {
+        Entry* entry = &_entries[i];
+
+        if (entry->uid_length != 0 && now - entry->last_seen > _exit_hold_off) {
+            // The tag was last in the field when it was last seen, not now
+            make_event(entry, PRESENCE_EXIT, entry->last_seen, event);
+            remove(i);
+
+            return true;
+        }
+    }
+
+    return false;
+};
+
+unsigned char PresenceTracker::count() {
+    return _count;
+};
+
+unsigned long PresenceTracker::untracked() {
+    return _untracked;
+};
+
+unsigned char PresenceTracker::hash(unsigned char* uid, unsigned char uid_length) {
+    /*
+        Rotate and XOR the UID bytes together; UIDs are close to uniformly distributed already, so this is enough to spread
+        them over the table
+    */
+
+    unsigned char h = 0;
+
+    for (int i = 0; i < uid_length; i++) {
+        h = (unsigned char)((h << 1) | (h >> 7)) ^ uid[i];
+    }
+
+    return h % PRESENCE_TRACKER_CAPACITY;
+};
+
+int PresenceTracker::find(unsigned char* uid, unsigned char uid_length) {
+    /*
+        Return the slot holding the given UID, or -1 if it is not being tracked
+    */
+
+    int slot = hash(uid, uid_length);
+
+    for (int probes = 0; probes < PRESENCE_TRACKER_CAPACITY; probes++) {
+        Entry* entry = &_entries[slot];
+
+        // An empty slot ends the probe sequence; the UID would have been placed here otherwise
+        if (entry->uid_length == 0) {
+            return -1;
+        }
+
+        if (entry->uid_length == uid_length && memcmp(entry->uid, uid, uid_length) == 0) {
+            return slot;
+        }
+
+        slot = (slot + 1) % PRESENCE_TRACKER_CAPACITY;
+    }
+
+    return -1;
+};
+
+void PresenceTracker::remove(int slot) {
+    /*
+        Empty `slot`, and shift back any entries further along the probe sequence that could no longer be found otherwise
+        (backward shift deletion)
+    */
+
+    int hole = slot;
+    int next = slot;
+
+    // Empty the slot first, so that the probe below stops even if the table was full
+    _entries[hole].uid_length = 0;
+    _count--;
+
+    while (true) {
+        next = (next + 1) % PRESENCE_TRACKER_CAPACITY;
+
+        if (_entries[next].uid_length == 0) {
+            break;
+        }
+
+        int home = hash(_entries[next].uid, _entries[next].uid_length);
+
+        // The entry at `next` may move into the hole unless its home slot lies cyclically in (hole, next]
+        bool home_in_between;
+        if (hole <= next) {
+            home_in_between = (hole < home) && (home <= next);
+        } else {
+            home_in_between = (hole < home) || (home <= next);
+        }
+
+        if (!home_in_between) {
+            _entries[hole] = _entries[next];
+            _entries[next].uid_length = 0;
+            hole = next;
+        }
+    }
+};
+
+void PresenceTracker::make_event(Entry* entry, unsigned char type, unsigned long now, PresenceEvent* event) {
+    event->type = type;
+
+    memcpy(event->uid, entry->uid, entry->uid_length);
+    event->uid_length = entry->uid_length;
+    event->reader = entry->reader;
+
+    event->timestamp = now;
+    event->dwell_time = now - entry->entered;
+};
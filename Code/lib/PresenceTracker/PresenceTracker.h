@@ -0,0 +1,79 @@
+/*
+    PresenceTracker.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Keeps track of the tags currently in the field of the reader, so that a tag sitting on the forks is reported once when it
+    enters the field, periodically while it dwells there, and once when it leaves, instead of once every time it is detected.
+
+    The tags are kept in a fixed capacity open addressing hash table (linear probing, with backward shift deletion so no
+    tombstones are needed), keyed by their UIDs.
+
+    The following sources were referenced.
+
+    http://www.emutag.com/iso/14443-3.pdf [ISO-3]
+*/
+
+#ifndef PRESENCE_TRACKER_H
+#define PRESENCE_TRACKER_H
+
+#ifndef MAX_UID_LENGTH
+#define MAX_UID_LENGTH              10 // Triple size UID [Section 6.4.4 (ISO-3)]
+#endif
+
+#ifndef PRESENCE_TRACKER_CAPACITY
+#define PRESENCE_TRACKER_CAPACITY   16 // Maximum number of tags tracked at once
+#endif
+
+// Event Types
+#define PRESENCE_ENTER              0
+#define PRESENCE_DWELL              1
+#define PRESENCE_EXIT               2
+
+struct PresenceEvent {
+    unsigned char type;
+    unsigned char uid[MAX_UID_LENGTH];
+    unsigned char uid_length;
+    unsigned char reader;       // Index of the reader that detected the tag (last detected it, for EXIT)
+    unsigned long timestamp;    // Time at which the event occurred, in milliseconds
+    unsigned long dwell_time;   // Time since the tag entered the field, in milliseconds
+};
+
+class PresenceTracker {
+    public:
+        PresenceTracker(unsigned long exit_hold_off, unsigned long dwell_interval);
+
+        bool observe(unsigned char* uid, unsigned char uid_length, unsigned char reader, unsigned long now, PresenceEvent* event);
+        bool expire(unsigned long now, PresenceEvent* event);
+
+        unsigned char count();
+        unsigned long untracked();
+
+    private:
+        struct Entry {
+            unsigned char uid[MAX_UID_LENGTH];
+            unsigned char uid_length; // 0 marks an empty slot
+            unsigned char reader;
+            unsigned long entered;
+            unsigned long last_seen;
+            unsigned long last_reported;
+        };
+
+        unsigned char hash(unsigned char* uid, unsigned char uid_length);
+        int find(unsigned char* uid, unsigned char uid_length);
+        void remove(int slot);
+        void make_event(Entry* entry, unsigned char type, unsigned long now, PresenceEvent* event);
+
+        Entry _entries[PRESENCE_TRACKER_CAPACITY];
+        unsigned char _count;
+        unsigned long _untracked;   // Detections of new tags while the table was full
+
+        unsigned long _exit_hold_off;
+        unsigned long _dwell_interval;
+};
+
+#endif
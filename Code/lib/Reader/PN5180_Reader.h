@@ -0,0 +1,263 @@
+/*
+    PN5180_Reader.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Implements the `Reader` interface with the PN5180, which only exchanges raw frames; the ISO14443A activation runs on the host,
+    in `ISO14443A_PCD`, over `transmit_rf()` and `receive_rf()`. The PN5180 adds the CRCs of the exchanges with selected tags,
+    and runs MIFARE Classic authentication (and the encryption that follows) by itself.
+
+    A reader made with `vicinity` set also runs an ISO15693 inventory whenever no ISO14443A tag answers, for the longer read
+    range of vicinity tags; these are only detected, by their UIDs, with `sak` set to READER_SAK_VICINITY.
+
+    Writes to MIFARE Classic and Type 2 tags are answered with a 4-bit ACK, without a CRC, which the PN5180 hands back as a
+    frame like any other; a MIFARE Classic WRITE is sent in its two parts, the address and then the block, each acknowledged.
+
+    The following sources were referenced.
+
+    https://www.nxp.com/docs/en/data-sheet/PN5180A0XX_C3_C4.pdf [PN5180DS]
+    https://www.nxp.com/docs/en/data-sheet/MF1S50YYX_V1.pdf [MF1S50]
+*/
+
+#ifndef PN5180_READER_H
+#define PN5180_READER_H
+
+#include "Reader.h"
+#include "PN5180.h"
+#include "ISO14443.h"
+
+#include "string.h"
+
+#ifndef PN5180_READER_MAX_TAGS
+#define PN5180_READER_MAX_TAGS      8 // Largest inventory
+#endif
+
+// Writes to MIFARE Classic and Type 2 tags [Section 12.6 (MF1S50)]
+#define PN5180_READER_CLASSIC_WRITE 0xA0
+#define PN5180_READER_CLASSIC_DATA  16 // Bytes of a block, sent after the address is acknowledged
+#define PN5180_READER_ACK           0x0A
+#define PN5180_READER_ACK_BITS      4
+
+// Callbacks of `ISO14443A_PCD`
+struct PN5180_ISO14443A_Send {
+    PN5180* pn5180;
+
+    bool operator()(uint8_t* bytes, uint8_t num_bytes, uint8_t valid_bits_last_byte, uint8_t rx_align) {
+        return pn5180->set_rx_bit_align(rx_align) && pn5180->transmit_rf(valid_bits_last_byte, num_bytes, bytes);
+    };
+};
+
+struct PN5180_ISO14443A_Receive {
+    PN5180* pn5180;
+
+    int operator()(uint8_t* buffer, uint8_t length) {
+        uint8_t valid_bytes;
+        uint8_t valid_bits_last_byte;
+
+        if (!pn5180->receive_rf(buffer, length, &valid_bytes, &valid_bits_last_byte)) {
+            return 0;
+        }
+
+        return valid_bytes;
+    };
+};
+
+struct PN5180_ISO14443A_Collision {
+    PN5180* pn5180;
+
+    int operator()() {
+        return pn5180->collision_position();
+    };
+};
+
+typedef ISO14443A_PCD<PN5180_ISO14443A_Send, PN5180_ISO14443A_Receive, PN5180_ISO14443A_Collision> PN5180_ISO14443A_PCD;
+
+class PN5180_Reader : public Reader<PN5180_Reader> {
+    public:
+        PN5180_Reader(PN5180* pn5180, bool vicinity = false)
+            : _pn5180(pn5180), _pcd(PN5180_ISO14443A_Send{pn5180}, PN5180_ISO14443A_Receive{pn5180}, PN5180_ISO14443A_Collision{pn5180}),
+              _vicinity(vicinity) {
+                ;
+        };
+
+        PN5180* pn5180() {
+            return _pn5180;
+        };
+
+    private:
+        friend class Reader<PN5180_Reader>;
+
+        bool initialize_impl(bool /* warm_start */) {
+            // The PN5180 is reset through RST in any case, so a warm start changes nothing
+            _pn5180->initialize();
+
+            // A PN5180 that is not fitted never releases BUSY, and no register can be read
+            uint32_t system_config;
+            return _pn5180->read_register(REG_SYSTEM_CONFIG, &system_config);
+        };
+
+        bool start_activation() {
+            /*
+                Configure for ISO14443A with the CRC left to `ISO14443A_PCD`, switch the field on, and wake the tags
+
+                A tag left READY or ACTIVE by the previous scan returns to IDLE on WUPA instead of answering, so WUPA is sent again
+                if nothing answers the first. [Section 6.3 (ISO-3)]
+            */
+
+            if (!_pn5180->load_rf_config(RF_CONFIG_ISO14443A_TX, RF_CONFIG_ISO14443A_RX) || !_pn5180->set_crc(false) ||
+                !_pn5180->set_rf_field(true)) {
+                return false;
+            }
+
+            uint8_t atqa[2];
+            return _pcd.request(true, atqa) || _pcd.request(true, atqa);
+        };
+
+        bool detect_impl(ReaderTag* tag) {
+            ISO14443A_Tag found;
+
+            if (!start_activation() || !_pcd.select(&found)) {
+                return _vicinity && vicinity_inventory(tag, 1) == 1;
+            }
+
+            tag->number = 0;
+            tag->sak = found.sak;
+            tag->uid_length = found.uid_length;
+            memcpy(tag->uid, found.uid, found.uid_length);
+
+            return true;
+        };
+
+        bool select_impl(ReaderTag* tag) {
+            ISO14443A_Tag selected;
+
+            if (!start_activation() || !_pcd.select_uid(tag->uid, tag->uid_length, &selected)) {
+                return false;
+            }
+
+            tag->sak = selected.sak;
+            return true;
+        };
+
+        int inventory_impl(ReaderTag* tags, int max_tags) {
+            if (max_tags > PN5180_READER_MAX_TAGS) {
+                max_tags = PN5180_READER_MAX_TAGS;
+            }
+
+            if (!_pn5180->load_rf_config(RF_CONFIG_ISO14443A_TX, RF_CONFIG_ISO14443A_RX) || !_pn5180->set_crc(false) ||
+                !_pn5180->set_rf_field(true)) {
+                return 0;
+            }
+
+            ISO14443A_Tag found[PN5180_READER_MAX_TAGS];
+            int num_tags = _pcd.enumerate(found, max_tags);
+
+            for (int i = 0; i < num_tags; i++) {
+                tags[i].number = i;
+                tags[i].sak = found[i].sak;
+                tags[i].uid_length = found[i].uid_length;
+                memcpy(tags[i].uid, found[i].uid, found[i].uid_length);
+            }
+
+            if (_vicinity && num_tags < max_tags) {
+                num_tags += vicinity_inventory(tags + num_tags, max_tags - num_tags);
+            }
+
+            return num_tags;
+        };
+
+        int vicinity_inventory(ReaderTag* tags, int max_tags) {
+            // The ISO15693 tags in the field; the next activation loads the ISO14443A configuration again
+            uint8_t uids[PN5180_READER_MAX_TAGS * ISO15693_UID_LENGTH];
+
+            if (max_tags > PN5180_READER_MAX_TAGS) {
+                max_tags = PN5180_READER_MAX_TAGS;
+            }
+
+            int num_tags = _pn5180->iso15693_inventory(uids, max_tags);
+
+            for (int i = 0; i < num_tags; i++) {
+                tags[i].number = i;
+                tags[i].sak = READER_SAK_VICINITY;
+                tags[i].uid_length = ISO15693_UID_LENGTH;
+                memcpy(tags[i].uid, uids + i * ISO15693_UID_LENGTH, ISO15693_UID_LENGTH);
+            }
+
+            return (num_tags < 0) ? 0 : num_tags;
+        };
+
+        int exchange_impl(ReaderTag* /* tag */, unsigned char* command, int length, unsigned char* response,
+                          int max_response_length) {
+            if (length > PN5180_MAX_FRAME_SIZE || max_response_length > PN5180_MAX_FRAME_SIZE) {
+                return -1;
+            }
+
+            if (!_pn5180->set_crc(true) || !_pn5180->set_rx_bit_align(0) || !_pn5180->transmit_rf(0, length, command)) {
+                return -1;
+            }
+
+            uint8_t valid_bytes;
+            uint8_t valid_bits_last_byte;
+
+            if (!_pn5180->receive_rf(response, max_response_length, &valid_bytes, &valid_bits_last_byte) ||
+                _pn5180->collision_position() >= 0) {
+                return -1;
+            }
+
+            return valid_bytes;
+        };
+
+        bool write_impl(ReaderTag* /* tag */, unsigned char* command, int length) {
+            /*
+                A MIFARE Classic WRITE goes as the command and address, then the 16 bytes once the card has acknowledged them; a
+                Type 2 WRITE goes whole. The frames sent carry a CRC, but the ACKs do not. [Section 12.6 (MF1S50)]
+            */
+
+            int first_part = length;
+
+            if (command[0] == PN5180_READER_CLASSIC_WRITE && length == 2 + PN5180_READER_CLASSIC_DATA) {
+                first_part = 2;
+            }
+
+            if (!_pn5180->set_crc(true, false) || !send_acknowledged(command, first_part)) {
+                return false;
+            }
+
+            return first_part == length || send_acknowledged(command + first_part, length - first_part);
+        };
+
+        bool send_acknowledged(unsigned char* bytes, int length) {
+            // Send a frame, and see that the tag answers it with an ACK rather than a NAK
+            if (length > PN5180_MAX_FRAME_SIZE || !_pn5180->set_rx_bit_align(0) || !_pn5180->transmit_rf(0, length, bytes)) {
+                return false;
+            }
+
+            uint8_t ack;
+            uint8_t valid_bytes;
+            uint8_t valid_bits_last_byte;
+
+            if (!_pn5180->receive_rf(&ack, 1, &valid_bytes, &valid_bits_last_byte)) {
+                return false;
+            }
+
+            return valid_bytes == 1 && valid_bits_last_byte == PN5180_READER_ACK_BITS && (ack & 0x0F) == PN5180_READER_ACK;
+        };
+
+        bool authenticate_impl(ReaderTag* tag, unsigned char key_type, unsigned char block_address, unsigned char* key) {
+            return _pn5180->mifare_authenticate(key, key_type, block_address, tag->uid);
+        };
+
+        bool set_rf_field_impl(bool on) {
+            return _pn5180->set_rf_field(on);
+        };
+
+        PN5180* _pn5180;
+        PN5180_ISO14443A_PCD _pcd;
+        bool _vicinity;
+};
+
+#endif
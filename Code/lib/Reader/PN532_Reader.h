@@ -0,0 +1,132 @@
+/*
+    PN532_Reader.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Implements the `Reader` interface with the PN532, which runs the ISO14443A activation, CRCs and MIFARE Classic
+    authentication by itself; the tags it activates are addressed by the logical numbers it gives them.
+
+    Each reader has a parameter profile for its scan mode (see `PN532::set_parameters()`); PROFILE_INVENTORY by default, as only
+    the UID and the blocks of the tags are wanted, so ISO14443-4 tags are not sent RATS during their activation.
+
+    The following sources were referenced.
+
+    https://www.nxp.com/docs/en/user-guide/141520.pdf [PN532UM]
+*/
+
+#ifndef PN532_READER_H
+#define PN532_READER_H
+
+#include "Reader.h"
+#include "PN532.h"
+
+#include "string.h"
+
+// LIST_PASSIVE_TARGETS gives up after this many activation attempts, so a reader with no tag in its field answers promptly
+#define PN532_READER_ACTIVATION_RETRIES 2
+
+class PN532_Reader : public Reader<PN532_Reader> {
+    public:
+        PN532_Reader(PN532* pn532, unsigned char profile = PROFILE_INVENTORY) : _pn532(pn532), _profile(profile) {
+            ;
+        };
+
+        PN532* pn532() {
+            return _pn532;
+        };
+
+        void set_profile(unsigned char profile) {
+            // Takes effect from the next detection
+            _profile = profile;
+        };
+
+        unsigned char profile() {
+            return _profile;
+        };
+
+    private:
+        friend class Reader<PN532_Reader>;
+
+        bool initialize_impl(bool warm_start) {
+            /*
+                Wait for the PN532 to answer, for at most PN532_BOOT_TIMEOUT, then configure it; on a warm start it is still
+                configured, as it keeps its configuration until it loses power, so the SAM configuration and retries are not sent
+                again. The receiver setting made last is made again, so a PN532 recovered after a fault keeps its tuning.
+            */
+
+            _pn532->initialize();
+
+            if (!_pn532->wake_up()) {
+                return false;
+            }
+
+            if (warm_start) {
+                return true;
+            }
+
+            return _pn532->SAMConfig() && _pn532->set_passive_activation_retries(PN532_READER_ACTIVATION_RETRIES) &&
+                   _pn532->restore_receiver() && _pn532->set_parameters(_profile);
+        };
+
+        bool request_detection_impl() {
+            // Only sent to the PN532 when the profile has changed
+            return _pn532->set_parameters(_profile) && _pn532->request_card_detection();
+        };
+
+        bool read_detection_impl(ReaderTag* tag) {
+            unsigned char card_data[CARD_DATA_SIZE];
+
+            if (!_pn532->read_card_detection(&tag->number, card_data)) {
+                return false;
+            }
+
+            tag->sak = card_data[SAK_IDX];
+            tag->uid_length = card_data[UID_LEN_IDX];
+            memcpy(tag->uid, card_data + UID_START_IDX, tag->uid_length);
+
+            return true;
+        };
+
+        bool detect_impl(ReaderTag* tag) {
+            return request_detection_impl() && read_detection_impl(tag);
+        };
+
+        bool select_impl(ReaderTag* tag) {
+            return _pn532->select_target(tag->number);
+        };
+
+        int exchange_impl(ReaderTag* tag, unsigned char* command, int length, unsigned char* response, int max_response_length) {
+            return _pn532->data_exchange(tag->number, command, length, response, max_response_length);
+        };
+
+        bool authenticate_impl(ReaderTag* tag, unsigned char key_type, unsigned char block_address, unsigned char* key) {
+            /*
+                The PN532 runs the MIFARE Classic authentication when sent the authentication command through DATA_EXCHANGE;
+
+                AUTH_COMMAND Addr Key[0] ... Key[5] UID[0] ... UID[3]
+
+                [Section 7.3.8 (PN532UM)]
+            */
+
+            unsigned char command[12];
+            command[0] = key_type;
+            command[1] = block_address;
+            memcpy(command + 2, key, 6);
+            memcpy(command + 8, tag->uid, 4);
+
+            return _pn532->data_exchange(tag->number, command, 12, nullptr, 0) == 0;
+        };
+
+        bool set_rf_field_impl(bool on) {
+            return _pn532->set_rf_field(on);
+        };
+
+        PN532* _pn532;
+        unsigned char _profile;
+};
+
+#endif
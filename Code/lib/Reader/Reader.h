@@ -0,0 +1,158 @@
+/*
+    Reader.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    A common interface to the RFID reader chips, so that the application is written once and the chip is picked per forklift
+    model at compile time.
+
+    `Reader` is a base class template, to be inherited by each chip's implementation with the implementation itself as the
+    template argument (the Curiously Recurring Template Pattern), e.g. `class PN532_Reader : public Reader<PN532_Reader>`. Calls
+    go straight to the implementation, without virtual functions, so there are no vtables in SRAM and no indirect calls; the
+    compiler can inline them. Code using a reader is a template over its type, as `ReaderGroup` is.
+
+    An implementation must provide
+
+    bool initialize_impl(bool warm_start)
+    bool detect_impl(ReaderTag* tag)
+    int exchange_impl(ReaderTag* tag, unsigned char* command, int length, unsigned char* response, int max_response_length)
+    bool authenticate_impl(ReaderTag* tag, unsigned char key_type, unsigned char block_address, unsigned char* key)
+    bool set_rf_field_impl(bool on)
+
+    and may override the defaults of `select_impl()`, `inventory_impl()`, `request_detection_impl()`, `read_detection_impl()` and
+    `write_impl()`.
+
+    The following sources were referenced.
+
+    http://www.emutag.com/iso/14443-3.pdf [ISO-3]
+    https://www.nxp.com/docs/en/data-sheet/MF1S50YYX_V1.pdf [MF1S50]
+*/
+
+#ifndef READER_H
+#define READER_H
+
+#ifndef MAX_UID_LENGTH
+#define MAX_UID_LENGTH              10 // Triple size UID
+#endif
+
+// In `sak` of a tag found by an ISO15693 (vicinity) inventory, which has no SAK; such a tag is only ever detected
+#define READER_SAK_VICINITY         0xFF
+
+// MIFARE Classic Authentication Key Types
+#define READER_KEY_A                0x60
+#define READER_KEY_B                0x61
+
+struct ReaderTag {
+    unsigned char number;           // Logical number the reader gave the tag, if it keeps track of tags itself
+    unsigned char uid[MAX_UID_LENGTH];
+    unsigned char uid_length;
+    unsigned char sak;
+};
+
+template <typename Reader_Impl>
+class Reader {
+    public:
+        bool initialize(bool warm_start = false) {
+            /*
+                Initialize the chip, and configure it for ISO14443A; returns `false` if it does not respond. On a `warm_start`,
+                where the host was reset but the chip kept its power, a chip that keeps its configuration is only checked.
+                Called again to recover a chip that stopped answering.
+            */
+
+            return impl()->initialize_impl(warm_start);
+        };
+
+        bool detect(ReaderTag* tag) {
+            // Find a tag in the field and activate it, leaving it selected; returns `true` if a tag was found
+            return impl()->detect_impl(tag);
+        };
+
+        bool request_detection() {
+            // Start a detection, without waiting for it; other readers can be started in the meantime
+            return impl()->request_detection_impl();
+        };
+
+        bool read_detection(ReaderTag* tag) {
+            // Finish the detection started by `request_detection()`
+            return impl()->read_detection_impl(tag);
+        };
+
+        bool select(ReaderTag* tag) {
+            // Select a tag found earlier, e.g. one of those found by `inventory()`, for the exchanges that follow
+            return impl()->select_impl(tag);
+        };
+
+        int exchange(ReaderTag* tag, unsigned char* command, int length, unsigned char* response, int max_response_length) {
+            /*
+                Send `length` bytes of `command` to the selected `tag`, and place its answer in `response`, which holds
+                `max_response_length` bytes; returns the number of bytes it answered with, or -1 if the exchange failed. CRCs
+                are added and checked by the reader.
+            */
+
+            return impl()->exchange_impl(tag, command, length, response, max_response_length);
+        };
+
+        bool write(ReaderTag* tag, unsigned char* command, int length) {
+            /*
+                Send a MIFARE Classic WRITE (0xA0, the block address and 16 bytes) or a Type 2 WRITE (0xA2, the page address and 4
+                bytes) to the selected `tag`; returns `true` if the tag acknowledged it. Tags answer a write with a 4-bit ACK, and a
+                MIFARE Classic card takes the 16 bytes only after acknowledging the address, which not every reader does by itself
+                in `exchange()`. [Section 12.6 (MF1S50)]
+            */
+
+            return impl()->write_impl(tag, command, length);
+        };
+
+        bool authenticate(ReaderTag* tag, unsigned char key_type, unsigned char block_address, unsigned char* key) {
+            // Authenticate `block_address` of a selected MIFARE Classic `tag` with the 6-byte `key` of type READER_KEY_A or B
+            return impl()->authenticate_impl(tag, key_type, block_address, key);
+        };
+
+        int inventory(ReaderTag* tags, int max_tags) {
+            // Find up to `max_tags` tags in the field and place them in `tags`; returns the number found
+            return impl()->inventory_impl(tags, max_tags);
+        };
+
+        bool set_rf_field(bool on) {
+            return impl()->set_rf_field_impl(on);
+        };
+
+    protected:
+        // Defaults, for implementations that do not do better
+
+        bool select_impl(ReaderTag* tag) {
+            // The tag detected last is left selected
+            return true;
+        };
+
+        int inventory_impl(ReaderTag* tags, int max_tags) {
+            // A single tag at a time
+            return (max_tags > 0 && impl()->detect_impl(tags)) ? 1 : 0;
+        };
+
+        bool request_detection_impl() {
+            // Nothing to start ahead; `read_detection()` does the whole detection
+            return true;
+        };
+
+        bool read_detection_impl(ReaderTag* tag) {
+            return impl()->detect_impl(tag);
+        };
+
+        bool write_impl(ReaderTag* tag, unsigned char* command, int length) {
+            // The reader runs both parts of the write, and checks the ACKs
+            unsigned char response[1];
+            return impl()->exchange_impl(tag, command, length, response, 1) >= 0;
+        };
+
+    private:
+        Reader_Impl* impl() {
+            return static_cast<Reader_Impl*>(this);
+        };
+};
+
+#endif
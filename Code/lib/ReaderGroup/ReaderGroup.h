@@ -0,0 +1,215 @@
+/*
+    ReaderGroup.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Drives several readers sharing one SPI bus, each selected by its own NSS pin, e.g. one antenna per tine and one on the mast.
+
+    Each reader is assigned an RF slot. Readers in the same slot are scanned together, interleaved; the detection is started on
+    every one of them before any result is read, so readers that work on their own (the PN532) run their RF exchanges at the
+    same time. Slots are scanned one after the other, and the fields of a slot are switched off before the next slot starts, so
+    antennas that would interfere with each other never radiate at the same time. Giving every reader its own slot scans them
+    round-robin.
+
+    A reader that stops answering (its detection cannot even be started) is initialized again in the middle of the scans,
+    without resetting the host; if it does not answer that either, it is left out. A reader left out, whether it failed then or
+    never answered at boot, is probed (initialized again) once every READER_PROBE_INTERVAL scans, so that one that was down for
+    longer, or was connected late, comes back; each probe of a reader that is still not answering costs its boot timeout, e.g.
+    PN532_BOOT_TIMEOUT.
+
+    A template over the type of the readers, any implementation of `Reader` (e.g. `PN532_Reader`, `PN5180_Reader`), so that
+    there is no runtime dispatch.
+
+    The following sources were referenced.
+
+    https://www.nxp.com/docs/en/user-guide/141520.pdf [PN532UM]
+*/
+
+#ifndef READERGROUP_H
+#define READERGROUP_H
+
+#include "Reader.h"
+#include "TokenLog.h"
+
+#ifndef MAX_READERS
+#define MAX_READERS                     4
+#endif
+
+#ifndef READER_PROBE_INTERVAL
+#define READER_PROBE_INTERVAL           50 // Scans between probes of a reader left out; at most 255
+#endif
+
+struct ReaderDetection {
+    unsigned char reader;       // Index of the reader, in the order the readers were added
+    ReaderTag tag;
+};
+
+template <typename Reader_Impl>
+class ReaderGroup {
+    public:
+        ReaderGroup() {
+            _num_readers = 0;
+            _num_slots = 0;
+            _recoveries = 0;
+        };
+
+        bool add_reader(Reader_Impl* reader, unsigned char rf_slot) {
+            /*
+                Add `reader` to the group, to be scanned in RF slot `rf_slot`; readers whose antennas are far enough apart not to
+                interfere may share a slot. Returns `false` if the group is full.
+            */
+
+            if (_num_readers == MAX_READERS) {
+                return false;
+            }
+
+            _readers[_num_readers] = reader;
+            _rf_slots[_num_readers] = rf_slot;
+            _present[_num_readers] = false;
+            _scans_absent[_num_readers] = 0;
+            _num_readers++;
+
+            if (rf_slot + 1 > _num_slots) {
+                _num_slots = rf_slot + 1;
+            }
+
+            return true;
+        };
+
+        unsigned char initialize(bool warm_start = false) {
+            /*
+                Initialize every reader; readers that do not respond are left out of the scans. Every reader keeps itself
+                deselected from construction, as they share MISO. `warm_start` is as for `Reader::initialize()`. Returns the
+                number of readers that responded.
+            */
+
+            unsigned char present = 0;
+
+            for (unsigned char i = 0; i < _num_readers; i++) {
+                if (initialize_reader(i, warm_start)) {
+                    present++;
+                }
+            }
+
+            return present;
+        };
+
+        bool reinitialize(unsigned char index) {
+            /*
+                Initialize reader `index` again, without a warm start, e.g. after it stopped answering; `scan()` does this by
+                itself. Returns `false`, leaving the reader out of the scans, if it does not respond.
+            */
+
+            _recoveries++;
+
+            bool answering = initialize_reader(index, false);
+            log_event(LOG_READER_REINITIALIZED, index, answering);
+
+            return answering;
+        };
+
+        unsigned int recoveries() {
+            // How many times a reader was initialized again
+            return _recoveries;
+        };
+
+        template <typename detection_callback>
+        unsigned char scan(detection_callback on_detection) {
+            /*
+                Look for a tag with every reader once, slot by slot, and call `on_detection(ReaderDetection* detection)` for each
+                tag found. The callback runs while the field of the reader is still on and the tag is still selected, so it may
+                go on to exchange data with the tag. Returns the number of detections.
+            */
+
+            unsigned char num_detections = 0;
+
+            for (unsigned char rf_slot = 0; rf_slot < _num_slots; rf_slot++) {
+                bool requested[MAX_READERS];
+
+                // Start the detection on every reader in the slot first; the PN532 returns as soon as it has ACK'ed
+                // LIST_PASSIVE_TARGETS, and works on the RF exchanges while the next is being started
+                for (unsigned char i = 0; i < _num_readers; i++) {
+                    requested[i] = false;
+
+                    if (_rf_slots[i] != rf_slot) {
+                        continue;
+                    }
+
+                    // Left out; probed every READER_PROBE_INTERVAL scans, which starts the count over, and scanned with the
+                    // others again as soon as it answers
+                    if (!_present[i] && (++_scans_absent[i] < READER_PROBE_INTERVAL || !reinitialize(i))) {
+                        continue;
+                    }
+
+                    requested[i] = _readers[i]->request_detection();
+
+                    // Not even started; the reader is not answering, e.g. after a brown-out reset it alone, so it is brought
+                    // back, and tried again
+                    if (!requested[i] && reinitialize(i)) {
+                        requested[i] = _readers[i]->request_detection();
+                    }
+                }
+
+                // Then collect the results
+                for (unsigned char i = 0; i < _num_readers; i++) {
+                    ReaderDetection detection;
+
+                    if (requested[i] && _readers[i]->read_detection(&detection.tag)) {
+                        detection.reader = i;
+                        on_detection(&detection);
+                        num_detections++;
+                    }
+                }
+
+                // Switch the fields off, so that this slot does not interfere with the next
+                if (_num_slots > 1) {
+                    for (unsigned char i = 0; i < _num_readers; i++) {
+                        if (requested[i]) {
+                            _readers[i]->set_rf_field(false);
+                        }
+                    }
+                }
+            }
+
+            return num_detections;
+        };
+
+        unsigned char num_readers() {
+            return _num_readers;
+        };
+
+        Reader_Impl* reader(unsigned char index) {
+            return _readers[index];
+        };
+
+        bool is_present(unsigned char index) {
+            return _present[index];
+        };
+
+    private:
+        Reader_Impl* _readers[MAX_READERS];
+        unsigned char _rf_slots[MAX_READERS];
+        bool _present[MAX_READERS];
+        unsigned char _num_readers;
+        unsigned char _num_slots;
+        unsigned int _recoveries;
+        unsigned char _scans_absent[MAX_READERS];    // Scans since a reader left out was last probed
+
+        bool initialize_reader(unsigned char index, bool warm_start) {
+            _present[index] = _readers[index]->initialize(warm_start);
+            _scans_absent[index] = 0;
+
+            // Stay quiet until this reader's slot comes up
+            if (_present[index] && _num_slots > 1) {
+                _readers[index]->set_rf_field(false);
+            }
+
+            return _present[index];
+        };
+};
+
+#endif
@@ -0,0 +1,54 @@
+/*
+    Registers.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    The emulated register file of the `native` build; nothing is compiled for the microcontroller.
+*/
+
+#include "Registers.h"
+
+#ifdef NATIVE
+
+EmulatedRegister emulated_registers[IO_REGISTER_SPACE];
+
+// Without hooks, the registers behave as plain memory
+static register_read_hook _on_read = nullptr;
+static register_write_hook _on_write = nullptr;
+
+void set_register_hooks(register_read_hook on_read, register_write_hook on_write) {
+    _on_read = on_read;
+    _on_write = on_write;
+};
+
+void reset_registers() {
+    for (unsigned int i = 0; i < IO_REGISTER_SPACE; i++) {
+        emulated_registers[i].value = 0;
+    }
+};
+
+unsigned char read_register(EmulatedRegister* io_register) {
+    unsigned int address = io_register - emulated_registers;
+
+    if (_on_read) {
+        return _on_read(address, io_register->value);
+    }
+
+    return io_register->value;
+};
+
+void write_register(EmulatedRegister* io_register, unsigned char value) {
+    unsigned int address = io_register - emulated_registers;
+
+    if (_on_write) {
+        io_register->value = _on_write(address, io_register->value, value);
+    } else {
+        io_register->value = value;
+    }
+};
+
+#endif
@@ -0,0 +1,91 @@
+/*
+    Registers.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Access to the memory mapped I/O registers of the ATMega328P, through `IO_REGISTER(address)`, which every library uses to
+    define its registers, e.g. `#define SPDR IO_REGISTER(0x4E)`.
+
+    On the microcontroller, `IO_REGISTER(address)` is the volatile byte at `address`. In the `native` build (NATIVE defined), it
+    is an `EmulatedRegister` in an emulated register file instead, and every read and write of it goes through hooks, through
+    which the `Emulator` (lib/Emulation) models the peripherals; so the libraries run unchanged on a computer.
+
+    The following sources were referenced.
+
+    https://ww1.microchip.com/downloads/en/DeviceDoc/Atmel-7810-Automotive-Microcontrollers-ATmega328P_Datasheet.pdf
+    [Section 30], [Section 31]
+*/
+
+#ifndef REGISTERS_H
+#define REGISTERS_H
+
+#ifdef NATIVE
+
+// Data memory addresses below this hold the I/O registers [Section 8.3]
+#define IO_REGISTER_SPACE   0x100
+
+class EmulatedRegister;
+
+// Called on every read of a register, with the value it holds; returns the value read
+typedef unsigned char (*register_read_hook)(unsigned int address, unsigned char stored);
+
+// Called on every write of a register, with the value it holds and the value written; returns the value it then holds
+typedef unsigned char (*register_write_hook)(unsigned int address, unsigned char stored, unsigned char written);
+
+void set_register_hooks(register_read_hook on_read, register_write_hook on_write);
+void reset_registers();
+
+unsigned char read_register(EmulatedRegister* io_register);
+void write_register(EmulatedRegister* io_register, unsigned char value);
+
+class EmulatedRegister {
+    public:
+        operator unsigned char() {
+            return read_register(this);
+        };
+
+        // Operands are taken as `int`, as the integer promotions leave them, and truncated to the register as on the microcontroller
+        EmulatedRegister& operator=(int value) {
+            write_register(this, (unsigned char)(value));
+            return *this;
+        };
+
+        EmulatedRegister& operator=(EmulatedRegister& other) {
+            write_register(this, (unsigned char)(other));
+            return *this;
+        };
+
+        // Read-modify-write, a read and then a write, as on the microcontroller
+        EmulatedRegister& operator|=(int value) {
+            write_register(this, (unsigned char)(read_register(this) | value));
+            return *this;
+        };
+
+        EmulatedRegister& operator&=(int value) {
+            write_register(this, (unsigned char)(read_register(this) & value));
+            return *this;
+        };
+
+        EmulatedRegister& operator^=(int value) {
+            write_register(this, (unsigned char)(read_register(this) ^ value));
+            return *this;
+        };
+
+        unsigned char value;
+};
+
+extern EmulatedRegister emulated_registers[IO_REGISTER_SPACE];
+
+#define IO_REGISTER(address)    (emulated_registers[(address)])
+
+#else
+
+#define IO_REGISTER(address)    (*((volatile unsigned char*)(address)))
+
+#endif
+
+#endif
@@ -18,6 +18,52 @@
 
 #include "Pins.h"
 #include "SPI.h"
+#include "Timer.h"
+
+#ifdef SPI_TRACE
+
+static SPITraceRecord _trace[SPI_TRACE_SIZE];
+static unsigned int _trace_head = 0;        // Next record to be written
+static unsigned int _trace_length = 0;
+static unsigned int _trace_dropped = 0;     // Records overwritten before they were read
+
+static void trace(unsigned char type, unsigned char sent, unsigned char received) {
+    SPITraceRecord* record = &_trace[_trace_head];
+
+    record->type = type;
+    record->sent = sent;
+    record->received = received;
+    record->ticks = tick_count();
+
+    _trace_head = (_trace_head + 1) % SPI_TRACE_SIZE;
+
+    if (_trace_length == SPI_TRACE_SIZE) {
+        _trace_dropped++;
+    } else {
+        _trace_length++;
+    }
+};
+
+bool spi_trace_read(SPITraceRecord* record) {
+    /*
+        Take the oldest record out of the trace; returns `false` if it is empty
+    */
+
+    if (_trace_length == 0) {
+        return false;
+    }
+
+    *record = _trace[(_trace_head + SPI_TRACE_SIZE - _trace_length) % SPI_TRACE_SIZE];
+    _trace_length--;
+
+    return true;
+};
+
+unsigned int spi_trace_dropped() {
+    return _trace_dropped;
+};
+
+#endif
 
 SPI_Master::SPI_Master() : _MOSI(B, 3), _MISO(B, 4), _SCK(B, 5) {
     ;
@@ -39,6 +85,23 @@ void SPI_Master::initialize(unsigned char data_order) {
     SPCR = (1 << SPE) | (1 << MSTR) | (1 << SPR0) | (data_order << DORD);
 };
 
+void SPI_Master::select(Pin* NSS) {
+    // Start a transaction with the slave whose slave select is `NSS`, by driving it low
+    NSS->deassert();
+
+#ifdef SPI_TRACE
+    trace(SPI_TRACE_SELECT, NSS->id(), 0);
+#endif
+};
+
+void SPI_Master::deselect(Pin* NSS) {
+    NSS->assert();
+
+#ifdef SPI_TRACE
+    trace(SPI_TRACE_DESELECT, NSS->id(), 0);
+#endif
+};
+
 bool SPI_Master::send_and_receive_byte(unsigned char send_byte, unsigned char* receive_byte) {
     // Follows the example in Section 18.2 and Section 18.5.2
 
@@ -51,10 +114,16 @@ bool SPI_Master::send_and_receive_byte(unsigned char send_byte, unsigned char* r
     }
 
     // SPDR now contains a byte received from the slave, save it in receive_byte if it is not a null pointer
+    unsigned char received = SPDR;
+
     if (receive_byte) {
-        *receive_byte = SPDR;
+        *receive_byte = received;
     }
 
+#ifdef SPI_TRACE
+    trace(SPI_TRACE_BYTE, send_byte, received);
+#endif
+
     return true;
 };
 
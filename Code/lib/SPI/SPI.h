@@ -20,16 +20,17 @@
 #define SPI_H
 
 #include "Pins.h"
+#include "Registers.h"
 
 #define MSB_FIRST   0
 #define LSB_FIRST   1
 
 // Relevant registers and bit positions [Section 31]
-#define PRR0    *((volatile unsigned char*)(0x64))
+#define PRR0    IO_REGISTER(0x64)
 
-#define SPCR    *((volatile unsigned char*)(0x4C))
-#define SPSR    *((volatile unsigned char*)(0x4D))
-#define SPDR    *((volatile unsigned char*)(0x4E))
+#define SPCR    IO_REGISTER(0x4C)
+#define SPSR    IO_REGISTER(0x4D)
+#define SPDR    IO_REGISTER(0x4E)
 
 #define PRSPI   2
 
@@ -39,12 +40,44 @@
 #define SPE     6
 #define SPIF    7
 
+/*
+    With SPI_TRACE defined, every transaction (NSS going low, the bytes exchanged, NSS going high) is recorded in a ring of
+    SPI_TRACE_SIZE records in SRAM, for capturing what a reader in the field does; read them out with `spi_trace_read()`. The
+    oldest records are overwritten when the ring is full. Each record is timestamped with `tick_count()`.
+*/
+
+// Record types
+#define SPI_TRACE_SELECT    'S' // `sent` is the id of the NSS pin
+#define SPI_TRACE_DESELECT  'D' // `sent` is the id of the NSS pin
+#define SPI_TRACE_BYTE      'B' // `sent` and `received` are the bytes exchanged
+
+struct SPITraceRecord {
+    unsigned char type;
+    unsigned char sent;
+    unsigned char received;
+    unsigned int ticks;
+};
+
+#ifdef SPI_TRACE
+
+#ifndef SPI_TRACE_SIZE
+#define SPI_TRACE_SIZE  128
+#endif
+
+bool spi_trace_read(SPITraceRecord* record);
+unsigned int spi_trace_dropped();
+
+#endif
+
 class SPI_Master {
     public:
-        SPI_Master(); // Assume SS is asserted and deasserted by the user
+        SPI_Master(); // The slave select of each slave is driven through `select()` and `deselect()`
         
         void initialize(unsigned char data_order);
 
+        void select(Pin* NSS);
+        void deselect(Pin* NSS);
+
         bool send_and_receive_byte(unsigned char send_byte, unsigned char* receive_byte);
 
         bool send(unsigned char* send_bytes, int num_bytes);
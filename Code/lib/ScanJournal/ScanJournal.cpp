@@ -0,0 +1,328 @@
+/*
+    ScanJournal.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    A persistent circular journal of scan events in the EEPROM, so that events are kept until the uplink acknowledges them, and
+    replayed if it does not.
+*/
+
+#include "EEPROMInterface.h"
+#include "CRC.h"
+#include "ScanJournal.h"
+
+#include "string.h"
+
+// Sequence numbers are 16 bits wide in the EEPROM; compare them modulo 2^16 regardless of the width of `unsigned int`
+static unsigned int distance(unsigned int from, unsigned int to) {
+    return (to - from) & 0xFFFF;
+};
+
+ScanJournal::ScanJournal(EEPROMInterface* eeprom, unsigned int start_address, unsigned char num_slots) {
+    /*
+        The journal occupies `num_slots` * JOURNAL_RECORD_SIZE bytes of the EEPROM from `start_address` onwards
+    */
+
+    _eeprom = eeprom;
+    _start_address = start_address;
+    _num_slots = num_slots;
+
+    _head = 0;
+    _next_sequence = 0;
+    _acknowledged = 0xFFFF;
+    _marked = 0xFFFF;
+    _next_to_send = 0;
+
+    _overwritten = 0;
+
+    _staged_first = 0;
+    _staged_count = 0;
+    _staged_bytes_written = 0;
+};
+
+void ScanJournal::initialize() {
+    /*
+        Recover the head of the journal and the oldest record not yet acknowledged from the contents of the EEPROM
+
+        The newest record is the valid record with the highest sequence number; the next record goes in the slot after it.
+    */
+
+    unsigned char raw[JOURNAL_RECORD_SIZE];
+
+    bool found = false;
+    unsigned int highest = 0;
+    unsigned char highest_slot = 0;
+
+    for (unsigned char slot = 0; slot < _num_slots; slot++) {
+        if (!read_slot(slot, raw)) {
+            continue; // Erased, or torn by a power loss while being written
+        }
+
+        unsigned int sequence = raw[JOURNAL_SEQUENCE_IDX] | ((unsigned int)(raw[JOURNAL_SEQUENCE_IDX + 1]) << 8);
+
+        if (!found || (distance(highest, sequence) != 0 && distance(highest, sequence) < 0x8000)) {
+            found = true;
+            highest = sequence;
+            highest_slot = slot;
+        }
+    }
+
+    if (found) {
+        _head = (highest_slot + 1) % _num_slots;
+        _next_sequence = (highest + 1) & 0xFFFF;
+    } else {
+        _head = 0;
+        _next_sequence = 0;
+    }
+
+    // Walk from the oldest slot to the newest to find the first record still pending
+    _acknowledged = (_next_sequence - 1) & 0xFFFF;
+
+    for (unsigned int age = _num_slots; age > 0; age--) {
+        unsigned int sequence = (_next_sequence - age) & 0xFFFF;
+
+        if (!read_slot(slot_of(sequence), raw)) {
+            continue;
+        }
+
+        unsigned int stored = raw[JOURNAL_SEQUENCE_IDX] | ((unsigned int)(raw[JOURNAL_SEQUENCE_IDX + 1]) << 8);
+
+        if (stored == sequence && raw[JOURNAL_STATE_IDX] == JOURNAL_PENDING) {
+            _acknowledged = (sequence - 1) & 0xFFFF;
+            break;
+        }
+    }
+
+    _marked = _acknowledged;
+    _next_to_send = (_acknowledged + 1) & 0xFFFF;
+};
+
+unsigned int ScanJournal::append(JournalRecord* record) {
+    /*
+        Assign the next sequence number to `record` and add it to the journal; returns the sequence number
+
+        The record is staged in SRAM and written to the EEPROM by `service()`. If every slot holds a record not yet acknowledged,
+        the oldest of them is overwritten and counted in `overwritten()`.
+    */
+
+    // The EEPROM is falling behind; write out the oldest staged record before accepting another
+    while (_staged_count == JOURNAL_STAGING_CAPACITY) {
+        service();
+    }
+
+    if (pending() == _num_slots) {
+        _acknowledged = (_acknowledged + 1) & 0xFFFF;
+        _overwritten++;
+
+        if (distance(_acknowledged, _next_to_send) == 0) {
+            _next_to_send = (_acknowledged + 1) & 0xFFFF;
+        }
+    }
+
+    record->sequence = _next_sequence;
+
+    unsigned char staged = (_staged_first + _staged_count) % JOURNAL_STAGING_CAPACITY;
+    encode(record, _staged[staged]);
+    _staged_slot[staged] = _head;
+    _staged_count++;
+
+    _head = (_head + 1) % _num_slots;
+    _next_sequence = (_next_sequence + 1) & 0xFFFF;
+
+    return record->sequence;
+};
+
+bool ScanJournal::next_unsent(JournalRecord* record) {
+    /*
+        Place the next record that has not been sent to the uplink yet in `record`; returns `false` if every record not yet
+        acknowledged has already been sent
+    */
+
+    unsigned char raw[JOURNAL_RECORD_SIZE];
+
+    while (distance(_next_to_send, _next_sequence) != 0) {
+        unsigned int sequence = _next_to_send;
+        _next_to_send = (_next_to_send + 1) & 0xFFFF;
+
+        if (!read_slot(slot_of(sequence), raw)) {
+            continue;
+        }
+
+        decode(raw, record);
+
+        if (record->sequence == sequence && raw[JOURNAL_STATE_IDX] == JOURNAL_PENDING) {
+            return true;
+        }
+    }
+
+    return false;
+};
+
+void ScanJournal::acknowledge(unsigned int sequence) {
+    /*
+        The uplink has received every record up to and including `sequence`; they will not be sent again, and are marked as
+        acknowledged in the EEPROM by `service()`
+    */
+
+    sequence &= 0xFFFF;
+
+    unsigned int acknowledgeable = distance(_acknowledged, _next_sequence) - 1;
+    unsigned int advance = distance(_acknowledged, sequence);
+
+    if (advance == 0 || advance > acknowledgeable) {
+        return; // Stale or unknown sequence number
+    }
+
+    _acknowledged = sequence;
+
+    if (distance(_acknowledged, _next_to_send) > distance(_acknowledged, _next_sequence)) {
+        _next_to_send = (_acknowledged + 1) & 0xFFFF;
+    }
+};
+
+void ScanJournal::rewind() {
+    /*
+        Send every record not yet acknowledged again, starting with the oldest; use when the uplink reconnects or stops
+        acknowledging
+    */
+
+    _next_to_send = (_acknowledged + 1) & 0xFFFF;
+};
+
+void ScanJournal::service() {
+    /*
+        Write staged records, then acknowledgement marks, to the EEPROM for as long as it can accept bytes without waiting
+
+        Call as often as possible while idle. Bytes that do not change are skipped, so only one real write happens per call.
+    */
+
+    while (_eeprom->ready()) {
+        if (_staged_count > 0) {
+            unsigned char* raw = _staged[_staged_first];
+            unsigned int address = slot_address(_staged_slot[_staged_first]) + _staged_bytes_written;
+
+            // The CRC is the last byte written, so a record torn by a power loss is never taken to be valid
+            _eeprom->write_byte(address, raw[_staged_bytes_written]);
+            _staged_bytes_written++;
+
+            if (_staged_bytes_written == JOURNAL_RECORD_SIZE) {
+                _staged_first = (_staged_first + 1) % JOURNAL_STAGING_CAPACITY;
+                _staged_count--;
+                _staged_bytes_written = 0;
+            }
+        } else if (_marked != _acknowledged) {
+            unsigned int sequence = (_marked + 1) & 0xFFFF;
+            _marked = sequence;
+
+            if (distance(sequence, _next_sequence) > _num_slots) {
+                continue; // Overwritten already
+            }
+
+            unsigned char raw[JOURNAL_RECORD_SIZE];
+            unsigned char slot = slot_of(sequence);
+
+            if (read_slot(slot, raw) && raw[JOURNAL_STATE_IDX] == JOURNAL_PENDING) {
+                _eeprom->write_byte(slot_address(slot) + JOURNAL_STATE_IDX, JOURNAL_ACKNOWLEDGED);
+            }
+        } else {
+            return;
+        }
+    }
+};
+
+unsigned int ScanJournal::pending() {
+    // Records not yet acknowledged
+    return distance(_acknowledged, _next_sequence) - 1;
+};
+
+unsigned int ScanJournal::unsent() {
+    return distance(_next_to_send, _next_sequence);
+};
+
+unsigned long ScanJournal::overwritten() {
+    return _overwritten;
+};
+
+unsigned int ScanJournal::next_sequence() {
+    return _next_sequence;
+};
+
+unsigned int ScanJournal::slot_address(unsigned char slot) {
+    return _start_address + (unsigned int)(slot) * JOURNAL_RECORD_SIZE;
+};
+
+unsigned char ScanJournal::slot_of(unsigned int sequence) {
+    /*
+        Consecutive sequence numbers occupy consecutive slots, so the slot of a recent record follows from how far behind the
+        head it is
+    */
+
+    unsigned int age = distance(sequence, _next_sequence) % _num_slots;
+    return (_head + _num_slots - age) % _num_slots;
+};
+
+bool ScanJournal::read_slot(unsigned char slot, unsigned char* raw) {
+    /*
+        Read the record in `slot` into `raw`, from the staging area if it has not been completely written out yet, and check its
+        CRC; returns `true` if it holds a valid record
+    */
+
+    bool staged = false;
+
+    // The newest staged copy of a slot is the current one
+    for (unsigned char i = 0; i < _staged_count; i++) {
+        unsigned char index = (_staged_first + i) % JOURNAL_STAGING_CAPACITY;
+
+        if (_staged_slot[index] == slot) {
+            memcpy(raw, _staged[index], JOURNAL_RECORD_SIZE);
+            staged = true;
+        }
+    }
+
+    if (!staged) {
+        _eeprom->read(slot_address(slot), raw, JOURNAL_RECORD_SIZE);
+    }
+
+    // The CRC covers every byte except the state, which changes when the record is acknowledged, and the CRC itself
+    unsigned char crc = crc8(raw, JOURNAL_STATE_IDX);
+    crc = crc8(raw + JOURNAL_TYPE_IDX, JOURNAL_CRC_IDX - JOURNAL_TYPE_IDX, crc);
+
+    return (crc == raw[JOURNAL_CRC_IDX]) && (raw[JOURNAL_UID_LEN_IDX] <= MAX_UID_LENGTH);
+};
+
+void ScanJournal::encode(JournalRecord* record, unsigned char* raw) {
+    memset(raw, 0, JOURNAL_RECORD_SIZE);
+
+    raw[JOURNAL_SEQUENCE_IDX] = (unsigned char)(record->sequence);
+    raw[JOURNAL_SEQUENCE_IDX + 1] = (unsigned char)(record->sequence >> 8);
+    raw[JOURNAL_STATE_IDX] = JOURNAL_PENDING;
+    raw[JOURNAL_TYPE_IDX] = (record->reader << 4) | (record->type & 0x0F);
+    raw[JOURNAL_UID_LEN_IDX] = record->uid_length;
+
+    memcpy(raw + JOURNAL_UID_IDX, record->uid, record->uid_length);
+
+    for (int i = 0; i < 4; i++) {
+        raw[JOURNAL_TIMESTAMP_IDX + i] = (unsigned char)(record->timestamp >> (8 * i));
+    }
+
+    unsigned char crc = crc8(raw, JOURNAL_STATE_IDX);
+    raw[JOURNAL_CRC_IDX] = crc8(raw + JOURNAL_TYPE_IDX, JOURNAL_CRC_IDX - JOURNAL_TYPE_IDX, crc);
+};
+
+void ScanJournal::decode(unsigned char* raw, JournalRecord* record) {
+    record->sequence = raw[JOURNAL_SEQUENCE_IDX] | ((unsigned int)(raw[JOURNAL_SEQUENCE_IDX + 1]) << 8);
+    record->type = raw[JOURNAL_TYPE_IDX] & 0x0F;
+    record->reader = raw[JOURNAL_TYPE_IDX] >> 4;
+    record->uid_length = raw[JOURNAL_UID_LEN_IDX];
+
+    memcpy(record->uid, raw + JOURNAL_UID_IDX, record->uid_length);
+
+    record->timestamp = 0;
+    for (int i = 0; i < 4; i++) {
+        record->timestamp |= (unsigned long)(raw[JOURNAL_TIMESTAMP_IDX + i]) << (8 * i);
+    }
+};
@@ -0,0 +1,104 @@
+/*
+    ScanJournal.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    A persistent circular journal of scan events in the EEPROM, so that events are kept until the uplink acknowledges them, and
+    replayed if it does not.
+
+    Records are appended to consecutive slots of a region of the EEPROM, each carrying a sequence number and a CRC. No head or
+    tail pointer is stored; both are recovered at start up by looking for the highest sequence number, so every slot is written
+    equally often (wear leveling). Appended records are staged in SRAM and written out a byte at a time by `service()`, so
+    scanning never waits on the 3.4 ms EEPROM writes.
+*/
+
+#ifndef SCANJOURNAL_H
+#define SCANJOURNAL_H
+
+#include "EEPROMInterface.h"
+#include "CRC.h"
+
+#ifndef MAX_UID_LENGTH
+#define MAX_UID_LENGTH              10 // Triple size UID
+#endif
+
+#ifndef JOURNAL_STAGING_CAPACITY
+#define JOURNAL_STAGING_CAPACITY    4 // Records waiting in SRAM to be written to the EEPROM
+#endif
+
+// Record Layout
+#define JOURNAL_SEQUENCE_IDX        0 // 2 bytes, LSB first
+#define JOURNAL_STATE_IDX           2
+#define JOURNAL_TYPE_IDX            3 // Event type in the low nibble, reader index in the high nibble
+#define JOURNAL_UID_LEN_IDX         4
+#define JOURNAL_UID_IDX             5 // MAX_UID_LENGTH bytes
+#define JOURNAL_TIMESTAMP_IDX       15 // 4 bytes, LSB first
+#define JOURNAL_CRC_IDX             19
+
+#define JOURNAL_RECORD_SIZE         20
+
+// Record States; an erased EEPROM cell reads 0xFF, so a freshly written record is pending without writing the state byte
+#define JOURNAL_PENDING             0xFF
+#define JOURNAL_ACKNOWLEDGED        0x00
+
+struct JournalRecord {
+    unsigned int sequence;
+    unsigned char type;
+    unsigned char reader;
+    unsigned char uid[MAX_UID_LENGTH];
+    unsigned char uid_length;
+    unsigned long timestamp;
+};
+
+class ScanJournal {
+    public:
+        ScanJournal(EEPROMInterface* eeprom, unsigned int start_address, unsigned char num_slots);
+
+        void initialize();
+
+        unsigned int append(JournalRecord* record);
+        bool next_unsent(JournalRecord* record);
+
+        void acknowledge(unsigned int sequence);
+        void rewind();
+
+        void service();
+
+        unsigned int pending();
+        unsigned int unsent();
+        unsigned long overwritten();
+        unsigned int next_sequence();
+
+    private:
+        unsigned int slot_address(unsigned char slot);
+        unsigned char slot_of(unsigned int sequence);
+
+        bool read_slot(unsigned char slot, unsigned char* raw);
+        void encode(JournalRecord* record, unsigned char* raw);
+        void decode(unsigned char* raw, JournalRecord* record);
+
+        EEPROMInterface* _eeprom;
+        unsigned int _start_address;
+        unsigned char _num_slots;
+
+        unsigned char _head;                // Slot the next record goes in
+        unsigned int _next_sequence;        // Sequence number of the next record
+        unsigned int _acknowledged;         // Every record up to and including this sequence number has been acknowledged
+        unsigned int _marked;               // Every acknowledged record up to this one is marked so in the EEPROM
+        unsigned int _next_to_send;
+
+        unsigned long _overwritten;
+
+        // Records appended but not yet completely written to the EEPROM, oldest first
+        unsigned char _staged[JOURNAL_STAGING_CAPACITY][JOURNAL_RECORD_SIZE];
+        unsigned char _staged_slot[JOURNAL_STAGING_CAPACITY];
+        unsigned char _staged_first;
+        unsigned char _staged_count;
+        unsigned char _staged_bytes_written; // Of the oldest staged record
+};
+
+#endif
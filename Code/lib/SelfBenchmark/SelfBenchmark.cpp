@@ -0,0 +1,57 @@
+/*
+    SelfBenchmark.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Times operations of the firmware on the microcontroller itself, against a real reader and a tag held in its field.
+*/
+
+#include "SelfBenchmark.h"
+
+void self_benchmark_reset(SelfBenchmarkResult* result) {
+    result->runs = 0;
+    result->failures = 0;
+    result->total = 0;
+    result->fastest = 0xFFFFFFFF;
+    result->slowest = 0;
+};
+
+void self_benchmark_record(SelfBenchmarkResult* result, unsigned long duration, bool succeeded) {
+    /*
+        Add a run that took `duration` microseconds; only successful runs count towards the latency, as a failed one (e.g. no
+        tag answering) takes however long the reader waits before giving up
+    */
+
+    result->runs++;
+
+    if (!succeeded) {
+        result->failures++;
+        return;
+    }
+
+    result->total += duration;
+
+    if (duration < result->fastest) {
+        result->fastest = duration;
+    }
+
+    if (duration > result->slowest) {
+        result->slowest = duration;
+    }
+};
+
+unsigned long self_benchmark_mean(SelfBenchmarkResult* result) {
+    // Mean latency of the successful runs, in microseconds; 0 if there were none
+    unsigned int successes = result->runs - result->failures;
+
+    return (successes > 0) ? result->total / successes : 0;
+};
+
+float self_benchmark_rate(SelfBenchmarkResult* result) {
+    // Successful runs per second, back to back
+    return (result->total > 0) ? (result->runs - result->failures) * 1000000.0 / result->total : 0;
+};
@@ -0,0 +1,65 @@
+/*
+    SelfBenchmark.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Times operations of the firmware on the microcontroller itself, against a real reader and a tag held in its field, to compare
+    antennas, enclosures, reader settings and builds; the `Benchmark` library does the same against simulated chips, and only
+    on a computer.
+
+    Each run is timed with Timer 1 (`current_time(MICROSECONDS)`, to 4 microseconds). There is no room in SRAM to keep every
+    sample, so only the count, the failures, the total, and the fastest and slowest successful runs are kept; from them, the
+    mean latency and the sustained rate.
+*/
+
+#ifndef SELFBENCHMARK_H
+#define SELFBENCHMARK_H
+
+#include "Timer.h"
+
+#ifndef SELF_BENCHMARK_MAX_RUNS
+#define SELF_BENCHMARK_MAX_RUNS     1000 // Keeps the total in microseconds well within an unsigned long
+#endif
+
+struct SelfBenchmarkResult {
+    unsigned int runs;
+    unsigned int failures;
+
+    // Of the successful runs, in microseconds
+    unsigned long total;
+    unsigned long fastest;
+    unsigned long slowest;
+};
+
+void self_benchmark_reset(SelfBenchmarkResult* result);
+void self_benchmark_record(SelfBenchmarkResult* result, unsigned long duration, bool succeeded);
+
+unsigned long self_benchmark_mean(SelfBenchmarkResult* result);
+float self_benchmark_rate(SelfBenchmarkResult* result);
+
+template <typename operation>
+void self_benchmark(int runs, operation run, SelfBenchmarkResult* result) {
+    /*
+        Run `bool run()` `runs` times (at most SELF_BENCHMARK_MAX_RUNS), timing each, and place the results in `result`; `run`
+        returns whether it succeeded, e.g. whether a tag was detected and read
+    */
+
+    self_benchmark_reset(result);
+
+    if (runs > SELF_BENCHMARK_MAX_RUNS) {
+        runs = SELF_BENCHMARK_MAX_RUNS;
+    }
+
+    for (int i = 0; i < runs; i++) {
+        unsigned long start = current_time(MICROSECONDS);
+        bool succeeded = run();
+
+        self_benchmark_record(result, current_time(MICROSECONDS) - start, succeeded);
+    }
+};
+
+#endif
@@ -19,18 +19,20 @@
 #ifndef SERIALINTERFACE_H
 #define SERIALINTERFACE_H
 
+#include "Registers.h"
+
 #ifndef CPU_FREQ
 #define CPU_FREQ    16000000 // 16 MHz
 #endif
 
 // Relevant registers and bit positions [Section 31]
-#define UCSR0A      *((volatile unsigned char*)(0xC0))
-#define UCSR0B      *((volatile unsigned char*)(0xC1))
-#define UCSR0C      *((volatile unsigned char*)(0xC2))
+#define UCSR0A      IO_REGISTER(0xC0)
+#define UCSR0B      IO_REGISTER(0xC1)
+#define UCSR0C      IO_REGISTER(0xC2)
 
-#define UBRR0L      *((volatile unsigned char*)(0xC4))
-#define UBRR0H      *((volatile unsigned char*)(0xC5))
-#define UDR0        *((volatile unsigned char*)(0xC6))
+#define UBRR0L      IO_REGISTER(0xC4)
+#define UBRR0H      IO_REGISTER(0xC5)
+#define UDR0        IO_REGISTER(0xC6)
 
 #define UCSZ00      1
 #define UCSZ01      2
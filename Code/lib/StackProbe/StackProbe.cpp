@@ -0,0 +1,105 @@
+/*
+    StackProbe.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Measures the deepest the stack has grown since boot (its high-water mark), by painting the free SRAM between the heap and the
+    stack with a known byte at startup, and later finding the lowest address overwritten.
+
+    The following sources were referenced.
+
+    https://ww1.microchip.com/downloads/en/DeviceDoc/Atmel-7810-Automotive-Microcontrollers-ATmega328P_Datasheet.pdf
+    [Section 7.5], [Section 8.3]
+    https://www.nongnu.org/avr-libc/user-manual/malloc.html
+*/
+
+#include "Registers.h"
+#include "StackProbe.h"
+
+#ifndef NATIVE
+
+// Stack Pointer and Status Register [Section 7.5]
+#define SPL     IO_REGISTER(0x5D)
+#define SPH     IO_REGISTER(0x5E)
+#define SREG    IO_REGISTER(0x5F)
+
+#define SREG_I  7 // Global Interrupt Enable
+
+// Set by the linker and by malloc(); the heap starts at `__heap_start`, and ends at `__brkval` once anything is allocated
+extern unsigned char __heap_start;
+extern char* __brkval;
+
+static unsigned char* heap_end() {
+    return __brkval ? (unsigned char*)(__brkval) : &__heap_start;
+};
+
+static unsigned char* lowest_overwritten() {
+    /*
+        Find the lowest address above the heap that no longer holds the paint; the stack has reached down to there
+    */
+
+    unsigned char* address = heap_end();
+
+    while (address <= (unsigned char*)(STACK_PROBE_RAMEND) && *address == STACK_PROBE_PAINT) {
+        address++;
+    }
+
+    return address;
+};
+
+void stack_probe_paint() {
+    /*
+        Paint the free SRAM between the end of the heap and the stack pointer; call first thing in `setup()`, before the stack has
+        been any deeper
+
+        Interrupts are held off meanwhile, as an interrupt would push onto the very bytes being painted.
+    */
+
+    unsigned char status = SREG;
+    SREG = status & ~(1 << SREG_I);
+
+    // The stack pointer points at the next free byte, below everything in use [Section 7.5]
+    unsigned char* stack_pointer = (unsigned char*)((SPH << 8) | SPL);
+
+    for (unsigned char* address = heap_end(); address < stack_pointer; address++) {
+        *address = STACK_PROBE_PAINT;
+    }
+
+    SREG = status;
+};
+
+unsigned int stack_probe_high_water() {
+    /*
+        The most bytes of stack used at any time since `stack_probe_paint()`, counted from the end of SRAM
+    */
+
+    return (unsigned int)((unsigned char*)(STACK_PROBE_RAMEND) - lowest_overwritten()) + 1;
+};
+
+unsigned int stack_probe_unused() {
+    /*
+        The bytes between the heap and the deepest the stack has reached, that neither has ever used
+    */
+
+    return (unsigned int)(lowest_overwritten() - heap_end());
+};
+
+#else
+
+void stack_probe_paint() {
+    ;
+};
+
+unsigned int stack_probe_high_water() {
+    return 0;
+};
+
+unsigned int stack_probe_unused() {
+    return 0;
+};
+
+#endif
@@ -0,0 +1,41 @@
+/*
+    StackProbe.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Measures the deepest the stack has grown since boot (its high-water mark), by painting the free SRAM between the heap and the
+    stack with a known byte at startup, and later finding the lowest address overwritten. There is no memory protection; a stack
+    that grows into the heap or the globals corrupts them silently, so this tells how much headroom is actually left.
+
+    A stack byte that happens to hold the paint byte is counted as unused, so the result may be short by a few bytes. In the
+    `native` build, where the stack is the computer's, there is nothing to measure and both functions return 0.
+
+    The following sources were referenced.
+
+    https://ww1.microchip.com/downloads/en/DeviceDoc/Atmel-7810-Automotive-Microcontrollers-ATmega328P_Datasheet.pdf
+    [Section 7.5], [Section 8.3]
+    https://www.nongnu.org/avr-libc/user-manual/malloc.html
+*/
+
+#ifndef STACKPROBE_H
+#define STACKPROBE_H
+
+#define STACK_PROBE_PAINT   0xC5
+
+// Last address of SRAM, where the stack starts [Section 8.3]
+#if defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
+#define STACK_PROBE_RAMEND  0x21FF
+#else
+#define STACK_PROBE_RAMEND  0x08FF // ATMega328P
+#endif
+
+void stack_probe_paint();
+
+unsigned int stack_probe_high_water();
+unsigned int stack_probe_unused();
+
+#endif
@@ -14,11 +14,17 @@
     The following sources were referenced.
 
     https://ww1.microchip.com/downloads/en/DeviceDoc/Atmel-7810-Automotive-Microcontrollers-ATmega328P_Datasheet.pdf
-    [Section 14]
+    [Section 14], [Section 15]
 */
 
 #include "Timer.h"
 
+// Time elapsed since `initialize_tick_counter()`, accumulated from Timer 1 every time `current_time()` is called
+static unsigned int _last_tick_count = 0;
+static unsigned long _elapsed_microseconds = 0;
+static unsigned long _elapsed_milliseconds = 0;
+static unsigned int _microsecond_remainder = 0;
+
 void initialize_timer() {
     /*
         Initialize Timer 0 with the specified prescaler
@@ -65,11 +71,12 @@ bool blocking_delay(unsigned long duration, unsigned char unit) {
         For microsecond precision, we need (Prescaling Factor / CPU_FREQ) * OCR0A = 0.000001 seconds, so Prescaling Factor * OCR0A =
         16000000 * 0.000001 = 16, so we can use a prescaling factor of 1 and OCR0A = 16.
     */
+    // The CS bits are replaced, not OR'ed in; a microsecond delay after a millisecond delay would otherwise keep the prescaler of 64
     if (unit == MILLISECONDS) {
-        TCCR0B |= PRESCALER_64;
+        TCCR0B = (TCCR0B & 0b11111000) | PRESCALER_64;
         OCR0A = 250;
     } else if (unit == MICROSECONDS) {
-        TCCR0B |= NO_PRESCALER;
+        TCCR0B = (TCCR0B & 0b11111000) | NO_PRESCALER;
         OCR0A = 16;
     } else {
         return false;
@@ -85,7 +92,74 @@ bool blocking_delay(unsigned long duration, unsigned char unit) {
         TIFR0 |= (1 << OCF0A);
 
         ticks_counted++;
+
+        // Keep the tick counter from missing a Timer 1 wrap around during long delays
+        if (unit == MILLISECONDS) {
+            current_time(MILLISECONDS);
+        }
     }
 
     return true;
+};
+
+void initialize_tick_counter() {
+    /*
+        Let Timer 1 count freely in the Normal Mode with a prescaling factor of 64 [Section 15.9.1], [Section 15.11]
+    */
+
+    // Keep OC1A and OC1B disconnected, and clear the WGM bits for the Normal Mode
+    TCCR1A = 0;
+    TCCR1B = PRESCALER_64;
+
+    // The high byte must be written first, it is latched into TEMP and written with the low byte [Section 15.3]
+    TCNT1H = 0;
+    TCNT1L = 0;
+
+    _last_tick_count = 0;
+    _elapsed_microseconds = 0;
+    _elapsed_milliseconds = 0;
+    _microsecond_remainder = 0;
+};
+
+unsigned long current_time(unsigned char unit) {
+    /*
+        Return the time elapsed since `initialize_tick_counter()` in `unit`s (MILLISECONDS or MICROSECONDS)
+
+        TCNT1 wraps around every 262.144 milliseconds, so this must be called at least that often for the elapsed time to stay
+        correct; `blocking_delay()` does so on its own. Both values wrap around at 2^32, so intervals must be computed by unsigned
+        subtraction, e.g. `current_time(MILLISECONDS) - start`.
+    */
+
+    // The low byte must be read first, the high byte is latched into TEMP when it is read [Section 15.3]
+    unsigned char low = TCNT1L;
+    unsigned char high = TCNT1H;
+    unsigned int tick_count = ((unsigned int)(high) << 8) | low;
+
+    // Unsigned 16-bit subtraction handles a single wrap around of TCNT1; masked, as `unsigned int` is wider on the native build
+    unsigned long elapsed = (unsigned long)((unsigned int)(tick_count - _last_tick_count) & 0xFFFF) * TICK_MICROSECONDS;
+    _last_tick_count = tick_count;
+
+    _elapsed_microseconds += elapsed;
+
+    elapsed += _microsecond_remainder;
+    _elapsed_milliseconds += elapsed / 1000;
+    _microsecond_remainder = elapsed % 1000;
+
+    if (unit == MILLISECONDS) {
+        return _elapsed_milliseconds;
+    } else {
+        return _elapsed_microseconds;
+    }
+};
+
+unsigned int tick_count() {
+    /*
+        Return TCNT1 as it is, in ticks of TICK_MICROSECONDS; cheaper than `current_time()` where only short intervals are timed,
+        as it wraps around every 262.144 milliseconds. Does not affect `current_time()`.
+    */
+
+    unsigned char low = TCNT1L;
+    unsigned char high = TCNT1H;
+
+    return ((unsigned int)(high) << 8) | low;
 };
\ No newline at end of file
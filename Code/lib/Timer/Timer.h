@@ -14,22 +14,32 @@
     The following sources were referenced.
 
     https://ww1.microchip.com/downloads/en/DeviceDoc/Atmel-7810-Automotive-Microcontrollers-ATmega328P_Datasheet.pdf
-    [Section 14]
+    [Section 14], [Section 15]
 */
 
 #ifndef TIMER_H
 #define TIMER_H
 
+#include "Registers.h"
+
 // Relevant registers and bit positions [Section 31]
-#define TIFR0       *((volatile unsigned char*)(0x35))
+#define TIFR0       IO_REGISTER(0x35)
+
+#define TCCR0A      IO_REGISTER(0x44)
+#define TCCR0B      IO_REGISTER(0x45)
+
+#define TCNT0       IO_REGISTER(0x46)
+#define OCR0A       IO_REGISTER(0x47)
 
-#define TCCR0A      *((volatile unsigned char*)(0x44))
-#define TCCR0B      *((volatile unsigned char*)(0x45))
+#define TIMSK0      IO_REGISTER(0x6E)
 
-#define TCNT0       *((volatile unsigned char*)(0x46))
-#define OCR0A       *((volatile unsigned char*)(0x47))
+#define TIFR1       IO_REGISTER(0x36)
 
-#define TIMSK0      *((volatile unsigned char*)(0x6E))
+#define TCCR1A      IO_REGISTER(0x80)
+#define TCCR1B      IO_REGISTER(0x81)
+
+#define TCNT1L      IO_REGISTER(0x84)
+#define TCNT1H      IO_REGISTER(0x85)
 
 #define OCF0A           1
 
@@ -59,7 +69,15 @@
 #define MILLISECONDS    0
 #define MICROSECONDS    1
 
+// Timer 1 runs free with a prescaling factor of 64, so TCNT1 is incremented every 64 / 16 MHz = 4 microseconds, and wraps
+// around every 65536 * 4 microseconds = 262.144 milliseconds
+#define TICK_MICROSECONDS   4
+
 void initialize_timer();
 bool blocking_delay(unsigned long milliseconds, unsigned char unit);
 
+void initialize_tick_counter();
+unsigned long current_time(unsigned char unit);
+unsigned int tick_count();
+
 #endif
\ No newline at end of file
@@ -0,0 +1,51 @@
+/*
+    LogTokens.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Every message the firmware logs with `TokenLog`, as a token and the text it stands for. The firmware only ever sends the
+    token, numbered in the order below, and the arguments; the text stays here, out of the flash and off the serial port, and
+    `src/log_decoder` puts the two back together.
+
+    Each entry is TOKEN(name, kind, text). The arguments of a LOG_VALUES message are unsigned longs, placed in the text as by
+    printf() with one %lu, %lX (or similar) per argument; the argument of a LOG_BYTES message is a byte string, printed after the
+    text in hexadecimal.
+
+    Only ever add entries at the end, so that logs captured from older builds still decode.
+*/
+
+#ifndef LOG_TOKENS_H
+#define LOG_TOKENS_H
+
+#define LOG_VALUES      0
+#define LOG_BYTES       1
+
+#define LOG_TOKENS(TOKEN) \
+    TOKEN(LOG_DROPPED,              LOG_VALUES, "%lu messages dropped, the log was full") \
+    TOKEN(LOG_BOOT,                 LOG_VALUES, "boot, warm start %lu") \
+    TOKEN(LOG_PALLET,               LOG_VALUES, "pallet SKU %lu quantity %lu destination %lu shipment %lu sequence %lu") \
+    TOKEN(LOG_NO_PALLET,            LOG_BYTES,  "no pallet record on tag") \
+    TOKEN(LOG_WRITE_FAILED,         LOG_VALUES, "write %lu failed, attempt %lu") \
+    TOKEN(LOG_READER_REINITIALIZED, LOG_VALUES, "reader %lu initialized again, answering %lu") \
+    TOKEN(LOG_PN532_CORRUPTED,      LOG_VALUES, "PN532 on pin %lu sent a corrupted response, attempt %lu") \
+    TOKEN(LOG_PN5180_TX_STATE,      LOG_VALUES, "PN5180 not waiting to transmit, RF_STATUS %08lX") \
+    TOKEN(LOG_PN5180_RX_ERROR,      LOG_VALUES, "PN5180 received a frame with errors, RX_STATUS %08lX") \
+    TOKEN(LOG_UNEXPECTED_PALLET,    LOG_BYTES,  "pallet not on the manifest") \
+    TOKEN(LOG_MANIFEST_COMPLETE,    LOG_VALUES, "shipment %lu loaded, %lu pallets") \
+    TOKEN(LOG_PN532_TOO_LONG,       LOG_VALUES, "PN532 on pin %lu sent a response of %lu bytes, too long to take") \
+    TOKEN(LOG_PALLET_NO_ROOM,       LOG_BYTES,  "no room for a pallet record beside the NDEF data of tag")
+
+#define LOG_TOKEN_ID(name, kind, text) name,
+
+enum LogToken {
+    LOG_TOKENS(LOG_TOKEN_ID)
+    LOG_NUM_TOKENS
+};
+
+#undef LOG_TOKEN_ID
+
+#endif
@@ -0,0 +1,124 @@
+/*
+    TokenLog.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    A log of tokens and binary arguments, kept in a ring in SRAM until there is time to send it.
+*/
+
+#include "TokenLog.h"
+#include "Timer.h"
+
+static unsigned char _log[LOG_BUFFER_SIZE];
+static unsigned int _log_head = 0;          // Next byte to be written
+static unsigned int _log_length = 0;
+static unsigned long _log_dropped = 0;      // Messages dropped since the last LOG_DROPPED
+
+static void put(unsigned char byte) {
+    _log[_log_head] = byte;
+    _log_head = (_log_head + 1) % LOG_BUFFER_SIZE;
+    _log_length++;
+};
+
+static void put_long(unsigned long value) {
+    for (int i = 0; i < 4; i++) {
+        put((value >> (8 * i)) & 0xFF);
+    }
+};
+
+static bool append(unsigned char token, const unsigned char* arguments, unsigned char length) {
+    // Copy a record into the ring if it fits whole; returns `false` if it does not
+    if (_log_length + LOG_HEADER_SIZE + length > LOG_BUFFER_SIZE) {
+        return false;
+    }
+
+    put(token);
+    put(length);
+    put_long(current_time(MILLISECONDS));
+
+    for (int i = 0; i < length; i++) {
+        put(arguments[i]);
+    }
+
+    return true;
+};
+
+void log_write(unsigned char token, const unsigned char* arguments, unsigned char length) {
+    /*
+        Log the message `token`, with `length` bytes of arguments already laid out as in the record; see `log_event()` and
+        `log_bytes()`. Arguments longer than LOG_MAX_ARGUMENTS_SIZE are cut short.
+    */
+
+    if (length > LOG_MAX_ARGUMENTS_SIZE) {
+        length = LOG_MAX_ARGUMENTS_SIZE;
+    }
+
+    // The drops are reported before anything newer, so that the gap shows where it was
+    if (_log_dropped > 0) {
+        unsigned char dropped[4];
+
+        for (int i = 0; i < 4; i++) {
+            dropped[i] = (_log_dropped >> (8 * i)) & 0xFF;
+        }
+
+        if (_log_length + LOG_HEADER_SIZE + 4 + LOG_HEADER_SIZE + length > LOG_BUFFER_SIZE ||
+            !append(LOG_DROPPED, dropped, 4)) {
+            _log_dropped++;
+            return;
+        }
+
+        _log_dropped = 0;
+    }
+
+    if (!append(token, arguments, length)) {
+        _log_dropped++;
+    }
+};
+
+void log_values(unsigned char token, const unsigned long* values, unsigned char count) {
+    // Log the message `token` with `count` unsigned long arguments, 4 bytes each, LSB first
+    unsigned char arguments[LOG_MAX_ARGUMENTS_SIZE];
+
+    if (count > LOG_MAX_ARGUMENTS_SIZE / 4) {
+        count = LOG_MAX_ARGUMENTS_SIZE / 4;
+    }
+
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < 4; j++) {
+            arguments[4 * i + j] = (values[i] >> (8 * j)) & 0xFF;
+        }
+    }
+
+    log_write(token, arguments, 4 * count);
+};
+
+int log_read(unsigned char* record) {
+    /*
+        Take the oldest record out of the log, and copy it to `record`, which must hold LOG_MAX_RECORD_SIZE bytes; returns its
+        length, or 0 if the log is empty
+    */
+
+    if (_log_length == 0) {
+        return 0;
+    }
+
+    unsigned int tail = (_log_head + LOG_BUFFER_SIZE - _log_length) % LOG_BUFFER_SIZE;
+    int length = LOG_HEADER_SIZE + _log[(tail + LOG_LENGTH_IDX) % LOG_BUFFER_SIZE];
+
+    for (int i = 0; i < length; i++) {
+        record[i] = _log[(tail + i) % LOG_BUFFER_SIZE];
+    }
+
+    _log_length -= length;
+
+    return length;
+};
+
+unsigned int log_pending() {
+    // Bytes of records waiting in the log
+    return _log_length;
+};
@@ -0,0 +1,64 @@
+/*
+    TokenLog.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    A log cheap enough to leave on in the scan path. Printing a line at 9600 baud takes a millisecond per character, and changes
+    the timing it is meant to show; here a message is a token from `LogTokens.h` and its arguments in binary, copied into a ring
+    in SRAM in microseconds, and sent later, when there is time, with `log_read()`. `src/log_decoder` turns the tokens back into
+    text.
+
+    A record in the ring is the token (1 byte), the length of the arguments (1 byte), the time in milliseconds (4 bytes, LSB
+    first), and the arguments; 4 bytes each, LSB first, or a byte string.
+
+    A message that does not fit in the ring is dropped, rather than overwriting older ones, and the number dropped is logged as
+    LOG_DROPPED once there is room again. Not to be used from interrupts.
+*/
+
+#ifndef TOKEN_LOG_H
+#define TOKEN_LOG_H
+
+#include "LogTokens.h"
+
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE         256 // Bytes of SRAM for the ring
+#endif
+
+#define LOG_HEADER_SIZE         6
+#define LOG_MAX_ARGUMENTS_SIZE  20 // Five values, or a 10-byte UID with room to spare
+#define LOG_MAX_RECORD_SIZE     (LOG_HEADER_SIZE + LOG_MAX_ARGUMENTS_SIZE)
+
+#define LOG_TOKEN_IDX           0
+#define LOG_LENGTH_IDX          1
+#define LOG_TIME_IDX            2
+#define LOG_ARGUMENTS_IDX       6
+
+void log_write(unsigned char token, const unsigned char* arguments, unsigned char length);
+void log_values(unsigned char token, const unsigned long* values, unsigned char count);
+
+template <typename... Log_Arguments>
+void log_event(unsigned char token, Log_Arguments... arguments) {
+    /*
+        Log the LOG_VALUES message `token`, with up to five arguments, each taken as an unsigned long, e.g.
+        `log_event(LOG_WRITE_FAILED, id, attempts)`
+    */
+
+    // The leading 0 keeps the array from being empty when there are no arguments
+    unsigned long values[] = {0, (unsigned long)(arguments)...};
+
+    log_values(token, values + 1, sizeof(values) / sizeof(values[0]) - 1);
+};
+
+inline void log_bytes(unsigned char token, const unsigned char* bytes, unsigned char length) {
+    // Log the LOG_BYTES message `token`, with a byte string of up to LOG_MAX_ARGUMENTS_SIZE bytes, e.g. a UID
+    log_write(token, bytes, length);
+};
+
+int log_read(unsigned char* record);
+unsigned int log_pending();
+
+#endif
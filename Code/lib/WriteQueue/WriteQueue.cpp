@@ -0,0 +1,221 @@
+/*
+    WriteQueue.cpp
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Holds the writes the dispatch system wants made to pallet tags until the tag passes the forklift, and schedules them within
+    the moment it is in the field.
+*/
+
+#include "WriteQueue.h"
+
+#include "string.h"
+
+static bool before(unsigned long a, unsigned long b) {
+    // Whether time `a` is before time `b`, allowing for the millisecond counter to wrap around
+    return (long)(a - b) < 0;
+};
+
+WriteQueue::WriteQueue(unsigned long exit_hold_off, unsigned long initial_dwell, unsigned long initial_write_time) {
+    /*
+        `exit_hold_off`         = a tag is considered to have left the field once it has not been detected for this many
+                                  milliseconds, as for `PresenceTracker`
+        `initial_dwell`         = how long a tag is expected to stay in the field, in milliseconds, until some have been seen
+        `initial_write_time`    = how long a write is expected to take, in milliseconds, until some have been made
+    */
+
+    _exit_hold_off = exit_hold_off;
+    _dwell = initial_dwell;
+    _write_time = initial_write_time;
+
+    _count = 0;
+
+    for (int i = 0; i < WRITE_QUEUE_CAPACITY; i++) {
+        _writes[i].uid_length = 0;
+    }
+};
+
+bool WriteQueue::add(unsigned long id, unsigned char* uid, unsigned char uid_length, unsigned long shipment,
+                     unsigned int destination, unsigned long deadline) {
+    /*
+        Queue a write of `shipment` and `destination` to the tag with the given UID, to be made by time `deadline` (in
+        milliseconds); a write already pending for the tag is replaced, as the newer one supersedes it. Returns `false` if the
+        queue is full.
+    */
+
+    if (uid_length == 0 || uid_length > MAX_UID_LENGTH) {
+        return false;
+    }
+
+    int index = find(uid, uid_length);
+
+    if (index < 0) {
+        if (_count == WRITE_QUEUE_CAPACITY) {
+            return false;
+        }
+
+        for (index = 0; _writes[index].uid_length != 0; index++) {
+            ;
+        }
+
+        memcpy(_writes[index].uid, uid, uid_length);
+        _writes[index].uid_length = uid_length;
+        _writes[index].present = false;
+        _count++;
+    }
+
+    PendingWrite* write = &_writes[index];
+
+    write->id = id;
+    write->shipment = shipment;
+    write->destination = destination;
+    write->deadline = deadline;
+    write->attempts = 0;
+
+    return true;
+};
+
+PendingWrite* WriteQueue::due(unsigned char* uid, unsigned char uid_length, unsigned long now) {
+    /*
+        Record that the tag with the given UID was detected at time `now` (in milliseconds), and return its pending write if it
+        is to be made now, or a null pointer if there is none, or it is held back for writes with earlier deadlines
+
+        Report the outcome of a write returned with `complete()` or `fail()`.
+    */
+
+    int index = find(uid, uid_length);
+
+    if (index < 0) {
+        return nullptr;
+    }
+
+    PendingWrite* write = &_writes[index];
+
+    if (!in_field(write, now)) {
+        write->entered = now;
+    }
+
+    write->present = true;
+    write->last_seen = now;
+
+    // Missed already; left for `expire()` to report
+    if (before(write->deadline, now)) {
+        return nullptr;
+    }
+
+    // Time left before the tag is expected to leave the field
+    unsigned long elapsed = now - write->entered;
+    unsigned long remaining = (elapsed < _dwell) ? _dwell - elapsed : 0;
+
+    // Time for the writes due earlier to tags in the field, which go first
+    unsigned long reserved = 0;
+
+    for (int i = 0; i < WRITE_QUEUE_CAPACITY; i++) {
+        PendingWrite* other = &_writes[i];
+
+        if (other != write && other->uid_length != 0 && in_field(other, now) && before(other->deadline, write->deadline)) {
+            reserved += _write_time;
+        }
+    }
+
+    // The most urgent write is always tried, even if it may not fit; a write interrupted by the tag leaving changes nothing
+    if (reserved > 0 && reserved + _write_time > remaining) {
+        return nullptr;
+    }
+
+    return write;
+};
+
+void WriteQueue::complete(PendingWrite* write, unsigned long write_time) {
+    /*
+        The write returned by `due()` was made and verified, in `write_time` milliseconds; it is taken off the queue
+    */
+
+    average(&_write_time, write_time);
+
+    write->uid_length = 0;
+    _count--;
+};
+
+void WriteQueue::fail(PendingWrite* write, unsigned long write_time) {
+    /*
+        The write returned by `due()` failed after `write_time` milliseconds; it stays queued, to be tried again the next time
+        the tag is detected
+    */
+
+    average(&_write_time, write_time);
+
+    write->attempts++;
+};
+
+bool WriteQueue::expire(unsigned long now, PendingWrite* missed) {
+    /*
+        Look for a write whose deadline has passed by time `now`, take it off the queue, and copy it to `missed`
+
+        Returns `true` if such a write was found. Only one write is expired per call, so call repeatedly until it returns `false`.
+    */
+
+    for (int i = 0; i < WRITE_QUEUE_CAPACITY; i++) {
+        PendingWrite* write = &_writes[i];
+
+        if (write->uid_length != 0 && before(write->deadline, now)) {
+            *missed = *write;
+
+            write->uid_length = 0;
+            _count--;
+
+            return true;
+        }
+    }
+
+    return false;
+};
+
+void WriteQueue::observe_dwell(unsigned long dwell_time) {
+    /*
+        A tag has left the field after `dwell_time` milliseconds in it (e.g. from an EXIT `PresenceEvent`); any tag, not only
+        those with pending writes, as they all pass the forklift alike
+    */
+
+    average(&_dwell, dwell_time);
+};
+
+unsigned char WriteQueue::count() {
+    return _count;
+};
+
+unsigned long WriteQueue::estimated_dwell() {
+    return _dwell;
+};
+
+unsigned long WriteQueue::estimated_write_time() {
+    return _write_time;
+};
+
+int WriteQueue::find(unsigned char* uid, unsigned char uid_length) {
+    /*
+        Return the index of the write pending for the given UID, or -1 if there is none
+    */
+
+    for (int i = 0; i < WRITE_QUEUE_CAPACITY; i++) {
+        if (uid_length != 0 && _writes[i].uid_length == uid_length && memcmp(_writes[i].uid, uid, uid_length) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+};
+
+bool WriteQueue::in_field(PendingWrite* write, unsigned long now) {
+    // As for `PresenceTracker`, a tag is still in the field until it has not been detected for `exit_hold_off` milliseconds
+    return write->present && now - write->last_seen <= _exit_hold_off;
+};
+
+void WriteQueue::average(unsigned long* estimate, unsigned long sample) {
+    // estimate += (sample - estimate) / 2^WRITE_QUEUE_SMOOTHING, without going negative
+    *estimate = *estimate - (*estimate >> WRITE_QUEUE_SMOOTHING) + (sample >> WRITE_QUEUE_SMOOTHING);
+};
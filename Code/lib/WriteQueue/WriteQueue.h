@@ -0,0 +1,83 @@
+/*
+    WriteQueue.h
+
+    for "RFID Reader for Forklift"
+    Course Project,
+    EN2160 - Electronic Design Realization,
+    Semester 4, University of Moratuwa
+
+
+    Holds the writes the dispatch system wants made to pallet tags (a new shipment and destination for the pallet record), keyed
+    by the UID of the tag, until the tag passes the forklift. A write is made as soon as its tag is detected, and reported done,
+    or reported missed once its deadline passes.
+
+    A tag is only in the field for a moment, so the writes are scheduled within it. The time a tag stays in the field (its dwell)
+    and the time a write takes are estimated from the recent ones, as exponentially weighted moving averages. When several tags
+    with pending writes are in the field together, the writes with the earliest deadlines go first; a write is held back for a
+    later detection if it would leave no time, before the tag is expected to leave, for the earlier ones.
+
+    The writes are few, so they are kept in a small array and searched linearly.
+*/
+
+#ifndef WRITE_QUEUE_H
+#define WRITE_QUEUE_H
+
+#ifndef MAX_UID_LENGTH
+#define MAX_UID_LENGTH              10 // Triple size UID
+#endif
+
+#ifndef WRITE_QUEUE_CAPACITY
+#define WRITE_QUEUE_CAPACITY        8 // Maximum number of writes pending at once
+#endif
+
+// Weight of the newest sample in the moving averages, as a right shift; 2 weighs it 1/4
+#define WRITE_QUEUE_SMOOTHING       2
+
+struct PendingWrite {
+    unsigned long id;               // Chosen by the dispatch system, to match the report to the request
+    unsigned char uid[MAX_UID_LENGTH];
+    unsigned char uid_length;       // 0 marks an empty entry
+    unsigned long shipment;
+    unsigned int destination;
+    unsigned long deadline;         // In milliseconds
+    unsigned char attempts;
+
+    // When the tag last entered the field, and was last detected, in milliseconds
+    bool present;
+    unsigned long entered;
+    unsigned long last_seen;
+};
+
+class WriteQueue {
+    public:
+        WriteQueue(unsigned long exit_hold_off, unsigned long initial_dwell, unsigned long initial_write_time);
+
+        bool add(unsigned long id, unsigned char* uid, unsigned char uid_length, unsigned long shipment, unsigned int destination,
+                 unsigned long deadline);
+
+        PendingWrite* due(unsigned char* uid, unsigned char uid_length, unsigned long now);
+        void complete(PendingWrite* write, unsigned long write_time);
+        void fail(PendingWrite* write, unsigned long write_time);
+
+        bool expire(unsigned long now, PendingWrite* missed);
+
+        void observe_dwell(unsigned long dwell_time);
+
+        unsigned char count();
+        unsigned long estimated_dwell();
+        unsigned long estimated_write_time();
+
+    private:
+        int find(unsigned char* uid, unsigned char uid_length);
+        bool in_field(PendingWrite* write, unsigned long now);
+        void average(unsigned long* estimate, unsigned long sample);
+
+        PendingWrite _writes[WRITE_QUEUE_CAPACITY];
+        unsigned char _count;
+
+        unsigned long _exit_hold_off;
+        unsigned long _dwell;
+        unsigned long _write_time;
+};
+
+#endif
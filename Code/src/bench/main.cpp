@@ -0,0 +1,688 @@
+/*
+    Benchmarks of the scan path of the PN532 driver, against a simulated PN532 (`PN532_Model`) in the `native` build; build with
+    `pio run -e bench`, and run .pio/build/bench/program [runs per operation].
+
+    Each operation is run repeatedly in a scripted scenario; an empty field, one MIFARE Classic 1K, three of them, a dual
+    interface card detected with and without RATS, a noisy bus that corrupts every third response, an antenna detuned by metal
+    racking before and after the receiver is tuned, a tag that leaves the field while it is being read, NDEF messages read and
+    written on an NTAG213 and an NDEF formatted MIFARE Classic 1K, with a pallet record written alongside, a pallet record read
+    again and again with and without the pallet cache, through it on a tag written only once, and after a rewrite torn on the
+    tag, a file written and read with APDUs on an ISO14443-4 card at 106 kbps and at the bit rate negotiated with PSL, and
+    populations of tags enumerated by the anticollision engine of `ISO14443.h` in a simulated field. The simulated PN532 takes
+    a pseudorandom extra 0 to 5 ms to answer each command, counted from when the driver would first have found the response, so
+    the latencies spread as on the hardware rather than vanishing in the driver's waits. For each operation, the latency
+    percentiles, and the mean SPI bytes and SPI transactions (NSS going low), are reported; the times are those the firmware
+    would take on the microcontroller.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Pins.h>
+#include <Timer.h>
+#include <PN532.h>
+#include <PN532_Reader.h>
+#include <NDEF.h>
+#include <PalletRecord.h>
+#include <PalletCache.h>
+#include <Emulator.h>
+#include <PN532_Model.h>
+#include <Simulated_Cards.h>
+#include <Benchmark.h>
+#include <ISO14443A_Field_Simulator.h>
+
+#define DEFAULT_RUNS 200
+
+#define BLOCK 0x02
+
+Emulator emulator;
+PN532_Model model;
+
+const unsigned char uids[3][4] = {{0xDE, 0xAD, 0xBE, 0xEF}, {0x11, 0x22, 0x33, 0x44}, {0xCA, 0xFE, 0xF0, 0x0D}};
+
+Simulated_MIFARE_Classic cards[3] = {
+  Simulated_MIFARE_Classic(uids[0]), Simulated_MIFARE_Classic(uids[1]), Simulated_MIFARE_Classic(uids[2])
+};
+
+unsigned char key[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+unsigned char block_contents[16] = {'P', 'A', 'L', 'L', 'E', 'T', ' ', '0', '0', '0', '1', '2', '3', ' ', ' ', ' '};
+
+unsigned char read_buffer[16];
+
+// A URI record to the shipment first, then a longer text record the URI is read without
+const char* shipment_uri = "https://ship.example.com/S0012345";
+const char* manifest_text = "SKU 4711-0815, 48 cartons, fragile; stack two high, to dock 7";
+
+const unsigned char ntag_uid[7] = {0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+const unsigned char ndef_classic_uid[4] = {0x0A, 0x0B, 0x0C, 0x0D};
+
+Simulated_NTAG213 ndef_ntag(ntag_uid);
+Simulated_MIFARE_Classic ndef_classic(ndef_classic_uid);
+
+// A dual interface card, a MIFARE Classic 1K that also speaks ISO14443-4 (SAK 0x28), with a 13-byte ATS
+const unsigned char dual_interface_uid[4] = {0x5A, 0x5A, 0x01, 0x02};
+const unsigned char dual_interface_ats[13] = {0x78, 0x77, 0x71, 0x02, 0x80, 0x31, 0x80, 0x66, 0xB0, 0x84, 0x0C, 0x01, 0x6E};
+
+Simulated_MIFARE_Classic dual_interface(dual_interface_uid);
+
+// An ISO14443-4 card with FSC 64, and the file written to and read from it with UPDATE BINARY and READ BINARY
+const unsigned char iso_dep_uid[7] = {0x04, 0x52, 0x2C, 0x6A, 0x9B, 0x3E, 0x80};
+
+Simulated_ISO_DEP_Card iso_dep_card(iso_dep_uid);
+
+#define ISO_DEP_FILE_BYTES   256 // Read back whole, in an extended frame
+#define ISO_DEP_UPDATE_PIECE 128 // Lc is one byte
+
+void format_ndef_classic(Simulated_MIFARE_Classic* card) {
+  // The MAD in sector 0 gives sectors 1 to 3 to NDEF, and their trailers take the public NFC key [Section 5 (AN1304)]
+  memcpy(card->blocks[3], MAD_KEY_A, 6);
+  card->blocks[1][1] = 0x01;
+
+  for (int sector = 1; sector <= 3; sector++) {
+    card->blocks[1][2 * sector] = NDEF_AID_APPLICATION;
+    card->blocks[1][2 * sector + 1] = NDEF_AID_CLUSTER;
+    memcpy(card->blocks[sector * 4 + 3], NFC_KEY_A, 6);
+  }
+
+  // An empty NDEF message
+  card->blocks[4][0] = TLV_NDEF_MESSAGE;
+  card->blocks[4][2] = TLV_TERMINATOR;
+}
+
+int make_pallet_message(unsigned char* message, int max_length, const char* uri) {
+  int length = ndef_make_uri_record(message, max_length, NDEF_MB, uri);
+  return length + ndef_make_text_record(message + length, max_length - length, NDEF_ME, "en", manifest_text);
+}
+
+void take_card_away(void* card) {
+  model.remove_card((Simulated_Card*)(card));
+}
+
+void set_cards_in_field(int num_cards) {
+  for (int i = 0; i < 3; i++) {
+    model.remove_card(&cards[i]);
+  }
+
+  for (int i = 0; i < num_cards; i++) {
+    model.add_card(&cards[i]);
+  }
+}
+
+bool detect(PN532* pn532) {
+  unsigned char card_number;
+  unsigned char card_data[CARD_DATA_SIZE];
+
+  return pn532->detect_card(&card_number, card_data);
+}
+
+bool detect_authenticate_read(PN532* pn532) {
+  unsigned char card_number;
+  unsigned char card_data[CARD_DATA_SIZE];
+
+  if (!pn532->detect_card(&card_number, card_data)) {
+    return false;
+  }
+
+  MIFARE_Classic_PN532 card(pn532, card_data + UID_START_IDX, card_data[UID_LEN_IDX]);
+
+  return card.authenticate_block(AUTHENTICATE_KEY_A, BLOCK, key) && card.read_block(BLOCK, read_buffer);
+}
+
+bool update_file(ISO_DEP_PN532* card, const unsigned char* data, int length) {
+  // UPDATE BINARY of `data` from offset 0, ISO_DEP_UPDATE_PIECE bytes per APDU, each chained to the card
+  for (int offset = 0; offset < length; offset += ISO_DEP_UPDATE_PIECE) {
+    int piece = (length - offset < ISO_DEP_UPDATE_PIECE) ? length - offset : ISO_DEP_UPDATE_PIECE;
+    unsigned char apdu[APDU_HEADER_SIZE + 1 + ISO_DEP_UPDATE_PIECE] = {
+        0x00, APDU_UPDATE_BINARY, (unsigned char)(offset >> 8), (unsigned char)(offset), (unsigned char)(piece)};
+    unsigned char response[2];
+
+    memcpy(apdu + APDU_HEADER_SIZE + 1, data + offset, piece);
+
+    if (card->transceive(apdu, APDU_HEADER_SIZE + 1 + piece, response, sizeof(response)) != 2 || response[0] != 0x90) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool read_file(ISO_DEP_PN532* card, unsigned char* data, int length) {
+  // READ BINARY of `length` bytes, up to 256, from offset 0, in one APDU; Le = 0 asks for 256
+  unsigned char apdu[5] = {0x00, APDU_READ_BINARY, 0x00, 0x00, (unsigned char)(length)};
+  unsigned char response[256 + 2];
+
+  if (card->transceive(apdu, sizeof(apdu), response, sizeof(response)) != length + 2 || response[length] != 0x90) {
+    return false;
+  }
+
+  memcpy(data, response, length);
+
+  return true;
+}
+
+void print_throughput(Benchmark* benchmark) {
+  printf("%-40s %.2f tags/s\n", "  sustained, one reader", 1e9 / benchmark->mean_nanoseconds());
+}
+
+int main(int argc, char** argv) {
+  int runs = (argc > 1) ? atoi(argv[1]) : DEFAULT_RUNS;
+
+  if (runs < 1 || runs > BENCHMARK_MAX_SAMPLES) {
+    printf("runs must be 1 to %d\n", BENCHMARK_MAX_SAMPLES);
+    return 1;
+  }
+
+  // The emulator must be attached before anything touches the registers
+  emulator.attach();
+  emulator.add_spi_device(&model, B, 0);
+
+  model.set_jitter(5000, 42);
+
+  for (int i = 0; i < 3; i++) {
+    memcpy(cards[i].blocks[BLOCK], block_contents, 16);
+  }
+
+  Pin NSS(B, 0);
+  PN532 pn532(NSS);
+
+  initialize_timer();
+  initialize_tick_counter();
+
+  pn532.initialize();
+
+  if (!pn532.SAMConfig() || !pn532.set_passive_activation_retries(2)) {
+    printf("the simulated PN532 did not respond\n");
+    return 1;
+  }
+
+  Benchmark::print_header();
+
+  // Empty field
+  set_cards_in_field(0);
+
+  Benchmark empty_detect("empty field: detect_card", &emulator);
+  for (int i = 0; i < runs; i++) {
+    empty_detect.measure([&]() { return !detect(&pn532); });
+  }
+  empty_detect.print();
+
+  // One tag
+  set_cards_in_field(1);
+
+  Benchmark one_detect("one tag: detect_card", &emulator);
+  Benchmark one_get_card("one tag: get_mifare_classic_card", &emulator);
+  Benchmark one_authenticate("one tag: authenticate_block", &emulator);
+  Benchmark one_read("one tag: read_block", &emulator);
+  Benchmark one_write("one tag: write_block", &emulator);
+  Benchmark one_scan("one tag: detect + authenticate + read", &emulator);
+
+  for (int i = 0; i < runs; i++) {
+    one_detect.measure([&]() { return detect(&pn532); });
+
+    MIFARE_Classic_PN532* card = nullptr;
+    one_get_card.measure([&]() { return (card = pn532.get_mifare_classic_card()) != nullptr; });
+
+    if (!card) {
+      continue;
+    }
+
+    one_authenticate.measure([&]() { return card->authenticate_block(AUTHENTICATE_KEY_A, BLOCK, key); });
+    one_read.measure([&]() { return card->read_block(BLOCK, read_buffer); });
+    one_write.measure([&]() { return card->write_block(BLOCK, block_contents); });
+
+    delete card;
+
+    one_scan.measure([&]() { return detect_authenticate_read(&pn532); });
+  }
+
+  one_detect.print();
+  one_get_card.print();
+  one_authenticate.print();
+  one_read.print();
+  one_write.print();
+  one_scan.print();
+  print_throughput(&one_scan);
+
+  // Several tags
+  set_cards_in_field(3);
+
+  Benchmark several_detect("three tags: detect_card", &emulator);
+  Benchmark several_scan("three tags: detect + authenticate + read", &emulator);
+
+  for (int i = 0; i < runs; i++) {
+    several_detect.measure([&]() { return detect(&pn532); });
+    several_scan.measure([&]() { return detect_authenticate_read(&pn532); });
+  }
+
+  several_detect.print();
+  several_scan.print();
+  print_throughput(&several_scan);
+
+  // A dual interface card, detected with the PN532's default parameters, which send it RATS and return its ATS, and with the
+  // inventory profile, which stops at its SAK
+  set_cards_in_field(0);
+
+  dual_interface.sak = 0x28;
+  memcpy(dual_interface.ats, dual_interface_ats, sizeof(dual_interface_ats));
+  dual_interface.ats_length = sizeof(dual_interface_ats);
+  model.add_card(&dual_interface);
+
+  const unsigned char profiles[2] = {PROFILE_ISO_DEP, PROFILE_INVENTORY};
+  const char* profile_names[2] = {"dual interface: detect_card, ISO-DEP", "dual interface: detect_card, inventory"};
+
+  for (int p = 0; p < 2; p++) {
+    pn532.set_parameters(profiles[p]);
+
+    Benchmark dual_detect(profile_names[p], &emulator);
+    for (int i = 0; i < runs; i++) {
+      dual_detect.measure([&]() { return detect(&pn532); });
+    }
+    dual_detect.print();
+  }
+
+  model.remove_card(&dual_interface);
+  pn532.set_parameters(PROFILE_ISO_DEP);
+
+  // A noisy bus; every third response arrives corrupted, and is read again after a NACK rather than the command failing
+  set_cards_in_field(1);
+  model.set_corruption(3);
+  pn532.reset_error_counters();
+
+  Benchmark noisy_scan("noisy bus: detect + authenticate + read", &emulator);
+
+  for (int i = 0; i < runs; i++) {
+    noisy_scan.measure([&]() { return detect_authenticate_read(&pn532); });
+  }
+
+  noisy_scan.print();
+  printf("  %lu responses corrupted, %lu recovered with a NACK\n", pn532.checksum_errors(), pn532.nack_recoveries());
+
+  model.set_corruption(0);
+
+  // An antenna detuned by metal racking; the receiver works best at RxGain 7 and MinLevel 4, far from the defaults, so exchanges
+  // fail with CRC errors until the receiver is tuned
+  model.set_receiver_optimum(7, 4);
+  pn532.reset_rf_statistics();
+
+  Benchmark detuned_scan("detuned: detect + authenticate + read", &emulator);
+  Benchmark tuned_scan("tuned: detect + authenticate + read", &emulator);
+
+  for (int i = 0; i < runs; i++) {
+    detuned_scan.measure([&]() { return detect_authenticate_read(&pn532); });
+  }
+
+  detuned_scan.print();
+
+  PN532_RF_Statistics* statistics = pn532.rf_statistics();
+  printf("  %lu exchanges, %lu CRC errors\n", statistics->exchanges, statistics->crc_errors);
+
+  unsigned char rx_gain;
+  unsigned char min_level;
+  int successes;
+
+  pn532.tune_receiver(20, detect_authenticate_read, &rx_gain, &min_level, &successes);
+  printf("  tuned to RxGain %d, MinLevel %d; %d of 20 reads\n", rx_gain, min_level, successes);
+
+  pn532.reset_rf_statistics();
+
+  for (int i = 0; i < runs; i++) {
+    tuned_scan.measure([&]() { return detect_authenticate_read(&pn532); });
+  }
+
+  tuned_scan.print();
+  printf("  %lu exchanges, %lu CRC errors\n", statistics->exchanges, statistics->crc_errors);
+
+  // Back to the defaults, with the antenna as it was
+  model.set_receiver_optimum(DEFAULT_RX_GAIN, DEFAULT_MIN_LEVEL);
+  pn532.set_receiver(DEFAULT_RX_GAIN, DEFAULT_MIN_LEVEL);
+
+  // A tag leaving the field while the read command is being sent; the read is expected to fail
+  Benchmark leaving_read("tag leaves: read_block (fails)", &emulator);
+
+  for (int i = 0; i < runs; i++) {
+    set_cards_in_field(1);
+
+    unsigned char card_number;
+    unsigned char card_data[CARD_DATA_SIZE];
+
+    if (!pn532.detect_card(&card_number, card_data)) {
+      continue;
+    }
+
+    MIFARE_Classic_PN532 card(&pn532, card_data + UID_START_IDX, card_data[UID_LEN_IDX]);
+
+    if (!card.authenticate_block(AUTHENTICATE_KEY_A, BLOCK, key)) {
+      continue;
+    }
+
+    emulator.schedule(emulator.now() + 50000ULL, take_card_away, &cards[0]);
+    leaving_read.measure([&]() { return card.read_block(BLOCK, read_buffer); });
+  }
+
+  leaving_read.print();
+
+  // NDEF on an NTAG213 and on a MIFARE Classic 1K; the URI is read without reading the text record after it, and a rewrite
+  // that changes one character writes one page or block. A pallet record is then written to the same tag, and must leave the
+  // message as it was; the NTAG213, as shipped, gives NDEF all of its user memory, so the write is refused there
+  format_ndef_classic(&ndef_classic);
+
+  PN532_Reader reader(&pn532);
+  Simulated_Card* ndef_tags[2] = {&ndef_ntag, &ndef_classic};
+  const char* tag_names[2] = {"NTAG213", "Classic"};
+
+  for (int t = 0; t < 2; t++) {
+    set_cards_in_field(0);
+    model.add_card(ndef_tags[t]);
+
+    char names[4][64];
+    snprintf(names[0], sizeof(names[0]), "NDEF %s: write message", tag_names[t]);
+    snprintf(names[1], sizeof(names[1]), "NDEF %s: rewrite, 1 byte changed", tag_names[t]);
+    snprintf(names[2], sizeof(names[2]), "NDEF %s: detect + read_uri", tag_names[t]);
+    snprintf(names[3], sizeof(names[3]), "NDEF %s: write or refuse pallet", tag_names[t]);
+
+    Benchmark ndef_write(names[0], &emulator);
+    Benchmark ndef_rewrite(names[1], &emulator);
+    Benchmark ndef_read(names[2], &emulator);
+    Benchmark ndef_pallet(names[3], &emulator);
+
+    unsigned long operations[3][2] = {{0, 0}, {0, 0}, {0, 0}};
+    int uris_intact = 0;
+    int refused = 0;
+
+    for (int i = 0; i < runs; i++) {
+      ReaderTag tag;
+      unsigned char message[160];
+      char uri[64];
+
+      // Start from the other message each run, so that the whole message is written
+      const char* written_uri = (i % 2) ? shipment_uri : "https://ship.example.com/X9988776";
+      int length = make_pallet_message(message, sizeof(message), written_uri);
+
+      NDEF_Tag<PN532_Reader> writer(&reader, &tag);
+      ndef_write.measure([&]() { return reader.detect(&tag) && writer.open() && writer.write_message(message, length); });
+      operations[0][0] = writer.num_reads();
+      operations[0][1] = writer.num_writes();
+
+      message[length - 1] ^= 0x01;
+
+      NDEF_Tag<PN532_Reader> rewriter(&reader, &tag);
+      ndef_rewrite.measure([&]() { return reader.detect(&tag) && rewriter.open() && rewriter.write_message(message, length); });
+      operations[1][0] = rewriter.num_reads();
+      operations[1][1] = rewriter.num_writes();
+
+      NDEF_Tag<PN532_Reader> ndef(&reader, &tag);
+      ndef_read.measure([&]() {
+        return reader.detect(&tag) && ndef.open() && ndef.read_uri(uri, sizeof(uri)) > 0 && strcmp(uri, written_uri) == 0;
+      });
+      operations[2][0] = ndef.num_reads();
+      operations[2][1] = ndef.num_writes();
+
+      // A quantity of its own each run, so that the record is written every time
+      PalletRecord pallet = {4711, (unsigned int)(48 + i), 7, 123, 0};
+      PalletRecord current;
+      int current_slot = PALLET_READ_FAILED;
+
+      ndef_pallet.measure([&]() {
+        if (!reader.detect(&tag)) {
+          return false;
+        }
+
+        current_slot = find_pallet_record(&reader, &tag, key, &current);
+        return current_slot == PALLET_NO_ROOM || commit_pallet_record(&reader, &tag, &pallet, current_slot, &current);
+      });
+      refused += (current_slot == PALLET_NO_ROOM);
+
+      NDEF_Tag<PN532_Reader> after_pallet(&reader, &tag);
+      uris_intact += reader.detect(&tag) && after_pallet.open() && after_pallet.read_uri(uri, sizeof(uri)) > 0 &&
+                     strcmp(uri, written_uri) == 0;
+    }
+
+    Benchmark* benchmarks[3] = {&ndef_write, &ndef_rewrite, &ndef_read};
+
+    for (int i = 0; i < 3; i++) {
+      benchmarks[i]->print();
+      printf("  %lu blocks read, %lu written\n", operations[i][0], operations[i][1]);
+    }
+
+    ndef_pallet.print();
+    printf("  refused for want of room in %d of %d runs, URI read back intact in %d\n", refused, runs, uris_intact);
+
+    model.remove_card(ndef_tags[t]);
+  }
+
+  // A pallet passing again and again; the record read in full each time, and through the pallet cache, which reads only the slot
+  // a rewrite would go to. Every tenth pass, the record is rewritten first, as by another forklift, and read in full again.
+  set_cards_in_field(1);
+
+  PalletRecord pallet = {4711, 48, 7, 123, 1};
+  pallet_record_encode(&pallet, cards[0].blocks[PALLET_CLASSIC_BLOCK]);
+
+  PalletCache pallet_cache;
+  const char* pallet_names[2] = {"pallet: detect + read record", "pallet: detect + read record, cached"};
+
+  for (int cached = 0; cached < 2; cached++) {
+    Benchmark pallet_read(pallet_names[cached], &emulator);
+    unsigned long exchanges = 0;
+    int wrong = 0;
+
+    for (int i = 0; i < runs; i++) {
+      ReaderTag tag;
+      PalletRecord record;
+
+      if (i % 10 == 9) {
+        pallet.quantity = i;
+
+        if (!reader.detect(&tag) || !write_pallet_record(&reader, &tag, key, &pallet)) {
+          continue;
+        }
+      }
+
+      model.reset_counters();
+      pallet_read.measure([&]() {
+        return reader.detect(&tag) &&
+               (cached ? read_pallet_record(&reader, &tag, key, &pallet_cache, &record) : read_pallet_record(&reader, &tag, key, &record));
+      });
+      exchanges += model.rf_exchanges();
+
+      wrong += (record.quantity != pallet.quantity);
+    }
+
+    pallet_read.print();
+    printf("  %.1f RF exchanges per read, %d records wrong\n", (double)(exchanges) / runs, wrong);
+  }
+
+  printf("  %lu reads served from the cache, %lu in full\n", pallet_cache.hits(), pallet_cache.misses());
+
+  // A pallet whose record was written once, when it was tagged, and never since, as most are; the other slot is blank, so the
+  // cache serves every pass after the first
+  Benchmark pallet_once("pallet: written once, cached", &emulator);
+  PalletCache once_cache;
+  unsigned long once_exchanges = 0;
+
+  pallet_record_encode(&pallet, cards[0].blocks[PALLET_CLASSIC_BLOCK]);
+  memset(cards[0].blocks[PALLET_CLASSIC_SHADOW_BLOCK], 0, PALLET_RECORD_SIZE);
+
+  for (int i = 0; i < runs; i++) {
+    ReaderTag tag;
+    PalletRecord record;
+
+    model.reset_counters();
+    pallet_once.measure([&]() { return reader.detect(&tag) && read_pallet_record(&reader, &tag, key, &once_cache, &record); });
+    once_exchanges += model.rf_exchanges();
+  }
+
+  pallet_once.print();
+  printf("  %.1f RF exchanges per read, %lu reads served from the cache, %lu in full\n", (double)(once_exchanges) / runs,
+         once_cache.hits(), once_cache.misses());
+
+  // The record cached from one slot, then rewritten twice by another forklift, to the other slot and back to the cached one,
+  // and a third rewrite torn in the other slot; the read through the cache must find the record in the cached slot newer than
+  // the one cached, rather than serve the one cached because the other slot holds nothing valid
+  Benchmark pallet_torn("pallet: cached read after a torn write", &emulator);
+  int stale = 0;
+
+  for (int i = 0; i < runs; i++) {
+    ReaderTag tag;
+    PalletRecord record;
+    PalletCache torn_cache;
+
+    pallet.sequence = 1;
+    pallet_record_encode(&pallet, cards[0].blocks[PALLET_CLASSIC_BLOCK]);
+    memset(cards[0].blocks[PALLET_CLASSIC_SHADOW_BLOCK], 0, PALLET_RECORD_SIZE);
+
+    if (!reader.detect(&tag) || !read_pallet_record(&reader, &tag, key, &torn_cache, &record)) {
+      continue;
+    }
+
+    pallet.quantity++;
+    bool rewritten = write_pallet_record(&reader, &tag, key, &pallet);
+    pallet.quantity++;
+
+    if (!rewritten || !write_pallet_record(&reader, &tag, key, &pallet)) {
+      continue;
+    }
+
+    // Half of the block written when the tag left the field
+    memset(cards[0].blocks[PALLET_CLASSIC_SHADOW_BLOCK] + PALLET_RECORD_SIZE / 2, 0xA5, PALLET_RECORD_SIZE / 2);
+
+    pallet_torn.measure([&]() { return reader.detect(&tag) && read_pallet_record(&reader, &tag, key, &torn_cache, &record); });
+    stale += (record.sequence != pallet.sequence);
+  }
+
+  pallet_torn.print();
+  printf("  stale record served in %d of %d runs\n", stale, runs);
+
+  // A file on an ISO14443-4 card, written with UPDATE BINARY, each chained in pieces of whole I-blocks, and read back with one
+  // READ BINARY, whose answer comes in an extended frame, first at 106 kbps, then at the fastest bit rate the card and the
+  // PN532 agree on. Both save at the faster bit rate, the read the most, as its one answer is the longest time on the RF.
+  // The RF exchanges show what chaining costs
+  set_cards_in_field(0);
+  model.add_card(&iso_dep_card);
+
+  unsigned char file_contents[ISO_DEP_FILE_BYTES];
+  unsigned char file_read[ISO_DEP_FILE_BYTES];
+
+  for (int i = 0; i < ISO_DEP_FILE_BYTES; i++) {
+    file_contents[i] = i;
+  }
+
+  const char* rate_names[2] = {"106 kbps", "negotiated"};
+
+  for (int negotiate = 0; negotiate < 2; negotiate++) {
+    char names[2][64];
+    snprintf(names[0], sizeof(names[0]), "ISO-DEP %s: update %d bytes", rate_names[negotiate], ISO_DEP_FILE_BYTES);
+    snprintf(names[1], sizeof(names[1]), "ISO-DEP %s: read %d bytes", rate_names[negotiate], ISO_DEP_FILE_BYTES);
+
+    Benchmark iso_dep_update(names[0], &emulator);
+    Benchmark iso_dep_read(names[1], &emulator);
+
+    unsigned long exchanges[2] = {0, 0};
+    int chunk_size = 0;
+    unsigned char bit_rate = BIT_RATE_106;
+
+    for (int i = 0; i < runs; i++) {
+      // A fresh activation each run, as PSL is only accepted before the first exchange
+      ISO_DEP_PN532* card = pn532.get_iso_dep_card();
+
+      if (!card || (negotiate && !card->negotiate_bit_rate())) {
+        delete card;
+        continue;
+      }
+
+      chunk_size = card->chunk_size();
+      bit_rate = card->bit_rate_to_card();
+
+      model.reset_counters();
+      iso_dep_update.measure([&]() { return update_file(card, file_contents, ISO_DEP_FILE_BYTES); });
+      exchanges[0] = model.rf_exchanges();
+
+      model.reset_counters();
+      iso_dep_read.measure([&]() {
+        return read_file(card, file_read, ISO_DEP_FILE_BYTES) && memcmp(file_read, file_contents, ISO_DEP_FILE_BYTES) == 0;
+      });
+      exchanges[1] = model.rf_exchanges();
+
+      delete card;
+    }
+
+    iso_dep_update.print();
+    printf("  %lu RF exchanges, in pieces of %d bytes, at %d kbps\n", exchanges[0], chunk_size, 106 << bit_rate);
+    iso_dep_read.print();
+    printf("  %lu RF exchanges\n", exchanges[1]);
+  }
+
+  model.remove_card(&iso_dep_card);
+
+  // The anticollision engine of ISO14443.h, for readers that leave anticollision to the host, against a simulated field of 1 to
+  // 32 tags with random UIDs of all three sizes; half the populations share all but the last bits of their UIDs, for the most
+  // collisions. It runs on the host alone, so the frames sent into the field are reported rather than the time.
+  const int populations[4] = {1, 4, 16, 32};
+  unsigned long seed = 42;
+
+  for (int p = 0; p < 4; p++) {
+    unsigned long rounds = 0;
+    unsigned long frames = 0;
+    int missed = 0;
+
+    for (int i = 0; i < runs; i++) {
+      ISO14443A_Field_Simulator field;
+      uint8_t population_uids[ISO14443A_FIELD_CAPACITY][MAX_UID_LENGTH];
+      uint8_t population_lengths[ISO14443A_FIELD_CAPACITY];
+      int added = 0;
+
+      while (added < populations[p]) {
+        const uint8_t lengths[3] = {4, 7, 10};
+        uint8_t* uid = population_uids[added];
+
+        seed = seed * 1103515245 + 12345;
+        population_lengths[added] = lengths[(seed >> 16) % 3];
+
+        for (int b = 0; b < MAX_UID_LENGTH; b++) {
+          seed = seed * 1103515245 + 12345;
+          uid[b] = (i % 2) ? ((seed >> 16) & 0x01) : (seed >> 16);
+        }
+
+        // The first byte of a single size UID may not be the cascade tag, and every UID must differ
+        if (uid[0] == CASCADE_TAG) {
+          uid[0] = 0x08;
+        }
+
+        bool duplicate = false;
+
+        for (int k = 0; k < added; k++) {
+          duplicate |= population_lengths[k] == population_lengths[added] &&
+                       memcmp(population_uids[k], uid, population_lengths[added]) == 0;
+        }
+
+        if (!duplicate && field.add_tag(uid, population_lengths[added], 0x08)) {
+          added++;
+        }
+      }
+
+      auto pcd = make_ISO14443A_PCD(
+        [&](uint8_t* bytes, uint8_t num_bytes, uint8_t valid_bits, uint8_t rx_align) {
+          return field.send(bytes, num_bytes, valid_bits, rx_align);
+        },
+        [&](uint8_t* buffer, uint8_t length) { return field.receive(buffer, length); },
+        [&]() { return field.collision(); });
+
+      ISO14443A_Tag found[ISO14443A_FIELD_CAPACITY];
+      int num_found = pcd.enumerate(found, ISO14443A_FIELD_CAPACITY);
+
+      rounds += pcd.anticollision_rounds();
+      frames += field.frames();
+      missed += added - num_found;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "anticollision: enumerate %d tag%s", populations[p], (populations[p] == 1) ? "" : "s");
+
+    printf("%-40s %.1f anticollision rounds, %.1f frames, %d tags missed\n", name, (double)(rounds) / runs,
+           (double)(frames) / runs, missed);
+  }
+
+  printf("\nframe errors: %lu\n", model.frame_errors());
+
+  return 0;
+}
@@ -0,0 +1,1244 @@
+/*
+    A gateway from the readers to the backend for a Linux computer, for fixed readers (e.g. at dock doors) whose microcontrollers
+    are attached over USB serial rather than an ESP8266; build with `pio run -e gateway`, and run
+
+    .pio/build/gateway/program [options] <serial port> [<serial port> ...]
+
+    It takes the place of the ESP8266 in the uplink protocol (see README.md) on every port: it sends REPLAY when a port opens or
+    its microcontroller boots, gives each microcontroller its clock with SYNC and CLOCK every minute, reads the EVT lines, and
+    ACKs them once they are in its custody. A port named `pty` is a pseudoterminal, whose other end is printed, for feeding EVT
+    lines by hand or from a script.
+
+    The ENTER events of every port go into one queue in memory, and are posted to the backend in batches, as
+    {"scans":[{"id":"<UID>","timestamp":<Unix time>},...]}, once `--batch` of them are waiting or the oldest has waited
+    `--batch-time` ms; one request at a time, on a connection kept alive. The timestamp is the microcontroller's, or, if it had
+    not been given the time, when the line was read. DWELL and EXIT events are only acknowledged.
+
+    An event is ACKed when it has been posted, or written to the spool; the file `--spool`, to which the oldest batch in memory
+    goes, synced to the disk, when the queue is nearly full, e.g. while the backend is down. The spool is posted from before the
+    queue, so events are posted in the order they were read, and is kept across restarts; its read position is in
+    `<spool>.offset`. When the queue is full, and the spool too, events are neither queued nor ACKed, and the port is sent
+    REPLAY once there is room again, so the microcontroller's journal holds them meanwhile. Events sent again, as after a REPLAY,
+    are told apart by their sequence numbers, and queued once; only events read again after a port is opened again may be
+    posted twice.
+
+    A failed request is tried again after 0.5 s, doubling up to 30 s, as is one the backend answers with 5xx, or with a 4xx
+    that may pass later (e.g. 401, 408, 429). One the backend rejects as malformed (400 or 422) would be rejected again, so its
+    body is appended to the file `--dead-letter`, synced to the disk, with the time and the status, and only then are its
+    events dropped and ACKed; if it cannot be written, the request is tried again as if it had failed.
+
+    With `--stand-in <TCP port>`, it runs a local stand-in for the backend instead, answering every request with 200 and
+    printing the scans posted, for trying the gateway without the backend and its database.
+
+    Options
+
+    --url <URL>             Where scans are posted; http only (http://localhost/api/esp/send-id)
+    --baud <baud rate>      Of the serial ports (9600)
+    --batch <events>        Most events posted at once (100)
+    --batch-time <ms>       Longest an event waits for a batch to fill (250)
+    --queue <events>        Events kept in memory (10000)
+    --spool <file>          The spool (gateway.spool)
+    --spool-limit <events>  Most events kept in the spool (1000000)
+    --dead-letter <file>    Where batches rejected as malformed are kept (gateway.rejected)
+    --verbose               Print every line read but EVT, SYNC and CLOCK, e.g. LOG lines for src/log_decoder
+
+    Totals are printed on SIGINT or SIGTERM. Linux only.
+
+    The following sources were referenced.
+
+    https://man7.org/linux/man-pages/man7/epoll.7.html
+    https://man7.org/linux/man-pages/man3/termios.3.html
+    https://www.rfc-editor.org/rfc/rfc9112 [HTTP/1.1]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define MAX_PORTS           16
+#define LINE_SIZE           128
+#define UID_SIZE            21 // Triple size UID in hexadecimal
+
+#define TICK_INTERVAL       20 // ms between checks of the timers below
+#define REOPEN_INTERVAL     2000
+#define SYNC_INTERVAL       60000
+#define SYNC_TIMEOUT        1000
+#define SYNC_MAX_ROUND_TRIP 60 // As CLOCK_SYNC_MAX_ROUND_TRIP; a longer exchange is tried again a second later
+#define REQUEST_TIMEOUT     5000
+#define MIN_BACKOFF         500
+#define MAX_BACKOFF         30000
+#define RESPONSE_SIZE       4096
+#define SCAN_JSON_SIZE      64 // {"id":"<20 digits>","timestamp":<Unix time>}, and a comma
+
+// Statuses for a request that would be rejected again however often it is sent; any other 4xx may pass later
+#define HTTP_BAD_REQUEST    400
+#define HTTP_UNPROCESSABLE  422
+
+// What the events from epoll are for, in their data
+#define SOURCE_TIMER        0
+#define SOURCE_SIGNAL       1
+#define SOURCE_HTTP         2
+#define SOURCE_LISTEN       3
+#define SOURCE_PORT         16 // + the index of the port, or of the client of the stand-in
+
+struct Event {
+  unsigned char port;
+  unsigned int sequence;
+  char uid[UID_SIZE];
+  unsigned long long time;      // Unix time in ms
+  unsigned long long received;  // Monotonic time in ms
+};
+
+struct Port {
+  const char* path;
+  char name[64];                // The path, or the other end of a pseudoterminal
+  int fd;                       // -1 while closed
+  int peer_fd;                  // The other end of a pseudoterminal, held open so that it does not hang up
+  unsigned long long reopen_time;
+
+  char line[LINE_SIZE];
+  int line_length;
+  bool overlong;
+
+  bool seen;                    // Whether an event has been queued or let go, and the sequence number of the last one
+  unsigned int highest_seen;
+  unsigned long pending;        // Events queued in memory
+  bool ack_known;               // Whether an event has been posted or spooled, and the sequence number of the last one
+  unsigned int ack_to;
+  bool acked;                   // Whether an ACK has been sent, and its sequence number
+  unsigned int last_ack;
+  bool replay_needed;           // Events were turned away for want of room
+
+  bool sync_waiting;
+  unsigned long long sync_sent;       // Monotonic time in ms
+  unsigned long long sync_sent_wall;  // Unix time in ms
+  unsigned long long next_sync;
+};
+
+struct Totals {
+  unsigned long events;
+  unsigned long scans;
+  unsigned long duplicates;
+  unsigned long turned_away;
+  unsigned long posted;
+  unsigned long rejected;
+  unsigned long spooled;
+  unsigned long requests;
+  unsigned long failures;
+  unsigned long syncs;
+};
+
+enum HTTPState {HTTP_IDLE, HTTP_CONNECTING, HTTP_SENDING, HTTP_RECEIVING};
+
+// Options
+const char* url = "http://localhost/api/esp/send-id";
+unsigned long baud_rate = 9600;
+unsigned long batch_size = 100;
+unsigned long batch_time = 250;
+unsigned long queue_capacity = 10000;
+const char* spool_path = "gateway.spool";
+unsigned long spool_limit = 1000000;
+const char* dead_letter_path = "gateway.rejected";
+bool verbose = false;
+
+int epoll_fd;
+
+Port ports[MAX_PORTS];
+int num_ports = 0;
+
+Totals totals;
+
+// The queue in memory, a ring of `queue_capacity` events
+Event* queue;
+unsigned long queue_first = 0;
+unsigned long queue_count = 0;
+
+// The spool, and the position of the first event in it not yet posted
+FILE* spool;
+long spool_offset = 0;
+unsigned long spool_count = 0;
+
+// The backend, and the request in flight
+char host[128];
+char path[256];
+struct addrinfo* backend;
+
+HTTPState http_state = HTTP_IDLE;
+int http_fd = -1;
+bool http_reused = false;       // Whether the request in flight went on a connection kept alive from an earlier one
+char* request;
+size_t request_length = 0;
+size_t request_header_length = 0;
+size_t request_sent = 0;
+unsigned long request_events = 0;
+bool request_from_spool = false;
+long request_spool_end = 0;
+unsigned long long request_deadline = 0;
+char response[RESPONSE_SIZE];
+size_t response_length = 0;
+unsigned long backoff = 0;
+unsigned long long backoff_until = 0;
+
+unsigned long long monotonic_ms() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long long)(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+unsigned long long wall_ms() {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return (unsigned long long)(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+bool later(unsigned int sequence, unsigned int than) {
+  // Journal sequence numbers are 16 bits, and wrap around
+  unsigned int distance = (sequence - than) & 0xFFFF;
+  return distance != 0 && distance < 0x8000;
+}
+
+void watch(int fd, unsigned int events, unsigned int source, bool modify = false) {
+  struct epoll_event event;
+  event.events = events;
+  event.data.u32 = source;
+  epoll_ctl(epoll_fd, modify ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event);
+}
+
+Event* queued(unsigned long index) {
+  return &queue[(queue_first + index) % queue_capacity];
+}
+
+/*
+    Serial ports
+*/
+
+speed_t baud_constant(unsigned long baud) {
+  switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    default: return B0;
+  }
+}
+
+void port_write(Port* port, const char* line) {
+  // The lines are short, and the microcontroller reads them as they come, so they are not queued; one that does not fit in
+  // the buffer of the port is lost, as over the ESP8266
+  if (port->fd >= 0 && write(port->fd, line, strlen(line)) < 0 && errno != EAGAIN) {
+    fprintf(stderr, "%s: %s\n", port->name, strerror(errno));
+  }
+}
+
+void port_open(int index) {
+  Port* port = &ports[index];
+
+  if (strcmp(port->path, "pty") == 0) {
+    port->fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+    if (port->fd >= 0 && grantpt(port->fd) == 0 && unlockpt(port->fd) == 0) {
+      snprintf(port->name, sizeof(port->name), "%s", ptsname(port->fd));
+      port->peer_fd = open(port->name, O_RDWR | O_NOCTTY);
+    }
+
+    if (port->peer_fd < 0) {
+      fprintf(stderr, "pty: %s\n", strerror(errno));
+      exit(1);
+    }
+
+    // No echo of what the gateway writes back to it, nor line editing, on the other end
+    struct termios settings;
+    tcgetattr(port->peer_fd, &settings);
+    cfmakeraw(&settings);
+    tcsetattr(port->peer_fd, TCSANOW, &settings);
+
+    printf("%s: a pseudoterminal\n", port->name);
+  } else {
+    port->fd = open(port->path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+    if (port->fd < 0) {
+      port->reopen_time = monotonic_ms() + REOPEN_INTERVAL;
+      return;
+    }
+
+    struct termios settings;
+
+    if (tcgetattr(port->fd, &settings) == 0) {
+      cfmakeraw(&settings);
+      cfsetspeed(&settings, baud_constant(baud_rate));
+      settings.c_cflag |= CLOCAL | CREAD;
+      tcsetattr(port->fd, TCSANOW, &settings);
+      tcflush(port->fd, TCIOFLUSH);
+    }
+
+    printf("%s: opened\n", port->name);
+  }
+
+  watch(port->fd, EPOLLIN, SOURCE_PORT + index);
+
+  // The microcontroller starts over, if opening the port reset it, or else sends whatever it has not had ACKed; the gateway
+  // knows nothing of what it sent before
+  port->line_length = 0;
+  port->overlong = false;
+  port->seen = false;
+  port->ack_known = false;
+  port->acked = false;
+  port->replay_needed = false;
+  port->sync_waiting = false;
+  port->next_sync = monotonic_ms();
+
+  port_write(port, "REPLAY\n");
+}
+
+void port_close(Port* port) {
+  printf("%s: closed\n", port->name);
+
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, port->fd, NULL);
+  close(port->fd);
+  port->fd = -1;
+  port->reopen_time = monotonic_ms() + REOPEN_INTERVAL;
+}
+
+void send_ack(Port* port) {
+  // Once nothing of the port is queued in memory, everything it sent has been taken care of
+  if (port->pending == 0 && port->seen) {
+    port->ack_known = true;
+    port->ack_to = port->highest_seen;
+  }
+
+  if (port->ack_known && (!port->acked || later(port->ack_to, port->last_ack))) {
+    char line[16];
+    snprintf(line, sizeof(line), "ACK %u\n", port->ack_to);
+    port_write(port, line);
+
+    port->acked = true;
+    port->last_ack = port->ack_to;
+  }
+}
+
+void send_acks() {
+  for (int i = 0; i < num_ports; i++) {
+    send_ack(&ports[i]);
+  }
+}
+
+void taken_care_of(Event* event) {
+  // The event has been posted or spooled
+  Port* port = &ports[event->port];
+
+  port->pending--;
+
+  if (!port->ack_known || later(event->sequence, port->ack_to)) {
+    port->ack_known = true;
+    port->ack_to = event->sequence;
+  }
+}
+
+void handle_event(int index, const char* line) {
+  // EVT <sequence> <ENTER|DWELL|EXIT> <reader> <UID> <timestamp in ms> <Unix time, or 0 if not known>
+  Port* port = &ports[index];
+
+  unsigned int sequence;
+  char type[8];
+  unsigned int reader;
+  char uid[UID_SIZE];
+  unsigned long timestamp;
+  char unix_time[24] = "0";
+
+  if (sscanf(line, "EVT %u %7s %u %20s %lu %23s", &sequence, type, &reader, uid, &timestamp, unix_time) < 5) {
+    return;
+  }
+
+  totals.events++;
+
+  if (port->replay_needed) {
+    return;
+  }
+
+  if (port->seen && !later(sequence, port->highest_seen)) {
+    totals.duplicates++;
+    return;
+  }
+
+  if (strcmp(type, "ENTER") != 0) {
+    port->seen = true;
+    port->highest_seen = sequence;
+
+    send_ack(port);
+    return;
+  }
+
+  if (queue_count == queue_capacity) {
+    // Left in the microcontroller's journal, to be sent again after a REPLAY
+    totals.turned_away++;
+    port->replay_needed = true;
+    return;
+  }
+
+  port->seen = true;
+  port->highest_seen = sequence;
+  port->pending++;
+
+  Event* event = queued(queue_count++);
+
+  event->port = index;
+  event->sequence = sequence;
+  snprintf(event->uid, sizeof(event->uid), "%s", uid);
+  event->received = monotonic_ms();
+
+  unsigned long seconds;
+  unsigned int milliseconds;
+
+  if (sscanf(unix_time, "%lu.%u", &seconds, &milliseconds) == 2 && seconds > 0) {
+    event->time = (unsigned long long)(seconds) * 1000 + milliseconds;
+  } else {
+    event->time = wall_ms();
+  }
+
+  totals.scans++;
+}
+
+void handle_sync(Port* port, const char* line) {
+  // SYNC <timestamp in ms>, the microcontroller's tick counter as it answered; the gateway's clock at that tick is taken to
+  // be halfway through the round trip
+  unsigned long tick;
+
+  if (!port->sync_waiting || sscanf(line, "SYNC %lu", &tick) != 1) {
+    return;
+  }
+
+  unsigned long long now = monotonic_ms();
+  unsigned long round_trip = now - port->sync_sent;
+
+  port->sync_waiting = false;
+
+  if (round_trip > SYNC_MAX_ROUND_TRIP) {
+    port->next_sync = now + SYNC_TIMEOUT;
+    return;
+  }
+
+  unsigned long long time = port->sync_sent_wall + round_trip / 2;
+
+  char clock_line[64];
+  snprintf(clock_line, sizeof(clock_line), "CLOCK %lu %llu %llu %lu\n", tick, time / 1000, time % 1000, round_trip);
+  port_write(port, clock_line);
+
+  port->next_sync = now + SYNC_INTERVAL;
+  totals.syncs++;
+}
+
+void handle_line(int index, const char* line) {
+  Port* port = &ports[index];
+
+  if (strncmp(line, "EVT ", 4) == 0) {
+    handle_event(index, line);
+  } else if (strncmp(line, "SYNC ", 5) == 0) {
+    handle_sync(port, line);
+  } else if (strncmp(line, "CLOCK ", 6) == 0) {
+    int taken;
+    long error;
+    long drift;
+
+    if (verbose && sscanf(line, "CLOCK %d %ld %ld", &taken, &error, &drift) == 3) {
+      printf("%s: clock %s, %ld ms off, drift %ld ppm\n", port->name, taken ? "synced" : "not synced", error, drift);
+    }
+  } else {
+    if (strcmp(line, "HI") == 0) {
+      // The microcontroller has booted, and lost the time
+      port->sync_waiting = false;
+      port->next_sync = monotonic_ms();
+    }
+
+    if (verbose) {
+      printf("%s: %s\n", port->name, line);
+    }
+  }
+}
+
+void read_port(int index) {
+  Port* port = &ports[index];
+  char buffer[512];
+
+  ssize_t length = read(port->fd, buffer, sizeof(buffer));
+
+  if (length < 0 && (errno == EAGAIN || errno == EINTR)) {
+    return;
+  }
+
+  if (length <= 0) {
+    // Unplugged
+    port_close(port);
+    return;
+  }
+
+  for (ssize_t i = 0; i < length; i++) {
+    char c = buffer[i];
+
+    if (c == '\r') {
+      continue;
+    }
+
+    if (c == '\n') {
+      if (!port->overlong) {
+        port->line[port->line_length] = '\0';
+        handle_line(index, port->line);
+      }
+
+      port->line_length = 0;
+      port->overlong = false;
+    } else if (port->line_length < LINE_SIZE - 1) {
+      port->line[port->line_length++] = c;
+    } else {
+      port->overlong = true;
+    }
+  }
+}
+
+void service_ports(unsigned long long now) {
+  for (int i = 0; i < num_ports; i++) {
+    Port* port = &ports[i];
+
+    if (port->fd < 0) {
+      if (now >= port->reopen_time) {
+        port_open(i);
+      }
+      continue;
+    }
+
+    if (port->sync_waiting && now - port->sync_sent > SYNC_TIMEOUT) {
+      port->sync_waiting = false;
+      port->next_sync = now + SYNC_TIMEOUT;
+    }
+
+    if (!port->sync_waiting && now >= port->next_sync) {
+      port->sync_waiting = true;
+      port->sync_sent = now;
+      port->sync_sent_wall = wall_ms();
+      port_write(port, "SYNC\n");
+    }
+
+    if (port->replay_needed && queue_count < queue_capacity - batch_size) {
+      port->replay_needed = false;
+      port_write(port, "REPLAY\n");
+    }
+  }
+}
+
+/*
+    The spool
+*/
+
+void save_spool_offset() {
+  char offset_path[512];
+  snprintf(offset_path, sizeof(offset_path), "%s.offset", spool_path);
+
+  FILE* file = fopen(offset_path, "w");
+
+  if (file) {
+    fprintf(file, "%ld\n", spool_offset);
+    fclose(file);
+  }
+}
+
+void open_spool() {
+  spool = fopen(spool_path, "a+");
+
+  if (!spool) {
+    fprintf(stderr, "%s: %s\n", spool_path, strerror(errno));
+    exit(1);
+  }
+
+  char offset_path[512];
+  snprintf(offset_path, sizeof(offset_path), "%s.offset", spool_path);
+
+  FILE* file = fopen(offset_path, "r");
+
+  if (file) {
+    if (fscanf(file, "%ld", &spool_offset) != 1) {
+      spool_offset = 0;
+    }
+    fclose(file);
+  }
+
+  fseek(spool, 0, SEEK_END);
+
+  if (spool_offset < 0 || spool_offset > ftell(spool)) {
+    spool_offset = 0;
+  }
+
+  // Events left from before, posted first
+  fseek(spool, spool_offset, SEEK_SET);
+
+  int c;
+
+  while ((c = fgetc(spool)) != EOF) {
+    spool_count += (c == '\n');
+  }
+
+  if (spool_count > 0) {
+    printf("%lu events in the spool from before\n", spool_count);
+  }
+}
+
+void spill() {
+  // The oldest batch in memory goes to the spool, and is ACKed once it is on the disk
+  unsigned long count = (queue_count < batch_size) ? queue_count : batch_size;
+
+  if (count > spool_limit - spool_count) {
+    count = spool_limit - spool_count;
+  }
+
+  if (count == 0) {
+    return;
+  }
+
+  fseek(spool, 0, SEEK_END);
+
+  for (unsigned long i = 0; i < count; i++) {
+    fprintf(spool, "%s %llu\n", queued(i)->uid, queued(i)->time);
+  }
+
+  if (fflush(spool) != 0 || fdatasync(fileno(spool)) != 0) {
+    fprintf(stderr, "%s: %s\n", spool_path, strerror(errno));
+    return;
+  }
+
+  for (unsigned long i = 0; i < count; i++) {
+    taken_care_of(queued(i));
+  }
+
+  queue_first = (queue_first + count) % queue_capacity;
+  queue_count -= count;
+  spool_count += count;
+  totals.spooled += count;
+
+  send_acks();
+}
+
+/*
+    Posting to the backend
+*/
+
+bool parse_url() {
+  // http://<host>[:<port>]/<path>
+  if (strncmp(url, "http://", 7) != 0) {
+    return false;
+  }
+
+  const char* start = url + 7;
+  const char* slash = strchr(start, '/');
+  size_t length = slash ? (size_t)(slash - start) : strlen(start);
+
+  if (length == 0 || length >= sizeof(host)) {
+    return false;
+  }
+
+  memcpy(host, start, length);
+  host[length] = '\0';
+  snprintf(path, sizeof(path), "%s", slash ? slash : "/");
+
+  char name[128];
+  const char* service = "80";
+  snprintf(name, sizeof(name), "%s", host);
+
+  char* colon = strchr(name, ':');
+
+  if (colon) {
+    *colon = '\0';
+    service = colon + 1;
+  }
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  return getaddrinfo(name, service, &hints, &backend) == 0;
+}
+
+void http_close() {
+  if (http_fd >= 0) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, http_fd, NULL);
+    close(http_fd);
+    http_fd = -1;
+  }
+}
+
+size_t build_body(char* body) {
+  // {"scans":[...]} of the batch, from the spool if there is anything in it, as it holds the oldest events
+  size_t length = sprintf(body, "{\"scans\":[");
+
+  request_from_spool = spool_count > 0;
+
+  if (request_from_spool) {
+    char uid[UID_SIZE];
+    unsigned long long time;
+
+    fseek(spool, spool_offset, SEEK_SET);
+    request_events = 0;
+
+    while (request_events < batch_size && fscanf(spool, "%20s %llu\n", uid, &time) == 2) {
+      length += sprintf(body + length, "%s{\"id\":\"%s\",\"timestamp\":%llu.%03llu}", (request_events == 0) ? "" : ",", uid,
+                        time / 1000, time % 1000);
+      request_events++;
+    }
+
+    request_spool_end = ftell(spool);
+  } else {
+    request_events = (queue_count < batch_size) ? queue_count : batch_size;
+
+    for (unsigned long i = 0; i < request_events; i++) {
+      length += sprintf(body + length, "%s{\"id\":\"%s\",\"timestamp\":%llu.%03llu}", (i == 0) ? "" : ",", queued(i)->uid,
+                        queued(i)->time / 1000, queued(i)->time % 1000);
+    }
+  }
+
+  length += sprintf(body + length, "]}");
+  return length;
+}
+
+void request_failed(const char* why);
+
+void http_connect() {
+  http_fd = socket(backend->ai_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+  int on = 1;
+  setsockopt(http_fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+  http_state = HTTP_CONNECTING;
+  http_reused = false;
+
+  if (connect(http_fd, backend->ai_addr, backend->ai_addrlen) < 0 && errno != EINPROGRESS) {
+    request_failed(strerror(errno));
+    return;
+  }
+
+  watch(http_fd, EPOLLOUT, SOURCE_HTTP);
+}
+
+void start_request(unsigned long long now) {
+  if (http_state != HTTP_IDLE || now < backoff_until) {
+    return;
+  }
+
+  bool due = spool_count > 0 || queue_count >= batch_size || (queue_count > 0 && now - queued(0)->received >= batch_time);
+
+  if (!due) {
+    return;
+  }
+
+  // The body is built first, leaving room for the header, which needs its length
+  char* body = request + 512;
+  size_t body_length = build_body(body);
+
+  if (request_events == 0) {
+    // The spool holds a line that could not be read; skip it
+    spool_offset = request_spool_end;
+    spool_count = 0;
+    save_spool_offset();
+    return;
+  }
+
+  char header[512];
+  int header_length = snprintf(header, sizeof(header),
+                               "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+                               "Connection: keep-alive\r\n\r\n",
+                               path, host, body_length);
+
+  memmove(request + header_length, body, body_length);
+  memcpy(request, header, header_length);
+  request_header_length = header_length;
+  request_length = header_length + body_length;
+
+  request_sent = 0;
+  response_length = 0;
+  request_deadline = now + REQUEST_TIMEOUT;
+  totals.requests++;
+
+  if (http_fd >= 0) {
+    http_state = HTTP_SENDING;
+    http_reused = true;
+    watch(http_fd, EPOLLOUT, SOURCE_HTTP, true);
+  } else {
+    http_connect();
+  }
+}
+
+bool dead_letter(int status) {
+  // <Unix time in ms> <status> <body>, one line per batch rejected, synced to the disk before its events are let go
+  FILE* file = fopen(dead_letter_path, "a");
+
+  if (!file) {
+    return false;
+  }
+
+  fprintf(file, "%llu %d ", wall_ms(), status);
+  fwrite(request + request_header_length, 1, request_length - request_header_length, file);
+  fputc('\n', file);
+
+  bool written = fflush(file) == 0 && fdatasync(fileno(file)) == 0;
+  return (fclose(file) == 0) && written;
+}
+
+void request_done(int status) {
+  // The batch was posted, or rejected as malformed and kept in the dead letter file; either way it is done with
+  if (status == HTTP_BAD_REQUEST || status == HTTP_UNPROCESSABLE) {
+    if (!dead_letter(status)) {
+      fprintf(stderr, "%s: %s\n", dead_letter_path, strerror(errno));
+      http_reused = false;
+      request_failed("rejected, and not kept");
+      return;
+    }
+
+    totals.rejected += request_events;
+    fprintf(stderr, "backend rejected %lu scans with %d; kept in %s\n", request_events, status, dead_letter_path);
+  } else {
+    totals.posted += request_events;
+  }
+
+  if (request_from_spool) {
+    spool_offset = request_spool_end;
+    spool_count -= request_events;
+
+    if (spool_count == 0) {
+      spool_offset = 0;
+      fflush(spool);
+      if (ftruncate(fileno(spool), 0) != 0) {
+        fprintf(stderr, "%s: %s\n", spool_path, strerror(errno));
+      }
+    }
+
+    save_spool_offset();
+  } else {
+    for (unsigned long i = 0; i < request_events; i++) {
+      taken_care_of(queued(i));
+    }
+
+    queue_first = (queue_first + request_events) % queue_capacity;
+    queue_count -= request_events;
+
+    send_acks();
+  }
+
+  backoff = 0;
+  http_state = HTTP_IDLE;
+
+  // The connection is kept for the next batch
+  watch(http_fd, EPOLLIN | EPOLLRDHUP, SOURCE_HTTP, true);
+}
+
+void request_failed(const char* why) {
+  http_close();
+  http_state = HTTP_IDLE;
+
+  // A connection kept alive may have been closed by the backend in the meantime; try again at once on a new one
+  if (http_reused && response_length == 0) {
+    totals.requests--;
+    return;
+  }
+
+  totals.failures++;
+  backoff = (backoff == 0) ? MIN_BACKOFF : (backoff * 2 > MAX_BACKOFF) ? MAX_BACKOFF : backoff * 2;
+  backoff_until = monotonic_ms() + backoff;
+
+  fprintf(stderr, "posting %lu scans failed: %s; trying again in %lu ms\n", request_events, why, backoff);
+}
+
+bool response_complete(int* status) {
+  // The status of the response, once all of it is in; only Content-Length is understood, as that is what the backend sends
+  char* end = strstr(response, "\r\n\r\n");
+
+  if (!end || sscanf(response, "HTTP/1.%*d %d", status) != 1) {
+    return false;
+  }
+
+  size_t header_length = end + 4 - response;
+  size_t content_length = 0;
+
+  for (char* line = strstr(response, "\r\n"); line && line < end; line = strstr(line + 2, "\r\n")) {
+    if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+      content_length = strtoul(line + 17, NULL, 10);
+    }
+  }
+
+  return response_length >= header_length + content_length;
+}
+
+void service_http() {
+  if (http_state == HTTP_IDLE) {
+    // The backend closed the connection kept alive
+    http_close();
+    return;
+  }
+
+  if (http_state == HTTP_CONNECTING) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(http_fd, SOL_SOCKET, SO_ERROR, &error, &length);
+
+    if (error != 0) {
+      request_failed(strerror(error));
+      return;
+    }
+
+    http_state = HTTP_SENDING;
+  }
+
+  if (http_state == HTTP_SENDING) {
+    ssize_t sent = send(http_fd, request + request_sent, request_length - request_sent, MSG_NOSIGNAL);
+
+    if (sent < 0) {
+      if (errno != EAGAIN) {
+        request_failed(strerror(errno));
+      }
+      return;
+    }
+
+    request_sent += sent;
+
+    if (request_sent == request_length) {
+      http_state = HTTP_RECEIVING;
+      watch(http_fd, EPOLLIN | EPOLLRDHUP, SOURCE_HTTP, true);
+    }
+    return;
+  }
+
+  // Only the beginning of a long response is kept; its length is still counted
+  char buffer[RESPONSE_SIZE];
+  ssize_t received = recv(http_fd, buffer, sizeof(buffer), 0);
+
+  if (received < 0 && errno == EAGAIN) {
+    return;
+  }
+
+  if (received <= 0) {
+    request_failed(received < 0 ? strerror(errno) : "connection closed");
+    return;
+  }
+
+  if (response_length < RESPONSE_SIZE - 1) {
+    size_t kept = (received < (ssize_t)(RESPONSE_SIZE - 1 - response_length)) ? received : RESPONSE_SIZE - 1 - response_length;
+    memcpy(response + response_length, buffer, kept);
+    response[response_length + kept] = '\0';
+  }
+
+  response_length += received;
+
+  int status;
+
+  if (response_complete(&status)) {
+    if (status >= 400 && status != HTTP_BAD_REQUEST && status != HTTP_UNPROCESSABLE) {
+      char why[32];
+      snprintf(why, sizeof(why), "status %d", status);
+
+      http_reused = false;
+      request_failed(why);
+    } else {
+      request_done(status);
+    }
+  }
+}
+
+/*
+    The stand-in for the backend
+*/
+
+#define MAX_CLIENTS         16
+
+struct Client {
+  int fd;
+  char* buffer;
+  size_t length;
+  size_t size;
+};
+
+void stand_in_request(Client* client) {
+  // Answers each complete request in the buffer
+  while (true) {
+    char* end = (char*)(memmem(client->buffer, client->length, "\r\n\r\n", 4));
+
+    if (!end) {
+      return;
+    }
+
+    *end = '\0';
+    size_t header_length = end + 4 - client->buffer;
+    size_t content_length = 0;
+
+    for (char* line = strstr(client->buffer, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+      if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+        content_length = strtoul(line + 17, NULL, 10);
+      }
+    }
+
+    if (client->length < header_length + content_length) {
+      *end = '\r';
+      return;
+    }
+
+    char request_line[128];
+    sscanf(client->buffer, "%127[^\r]", request_line);
+
+    char* body = client->buffer + header_length;
+    unsigned long scans = 0;
+
+    for (char* id = body; (id = (char*)(memmem(id, body + content_length - id, "\"id\"", 4))); id += 4) {
+      scans++;
+    }
+
+    printf("%s: %lu scans, %zu bytes\n", request_line, scans, content_length);
+
+    if (verbose) {
+      printf("%.*s\n", (int)(content_length), body);
+    }
+
+    fflush(stdout);
+
+    const char* answer = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 2\r\n\r\n{}";
+
+    if (send(client->fd, answer, strlen(answer), MSG_NOSIGNAL) < 0) {
+      return;
+    }
+
+    client->length -= header_length + content_length;
+    memmove(client->buffer, client->buffer + header_length + content_length, client->length);
+  }
+}
+
+int run_stand_in(int tcp_port) {
+  int listen_fd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  int on = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  struct sockaddr_in6 address;
+  memset(&address, 0, sizeof(address));
+  address.sin6_family = AF_INET6;
+  address.sin6_addr = in6addr_any;
+  address.sin6_port = htons(tcp_port);
+
+  if (bind(listen_fd, (struct sockaddr*)(&address), sizeof(address)) < 0 || listen(listen_fd, MAX_CLIENTS) < 0) {
+    fprintf(stderr, "port %d: %s\n", tcp_port, strerror(errno));
+    return 1;
+  }
+
+  watch(listen_fd, EPOLLIN, SOURCE_LISTEN);
+  printf("standing in for the backend on port %d\n", tcp_port);
+  fflush(stdout);
+
+  Client clients[MAX_CLIENTS];
+
+  for (int i = 0; i < MAX_CLIENTS; i++) {
+    clients[i].fd = -1;
+  }
+
+  while (true) {
+    struct epoll_event events[16];
+    int count = epoll_wait(epoll_fd, events, 16, -1);
+
+    for (int e = 0; e < count; e++) {
+      unsigned int source = events[e].data.u32;
+
+      if (source == SOURCE_SIGNAL) {
+        return 0;
+      }
+
+      if (source == SOURCE_LISTEN) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK);
+        int i = 0;
+
+        while (fd >= 0 && i < MAX_CLIENTS && clients[i].fd >= 0) {
+          i++;
+        }
+
+        if (fd >= 0 && i == MAX_CLIENTS) {
+          close(fd);
+        } else if (fd >= 0) {
+          clients[i].fd = fd;
+          clients[i].length = 0;
+          clients[i].size = RESPONSE_SIZE;
+          clients[i].buffer = (char*)(malloc(clients[i].size));
+          watch(fd, EPOLLIN, SOURCE_PORT + i);
+        }
+        continue;
+      }
+
+      Client* client = &clients[source - SOURCE_PORT];
+
+      if (client->length == client->size) {
+        client->size *= 2;
+        client->buffer = (char*)(realloc(client->buffer, client->size));
+      }
+
+      ssize_t received = recv(client->fd, client->buffer + client->length, client->size - client->length, 0);
+
+      if (received < 0 && errno == EAGAIN) {
+        continue;
+      }
+
+      if (received <= 0) {
+        close(client->fd);
+        free(client->buffer);
+        client->fd = -1;
+        continue;
+      }
+
+      client->length += received;
+      stand_in_request(client);
+    }
+  }
+}
+
+void print_totals() {
+  printf("%lu events read, %lu scans queued, %lu duplicates, %lu turned away for want of room\n", totals.events, totals.scans,
+         totals.duplicates, totals.turned_away);
+  printf("%lu scans posted, %lu rejected, %lu spooled, %lu left in memory, %lu in the spool\n", totals.posted, totals.rejected,
+         totals.spooled, queue_count, spool_count);
+  printf("%lu requests, %lu failed, %lu clocks synced\n", totals.requests, totals.failures, totals.syncs);
+}
+
+int main(int argc, char** argv) {
+  const struct option options[] = {
+    {"url", required_argument, NULL, 'u'},
+    {"baud", required_argument, NULL, 'b'},
+    {"batch", required_argument, NULL, 'n'},
+    {"batch-time", required_argument, NULL, 't'},
+    {"queue", required_argument, NULL, 'q'},
+    {"spool", required_argument, NULL, 's'},
+    {"spool-limit", required_argument, NULL, 'l'},
+    {"dead-letter", required_argument, NULL, 'd'},
+    {"stand-in", required_argument, NULL, 'i'},
+    {"verbose", no_argument, NULL, 'v'},
+    {NULL, 0, NULL, 0}
+  };
+
+  int stand_in_port = 0;
+  int option;
+
+  while ((option = getopt_long(argc, argv, "v", options, NULL)) != -1) {
+    switch (option) {
+      case 'u': url = optarg; break;
+      case 'b': baud_rate = strtoul(optarg, NULL, 10); break;
+      case 'n': batch_size = strtoul(optarg, NULL, 10); break;
+      case 't': batch_time = strtoul(optarg, NULL, 10); break;
+      case 'q': queue_capacity = strtoul(optarg, NULL, 10); break;
+      case 's': spool_path = optarg; break;
+      case 'l': spool_limit = strtoul(optarg, NULL, 10); break;
+      case 'd': dead_letter_path = optarg; break;
+      case 'i': stand_in_port = atoi(optarg); break;
+      case 'v': verbose = true; break;
+      default: return 1;
+    }
+  }
+
+  epoll_fd = epoll_create1(0);
+
+  // Signals come through epoll, so that the totals are printed between events
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigprocmask(SIG_BLOCK, &signals, NULL);
+
+  int signal_fd = signalfd(-1, &signals, 0);
+  watch(signal_fd, EPOLLIN, SOURCE_SIGNAL);
+
+  if (stand_in_port > 0) {
+    return run_stand_in(stand_in_port);
+  }
+
+  num_ports = argc - optind;
+
+  if (num_ports < 1 || num_ports > MAX_PORTS) {
+    fprintf(stderr, "usage: %s [options] <serial port, or pty> [...], up to %d\n", argv[0], MAX_PORTS);
+    return 1;
+  }
+
+  if (baud_constant(baud_rate) == B0 || batch_size == 0 || queue_capacity <= batch_size) {
+    fprintf(stderr, "baud rate, batch, or queue not supported\n");
+    return 1;
+  }
+
+  if (!parse_url()) {
+    fprintf(stderr, "%s: not an http URL that resolves\n", url);
+    return 1;
+  }
+
+  queue = (Event*)(malloc(queue_capacity * sizeof(Event)));
+  request = (char*)(malloc(batch_size * SCAN_JSON_SIZE + 1024));
+
+  open_spool();
+
+  int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  struct itimerspec tick = {{0, TICK_INTERVAL * 1000000L}, {0, TICK_INTERVAL * 1000000L}};
+  timerfd_settime(timer_fd, 0, &tick, NULL);
+  watch(timer_fd, EPOLLIN, SOURCE_TIMER);
+
+  for (int i = 0; i < num_ports; i++) {
+    ports[i].path = argv[optind + i];
+    snprintf(ports[i].name, sizeof(ports[i].name), "%s", ports[i].path);
+    ports[i].fd = -1;
+    ports[i].peer_fd = -1;
+    ports[i].pending = 0;
+    port_open(i);
+  }
+
+  fflush(stdout);
+
+  while (true) {
+    struct epoll_event events[MAX_PORTS + 4];
+    int count = epoll_wait(epoll_fd, events, MAX_PORTS + 4, -1);
+
+    for (int e = 0; e < count; e++) {
+      unsigned int source = events[e].data.u32;
+
+      if (source == SOURCE_SIGNAL) {
+        print_totals();
+        return 0;
+      } else if (source == SOURCE_TIMER) {
+        unsigned long long expirations;
+
+        if (read(timer_fd, &expirations, sizeof(expirations)) < 0) {
+          continue;
+        }
+
+        unsigned long long now = monotonic_ms();
+
+        service_ports(now);
+
+        if (http_state != HTTP_IDLE && now > request_deadline) {
+          http_reused = false;
+          request_failed("timed out");
+        }
+      } else if (source == SOURCE_HTTP) {
+        service_http();
+      } else if (ports[source - SOURCE_PORT].fd >= 0) {
+        read_port(source - SOURCE_PORT);
+      }
+    }
+
+    // Room is made in memory before it runs out, unless the batch that would go to the spool is being posted
+    if (queue_count + batch_size >= queue_capacity && spool_count < spool_limit &&
+        !(http_state != HTTP_IDLE && !request_from_spool)) {
+      spill();
+    }
+
+    start_request(monotonic_ms());
+    fflush(stdout);
+  }
+}
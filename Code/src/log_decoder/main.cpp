@@ -0,0 +1,111 @@
+/*
+    Turns the log the firmware sends (see `TokenLog`) back into text; build with `pio run -e log_decoder`, and run
+    .pio/build/log_decoder/program <capture file>, or with the capture on the standard input, e.g. straight from the serial port.
+
+    The capture may hold anything else the firmware printed; only the lines
+
+    LOG <record in hexadecimal>
+
+    are read, and printed as
+
+    <time in milliseconds> <message>
+
+    The tokens are looked up in `LogTokens.h` as it is in this tree, so decode with the tree the firmware was built from, or a
+    later one.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <TokenLog.h>
+
+#define LOG_TOKEN_KIND(name, kind, text) kind,
+#define LOG_TOKEN_TEXT(name, kind, text) text,
+
+const unsigned char token_kinds[] = {LOG_TOKENS(LOG_TOKEN_KIND)};
+const char* token_texts[] = {LOG_TOKENS(LOG_TOKEN_TEXT)};
+
+unsigned long get_long(unsigned char* bytes) {
+  return bytes[0] | ((unsigned long)(bytes[1]) << 8) | ((unsigned long)(bytes[2]) << 16) | ((unsigned long)(bytes[3]) << 24);
+}
+
+int parse_record(const char* hex, unsigned char* record) {
+  // The bytes of a record from its hexadecimal digits; returns the length, or -1 if it is malformed
+  int length = 0;
+  unsigned int byte;
+
+  while (length < LOG_MAX_RECORD_SIZE && sscanf(hex + 2 * length, "%2x", &byte) == 1) {
+    record[length++] = byte;
+  }
+
+  if (length < LOG_HEADER_SIZE || length != LOG_HEADER_SIZE + record[LOG_LENGTH_IDX]) {
+    return -1;
+  }
+
+  return length;
+}
+
+void print_record(unsigned char* record) {
+  unsigned char token = record[LOG_TOKEN_IDX];
+  unsigned char length = record[LOG_LENGTH_IDX];
+  unsigned char* arguments = record + LOG_ARGUMENTS_IDX;
+
+  printf("%10lu ", get_long(record + LOG_TIME_IDX));
+
+  if (token >= LOG_NUM_TOKENS) {
+    printf("unknown token %u, from a later build\n", token);
+    return;
+  }
+
+  if (token_kinds[token] == LOG_BYTES) {
+    printf("%s", token_texts[token]);
+    for (int i = 0; i < length; i++) {
+      printf("%s%02X", (i == 0) ? " " : "", arguments[i]);
+    }
+    printf("\n");
+    return;
+  }
+
+  // Any argument the text does not use is ignored
+  unsigned long values[LOG_MAX_ARGUMENTS_SIZE / 4] = {0};
+
+  for (int i = 0; i < length / 4; i++) {
+    values[i] = get_long(arguments + 4 * i);
+  }
+
+  printf(token_texts[token], values[0], values[1], values[2], values[3], values[4]);
+  printf("\n");
+}
+
+int main(int argc, char** argv) {
+  FILE* file = (argc > 1) ? fopen(argv[1], "r") : stdin;
+
+  if (!file) {
+    printf("cannot open %s\n", argv[1]);
+    return 1;
+  }
+
+  char line[256];
+  int malformed = 0;
+
+  while (fgets(line, sizeof(line), file)) {
+    if (strncmp(line, "LOG ", 4) != 0) {
+      continue;
+    }
+
+    unsigned char record[LOG_MAX_RECORD_SIZE];
+
+    if (parse_record(line + 4, record) < 0) {
+      malformed++;
+      continue;
+    }
+
+    print_record(record);
+  }
+
+  if (malformed > 0) {
+    fprintf(stderr, "%d malformed LOG lines skipped\n", malformed);
+  }
+
+  return 0;
+}
@@ -3,69 +3,756 @@
 #include <Timer.h>
 #include <SerialInterface.h>
 #include <SPI.h>
-#include <PN532.h>
+#include <Reader.h>
+#include <ReaderGroup.h>
+#include <PresenceTracker.h>
+#include <EEPROMInterface.h>
+#include <CRC.h>
+#include <ScanJournal.h>
+#include <HostLink.h>
+#include <StackProbe.h>
+#include <PalletRecord.h>
+#include <PalletCache.h>
+#include <Manifest.h>
+#include <ClockSync.h>
+#include <WriteQueue.h>
+#include <SelfBenchmark.h>
+#include <TokenLog.h>
 
 // Pin HW_MOSI(B, 2);
 // Pin HW_MISO(B, 3);
 // Pin HW_SCK(B, 1);
 Pin NSS(B, 0);
 
-PN532 pn532(NSS);
+// One antenna per tine, and one on the mast; all on the same SPI bus, each with its own NSS
+Pin NSS_RIGHT_TINE(D, 7);
+Pin NSS_MAST(D, 6);
 
-void setup() {
-  Serial.begin(9600);
-  blocking_delay(1000, MILLISECONDS);
-  Serial.println("HI");
+// Lit for a moment when a pallet on the manifest, or one not on it, is detected
+Pin EXPECTED_LED(C, 3);
+Pin UNEXPECTED_LED(C, 4);
 
-  pn532.initialize();
-  blocking_delay(100, MILLISECONDS);
+#define INDICATOR_TIME    1500
 
-  pn532.SAMConfig();
+// The reader chip is picked per forklift model at compile time; build with -D READER_PN5180 for the PN5180, the PN532 is used
+// otherwise. Only the wiring differs; everything below works with either through the `Reader` interface.
+#ifdef READER_PN5180
 
-  initialize_timer();
+#include <PN5180_Reader.h>
+
+Pin BUSY_LEFT_TINE(D, 5);
+Pin BUSY_RIGHT_TINE(D, 4);
+Pin BUSY_MAST(D, 3);
+
+Pin RST_LEFT_TINE(C, 0);
+Pin RST_RIGHT_TINE(C, 1);
+Pin RST_MAST(C, 2);
+
+PN5180 pn5180_left_tine(NSS, BUSY_LEFT_TINE, RST_LEFT_TINE);
+PN5180 pn5180_right_tine(NSS_RIGHT_TINE, BUSY_RIGHT_TINE, RST_RIGHT_TINE);
+PN5180 pn5180_mast(NSS_MAST, BUSY_MAST, RST_MAST);
+
+typedef PN5180_Reader ForkliftReader;
+
+ForkliftReader left_tine(&pn5180_left_tine);
+ForkliftReader right_tine(&pn5180_right_tine);
+// The mast reader also looks for ISO15693 tags, which answer from further away, on pallets stacked above the forks
+ForkliftReader mast(&pn5180_mast, true);
+
+#else
+
+#include <PN532_Reader.h>
+
+PN532 pn532_left_tine(NSS);
+PN532 pn532_right_tine(NSS_RIGHT_TINE);
+PN532 pn532_mast(NSS_MAST);
+
+typedef PN532_Reader ForkliftReader;
+
+ForkliftReader left_tine(&pn532_left_tine);
+ForkliftReader right_tine(&pn532_right_tine);
+ForkliftReader mast(&pn532_mast);
+
+#endif
+
+// The tine antennas are far enough apart to run together; the mast antenna overlaps both, so it gets a slot of its own
+ReaderGroup<ForkliftReader> readers;
+
+// A tag is reported when it enters the field, every 30 s while it stays, and when it has not been seen for 2 s
+PresenceTracker tracker(2000, 30000);
+
+// Events are kept in the EEPROM until the uplink acknowledges them
+EEPROMInterface eeprom;
+ScanJournal journal(&eeprom, 0, 48);
+
+HostLink host_link;
+
+// Writes to pallet tags from the dispatch system, made as the tags pass; a tag is expected to stay in the field for 1.5 s, and a
+// write to take 150 ms, until some have been measured
+WriteQueue writes(2000, 1500, 150);
+
+// Writes made and verified during a scan, reported as WDONE once the field is off; a write is taken off the queue as it is made,
+// and the queue only takes writes from the host between scans, so there are never more than it holds
+struct CompletedWrite {
+  unsigned long id;
+  unsigned char sequence;
+};
+
+CompletedWrite completed_writes[WRITE_QUEUE_CAPACITY];
+unsigned char num_completed_writes = 0;
+
+// The pallet records last read, so that a pallet passing again only has the slot a rewrite would go to read
+PalletCache pallet_cache;
+
+// The shipment being loaded, pushed down by the host, and when the indicator lit for the last pallet checked goes off
+Manifest manifest;
+unsigned long indicator_off_time = 0;
+bool indicator_on = false;
+
+// The host's wall clock, from SYNC exchanges, so that events go out with the time they happened however late they are sent;
+// events journaled before the reset, from sequence numbers before `boot_sequence`, were stamped by the tick counter of then
+ClockSync clock_sync;
+unsigned int boot_sequence = 0;
+
+// The key A of the sector holding the pallet record, on MIFARE Classic cards
+unsigned char pallet_key[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+// If sent events are not acknowledged within this many milliseconds, the uplink is assumed to have lost them
+#define ACK_TIMEOUT       10000
+#define EVENTS_PER_BURST  4
+
+unsigned long last_sent_time = 0;
+
+void journal_event(PresenceEvent* event) {
+  JournalRecord record;
+
+  record.type = event->type;
+  record.reader = event->reader;
+  memcpy(record.uid, event->uid, event->uid_length);
+  record.uid_length = event->uid_length;
+  record.timestamp = event->timestamp;
+
+  journal.append(&record);
 }
 
-void loop() {
-  MIFARE_Classic_PN532* card;
-  card = pn532.get_mifare_classic_card();
-  if (card) {
-    Serial.println("FOUND");
-    unsigned char key[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
-    bool ok = card->authenticate_block(AUTHENTICATE_KEY_A, 0x02, key);
-    if (ok) {
-      Serial.println("AUTHED");
-      
-      unsigned char contents[16];
-      if (card->read_block(0x02, contents)) {
-        Serial.println("READ");
-        for (int i = 0; i < 16; i++) {
-          Serial.print(contents[i], HEX);
-          Serial.print(", ");
-        }
-        Serial.println();
-      } else {
-        Serial.println("CUDNT READ");
-      }
+void send_unsent_events() {
+  // EVT <sequence> <ENTER|DWELL|EXIT> <reader> <UID> <timestamp in ms> <Unix time, or 0 if not known>
+  const char* types[] = {"ENTER", "DWELL", "EXIT"};
 
-      blocking_delay(2000, MILLISECONDS);
+  JournalRecord record;
 
-      Serial.println("GONNA WRITE");
-      
-      unsigned char newcont[16] = {5, 1, 2, 3, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5};
-      
-      if (card->write_block(0x02, newcont)) {
-        Serial.println("WROTE");
-      } else {
-        Serial.println("CUDNT WRITE");
+  for (int sent = 0; sent < EVENTS_PER_BURST && journal.next_unsent(&record); sent++) {
+    Serial.print("EVT ");
+    Serial.print(record.sequence);
+    Serial.print(" ");
+    Serial.print(types[record.type]);
+    Serial.print(" ");
+    Serial.print(record.reader);
+    Serial.print(" ");
+    for (int i = 0; i < record.uid_length; i++) {
+      if (record.uid[i] < 0x10) {
+        Serial.print("0");
       }
+      Serial.print(record.uid[i], HEX);
+    }
+    Serial.print(" ");
+    Serial.print(record.timestamp);
+    Serial.print(" ");
 
-      blocking_delay(1000, MILLISECONDS);
+    unsigned long seconds;
+    unsigned int milliseconds;
 
+    if (((record.sequence - boot_sequence) & 0xFFFF) < 0x8000 &&
+        clock_sync.wall_time(record.timestamp, &seconds, &milliseconds)) {
+      Serial.print(seconds);
+      Serial.print(".");
+      if (milliseconds < 100) {
+        Serial.print("0");
+      }
+      if (milliseconds < 10) {
+        Serial.print("0");
+      }
+      Serial.println(milliseconds);
     } else {
-      Serial.println("CUDNT AUTH");
+      Serial.println("0");
+    }
+
+    last_sent_time = current_time(MILLISECONDS);
+  }
+
+  // Nothing has come back for the events sent; send them all again
+  if (journal.pending() > 0 && journal.unsent() == 0 && current_time(MILLISECONDS) - last_sent_time > ACK_TIMEOUT) {
+    journal.rewind();
+  }
+}
+
+// "LOG ", a record in hexadecimal, and the line ending
+#define LOG_LINE_SIZE     (4 + 2 * LOG_MAX_RECORD_SIZE + 2)
+
+void send_log() {
+  // LOG <record in hexadecimal>, one per line, for src/log_decoder; only while the whole line fits in the transmit buffer, so
+  // that sending the log never waits on the serial port
+  unsigned char record[LOG_MAX_RECORD_SIZE];
+
+  while (log_pending() > 0 && Serial.availableForWrite() >= LOG_LINE_SIZE) {
+    int length = log_read(record);
+
+    Serial.print("LOG ");
+    for (int i = 0; i < length; i++) {
+      if (record[i] < 0x10) {
+        Serial.print("0");
+      }
+      Serial.print(record[i], HEX);
+    }
+    Serial.println();
+  }
+}
+
+#ifdef SPI_TRACE
+void dump_spi_trace() {
+  // TRC <S|D|B> <sent> <received> <ticks>, one record per line, oldest first, then TRC END <records lost to the ring>
+  SPITraceRecord record;
+
+  while (spi_trace_read(&record)) {
+    Serial.print("TRC ");
+    Serial.print((char)(record.type));
+    Serial.print(" ");
+    Serial.print(record.sent, HEX);
+    Serial.print(" ");
+    Serial.print(record.received, HEX);
+    Serial.print(" ");
+    Serial.println(record.ticks, HEX);
+  }
+
+  Serial.print("TRC END ");
+  Serial.println(spi_trace_dropped());
+}
+#endif
+
+void report_missed_write(unsigned long id) {
+  // WMISS <id>: the write was not made by its deadline, or could not be queued
+  Serial.print("WMISS ");
+  Serial.println(id);
+}
+
+void report_completed_writes() {
+  // WDONE <id> <sequence>: the pallet record was written and verified, and has the new sequence number
+  for (int i = 0; i < num_completed_writes; i++) {
+    Serial.print("WDONE ");
+    Serial.print(completed_writes[i].id);
+    Serial.print(" ");
+    Serial.println(completed_writes[i].sequence);
+  }
+
+  num_completed_writes = 0;
+}
+
+void report_manifest() {
+  // MANIFEST <shipment> <pallets loaded> <pallets on the manifest>
+  Serial.print("MANIFEST ");
+  Serial.print(manifest.shipment());
+  Serial.print(" ");
+  Serial.print(manifest.loaded());
+  Serial.print(" ");
+  Serial.println(manifest.pallets());
+}
+
+#ifndef READER_PN5180
+// Receiver settings found by TUNE are kept after the journal, as RxGain MinLevel CRC-8 per reader
+#define TUNING_ADDRESS    960
+#define TUNING_SIZE       3
+
+PN532* reader_chip(unsigned char index) {
+  return readers.reader(index)->pn532();
+}
+
+void save_tuning(unsigned char index, unsigned char rx_gain, unsigned char min_level) {
+  unsigned char tuning[TUNING_SIZE] = {rx_gain, min_level, 0};
+  tuning[2] = crc8(tuning, 2);
+
+  for (int i = 0; i < TUNING_SIZE; i++) {
+    eeprom.write_byte(TUNING_ADDRESS + index * TUNING_SIZE + i, tuning[i]);
+  }
+}
+
+void load_tuning() {
+  // Readers never tuned, or whose setting was corrupted, keep the defaults
+  for (unsigned char i = 0; i < readers.num_readers(); i++) {
+    unsigned char tuning[TUNING_SIZE];
+
+    for (int j = 0; j < TUNING_SIZE; j++) {
+      tuning[j] = eeprom.read_byte(TUNING_ADDRESS + i * TUNING_SIZE + j);
+    }
+
+    if (readers.is_present(i) && crc8(tuning, 2) == tuning[2]) {
+      reader_chip(i)->set_receiver(tuning[0], tuning[1]);
+    }
+  }
+}
+
+void report_rf_statistics() {
+  // RFSTATS <reader> <exchanges> <timeouts> <CRC> <parity> <framing> <collisions> <other> <checksum errors> <NACK recoveries>,
+  // one line per reader; the counts are then cleared, so that each report covers the time since the last
+  for (unsigned char i = 0; i < readers.num_readers(); i++) {
+    PN532* pn532 = reader_chip(i);
+    PN532_RF_Statistics* statistics = pn532->rf_statistics();
+
+    unsigned long counts[] = {statistics->exchanges, statistics->timeouts, statistics->crc_errors, statistics->parity_errors,
+                              statistics->framing_errors, statistics->collisions, statistics->other_errors,
+                              pn532->checksum_errors(), pn532->nack_recoveries()};
+
+    Serial.print("RFSTATS ");
+    Serial.print(i);
+    for (unsigned int j = 0; j < sizeof(counts) / sizeof(counts[0]); j++) {
+      Serial.print(" ");
+      Serial.print(counts[j]);
+    }
+    Serial.println();
+
+    pn532->reset_rf_statistics();
+    pn532->reset_error_counters();
+  }
+}
+
+void tune_reader(unsigned char index, int trials) {
+  // TUNE <reader> <RxGain> <MinLevel> <successful reads> <trials>, or TUNE <reader> FAIL; a reference tag with a pallet record
+  // must be held in the field of the reader for the whole sweep
+  ForkliftReader* reader = readers.reader(index);
+
+  unsigned char rx_gain;
+  unsigned char min_level;
+  int successes;
+
+  bool tuned = reader_chip(index)->tune_receiver(trials, [reader](PN532*) {
+    ReaderTag tag;
+    PalletRecord record;
+
+    return reader->detect(&tag) && read_pallet_record(reader, &tag, pallet_key, &record);
+  }, &rx_gain, &min_level, &successes);
+
+  Serial.print("TUNE ");
+  Serial.print(index);
+
+  if (!tuned) {
+    Serial.println(" FAIL");
+    return;
+  }
+
+  save_tuning(index, rx_gain, min_level);
+
+  Serial.print(" ");
+  Serial.print(rx_gain);
+  Serial.print(" ");
+  Serial.print(min_level);
+  Serial.print(" ");
+  Serial.print(successes);
+  Serial.print(" ");
+  Serial.println(trials);
+}
+#endif
+
+// Operations timed by BENCH, each a full cycle against a tag held in the field; AUTH is the detection alone on a Type 2 tag
+#define BENCH_DETECT      0
+#define BENCH_AUTH        1
+#define BENCH_READ        2
+#define BENCH_OPERATIONS  3
+
+const char* bench_operations[] = {"DETECT", "AUTH", "READ"};
+
+bool bench_cycle(ForkliftReader* reader, int operation) {
+  ReaderTag tag;
+
+  if (!reader->detect(&tag)) {
+    return false;
+  }
+
+  if (operation == BENCH_DETECT) {
+    return true;
+  }
+
+  if (operation == BENCH_AUTH) {
+    return !pallet_tag_is_classic(&tag) || reader->authenticate(&tag, READER_KEY_A, PALLET_CLASSIC_BLOCK, pallet_key);
+  }
+
+  PalletRecord record;
+
+  return read_pallet_record(reader, &tag, pallet_key, &record);
+}
+
+void bench_preset(unsigned char index, const char* preset, int cycles) {
+  // BENCH <reader> <preset> <operation> <runs> <failures> <fastest us> <mean us> <slowest us> <cycles per second>, one line per
+  // operation; the times are of the successful cycles only
+  ForkliftReader* reader = readers.reader(index);
+
+  for (int operation = 0; operation < BENCH_OPERATIONS; operation++) {
+    SelfBenchmarkResult result;
+
+    self_benchmark(cycles, [reader, operation]() { return bench_cycle(reader, operation); }, &result);
+
+    unsigned long times[] = {(result.failures < result.runs) ? result.fastest : 0, self_benchmark_mean(&result), result.slowest};
+
+    Serial.print("BENCH ");
+    Serial.print(index);
+    Serial.print(" ");
+    Serial.print(preset);
+    Serial.print(" ");
+    Serial.print(bench_operations[operation]);
+    Serial.print(" ");
+    Serial.print(result.runs);
+    Serial.print(" ");
+    Serial.print(result.failures);
+    for (int i = 0; i < 3; i++) {
+      Serial.print(" ");
+      Serial.print(times[i]);
+    }
+    Serial.print(" ");
+    Serial.println(self_benchmark_rate(&result));
+  }
+}
+
+void bench_reader(unsigned char index, int cycles) {
+  // Time each operation `cycles` times per preset, then BENCH END; a tag must be held in the field of the reader throughout.
+  // Nothing else is serviced meanwhile, so events wait in the journal.
+#ifdef READER_PN5180
+  bench_preset(index, "SET", cycles);
+#else
+  // The receiver settings, and the parameter profile, are what set the time of a cycle on the PN532; SET is as the reader is
+  // configured (e.g. by TUNE), and it is left that way afterwards
+  PN532* pn532 = reader_chip(index);
+  ForkliftReader* reader = readers.reader(index);
+
+  unsigned char rx_gain = pn532->rx_gain();
+  unsigned char min_level = pn532->min_level();
+  unsigned char profile = reader->profile();
+
+  struct {
+    const char* name;
+    unsigned char rx_gain;
+    unsigned char min_level;
+    unsigned char profile;
+  } presets[] = {
+    {"SET", rx_gain, min_level, profile},
+    {"DEFAULT", (unsigned char)(DEFAULT_RX_GAIN), (unsigned char)(DEFAULT_MIN_LEVEL), profile},
+    {"HIGH", RX_GAIN_LAST, MIN_LEVEL_FIRST, profile},
+    {"LOW", RX_GAIN_FIRST, MIN_LEVEL_LAST, profile},
+    {"ISODEP", rx_gain, min_level, PROFILE_ISO_DEP},
+  };
+
+  for (unsigned int i = 0; i < sizeof(presets) / sizeof(presets[0]); i++) {
+    if (pn532->set_receiver(presets[i].rx_gain, presets[i].min_level)) {
+      reader->set_profile(presets[i].profile);
+      bench_preset(index, presets[i].name, cycles);
+    }
+  }
+
+  pn532->set_receiver(rx_gain, min_level);
+  reader->set_profile(profile);
+#endif
+
+  Serial.println("BENCH END");
+}
+
+void service_host_link() {
+  while (Serial.available() > 0) {
+    if (!host_link.feed(Serial.read())) {
+      continue;
+    }
+
+    if (host_link.is("ACK")) {
+      // ACK <sequence>: every event up to and including <sequence> has been delivered
+      journal.acknowledge(host_link.argument(0));
+    } else if (host_link.is("REPLAY")) {
+      // REPLAY: the uplink has reconnected; send every event not yet acknowledged again
+      journal.rewind();
+    } else if (host_link.is("WRITE")) {
+      // WRITE <id> <UID> <shipment> <destination> <deadline>: write a new shipment and destination to the pallet record of the
+      // tag with <UID> (in hexadecimal) when it passes, within <deadline> ms
+      unsigned char uid[MAX_UID_LENGTH];
+      int uid_length = host_link.argument_bytes(1, uid, MAX_UID_LENGTH);
+
+      if (uid_length <= 0 ||
+          !writes.add(host_link.argument(0), uid, uid_length, host_link.argument(2), host_link.argument(3),
+                      current_time(MILLISECONDS) + host_link.argument(4))) {
+        report_missed_write(host_link.argument(0));
+      }
+    } else if (host_link.is("BENCH")) {
+      // BENCH <reader> <cycles>: time detecting, authenticating and reading a tag held in the field of <reader>, per preset
+      if (host_link.argument(0) < readers.num_readers() && readers.is_present(host_link.argument(0)) && host_link.argument(1) > 0) {
+        bench_reader(host_link.argument(0), host_link.argument(1));
+      }
+    } else if (host_link.is("STACK")) {
+      // STACK: report the deepest the stack has grown since boot, as STACK <bytes used> <bytes never used>
+      Serial.print("STACK ");
+      Serial.print(stack_probe_high_water());
+      Serial.print(" ");
+      Serial.println(stack_probe_unused());
+    } else if (host_link.is("MBEGIN")) {
+      // MBEGIN <shipment>: start loading the manifest of <shipment>, replacing the one before
+      manifest.begin(host_link.argument(0));
+    } else if (host_link.is("MADD")) {
+      // MADD <UID> [<UID> ...]: add pallets to the manifest being loaded, by the UIDs of their tags (in hexadecimal)
+      for (unsigned char i = 0; i < host_link.argument_count(); i++) {
+        unsigned char uid[MAX_UID_LENGTH];
+        int uid_length = host_link.argument_bytes(i, uid, MAX_UID_LENGTH);
+
+        if (uid_length > 0 && !manifest.add(uid, uid_length)) {
+          Serial.println("MFULL");
+          break;
+        }
+      }
+    } else if (host_link.is("MEND")) {
+      // MEND: the manifest is loaded; check every tag detected against it from now on
+      manifest.end();
+      report_manifest();
+    } else if (host_link.is("MSTATUS")) {
+      report_manifest();
+    } else if (host_link.is("SYNC")) {
+      // SYNC: report the tick counter as SYNC <timestamp in ms>, for the host to give the wall clock time at, with CLOCK
+      Serial.print("SYNC ");
+      Serial.println(current_time(MILLISECONDS));
+    } else if (host_link.is("CLOCK")) {
+      // CLOCK <timestamp in ms> <Unix time in s> <ms> <round trip in ms>: the host's time at the timestamp of a SYNC reply,
+      // halfway through the round trip from sending SYNC to receiving the reply; reported as CLOCK <1 if the sample was taken,
+      // else 0> <error in ms> <drift in ppm>
+      bool taken = clock_sync.sample(host_link.argument(0), host_link.argument(1), host_link.argument(2), host_link.argument(3));
+
+      Serial.print("CLOCK ");
+      Serial.print(taken ? 1 : 0);
+      Serial.print(" ");
+      Serial.print(clock_sync.last_error());
+      Serial.print(" ");
+      Serial.println(clock_sync.drift());
+    } else if (host_link.is("CACHE")) {
+      // CACHE: report the pallet cache, as CACHE <records cached> <reads served from it> <reads in full>
+      Serial.print("CACHE ");
+      Serial.print(pallet_cache.count());
+      Serial.print(" ");
+      Serial.print(pallet_cache.hits());
+      Serial.print(" ");
+      Serial.println(pallet_cache.misses());
+    }
+#ifndef READER_PN5180
+    else if (host_link.is("RFSTATS")) {
+      // RFSTATS: report the RF errors of each reader since the last report
+      report_rf_statistics();
+    } else if (host_link.is("TUNE")) {
+      // TUNE <reader> <trials>: sweep the receiver settings of <reader> against a reference tag, and keep the best
+      if (host_link.argument(0) < readers.num_readers() && readers.is_present(host_link.argument(0)) && host_link.argument(1) > 0) {
+        tune_reader(host_link.argument(0), host_link.argument(1));
+      }
+    }
+#endif
+#ifdef SPI_TRACE
+    else if (host_link.is("TRACE")) {
+      // TRACE: dump the SPI trace captured so far, for src/replay
+      dump_spi_trace();
     }
+#endif
+  }
+}
+
+void check_manifest(ReaderTag* tag) {
+  // Light the indicator for a pallet on the manifest, or one that should not be on the forks; done first on every detection,
+  // as the driver is waiting on it
+  unsigned char found = manifest.check(tag->uid, tag->uid_length);
+
+  if (found == MANIFEST_NONE) {
+    return;
+  }
+
+  if (found == MANIFEST_UNEXPECTED) {
+    EXPECTED_LED.deassert();
+    UNEXPECTED_LED.assert();
   } else {
-    Serial.println("NO");
+    UNEXPECTED_LED.deassert();
+    EXPECTED_LED.assert();
+  }
+
+  indicator_off_time = current_time(MILLISECONDS) + INDICATOR_TIME;
+  indicator_on = true;
+
+  if (found == MANIFEST_UNEXPECTED) {
+    log_bytes(LOG_UNEXPECTED_PALLET, tag->uid, tag->uid_length);
+  } else if (found == MANIFEST_EXPECTED && manifest.complete()) {
+    log_event(LOG_MANIFEST_COMPLETE, manifest.shipment(), manifest.pallets());
   }
-  blocking_delay(500, MILLISECONDS);
-}
\ No newline at end of file
+}
+
+void service_indicator() {
+  if (indicator_on && (long)(current_time(MILLISECONDS) - indicator_off_time) >= 0) {
+    EXPECTED_LED.deassert();
+    UNEXPECTED_LED.deassert();
+    indicator_on = false;
+  }
+}
+
+void idle(unsigned long duration) {
+  // Do the background work while waiting, instead of just blocking
+  unsigned long start = current_time(MILLISECONDS);
+
+  while (current_time(MILLISECONDS) - start < duration) {
+    service_indicator();
+    report_completed_writes();
+    service_host_link();
+    send_unsent_events();
+    send_log();
+    journal.service();
+  }
+}
+
+void write_tag(ForkliftReader* reader, ReaderTag* tag, PendingWrite* write) {
+  // Change the shipment and destination of the current pallet record, in the same authentication it is read in; a tag without
+  // a valid record gets a fresh one
+  unsigned long start = current_time(MILLISECONDS);
+
+  PalletRecord current;
+  int current_slot = find_pallet_record(reader, tag, pallet_key, &current);
+
+  PalletRecord record = {0, 0, 0, 0, 0};
+
+  if (current_slot >= 0) {
+    record = current;
+  }
+
+  record.shipment = write->shipment;
+  record.destination = write->destination;
+
+  unsigned long id = write->id;
+
+  if (!commit_pallet_record(reader, tag, &record, current_slot, &current)) {
+    // Tried again when the tag is next detected, until the deadline; a tag whose NDEF data leaves no room never takes it
+    writes.fail(write, current_time(MILLISECONDS) - start);
+
+    if (current_slot == PALLET_NO_ROOM) {
+      log_bytes(LOG_PALLET_NO_ROOM, tag->uid, tag->uid_length);
+    } else {
+      log_event(LOG_WRITE_FAILED, id, write->attempts);
+    }
+
+    return;
+  }
+
+  writes.complete(write, current_time(MILLISECONDS) - start);
+
+  // The record is now current in the slot written, or still where it was if it was current already
+  int slot = (current_slot >= 0 && record.sequence == current.sequence) ? current_slot : (current_slot == 0) ? 1 : 0;
+  pallet_cache.store(tag->uid, tag->uid_length, &record, slot);
+
+  // Reported from `idle()`, as printing here would hold the field on for the serial port
+  if (num_completed_writes < WRITE_QUEUE_CAPACITY) {
+    completed_writes[num_completed_writes].id = id;
+    completed_writes[num_completed_writes].sequence = record.sequence;
+    num_completed_writes++;
+  }
+}
+
+void read_tag(ForkliftReader* reader, ReaderTag* tag) {
+  // The pallet record; one authentication and a read of each of blocks 60 and 61 of a MIFARE Classic card, or a read of the
+  // capability container and each of pages 32 to 35 and 36 to 39 of an NTAG, or only one slot for a pallet cached since it
+  // last passed. It is logged
+  // rather than printed, as the tag is read while the field is on.
+  PalletRecord record;
+
+  if (!read_pallet_record(reader, tag, pallet_key, &pallet_cache, &record)) {
+    log_bytes(LOG_NO_PALLET, tag->uid, tag->uid_length);
+    return;
+  }
+
+  log_event(LOG_PALLET, record.sku, record.quantity, record.destination, record.shipment, record.sequence);
+}
+
+void handle_detection(ReaderDetection* detection) {
+  ReaderTag* tag = &detection->tag;
+  unsigned long now = current_time(MILLISECONDS);
+
+  check_manifest(tag);
+
+  // A pending write goes first, on every detection until it is made, as the tag may only be in the field for a moment. A
+  // vicinity tag holds no pallet record, and is only tracked.
+  bool vicinity = (tag->sak == READER_SAK_VICINITY);
+  PendingWrite* write = vicinity ? nullptr : writes.due(tag->uid, tag->uid_length, now);
+
+  if (write) {
+    write_tag(readers.reader(detection->reader), tag, write);
+  }
+
+  PresenceEvent event;
+
+  if (!tracker.observe(tag->uid, tag->uid_length, detection->reader, now, &event)) {
+    return;
+  }
+
+  journal_event(&event);
+
+  // Only read the tag once when it arrives, not every time it is polled while sitting on the forks
+  if (event.type == PRESENCE_ENTER && !vicinity) {
+    read_tag(readers.reader(detection->reader), tag);
+  }
+}
+
+void setup() {
+  // Before anything has used the stack any deeper, so that STACK reports the worst case
+  stack_probe_paint();
+
+  // Any reset but a power-on or brown-out reset (the reset button, the watchdog) leaves the readers powered and configured
+  bool warm_start = !(MCUSR & ((1 << PORF) | (1 << BORF)));
+  MCUSR = 0;
+
+  initialize_timer();
+  initialize_tick_counter();
+
+  Serial.begin(9600);
+  Serial.println("HI");
+
+  log_event(LOG_BOOT, warm_start);
+
+  EXPECTED_LED.set_output();
+  UNEXPECTED_LED.set_output();
+
+  readers.add_reader(&left_tine, 0);
+  readers.add_reader(&right_tine, 0);
+  readers.add_reader(&mast, 1);
+
+  // Each reader is probed until it answers, rather than waited for; readers that are not fitted do not respond, and are left
+  // out. One that stops answering later is initialized again during the scans.
+  readers.initialize(warm_start);
+
+#ifndef READER_PN5180
+  // The receiver settings last found by TUNE, for the racking around each antenna
+  load_tuning();
+#endif
+
+  // Pick up where the journal left off, and send whatever was not acknowledged before the reset
+  journal.initialize();
+  boot_sequence = journal.next_sequence();
+
+#ifdef BENCH_AT_BOOT
+  // Build with -D BENCH_AT_BOOT=<cycles> to benchmark every reader on its own, as with BENCH, before scanning
+  for (unsigned char i = 0; i < readers.num_readers(); i++) {
+    if (readers.is_present(i)) {
+      bench_reader(i, BENCH_AT_BOOT);
+    }
+  }
+#endif
+}
+
+void loop() {
+  readers.scan(handle_detection);
+
+  PresenceEvent event;
+
+  while (tracker.expire(current_time(MILLISECONDS), &event)) {
+    journal_event(&event);
+
+    // How long tags stay in the field, for scheduling the writes
+    writes.observe_dwell(event.dwell_time);
+  }
+
+  PendingWrite missed;
+
+  while (writes.expire(current_time(MILLISECONDS), &missed)) {
+    report_missed_write(missed.id);
+  }
+
+  idle(500);
+}
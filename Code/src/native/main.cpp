@@ -0,0 +1,307 @@
+/*
+    The firmware's readers, running on a computer against simulated PN532s, for measuring what a scan costs without the
+    hardware; build with `pio run -e native`, and run .pio/build/native/program.
+
+    Three PN532s are wired as on the forklift, with a MIFARE Classic 1K on the left tine and an NTAG213 at the mast; the NTAG213
+    is taken away halfway, and the PN532 of the right tine browns out alone after the first scan, to be initialized again. The
+    PN532 at the mast browns out for longer, so that it is not back when it is initialized again, and is left out until it is
+    probed a couple of scans later. The readers are initialized once more as on a warm start. A write of a new shipment is queued for the MIFARE Classic card, and
+    one for a tag that never comes; later, the card's record is rewritten as by another forklift, which the pallet cache must
+    notice. A manifest holding the MIFARE Classic card, but not the NTAG213, is checked on every detection. Each scan reports
+    the simulated time it took, what went over the SPI bus, and what the PN532s saw. What the libraries logged is printed at the
+    end, as the firmware would send it, for src/log_decoder.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A reader left out is probed every other scan, rather than every 50, so that the mast's PN532 comes back within the run
+#define READER_PROBE_INTERVAL 2
+
+#include <Pins.h>
+#include <Timer.h>
+#include <Reader.h>
+#include <PN532_Reader.h>
+#include <ReaderGroup.h>
+#include <PalletRecord.h>
+#include <PalletCache.h>
+#include <Manifest.h>
+#include <WriteQueue.h>
+#include <TokenLog.h>
+#include <Emulator.h>
+#include <PN532_Model.h>
+#include <Simulated_Cards.h>
+
+#define NUM_SCANS 8
+
+Emulator emulator;
+
+PN532_Model left_tine_model;
+PN532_Model right_tine_model;
+PN532_Model mast_model;
+
+PN532_Model* models[] = {&left_tine_model, &right_tine_model, &mast_model};
+
+const unsigned char classic_uid[4] = {0xDE, 0xAD, 0xBE, 0xEF};
+const unsigned char ntag_uid[7] = {0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+
+Simulated_MIFARE_Classic pallet_card(classic_uid);
+Simulated_NTAG213 mast_tag(ntag_uid);
+
+ReaderGroup<PN532_Reader>* readers;
+
+WriteQueue writes(2000, 1500, 150);
+
+PalletCache pallet_cache;
+
+Manifest manifest;
+
+void print_uid(ReaderTag* tag) {
+  for (int i = 0; i < tag->uid_length; i++) {
+    printf("%02X", tag->uid[i]);
+  }
+}
+
+void read_tag(PN532_Reader* reader, ReaderTag* tag) {
+  // As in the firmware; the pallet record in blocks 60 and 61 of a MIFARE Classic card, or pages 32 to 39 of an NTAG
+  unsigned char key[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+  PalletRecord record;
+
+  if (!read_pallet_record(reader, tag, key, &pallet_cache, &record)) {
+    printf("    no pallet record\n");
+    return;
+  }
+
+  printf("    pallet: SKU %lu, quantity %u, destination %u, shipment %lu, sequence %u\n", record.sku, record.quantity,
+         record.destination, record.shipment, record.sequence);
+}
+
+void write_tag(PN532_Reader* reader, ReaderTag* tag, PendingWrite* write) {
+  // As in the firmware
+  unsigned char key[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+  unsigned long start = current_time(MILLISECONDS);
+
+  PalletRecord current;
+  int current_slot = find_pallet_record(reader, tag, key, &current);
+
+  PalletRecord record = {0, 0, 0, 0, 0};
+
+  if (current_slot >= 0) {
+    record = current;
+  }
+
+  record.shipment = write->shipment;
+  record.destination = write->destination;
+
+  unsigned long id = write->id;
+
+  if (!commit_pallet_record(reader, tag, &record, current_slot, &current)) {
+    writes.fail(write, current_time(MILLISECONDS) - start);
+    printf("    write %lu failed\n", id);
+    return;
+  }
+
+  writes.complete(write, current_time(MILLISECONDS) - start);
+
+  int slot = (current_slot >= 0 && record.sequence == current.sequence) ? current_slot : (current_slot == 0) ? 1 : 0;
+  pallet_cache.store(tag->uid, tag->uid_length, &record, slot);
+
+  printf("    write %lu done, sequence %u, in %lu ms\n", id, record.sequence, current_time(MILLISECONDS) - start);
+}
+
+void handle_detection(ReaderDetection* detection) {
+  printf("  reader %d: ", detection->reader);
+  print_uid(&detection->tag);
+  printf(" (SAK %02X)\n", detection->tag.sak);
+
+  // As in the firmware, first, where it lights the indicator
+  const char* manifest_results[] = {"", "on the manifest", "on the manifest, loaded already", "NOT on the manifest"};
+  unsigned char found = manifest.check(detection->tag.uid, detection->tag.uid_length);
+
+  if (found != MANIFEST_NONE) {
+    printf("    %s; %u of %u pallets loaded\n", manifest_results[found], manifest.loaded(), manifest.pallets());
+  }
+
+  PendingWrite* write = writes.due(detection->tag.uid, detection->tag.uid_length, current_time(MILLISECONDS));
+
+  if (write) {
+    write_tag(readers->reader(detection->reader), &detection->tag, write);
+  }
+
+  read_tag(readers->reader(detection->reader), &detection->tag);
+}
+
+void restore_power(void* model) {
+  ((PN532_Model*)(model))->set_powered(true);
+}
+
+void reset_counters() {
+  emulator.reset_counters();
+
+  for (int i = 0; i < 3; i++) {
+    models[i]->reset_counters();
+  }
+}
+
+void report(const char* what, unsigned long long start) {
+  unsigned long frames = 0;
+  unsigned long status_polls = 0;
+
+  for (int i = 0; i < 3; i++) {
+    frames += models[i]->frames_received();
+    status_polls += models[i]->status_polls();
+  }
+
+  printf("%s: %.3f ms, %lu SPI bytes, %lu SPI transactions, %lu frames, %lu status polls\n", what,
+         (emulator.now() - start) / 1000000.0, emulator.spi_bytes(), emulator.spi_transactions(), frames, status_polls);
+}
+
+int main(int argc, char** argv) {
+  int num_scans = (argc > 1) ? atoi(argv[1]) : NUM_SCANS;
+
+  // The emulator must be attached before anything touches the registers
+  emulator.attach();
+  emulator.add_spi_device(&left_tine_model, B, 0);
+  emulator.add_spi_device(&right_tine_model, D, 7);
+  emulator.add_spi_device(&mast_model, D, 6);
+
+  // A pallet record in the first slot of the MIFARE Classic card; the NTAG213 has none
+  PalletRecord pallet = {4711, 48, 7, 123, 1};
+  pallet_record_encode(&pallet, pallet_card.blocks[PALLET_CLASSIC_BLOCK]);
+
+  left_tine_model.add_card(&pallet_card);
+  mast_model.add_card(&mast_tag);
+
+  Pin NSS(B, 0);
+  Pin NSS_RIGHT_TINE(D, 7);
+  Pin NSS_MAST(D, 6);
+
+  PN532 pn532_left_tine(NSS);
+  PN532 pn532_right_tine(NSS_RIGHT_TINE);
+  PN532 pn532_mast(NSS_MAST);
+
+  PN532_Reader left_tine(&pn532_left_tine);
+  PN532_Reader right_tine(&pn532_right_tine);
+  PN532_Reader mast(&pn532_mast);
+
+  ReaderGroup<PN532_Reader> group;
+  readers = &group;
+
+  initialize_timer();
+  initialize_tick_counter();
+
+  group.add_reader(&left_tine, 0);
+  group.add_reader(&right_tine, 0);
+  group.add_reader(&mast, 1);
+
+  unsigned long long start = emulator.now();
+  reset_counters();
+
+  printf("%d readers initialized\n", group.initialize());
+  report("initialization", start);
+
+  // As after a reset of the host alone, e.g. by the watchdog; the PN532s are only probed
+  start = emulator.now();
+  reset_counters();
+
+  printf("%d readers initialized on a warm start\n", group.initialize(true));
+  report("warm start", start);
+
+  // Shipment 456 to destination 9 for the MIFARE Classic card, and a write for a tag that is never seen, due within 2 s
+  unsigned char absent_uid[4] = {0x01, 0x02, 0x03, 0x04};
+
+  writes.add(1, (unsigned char*)(classic_uid), sizeof(classic_uid), 456, 9, current_time(MILLISECONDS) + 2000);
+  writes.add(2, absent_uid, sizeof(absent_uid), 789, 3, current_time(MILLISECONDS) + 2000);
+
+  // The manifest of shipment 456 has the MIFARE Classic card and the tag that never comes; the NTAG213 is not on it
+  manifest.begin(456);
+  manifest.add((unsigned char*)(classic_uid), sizeof(classic_uid));
+  manifest.add(absent_uid, sizeof(absent_uid));
+  manifest.end();
+
+  bool present[MAX_READERS];
+
+  for (int i = 0; i < group.num_readers(); i++) {
+    present[i] = group.is_present(i);
+  }
+
+  for (int scan = 0; scan < num_scans; scan++) {
+    if (scan == num_scans / 2) {
+      mast_model.remove_card(&mast_tag);
+      printf("NTAG213 taken away from the mast\n");
+    }
+
+    if (scan == 2) {
+      // Another forklift takes 8 cartons off, writing sequence 3 to block 60; the write of scan 0 went to block 61, as sequence 2
+      PalletRecord rewritten = {4711, 40, 9, 456, 3};
+      pallet_record_encode(&rewritten, pallet_card.blocks[PALLET_CLASSIC_BLOCK]);
+      printf("pallet record rewritten by another forklift\n");
+    }
+
+    if (scan == 1) {
+      // The right tine's PN532 browns out alone, and is back 50 ms later, without its configuration
+      right_tine_model.set_powered(false);
+      emulator.schedule(emulator.now() + 50000000ULL, restore_power, &right_tine_model);
+      printf("right tine PN532 browned out\n");
+    }
+
+    if (scan == num_scans / 2) {
+      // The mast's PN532 browns out for 300 ms; it is still down when it is initialized again, so it is left out, until probed
+      mast_model.set_powered(false);
+      emulator.schedule(emulator.now() + 300000000ULL, restore_power, &mast_model);
+      printf("mast PN532 browned out\n");
+    }
+
+    start = emulator.now();
+    reset_counters();
+
+    char what[16];
+    snprintf(what, sizeof(what), "scan %d", scan);
+
+    printf("%s\n", what);
+    group.scan(handle_detection);
+    report(what, start);
+
+    for (int i = 0; i < group.num_readers(); i++) {
+      if (group.is_present(i) != present[i]) {
+        present[i] = group.is_present(i);
+        printf("reader %d %s\n", i, present[i] ? "answering again" : "left out");
+      }
+    }
+
+    PendingWrite missed;
+
+    while (writes.expire(current_time(MILLISECONDS), &missed)) {
+      printf("write %lu missed\n", missed.id);
+    }
+  }
+
+  printf("%u readers initialized again after a fault\n", group.recoveries());
+  printf("%lu pallet reads served from the cache, %lu in full\n", pallet_cache.hits(), pallet_cache.misses());
+
+  // The log of the whole run, for src/log_decoder
+  unsigned char log_record[LOG_MAX_RECORD_SIZE];
+  int log_length;
+
+  while ((log_length = log_read(log_record)) > 0) {
+    printf("LOG ");
+    for (int i = 0; i < log_length; i++) {
+      printf("%02X", log_record[i]);
+    }
+    printf("\n");
+  }
+
+#ifdef SPI_TRACE
+  // The trace of the whole run, for src/replay
+  SPITraceRecord record;
+
+  while (spi_trace_read(&record)) {
+    printf("TRC %c %02X %02X %04X\n", record.type, record.sent, record.received, record.ticks);
+  }
+
+  printf("TRC END %u\n", spi_trace_dropped());
+#endif
+
+  return 0;
+}
@@ -0,0 +1,208 @@
+/*
+    Replays an SPI trace captured from a PN532 (a firmware built with -D SPI_TRACE, whose trace was dumped with the TRACE
+    command) through the current `PN532` driver, against the emulator; build with `pio run -e replay`, and run
+    .pio/build/replay/program <trace file>, or with the trace on the standard input.
+
+    The file may hold anything else the firmware printed; only the lines
+
+    TRC <S|D|B> <sent> <received> <ticks>
+
+    are read (all but the type in hexadecimal). Only the first PN532 selected in the trace is replayed.
+
+    For each command the host sent, the time it took in the capture and in the replay is reported, split into writing the frame,
+    getting the ACK, and getting the response, along with the status polls, and whether the frame the driver wrote differs from
+    the one captured.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <Pins.h>
+#include <Timer.h>
+#include <PN532.h>
+#include <Emulator.h>
+#include <PN532_Trace_Replay.h>
+
+Emulator emulator;
+PN532_Trace_Replay replay;
+
+const char* command_name(unsigned char opcode) {
+  switch (opcode) {
+    case GET_FIRMWARE_VERSION: return "GET_FIRMWARE_VERSION";
+    case SET_PARAMETERS: return "SET_PARAMETERS";
+    case SAM_CONFIGURATION: return "SAM_CONFIGURATION";
+    case RF_CONFIGURATION: return "RF_CONFIGURATION";
+    case LIST_PASSIVE_TARGETS: return "LIST_PASSIVE_TARGETS";
+    case DATA_EXCHANGE: return "DATA_EXCHANGE";
+    case SELECT_TARGET: return "SELECT_TARGET";
+    case PSL: return "PSL";
+    default: return "?";
+  }
+}
+
+void run_command(PN532* pn532, TraceCommand* command) {
+  // Have the driver issue the command captured, the way the firmware would have
+  unsigned char* data = command->frame + OPCODE_IDX;
+  int length = command->frame[LEN_IDX] - 1;
+  unsigned char* parameters = data + 1;
+
+  unsigned char card_number;
+  unsigned char card_data[CARD_DATA_SIZE];
+  unsigned char response[TRACE_MAX_BYTES];
+
+  switch (data[0]) {
+    case SAM_CONFIGURATION:
+      pn532->SAMConfig();
+      return;
+
+    case RF_CONFIGURATION:
+      if (parameters[0] == RF_FIELD_ITEM) {
+        pn532->set_rf_field(parameters[1] & 0b1);
+        return;
+      } else if (parameters[0] == MAX_RETRIES_ITEM) {
+        pn532->set_passive_activation_retries(parameters[3]);
+        return;
+      }
+
+      break;
+
+    case LIST_PASSIVE_TARGETS:
+      pn532->detect_card(&card_number, card_data);
+      return;
+
+    case SELECT_TARGET:
+      pn532->select_target(parameters[0]);
+      return;
+
+    case DATA_EXCHANGE:
+      pn532->data_exchange(parameters[0], parameters + 1, length - 2, response, TRACE_MAX_BYTES);
+      return;
+
+    case PSL:
+      pn532->set_bit_rates(parameters[0], parameters[1], parameters[2]);
+      return;
+
+    default:
+      break;
+  }
+
+  // Anything else is sent as it was, and its response read whole
+  if (pn532->issue_command_from_array(data, length) && command->response_length > 0) {
+    pn532->receive_command_response(response, command->response_length, true, true);
+  }
+}
+
+double ms(unsigned long long nanoseconds) {
+  return nanoseconds / 1e6;
+}
+
+int main(int argc, char** argv) {
+  FILE* file = (argc > 1) ? fopen(argv[1], "r") : stdin;
+
+  if (!file) {
+    printf("cannot open %s\n", argv[1]);
+    return 1;
+  }
+
+  char line[128];
+  int num_records = 0;
+
+  while (fgets(line, sizeof(line), file)) {
+    char type;
+    unsigned int sent, received, ticks;
+
+    if (sscanf(line, "TRC %c %x %x %x", &type, &sent, &received, &ticks) != 4) {
+      continue;
+    }
+
+    if (!replay.add_record(type, sent, received, ticks)) {
+      printf("trace too long, replaying the first %d transactions\n", TRACE_MAX_TRANSACTIONS);
+      break;
+    }
+
+    num_records++;
+  }
+
+  int num_commands = replay.split_commands();
+  printf("%d records, %d commands\n\n", num_records, num_commands);
+
+  if (num_commands == 0) {
+    return 1;
+  }
+
+  // Wire the PN532 to the pin it was on in the capture
+  unsigned char port = (replay.device() / 8) * 3 + B;
+  unsigned char pin = replay.device() % 8;
+
+  emulator.attach();
+  emulator.add_spi_device(&replay, port, pin);
+
+  Pin NSS(port, pin);
+  PN532 pn532(NSS);
+
+  initialize_timer();
+  initialize_tick_counter();
+  pn532.initialize();
+
+  for (int i = 0; i < num_commands; i++) {
+    run_command(&pn532, replay.command(i));
+  }
+
+  // Where the time went, per command; write / ACK / response phases, in ms
+  printf("%4s %-22s %26s %26s %11s  %s\n", "#", "command", "captured (wr/ack/resp)", "replayed (wr/ack/resp)", "polls",
+         "frame");
+
+  unsigned long long captured[3] = {0, 0, 0};
+  unsigned long long replayed[3] = {0, 0, 0};
+  unsigned long long captured_between = 0;
+
+  for (int i = 0; i < num_commands; i++) {
+    TraceCommand* command = replay.command(i);
+
+    unsigned long long captured_phases[3] = {command->write_end - command->start, command->ack_end - command->write_end,
+                                             command->end - command->ack_end};
+    unsigned long long replayed_phases[3] = {command->replay_write_end - command->replay_start,
+                                             command->replay_ack_end - command->replay_write_end,
+                                             command->replay_end - command->replay_ack_end};
+
+    for (int phase = 0; phase < 3; phase++) {
+      captured[phase] += captured_phases[phase];
+      replayed[phase] += command->replayed ? replayed_phases[phase] : 0;
+    }
+
+    if (i > 0) {
+      captured_between += command->start - replay.command(i - 1)->end;
+    }
+
+    char frame[40];
+
+    if (!command->replayed) {
+      snprintf(frame, sizeof(frame), "not replayed");
+    } else if (command->divergence >= 0) {
+      snprintf(frame, sizeof(frame), "DIVERGES at byte %d: %02X, was %02X", command->divergence, command->written,
+               command->expected);
+    } else {
+      snprintf(frame, sizeof(frame), "same");
+    }
+
+    printf("%4d %-22s %8.2f/%7.2f/%8.2f %8.2f/%7.2f/%8.2f %5d/%5d  %s\n", i, command_name(command->frame[OPCODE_IDX]),
+           ms(captured_phases[0]), ms(captured_phases[1]), ms(captured_phases[2]), ms(replayed_phases[0]),
+           ms(replayed_phases[1]), ms(replayed_phases[2]), command->status_polls, command->replay_status_polls, frame);
+  }
+
+  unsigned long long captured_total = captured[0] + captured[1] + captured[2];
+  unsigned long long replayed_total = replayed[0] + replayed[1] + replayed[2];
+  const char* phases[3] = {"writing frames", "getting ACKs", "getting responses"};
+
+  printf("\n%-22s %12s %12s\n", "", "captured ms", "replayed ms");
+
+  for (int phase = 0; phase < 3; phase++) {
+    printf("%-22s %12.2f %12.2f\n", phases[phase], ms(captured[phase]), ms(replayed[phase]));
+  }
+
+  printf("%-22s %12.2f %12.2f\n", "total in commands", ms(captured_total), ms(replayed_total));
+  printf("%-22s %12.2f\n", "between commands", ms(captured_between));
+  printf("\n%d of %d commands diverge\n", replay.num_divergences(), num_commands);
+
+  return replay.num_divergences() ? 2 : 0;
+}
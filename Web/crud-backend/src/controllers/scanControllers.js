@@ -1,5 +1,6 @@
 import { query } from "../db.js";
 import { broadcastNewScan } from "../index.js";
+import { scanTime, saveScans } from "../services/scanServices.js";
 
 export async function addNewScan(req, res) {
   const { tag_id } = req.body;
@@ -8,12 +9,17 @@ export async function addNewScan(req, res) {
     return res.status(400).json({ message: "Missing tag_id" });
   }
 
+  // When the tag was seen, if the reader stamped it; otherwise now
+  const timestamp = scanTime(req.body.timestamp);
+
+  if (!timestamp) {
+    return res.status(400).json({ message: "Invalid timestamp" });
+  }
+
   try {
-    await query("INSERT INTO scans (tag_id, timestamp) VALUES ($1, NOW())", [
-      tag_id,
-    ]);
+    await saveScans([{ tag_id, timestamp }]);
 
-    const newScan = { tag_id, timestamp: new Date() };
+    const newScan = { tag_id, timestamp };
 
     broadcastNewScan(newScan);
 
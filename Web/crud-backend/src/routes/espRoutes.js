@@ -1,30 +1,42 @@
-import { query } from "../db.js";
 import { broadcastNewScan } from "../index.js";
+import { scanTime, saveScans } from "../services/scanServices.js";
 import express from "express";
 
 const router = express.Router();
 
+// { id, timestamp } for one scan, or { scans: [{ id, timestamp }, ...] } for a batch; timestamp is when the reader saw the
+// tag, by its synced clock (see scanServices.js)
 router.post("/esp/send-id", async (req, res) => {
-  const { id } = req.body;
+  const batch = Array.isArray(req.body.scans) ? req.body.scans : [req.body];
 
-  if (!id) {
+  if (batch.length === 0 || batch.some((scan) => !scan || !scan.id)) {
     return res.status(400).json({ error: "ID is required" });
   }
 
-  const scanData = {
-    tag_id: id,
-    timestamp: new Date().toISOString(),
-  };
+  const scans = batch.map((scan) => ({
+    tag_id: scan.id,
+    timestamp: scanTime(scan.timestamp),
+  }));
+
+  if (scans.some((scan) => !scan.timestamp)) {
+    return res.status(400).json({ error: "Invalid timestamp" });
+  }
 
   try {
-    await query("INSERT INTO scans (tag_id, timestamp) VALUES ($1, NOW())", [
-      id,
-    ]);
-    console.log("✅ Scan saved to DB from ESP:", scanData);
+    const saved = await saveScans(scans);
+    console.log("✅ Scans saved to DB from ESP:", saved);
+
+    const scanData = saved.map((scan) => ({
+      tag_id: scan.tag_id,
+      timestamp: new Date(scan.timestamp).toISOString(),
+    }));
 
-    broadcastNewScan(scanData);
+    scanData.forEach(broadcastNewScan);
 
-    res.status(200).json({ message: "Scan saved and broadcasted", scanData });
+    res.status(200).json({
+      message: "Scan saved and broadcasted",
+      scanData: Array.isArray(req.body.scans) ? scanData : scanData[0],
+    });
   } catch (err) {
     console.error("❌ Error inserting scan from ESP:", err);
     res.status(500).json({ error: "Failed to save scan" });
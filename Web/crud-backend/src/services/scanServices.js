@@ -0,0 +1,33 @@
+import { query } from "../db.js";
+
+// Readers stamp scans with their own clock, synced to ours, so scans can be sent late and in batches. A device timestamp is
+// Unix time in seconds (e.g. 1760000000.123, as on the reader's EVT lines) or an ISO 8601 string; 0 or none means the
+// reader did not know the time, and the scan is stamped on arrival instead.
+export const scanTime = (timestamp) => {
+  if (timestamp === undefined || timestamp === null || timestamp === 0 || timestamp === "0") {
+    return new Date();
+  }
+
+  const time =
+    typeof timestamp === "number" || /^\d+(\.\d+)?$/.test(timestamp)
+      ? new Date(Number(timestamp) * 1000)
+      : new Date(timestamp);
+
+  return isNaN(time.getTime()) ? null : time;
+};
+
+export const saveScans = async (scans) => {
+  // One INSERT for the whole batch; scans are { tag_id, timestamp } with timestamp a Date
+  const values = [];
+  const placeholders = scans.map((scan, i) => {
+    values.push(scan.tag_id, scan.timestamp);
+    return `($${2 * i + 1}, $${2 * i + 2})`;
+  });
+
+  const { rows } = await query(
+    `INSERT INTO scans (tag_id, timestamp) VALUES ${placeholders.join(", ")} RETURNING tag_id, timestamp`,
+    values
+  );
+
+  return rows;
+};